@@ -0,0 +1,175 @@
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <p2psc/policy/authorization.h>
+#include <random>
+#include <sstream>
+#include <vector>
+
+/**
+ * Measures policy::AuthorizationFilter at fleet scale: compiles a filter of
+ * --pairs random fingerprint pairs (each key allowed to connect to
+ * --per-key others) and times --checks checks of allowed pairs and of pairs
+ * which aren't.
+ *
+ * Usage:
+ *   p2psc_authorization [--pairs N,N,...] [--per-key N] [--checks N]
+ *                       [--bloom-bits N]
+ *
+ * Reported per size: build time, bytes of filter per pair, and mean
+ * nanoseconds per allowed and per denied check. Checks are made in a random
+ * order, so all but the smallest filters are mostly out of cache, while the
+ * fingerprints checked are read in order, as a Mediator reads them from the
+ * Advertises it has just received.
+ */
+namespace p2psc {
+namespace bench {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const std::size_t kBatchSize = 4096;
+
+struct Options {
+  std::vector<std::size_t> pairs = {10000, 1000000, 10000000};
+  std::size_t per_key = 10;
+  std::size_t checks = 1000000;
+  std::size_t bloom_bits = policy::AuthorizationFilterOptions()
+                               .bloom_bits_per_pair;
+};
+
+void usage() {
+  std::cerr << "usage: p2psc_authorization [--pairs N,N,...] [--per-key N] "
+               "[--checks N] [--bloom-bits N]"
+            << std::endl;
+  exit(1);
+}
+
+std::vector<std::size_t> parse_list(const std::string &arg) {
+  std::vector<std::size_t> values;
+  std::stringstream stream(arg);
+  std::string value;
+  while (std::getline(stream, value, ',')) {
+    values.push_back(std::stoul(value));
+  }
+  if (values.empty()) {
+    usage();
+  }
+  return values;
+}
+
+Options parse_options(int argc, char **argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      usage();
+    }
+    const std::string value = argv[++i];
+    if (arg == "--pairs") {
+      options.pairs = parse_list(value);
+    } else if (arg == "--per-key") {
+      options.per_key = std::stoul(value);
+    } else if (arg == "--checks") {
+      options.checks = std::stoul(value);
+    } else if (arg == "--bloom-bits") {
+      options.bloom_bits = std::stoul(value);
+    } else {
+      usage();
+    }
+  }
+  if (options.per_key == 0 || options.checks == 0) {
+    usage();
+  }
+  return options;
+}
+
+std::string random_fingerprint(std::mt19937_64 &random) {
+  std::string fingerprint(64, '0');
+  for (auto &c : fingerprint) {
+    c = "0123456789abcdef"[random() % 16];
+  }
+  return fingerprint;
+}
+
+// mean nanoseconds per check of pairs, picked at random
+double time_checks(const policy::AuthorizationFilter &filter,
+                   const std::vector<policy::FingerprintPair> &pairs,
+                   std::size_t checks, bool expected) {
+  std::mt19937_64 random(2);
+  std::vector<policy::FingerprintPair> batch;
+  std::size_t mismatches = 0;
+  Clock::duration elapsed(0);
+  for (std::size_t checked = 0; checked < checks; checked += batch.size()) {
+    // copied out first, so that they're read in order like received
+    // Advertises rather than from all over pairs
+    batch.clear();
+    for (std::size_t i = 0; i < kBatchSize && checked + i < checks; i++) {
+      batch.push_back(pairs[random() % pairs.size()]);
+    }
+    const auto start = Clock::now();
+    for (const auto &pair : batch) {
+      mismatches += filter.allows(pair.first, pair.second) != expected;
+    }
+    elapsed += Clock::now() - start;
+  }
+  if (mismatches) {
+    std::cerr << mismatches << " checks gave the wrong answer" << std::endl;
+    exit(1);
+  }
+  return std::chrono::duration<double, std::nano>(elapsed).count() / checks;
+}
+}
+}
+}
+
+int main(int argc, char **argv) {
+  using namespace p2psc;
+  using namespace p2psc::bench;
+
+  const auto options = parse_options(argc, argv);
+  const auto path = (boost::filesystem::temp_directory_path() /
+                     boost::filesystem::unique_path())
+                        .string();
+  policy::AuthorizationFilterOptions filter_options;
+  filter_options.bloom_bits_per_pair = options.bloom_bits;
+
+  std::cout << std::setw(10) << "pairs" << std::setw(12) << "build ms"
+            << std::setw(14) << "bytes/pair" << std::setw(14)
+            << "allowed ns" << std::setw(14) << "denied ns" << std::endl;
+  for (const auto count : options.pairs) {
+    std::mt19937_64 random(1);
+    std::vector<std::string> keys;
+    for (std::size_t i = 0; i < count / options.per_key + options.per_key;
+         i++) {
+      keys.push_back(random_fingerprint(random));
+    }
+    std::vector<policy::FingerprintPair> allowed;
+    std::vector<policy::FingerprintPair> denied;
+    for (std::size_t i = 0; allowed.size() < count; i++) {
+      allowed.emplace_back(keys[i / options.per_key],
+                           keys[i / options.per_key + 1 + i % options.per_key]);
+      // the same keys, the other way round
+      denied.emplace_back(allowed.back().second, allowed.back().first);
+    }
+
+    const auto start = Clock::now();
+    policy::AuthorizationFilter::build(allowed, path, filter_options);
+    const auto build_ms =
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count();
+    const auto filter = policy::AuthorizationFilter::open(path);
+    const auto allowed_ns =
+        time_checks(*filter, allowed, options.checks, true);
+    const auto denied_ns = time_checks(*filter, denied, options.checks, false);
+
+    std::cout << std::setw(10) << count << std::setw(12) << std::fixed
+              << std::setprecision(0) << build_ms << std::setw(14)
+              << std::setprecision(1)
+              << static_cast<double>(filter->size()) / count << std::setw(14)
+              << allowed_ns << std::setw(14) << denied_ns << std::endl;
+  }
+  boost::filesystem::remove(path);
+  return 0;
+}
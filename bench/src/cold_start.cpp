@@ -0,0 +1,285 @@
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <crypto/rsa.h>
+#include <fcntl.h>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <p2psc/connection.h>
+#include <p2psc/key/keypair.h>
+#include <spawn.h>
+#include <sstream>
+#include <src/util/fake_mediator.h>
+#include <src/util/peer_pair.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+extern char **environ;
+
+/**
+ * Measures how long a short-lived tool takes from being started to its first
+ * established connection. For each run, this process starts a copy of itself
+ * as the tool, which loads its key from a file and connects to a peer in
+ * this process through a local FakeMediator, then exits. The tool's log is
+ * discarded.
+ *
+ * Usage:
+ *   p2psc_cold_start [--runs N] [--formats pem,der] [--max-ms N]
+ *
+ * Reported per key file format, as percentiles over --runs: the time until
+ * the tool's main() runs (loading and initialising the libraries), loading
+ * the key, connecting, and in total. With --max-ms, exits with status 2 if
+ * the median total of any format exceeds it, so it can guard against
+ * regressions.
+ */
+namespace p2psc {
+namespace bench {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const auto kConnectTimeout = std::chrono::milliseconds(10000);
+// where the tool reports; its stdout has p2psc's log
+const int kReportFd = 3;
+
+struct Options {
+  std::size_t runs = 10;
+  std::vector<std::string> formats = {"pem", "der"};
+  double max_ms = 0;
+};
+
+// in ms: until the tool's main(), each phase, and from start to connected
+struct Run {
+  double main_ms;
+  double key_ms;
+  double connect_ms;
+  double total_ms;
+};
+
+void usage() {
+  std::cerr << "usage: p2psc_cold_start [--runs N] [--formats pem,der] "
+               "[--max-ms N]"
+            << std::endl;
+  exit(1);
+}
+
+Options parse_options(int argc, char **argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      usage();
+    }
+    const std::string value = argv[++i];
+    if (arg == "--runs") {
+      options.runs = std::stoul(value);
+    } else if (arg == "--formats") {
+      options.formats.clear();
+      std::stringstream stream(value);
+      std::string format;
+      while (std::getline(stream, format, ',')) {
+        if (format != "pem" && format != "der") {
+          usage();
+        }
+        options.formats.push_back(format);
+      }
+    } else if (arg == "--max-ms") {
+      options.max_ms = std::stod(value);
+    } else {
+      usage();
+    }
+  }
+  if (options.runs == 0 || options.formats.empty()) {
+    usage();
+  }
+  return options;
+}
+
+std::int64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             Clock::now().time_since_epoch())
+      .count();
+}
+
+std::string read_file(const std::string &path) {
+  std::ifstream file(path);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+/*
+ * The tool: load the key at key_path and connect to the peer whose public key
+ * is in peer_path. Writes to kReportFd the steady clock (which all processes
+ * share) at main(), after loading the key and once connected.
+ */
+int run_tool(const std::string &format, const std::string &key_path,
+             const std::string &peer_path, const std::string &ip,
+             std::uint16_t port) {
+  const auto main_ns = now_ns();
+  const auto keypair = format == "der" ? key::Keypair::from_der(key_path)
+                                       : key::Keypair::from_pem(key_path);
+  const auto key_ns = now_ns();
+  std::promise<std::shared_ptr<Socket>> connected;
+  Connection::connect<PlainSocketFactory>(
+      keypair, Peer(key::PublicKey::from_string(read_file(peer_path))),
+      Mediator(ip, port), [&](Error, std::shared_ptr<Socket> socket) {
+        connected.set_value(socket);
+      });
+  auto future = connected.get_future();
+  if (future.wait_for(kConnectTimeout) != std::future_status::ready ||
+      !future.get()) {
+    return 1;
+  }
+  const auto report = std::to_string(main_ns) + " " + std::to_string(key_ns) +
+                      " " + std::to_string(now_ns()) + "\n";
+  return write(kReportFd, report.data(), report.size()) ==
+                 static_cast<ssize_t>(report.size())
+             ? 0
+             : 1;
+}
+
+// Start this executable as the tool, returning its report.
+std::string spawn_tool(const std::vector<std::string> &args) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    throw std::runtime_error("Failed to create pipe");
+  }
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, fds[1], kReportFd);
+  posix_spawn_file_actions_addclose(&actions, fds[0]);
+  posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null",
+                                   O_WRONLY, 0);
+  std::vector<char *> argv;
+  for (const auto &arg : args) {
+    argv.push_back(const_cast<char *>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+  pid_t pid;
+  const auto error = posix_spawn(&pid, "/proc/self/exe", &actions, nullptr,
+                                 argv.data(), environ);
+  posix_spawn_file_actions_destroy(&actions);
+  close(fds[1]);
+  if (error != 0) {
+    close(fds[0]);
+    throw std::runtime_error("Failed to start tool");
+  }
+  std::string output;
+  char buffer[256];
+  ssize_t count;
+  while ((count = read(fds[0], buffer, sizeof(buffer))) > 0) {
+    output.append(buffer, count);
+  }
+  close(fds[0]);
+  int status;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    throw std::runtime_error("Tool failed to connect");
+  }
+  return output;
+}
+
+Run run_once(const Mediator &mediator, const std::string &format,
+             const boost::filesystem::path &directory) {
+  // keys are generated for every run, so that the Mediator sees new ones
+  const auto tool_key = crypto::RSA::generate();
+  const auto key_path = (directory / ("key." + format)).string();
+  if (format == "der") {
+    tool_key->write_der_to_file(key_path);
+  } else {
+    tool_key->write_to_file(key_path);
+  }
+  const auto keypair = key::Keypair::generate();
+  const auto peer_path = (directory / "peer.pub").string();
+  std::ofstream(peer_path) << keypair.get_serialised_public_key();
+
+  std::promise<std::shared_ptr<Socket>> connected;
+  Connection::connect<PlainSocketFactory>(
+      keypair,
+      Peer(key::PublicKey::from_string(tool_key->get_public_key_string())),
+      mediator, [&](Error, std::shared_ptr<Socket> socket) {
+        connected.set_value(socket);
+      });
+  const auto start_ns = now_ns();
+  std::stringstream output(spawn_tool(
+      {"p2psc_cold_start", "--tool", format, key_path, peer_path,
+       mediator.socket_address.ip(),
+       std::to_string(mediator.socket_address.port())}));
+  std::int64_t main_ns, key_ns, connected_ns;
+  if (!(output >> main_ns >> key_ns >> connected_ns)) {
+    throw std::runtime_error("Tool reported nothing");
+  }
+  auto future = connected.get_future();
+  if (future.wait_for(kConnectTimeout) != std::future_status::ready ||
+      !future.get()) {
+    throw std::runtime_error("Failed to connect to tool");
+  }
+  const auto ms = [](std::int64_t ns) { return ns / 1e6; };
+  return Run{ms(main_ns - start_ns), ms(key_ns - main_ns),
+             ms(connected_ns - key_ns), ms(connected_ns - start_ns)};
+}
+
+void report(const std::string &name, std::vector<double> &values) {
+  std::cout << std::setw(10) << name << std::setw(12) << std::fixed
+            << std::setprecision(2) << util::percentile(values, 0.5)
+            << std::setw(12) << util::percentile(values, 1) << std::endl;
+}
+}
+}
+}
+
+int main(int argc, char **argv) {
+  using namespace p2psc;
+  using namespace p2psc::bench;
+
+  if (argc == 7 && std::string(argv[1]) == "--tool") {
+    return run_tool(argv[2], argv[3], argv[4], argv[5],
+                    static_cast<std::uint16_t>(std::stoul(argv[6])));
+  }
+  const auto options = parse_options(argc, argv);
+  integration::util::FakeMediator mediator(util::plain_socket_creator());
+  mediator.set_record_messages(false);
+  mediator.run();
+  const auto directory = boost::filesystem::temp_directory_path() /
+                         boost::filesystem::unique_path();
+  boost::filesystem::create_directory(directory);
+
+  bool within_bound = true;
+  for (const auto &format : options.formats) {
+    std::vector<double> main_ms, key_ms, connect_ms, total_ms;
+    try {
+      for (std::size_t i = 0; i < options.runs; i++) {
+        const auto run =
+            run_once(mediator.get_mediator_description(), format, directory);
+        main_ms.push_back(run.main_ms);
+        key_ms.push_back(run.key_ms);
+        connect_ms.push_back(run.connect_ms);
+        total_ms.push_back(run.total_ms);
+      }
+    } catch (const std::runtime_error &e) {
+      std::cerr << e.what() << std::endl;
+      boost::filesystem::remove_all(directory);
+      return 1;
+    }
+    std::cout << std::endl
+              << "key format: " << format << ", runs: " << options.runs
+              << std::endl
+              << std::setw(10) << "" << std::setw(12) << "p50 ms"
+              << std::setw(12) << "max ms" << std::endl;
+    report("to main", main_ms);
+    report("load key", key_ms);
+    report("connect", connect_ms);
+    report("total", total_ms);
+    if (options.max_ms > 0 &&
+        util::percentile(total_ms, 0.5) > options.max_ms) {
+      std::cout << "median total exceeds " << options.max_ms << "ms"
+                << std::endl;
+      within_bound = false;
+    }
+  }
+  boost::filesystem::remove_all(directory);
+  return within_bound ? 0 : 2;
+}
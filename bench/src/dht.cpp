@@ -0,0 +1,220 @@
+#include <chrono>
+#include <csignal>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <p2psc/connection.h>
+#include <p2psc/dht/dht.h>
+#include <p2psc/key/public_key.h>
+#include <src/util/peer_pair.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * Measures DHT lookups and rendezvous against a DHT of --nodes node
+ * processes on loopback. The first process is the seed, which the others
+ * bootstrap through. This process then joins with a node of its own and, for
+ * --lookups records, publishes one and looks it up, and finally sets up
+ * --connections connections through Connection::connect with the DHT as the
+ * only way to meet (the Mediator is unreachable).
+ *
+ * Usage:
+ *   p2psc_dht [--nodes N] [--lookups N] [--connections N]
+ *
+ * Reported: latency percentiles of publishing, of looking up and of
+ * connecting, and how many lookups found their record.
+ */
+namespace p2psc {
+namespace bench {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const uint64_t kConnectTimeoutMs = 10000;
+
+struct Options {
+  std::size_t nodes = 50;
+  std::size_t lookups = 100;
+  std::size_t connections = 5;
+};
+
+void usage() {
+  std::cerr << "usage: p2psc_dht [--nodes N] [--lookups N] [--connections N]"
+            << std::endl;
+  exit(1);
+}
+
+Options parse_options(int argc, char **argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      usage();
+    }
+    const std::string value = argv[++i];
+    if (arg == "--nodes") {
+      options.nodes = std::stoul(value);
+    } else if (arg == "--lookups") {
+      options.lookups = std::stoul(value);
+    } else if (arg == "--connections") {
+      options.connections = std::stoul(value);
+    } else {
+      usage();
+    }
+  }
+  if (options.nodes == 0) {
+    usage();
+  }
+  return options;
+}
+
+double elapsed_ms(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+/*
+ * Run a node in a child process until we exit, bootstrapping through seed
+ * unless it's 0. Once it's ready, the child writes its port to ready_fd.
+ */
+pid_t spawn_node(std::uint16_t seed, int ready_fd) {
+  const auto pid = fork();
+  if (pid != 0) {
+    return pid;
+  }
+  prctl(PR_SET_PDEATHSIG, SIGKILL);
+  dht::Node node;
+  if (seed != 0) {
+    node.bootstrap({socket::SocketAddress(socket::local_ip, seed)});
+  }
+  const auto port = node.port();
+  if (write(ready_fd, &port, sizeof(port)) != sizeof(port)) {
+    _exit(1);
+  }
+  while (true) {
+    pause();
+  }
+}
+
+std::uint16_t wait_for_node(int ready_fd) {
+  std::uint16_t port;
+  if (read(ready_fd, &port, sizeof(port)) != sizeof(port)) {
+    std::cerr << "Node process failed" << std::endl;
+    exit(1);
+  }
+  return port;
+}
+
+Peer peer_of(const key::Keypair &keypair) {
+  return Peer(key::PublicKey::from_string(keypair.get_serialised_public_key()));
+}
+
+// Connect each pair of keys through the DHT, and return how long each took.
+std::vector<double> connect(const std::vector<util::KeypairPair> &keypairs) {
+  // nothing listens here, so connecting only succeeds through the DHT
+  const Mediator mediator("127.0.0.1", 1);
+  std::vector<double> latencies_ms;
+  for (const auto &keypair : keypairs) {
+    std::promise<std::shared_ptr<Socket>> client, peer;
+    const auto start = Clock::now();
+    Connection::connect<PlainSocketFactory>(
+        keypair.first, peer_of(keypair.second), mediator,
+        [&](Error, std::shared_ptr<Socket> socket) {
+          client.set_value(socket);
+        });
+    Connection::connect<PlainSocketFactory>(
+        keypair.second, peer_of(keypair.first), mediator,
+        [&](Error, std::shared_ptr<Socket> socket) {
+          peer.set_value(socket);
+        });
+    auto client_future = client.get_future();
+    auto peer_future = peer.get_future();
+    const auto deadline = start + std::chrono::milliseconds(kConnectTimeoutMs);
+    if (client_future.wait_until(deadline) != std::future_status::ready ||
+        peer_future.wait_until(deadline) != std::future_status::ready ||
+        !client_future.get() || !peer_future.get()) {
+      std::cerr << "Failed to connect through DHT" << std::endl;
+      exit(1);
+    }
+    latencies_ms.push_back(elapsed_ms(start));
+  }
+  return latencies_ms;
+}
+
+void report(const std::string &name, std::vector<double> &latencies_ms) {
+  std::cout << std::setw(12) << name << std::setw(8) << latencies_ms.size()
+            << std::setw(12) << std::fixed << std::setprecision(2)
+            << util::percentile(latencies_ms, 0.5) << std::setw(12)
+            << util::percentile(latencies_ms, 0.99) << std::endl;
+}
+}
+}
+}
+
+int main(int argc, char **argv) {
+  using namespace p2psc;
+  using namespace p2psc::bench;
+
+  const auto options = parse_options(argc, argv);
+  // Nodes are started before this process has any threads, so that forking
+  // is safe.
+  int ready_fds[2];
+  if (pipe(ready_fds) != 0) {
+    std::cerr << "Failed to create pipe" << std::endl;
+    return 1;
+  }
+  std::vector<pid_t> children;
+  children.push_back(spawn_node(0, ready_fds[1]));
+  const auto seed_port = wait_for_node(ready_fds[0]);
+  for (std::size_t i = 1; i < options.nodes; i++) {
+    children.push_back(spawn_node(seed_port, ready_fds[1]));
+  }
+  for (std::size_t i = 1; i < options.nodes; i++) {
+    wait_for_node(ready_fds[0]);
+  }
+
+  const std::vector<socket::SocketAddress> seed = {
+      socket::SocketAddress(socket::local_ip, seed_port)};
+  auto start = Clock::now();
+  const auto publisher = std::make_shared<dht::Node>();
+  publisher->bootstrap(seed);
+  std::vector<double> bootstrap_ms = {elapsed_ms(start)};
+  dht::Node finder;
+  finder.bootstrap(seed);
+
+  const auto keypair = key::Keypair::generate();
+  const auto fingerprint = peer_of(keypair).public_key.fingerprint();
+  std::vector<double> publish_ms, find_ms;
+  std::size_t found = 0;
+  for (std::size_t i = 0; i < options.lookups; i++) {
+    const auto to = "peer" + std::to_string(i);
+    start = Clock::now();
+    publisher->publish(keypair, to, 1337);
+    publish_ms.push_back(elapsed_ms(start));
+    start = Clock::now();
+    found += finder.find(fingerprint, to) ? 1 : 0;
+    find_ms.push_back(elapsed_ms(start));
+  }
+
+  dht::set_dht(publisher);
+  auto connect_ms = connect(util::generate_keypairs(options.connections));
+  dht::set_dht(nullptr);
+  for (const auto child : children) {
+    kill(child, SIGKILL);
+    waitpid(child, nullptr, 0);
+  }
+
+  std::cout << std::endl
+            << "nodes: " << options.nodes << ", known by ours: "
+            << publisher->known_nodes() << ", records found: " << found << "/"
+            << options.lookups << std::endl
+            << std::setw(12) << "" << std::setw(8) << "count" << std::setw(12)
+            << "p50 ms" << std::setw(12) << "p99 ms" << std::endl;
+  report("bootstrap", bootstrap_ms);
+  report("publish", publish_ms);
+  report("find", find_ms);
+  report("connect", connect_ms);
+  return found == options.lookups ? 0 : 2;
+}
@@ -0,0 +1,277 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <p2psc/capture/capture.h>
+#include <p2psc/capture/capture_exception.h>
+#include <p2psc/socket/socket.h>
+#include <src/util/peer_pair.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * Replays a capture recorded with a capture::RecordingSocket against a
+ * Mediator, preserving the timing (scaled by --speed) of every connection and
+ * every message in it.
+ *
+ * Usage:
+ *   p2psc_replay --capture FILE --target IP:PORT [--speed N|max]
+ *                [--only-remote IP:PORT] [--timeout-ms N]
+ *
+ * --only-remote restricts the replay to connections which, when captured, were
+ * made to the given address (usually the production Mediator), since a
+ * Client's capture also contains its connections to other Peers.
+ *
+ * The target may split or merge its replies differently from the capture, so
+ * replies are waited for by their byte counts rather than one receive() per
+ * recorded message. A session fails if the target sends nothing for
+ * --timeout-ms (5000 by default).
+ *
+ * Note that replayed AdvertiseResponses carry the nonces of the original
+ * session, so a Mediator which verifies them will reject the replayed
+ * connections after the AdvertiseChallenge. The load shape up to and
+ * including that point is still faithful.
+ */
+namespace p2psc {
+namespace bench {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Session {
+  std::string remote;
+  std::vector<capture::Record> records;
+};
+
+struct Options {
+  std::string capture_path;
+  std::string target_ip;
+  std::uint16_t target_port = 0;
+  // 0 means replay as fast as possible
+  double speed = 1.0;
+  std::string only_remote;
+  std::chrono::milliseconds timeout = std::chrono::milliseconds(5000);
+};
+
+struct Stats {
+  std::mutex mutex;
+  std::uint64_t sessions = 0;
+  std::uint64_t failed_sessions = 0;
+  std::uint64_t messages_sent = 0;
+  std::uint64_t messages_received = 0;
+  std::vector<double> response_latencies_ms;
+};
+
+void usage() {
+  std::cerr << "usage: p2psc_replay --capture FILE --target IP:PORT "
+               "[--speed N|max] [--only-remote IP:PORT] [--timeout-ms N]"
+            << std::endl;
+  exit(1);
+}
+
+std::pair<std::string, std::uint16_t> parse_address(const std::string &arg) {
+  const auto colon = arg.rfind(':');
+  if (colon == std::string::npos) {
+    usage();
+  }
+  return {arg.substr(0, colon),
+          static_cast<std::uint16_t>(std::stoi(arg.substr(colon + 1)))};
+}
+
+Options parse_options(int argc, char **argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      usage();
+    }
+    const std::string value = argv[++i];
+    if (arg == "--capture") {
+      options.capture_path = value;
+    } else if (arg == "--target") {
+      const auto address = parse_address(value);
+      options.target_ip = address.first;
+      options.target_port = address.second;
+    } else if (arg == "--speed") {
+      options.speed = value == "max" ? 0 : std::stod(value);
+    } else if (arg == "--only-remote") {
+      options.only_remote = value;
+    } else if (arg == "--timeout-ms") {
+      options.timeout = std::chrono::milliseconds(std::stoul(value));
+    } else {
+      usage();
+    }
+  }
+  if (options.capture_path.empty() || options.target_ip.empty()) {
+    usage();
+  }
+  return options;
+}
+
+std::vector<Session> load_sessions(const Options &options) {
+  std::map<std::uint32_t, Session> sessions;
+  const auto reader = capture::CaptureReader::open(options.capture_path);
+  while (const auto record = reader->next()) {
+    auto &session = sessions[record->connection_id];
+    if (record->event == capture::kEventOpen) {
+      session.remote = record->data;
+    }
+    session.records.push_back(*record);
+  }
+
+  std::vector<Session> result;
+  for (auto &session : sessions) {
+    if (session.second.records.empty() ||
+        session.second.records[0].event != capture::kEventOpen) {
+      // the capture started after this connection was opened
+      continue;
+    }
+    if (!options.only_remote.empty() &&
+        session.second.remote != options.only_remote) {
+      continue;
+    }
+    result.push_back(std::move(session.second));
+  }
+  return result;
+}
+
+void sleep_until_scheduled(Clock::time_point start, std::uint64_t capture_start,
+                           std::uint64_t timestamp_us, double speed) {
+  if (speed == 0) {
+    return;
+  }
+  const auto offset = std::chrono::microseconds(static_cast<std::uint64_t>(
+      (timestamp_us - capture_start) / speed));
+  std::this_thread::sleep_until(start + offset);
+}
+
+// A connection to the target, on which receives time out after timeout.
+std::unique_ptr<Socket> connect(const Options &options) {
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(options.target_port);
+  inet_pton(AF_INET, options.target_ip.c_str(), &address.sin_addr);
+  const auto sock_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  struct timeval timeout;
+  timeout.tv_sec = options.timeout.count() / 1000;
+  timeout.tv_usec = options.timeout.count() % 1000 * 1000;
+  if (sock_fd == -1 ||
+      setsockopt(sock_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+                 sizeof(timeout)) != 0 ||
+      ::connect(sock_fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+    const auto error = errno;
+    if (sock_fd != -1) {
+      ::close(sock_fd);
+    }
+    throw socket::SocketException("Failed to connect to target: " +
+                                  std::string(strerror(error)));
+  }
+  return std::make_unique<Socket>(sock_fd);
+}
+
+void replay_session(const Options &options, const Session &session,
+                    Clock::time_point start, std::uint64_t capture_start,
+                    Stats &stats) {
+  std::vector<double> latencies_ms;
+  std::uint64_t sent = 0, received = 0;
+  bool failed = false;
+
+  sleep_until_scheduled(start, capture_start, session.records[0].timestamp_us,
+                        options.speed);
+  try {
+    const auto replay_socket = connect(options);
+    auto last_send = Clock::now();
+    // bytes the capture received so far, and that we have
+    std::uint64_t expected_bytes = 0, received_bytes = 0;
+    for (const auto &record : session.records) {
+      if (record.event == capture::kEventSent) {
+        sleep_until_scheduled(start, capture_start, record.timestamp_us,
+                              options.speed);
+        replay_socket->send(record.data);
+        last_send = Clock::now();
+        sent++;
+      } else if (record.event == capture::kEventReceived) {
+        expected_bytes += record.data.size();
+        while (received_bytes < expected_bytes) {
+          received_bytes += replay_socket->receive().size();
+        }
+        latencies_ms.push_back(
+            std::chrono::duration<double, std::milli>(Clock::now() - last_send)
+                .count());
+        received++;
+      } else if (record.event == capture::kEventClose) {
+        break;
+      }
+    }
+  } catch (const socket::SocketException &e) {
+    failed = true;
+  }
+
+  std::lock_guard<std::mutex> guard(stats.mutex);
+  stats.sessions++;
+  stats.failed_sessions += failed ? 1 : 0;
+  stats.messages_sent += sent;
+  stats.messages_received += received;
+  stats.response_latencies_ms.insert(stats.response_latencies_ms.end(),
+                                     latencies_ms.begin(), latencies_ms.end());
+}
+
+}
+}
+}
+
+int main(int argc, char **argv) {
+  using namespace p2psc::bench;
+
+  const auto options = parse_options(argc, argv);
+  std::vector<Session> sessions;
+  try {
+    sessions = load_sessions(options);
+  } catch (const p2psc::capture::CaptureException &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  if (sessions.empty()) {
+    std::cerr << "No complete connections in capture" << std::endl;
+    return 1;
+  }
+
+  std::uint64_t capture_start = sessions[0].records[0].timestamp_us;
+  for (const auto &session : sessions) {
+    capture_start = std::min(capture_start, session.records[0].timestamp_us);
+  }
+
+  Stats stats;
+  const auto start = Clock::now();
+  std::vector<std::thread> threads;
+  for (const auto &session : sessions) {
+    threads.emplace_back(replay_session, std::cref(options), std::cref(session),
+                         start, capture_start, std::ref(stats));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  const auto elapsed_s =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::cout << "sessions:          " << stats.sessions << " ("
+            << stats.failed_sessions << " failed)" << std::endl
+            << "messages sent:     " << stats.messages_sent << std::endl
+            << "messages received: " << stats.messages_received << std::endl
+            << "elapsed:           " << elapsed_s << "s" << std::endl
+            << "sessions/s:        " << stats.sessions / elapsed_s << std::endl
+            << "response p50:      "
+            << util::percentile(stats.response_latencies_ms, 0.5) << "ms"
+            << std::endl
+            << "response p99:      "
+            << util::percentile(stats.response_latencies_ms, 0.99) << "ms"
+            << std::endl;
+  return stats.failed_sessions == 0 ? 0 : 2;
+}
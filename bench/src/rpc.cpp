@@ -0,0 +1,196 @@
+#include <chrono>
+#include <condition_variable>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <p2psc/rpc/channel.h>
+#include <p2psc/socket/buffered_socket.h>
+#include <sstream>
+#include <src/util/fake_mediator.h>
+#include <src/util/peer_pair.h>
+#include <vector>
+
+/**
+ * Measures the call rate and latency of an rpc::Channel over one connection
+ * set up through the full p2psc flow against a local FakeMediator.
+ *
+ * Usage:
+ *   p2psc_rpc [--size N] [--outstanding N,N,...] [--duration-ms N]
+ *             [--flush-delay-us N]
+ *
+ * The Peer's channel answers every call straight away with its request. For
+ * each --outstanding level, the Client keeps that many calls of --size bytes
+ * in flight for --duration-ms. Reported per level: calls per second and call
+ * latency percentiles. With --flush-delay-us, both ends' sockets are
+ * BufferedSockets with that flush delay.
+ */
+namespace p2psc {
+namespace bench {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const uint64_t kConnectTimeoutMs = 10000;
+const auto kCallTimeout = std::chrono::milliseconds(10000);
+
+struct Options {
+  std::size_t size = 64;
+  std::vector<std::size_t> outstanding = {1, 16, 256};
+  uint64_t duration_ms = 2000;
+  uint64_t flush_delay_us = 0;
+};
+
+struct Result {
+  std::uint64_t calls = 0;
+  std::uint64_t failures = 0;
+  double elapsed_s = 0;
+  std::vector<double> latencies_us;
+};
+
+void usage() {
+  std::cerr << "usage: p2psc_rpc [--size N] [--outstanding N,N,...] "
+               "[--duration-ms N] [--flush-delay-us N]"
+            << std::endl;
+  exit(1);
+}
+
+std::vector<std::size_t> parse_list(const std::string &arg) {
+  std::vector<std::size_t> values;
+  std::stringstream stream(arg);
+  std::string value;
+  while (std::getline(stream, value, ',')) {
+    values.push_back(std::stoul(value));
+  }
+  if (values.empty()) {
+    usage();
+  }
+  return values;
+}
+
+Options parse_options(int argc, char **argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      usage();
+    }
+    const std::string value = argv[++i];
+    if (arg == "--size") {
+      options.size = std::stoul(value);
+    } else if (arg == "--outstanding") {
+      options.outstanding = parse_list(value);
+    } else if (arg == "--duration-ms") {
+      options.duration_ms = std::stoull(value);
+    } else if (arg == "--flush-delay-us") {
+      options.flush_delay_us = std::stoull(value);
+    } else {
+      usage();
+    }
+  }
+  for (const auto outstanding : options.outstanding) {
+    if (outstanding == 0) {
+      usage();
+    }
+  }
+  return options;
+}
+
+std::shared_ptr<Socket> wrap(std::shared_ptr<Socket> socket,
+                             uint64_t flush_delay_us) {
+  if (flush_delay_us == 0) {
+    return socket;
+  }
+  socket::BufferedOptions options;
+  options.flush_delay_us = flush_delay_us;
+  return std::make_shared<socket::BufferedSocket>(socket, options);
+}
+
+// Calls are made from this thread rather than from callbacks, which run on
+// the channel's receive thread and mustn't block.
+Result run(rpc::Channel &channel, std::size_t size, std::size_t outstanding,
+           uint64_t duration_ms) {
+  Result result;
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::size_t in_flight = 0;
+  const auto request = std::string(size, 'x');
+  const auto start = Clock::now();
+  const auto deadline = start + std::chrono::milliseconds(duration_ms);
+
+  std::unique_lock<std::mutex> lock(mutex);
+  while (Clock::now() < deadline) {
+    cv.wait(lock, [&]() { return in_flight < outstanding; });
+    in_flight++;
+    lock.unlock();
+    const auto sent_at = Clock::now();
+    channel.call("echo", request, kCallTimeout,
+                 [&, sent_at](Error error, rpc::Payload) {
+                   const auto latency_us =
+                       std::chrono::duration<double, std::micro>(
+                           Clock::now() - sent_at)
+                           .count();
+                   std::lock_guard<std::mutex> guard(mutex);
+                   if (error) {
+                     result.failures++;
+                   } else {
+                     result.calls++;
+                     result.latencies_us.push_back(latency_us);
+                   }
+                   in_flight--;
+                   cv.notify_one();
+                 });
+    lock.lock();
+  }
+  cv.wait(lock, [&]() { return in_flight == 0; });
+  result.elapsed_s =
+      std::chrono::duration<double>(Clock::now() - start).count();
+  return result;
+}
+}
+}
+}
+
+int main(int argc, char **argv) {
+  using namespace p2psc;
+  using namespace p2psc::bench;
+
+  const auto options = parse_options(argc, argv);
+  integration::util::FakeMediator mediator(util::plain_socket_creator());
+  mediator.run();
+  std::vector<util::PeerPair> pairs;
+  try {
+    pairs = util::connect_pairs(mediator.get_mediator_description(),
+                                util::plain_socket_creator(), 1,
+                                kConnectTimeoutMs);
+  } catch (const std::runtime_error &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  rpc::Channel server(wrap(pairs[0].peer, options.flush_delay_us),
+                      [](const std::string &, rpc::Payload request,
+                         rpc::Responder responder) {
+                        responder.respond(request.to_string());
+                      });
+  rpc::Channel client(wrap(pairs[0].client, options.flush_delay_us));
+
+  std::stringstream report;
+  report << std::setw(12) << "outstanding" << std::setw(14) << "calls/s"
+         << std::setw(12) << "p50 us" << std::setw(12) << "p99 us"
+         << std::setw(10) << "failed" << std::endl;
+  for (const auto outstanding : options.outstanding) {
+    auto result =
+        run(client, options.size, outstanding, options.duration_ms);
+    report << std::setw(12) << outstanding << std::setw(14) << std::fixed
+           << std::setprecision(0) << result.calls / result.elapsed_s
+           << std::setw(12) << std::setprecision(1)
+           << util::percentile(result.latencies_us, 0.5) << std::setw(12)
+           << util::percentile(result.latencies_us, 0.99) << std::setw(10)
+           << result.failures << std::endl;
+  }
+
+  std::cout << std::endl
+            << "size: " << options.size
+            << ", flush delay: " << options.flush_delay_us << "us" << std::endl
+            << report.str();
+  return 0;
+}
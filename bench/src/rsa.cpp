@@ -0,0 +1,140 @@
+#include <chrono>
+#include <crypto/rsa.h>
+#include <iomanip>
+#include <iostream>
+#include <p2psc/crypto/crypto_exception.h>
+#include <sstream>
+#include <vector>
+
+/**
+ * Compares RSA key variants: for every combination of key size and number of
+ * primes, generates --keys keys and times --operations of each RSA operation
+ * the handshake makes with one of them.
+ *
+ * Usage:
+ *   p2psc_rsa [--sizes 2048,3072,...] [--primes 2,3,...] [--keys N]
+ *             [--operations N]
+ *
+ * Reported per variant: mean key generation time, and operations per second
+ * of private decryption (answering a challenge), private encryption
+ * (signing) and public encryption (challenging). Combinations OpenSSL
+ * doesn't allow are skipped.
+ */
+namespace p2psc {
+namespace bench {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  std::vector<std::size_t> sizes = {2048, 3072, 4096};
+  std::vector<std::size_t> primes = {2, 3};
+  std::size_t keys = 4;
+  std::size_t operations = 2000;
+};
+
+void usage() {
+  std::cerr << "usage: p2psc_rsa [--sizes N,N,...] [--primes N,N,...] "
+               "[--keys N] [--operations N]"
+            << std::endl;
+  exit(1);
+}
+
+std::vector<std::size_t> parse_list(const std::string &arg) {
+  std::vector<std::size_t> values;
+  std::stringstream stream(arg);
+  std::string value;
+  while (std::getline(stream, value, ',')) {
+    values.push_back(std::stoul(value));
+  }
+  if (values.empty()) {
+    usage();
+  }
+  return values;
+}
+
+Options parse_options(int argc, char **argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      usage();
+    }
+    const std::string value = argv[++i];
+    if (arg == "--sizes") {
+      options.sizes = parse_list(value);
+    } else if (arg == "--primes") {
+      options.primes = parse_list(value);
+    } else if (arg == "--keys") {
+      options.keys = std::stoul(value);
+    } else if (arg == "--operations") {
+      options.operations = std::stoul(value);
+    } else {
+      usage();
+    }
+  }
+  if (options.keys == 0 || options.operations == 0) {
+    usage();
+  }
+  return options;
+}
+
+template <typename Operation>
+double operations_per_second(std::size_t operations, Operation operation) {
+  const auto start = Clock::now();
+  for (std::size_t i = 0; i < operations; i++) {
+    operation();
+  }
+  return operations /
+         std::chrono::duration<double>(Clock::now() - start).count();
+}
+}
+}
+}
+
+int main(int argc, char **argv) {
+  using namespace p2psc;
+  using namespace p2psc::bench;
+
+  const auto options = parse_options(argc, argv);
+  // as long as the handshake's nonces
+  const auto message = std::string(32, 'x');
+
+  std::cout << std::setw(6) << "bits" << std::setw(8) << "primes"
+            << std::setw(12) << "keygen ms" << std::setw(14) << "decrypt/s"
+            << std::setw(12) << "sign/s" << std::setw(14) << "encrypt/s"
+            << std::endl;
+  for (const auto size : options.sizes) {
+    for (const auto primes : options.primes) {
+      std::vector<std::shared_ptr<crypto::RSA>> keys;
+      const auto start = Clock::now();
+      try {
+        for (std::size_t i = 0; i < options.keys; i++) {
+          keys.push_back(crypto::RSA::generate(size, primes));
+        }
+      } catch (const crypto::CryptoException &e) {
+        continue;
+      }
+      const auto keygen_ms =
+          std::chrono::duration<double, std::milli>(Clock::now() - start)
+              .count() /
+          options.keys;
+
+      const auto &key = *keys.front();
+      const auto encrypted = key.public_encrypt(message);
+      const auto decrypts = operations_per_second(
+          options.operations, [&]() { key.private_decrypt(encrypted); });
+      const auto signs = operations_per_second(
+          options.operations, [&]() { key.private_encrypt(message); });
+      const auto encrypts = operations_per_second(
+          options.operations, [&]() { key.public_encrypt(message); });
+
+      std::cout << std::setw(6) << size << std::setw(8) << primes
+                << std::setw(12) << std::fixed << std::setprecision(1)
+                << keygen_ms << std::setw(14) << std::setprecision(0)
+                << decrypts << std::setw(12) << signs << std::setw(14)
+                << encrypts << std::endl;
+    }
+  }
+  return 0;
+}
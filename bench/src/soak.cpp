@@ -0,0 +1,236 @@
+#include <dirent.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <malloc.h>
+#include <src/util/fake_mediator.h>
+#include <src/util/peer_pair.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * Runs handshakes in a loop against a local FakeMediator and samples the
+ * process' RSS, heap in use, open fds and thread count as it goes. Fails
+ * (exit code 2) if any of them keep growing: a long-lived process making
+ * connections should stay flat.
+ *
+ * Usage:
+ *   p2psc_soak [--handshakes N] [--concurrency N] [--samples N]
+ *              [--max-growth-kb N]
+ *
+ * Each round sets up --concurrency connections at once, reusing the same
+ * keys every round, and closes them. Samples are taken once p2psc's
+ * connection threads have exited. After a warm-up of the first fifth of the
+ * samples:
+ *  - RSS and heap in use fail the run if their trend grows by more than
+ *    --max-growth-kb per million handshakes, and by more than 1MB overall
+ *    (below which short runs only see allocator noise).
+ *  - fds and threads fail the run if every sample in the last quarter is
+ *    above every sample in the first quarter.
+ *
+ * p2psc logs to stdout, so samples and the verdict go to stderr.
+ */
+namespace p2psc {
+namespace bench {
+namespace {
+
+const uint64_t kConnectTimeoutMs = 10000;
+const double kMinGrowthKb = 1024;
+const auto kSettleTimeout = std::chrono::seconds(1);
+
+struct Options {
+  uint64_t handshakes = 1000000;
+  std::size_t concurrency = 8;
+  std::size_t samples = 50;
+  double max_growth_kb = 4096;
+};
+
+struct Sample {
+  uint64_t handshakes;
+  double rss_kb;
+  double heap_kb;
+  double fds;
+  double threads;
+};
+
+void usage() {
+  std::cerr << "usage: p2psc_soak [--handshakes N] [--concurrency N] "
+               "[--samples N] [--max-growth-kb N]"
+            << std::endl;
+  exit(1);
+}
+
+Options parse_options(int argc, char **argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      usage();
+    }
+    const std::string value = argv[++i];
+    if (arg == "--handshakes") {
+      options.handshakes = std::stoull(value);
+    } else if (arg == "--concurrency") {
+      options.concurrency = std::stoul(value);
+    } else if (arg == "--samples") {
+      options.samples = std::stoul(value);
+    } else if (arg == "--max-growth-kb") {
+      options.max_growth_kb = std::stod(value);
+    } else {
+      usage();
+    }
+  }
+  if (options.concurrency == 0 || options.samples < 8 ||
+      options.handshakes < options.samples * options.concurrency) {
+    usage();
+  }
+  return options;
+}
+
+double rss_kb() {
+  std::ifstream statm("/proc/self/statm");
+  uint64_t size, resident;
+  statm >> size >> resident;
+  return resident * sysconf(_SC_PAGESIZE) / 1024.0;
+}
+
+double heap_kb() { return mallinfo2().uordblks / 1024.0; }
+
+double open_fds() {
+  DIR *dir = opendir("/proc/self/fd");
+  double fds = 0;
+  while (readdir(dir)) {
+    fds++;
+  }
+  closedir(dir);
+  // ".", ".." and the fd of dir itself
+  return fds - 3;
+}
+
+double thread_count() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, 8, "Threads:") == 0) {
+      return std::stod(line.substr(8));
+    }
+  }
+  return 0;
+}
+
+// Connection threads are detached and exit some time after their callback
+// has run. Wait for them so that samples are taken in a quiescent state.
+void settle(double baseline_threads) {
+  const auto deadline = std::chrono::steady_clock::now() + kSettleTimeout;
+  while (thread_count() > baseline_threads &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+Sample sample(uint64_t handshakes) {
+  return Sample{handshakes, rss_kb(), heap_kb(), open_fds(), thread_count()};
+}
+
+// Least squares slope of value against handshakes.
+double slope(const std::vector<Sample> &samples, double Sample::*value) {
+  double mean_x = 0, mean_y = 0;
+  for (const auto &s : samples) {
+    mean_x += s.handshakes;
+    mean_y += s.*value;
+  }
+  mean_x /= samples.size();
+  mean_y /= samples.size();
+  double covariance = 0, variance = 0;
+  for (const auto &s : samples) {
+    covariance += (s.handshakes - mean_x) * (s.*value - mean_y);
+    variance += (s.handshakes - mean_x) * (s.handshakes - mean_x);
+  }
+  return variance == 0 ? 0 : covariance / variance;
+}
+
+bool keeps_growing(const std::vector<Sample> &samples, double Sample::*value) {
+  const auto quarter = samples.size() / 4;
+  double early_max = 0;
+  for (std::size_t i = 0; i < quarter; i++) {
+    early_max = std::max(early_max, samples[i].*value);
+  }
+  for (std::size_t i = samples.size() - quarter; i < samples.size(); i++) {
+    if (samples[i].*value <= early_max) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void print(const Sample &s) {
+  std::cerr << std::setw(12) << s.handshakes << std::setw(12) << std::fixed
+            << std::setprecision(0) << s.rss_kb << std::setw(12) << s.heap_kb
+            << std::setw(8) << s.fds << std::setw(8) << s.threads << std::endl;
+}
+}
+}
+}
+
+int main(int argc, char **argv) {
+  using namespace p2psc;
+  using namespace p2psc::bench;
+
+  const auto options = parse_options(argc, argv);
+  const auto socket_creator = util::plain_socket_creator();
+  integration::util::FakeMediator mediator(socket_creator);
+  mediator.set_record_messages(false);
+  mediator.run();
+  const auto keypairs = util::generate_keypairs(options.concurrency);
+  const auto handshakes_per_sample = options.handshakes / options.samples;
+  const auto baseline_threads = thread_count();
+
+  std::cerr << std::setw(12) << "handshakes" << std::setw(12) << "RSS kB"
+            << std::setw(12) << "heap kB" << std::setw(8) << "fds"
+            << std::setw(8) << "threads" << std::endl;
+  std::vector<Sample> samples;
+  uint64_t handshakes = 0;
+  while (samples.size() < options.samples) {
+    try {
+      util::connect_pairs(mediator.get_mediator_description(), socket_creator,
+                          keypairs, kConnectTimeoutMs);
+    } catch (const std::exception &e) {
+      std::cerr << "Handshake failed after " << handshakes
+                << " handshakes: " << e.what() << std::endl;
+      return 1;
+    }
+    handshakes += options.concurrency;
+    if (handshakes >= (samples.size() + 1) * handshakes_per_sample) {
+      settle(baseline_threads);
+      samples.push_back(sample(handshakes));
+      print(samples.back());
+    }
+  }
+
+  // the first samples include caches and pools filling up
+  const std::vector<Sample> measured(samples.begin() + samples.size() / 5,
+                                     samples.end());
+  bool failed = false;
+  for (const auto &metric :
+       {std::make_pair("RSS", &Sample::rss_kb),
+        std::make_pair("heap", &Sample::heap_kb)}) {
+    const auto growth_kb = slope(measured, metric.second) * 1000000;
+    const auto total_growth_kb = slope(measured, metric.second) *
+                                 (handshakes - measured.front().handshakes);
+    std::cerr << metric.first << " growth: " << std::setprecision(1)
+              << growth_kb << " kB per million handshakes" << std::endl;
+    if (growth_kb > options.max_growth_kb && total_growth_kb > kMinGrowthKb) {
+      std::cerr << "FAIL: " << metric.first << " keeps growing" << std::endl;
+      failed = true;
+    }
+  }
+  for (const auto &metric : {std::make_pair("fds", &Sample::fds),
+                             std::make_pair("threads", &Sample::threads)}) {
+    if (keeps_growing(measured, metric.second)) {
+      std::cerr << "FAIL: " << metric.first << " keep growing" << std::endl;
+      failed = true;
+    }
+  }
+  return failed ? 2 : 0;
+}
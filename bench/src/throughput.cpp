@@ -0,0 +1,257 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <p2psc/compression/compression.h>
+#include <p2psc/local/local_transport.h>
+#include <p2psc/multipath/multipath_socket.h>
+#include <set>
+#include <sstream>
+#include <src/util/fake_mediator.h>
+#include <src/util/peer_pair.h>
+#include <sys/resource.h>
+#include <thread>
+#include <vector>
+
+/**
+ * Measures the throughput of the sockets p2psc returns, iperf style. For each
+ * concurrency level, connections are set up through the full p2psc flow
+ * against a local FakeMediator; then, for each message size, every Client
+ * sends messages to its Peer which echoes them back, for --duration-ms.
+ *
+ * Usage:
+ *   p2psc_throughput [--sizes 64,1024,...] [--concurrency 1,4,...]
+ *                    [--duration-ms N] [--layer NAME] [--paths N]
+ *
+ * Reported per run: throughput (both directions), process CPU time per GB
+ * moved (which includes both ends of every connection) and round trip latency
+ * percentiles. --layer selects the socket layer the connections are made
+ * with, so layers can be compared against plain sockets: "plain", or "zstd"
+ * for zstd compression at the default level, or "local" for Unix domain
+ * sockets. Messages are repeated bytes, so "zstd" shows its best case. With
+ * --paths N, every connection is a MultipathSocket over N connections.
+ */
+namespace p2psc {
+namespace bench {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const uint64_t kConnectTimeoutMs = 10000;
+
+struct Options {
+  std::vector<std::size_t> sizes = {64, 1024, 16384, 65536};
+  std::vector<std::size_t> concurrency = {1, 4};
+  uint64_t duration_ms = 2000;
+  std::string layer = "plain";
+  std::size_t paths = 1;
+};
+
+struct Result {
+  std::uint64_t bytes = 0;
+  double elapsed_s = 0;
+  double cpu_s = 0;
+  std::vector<double> latencies_us;
+};
+
+// every layer is switched on globally, so all connect through plain sockets
+const std::set<std::string> kLayers = {"local", "plain", "zstd"};
+
+void usage() {
+  std::cerr << "usage: p2psc_throughput [--sizes N,N,...] "
+               "[--concurrency N,N,...] [--duration-ms N] [--layer ";
+  for (const auto &layer : kLayers) {
+    std::cerr << (layer == *kLayers.begin() ? "" : "|") << layer;
+  }
+  std::cerr << "] [--paths N]" << std::endl;
+  exit(1);
+}
+
+std::vector<std::size_t> parse_list(const std::string &arg) {
+  std::vector<std::size_t> values;
+  std::stringstream stream(arg);
+  std::string value;
+  while (std::getline(stream, value, ',')) {
+    values.push_back(std::stoul(value));
+  }
+  if (values.empty()) {
+    usage();
+  }
+  return values;
+}
+
+Options parse_options(int argc, char **argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      usage();
+    }
+    const std::string value = argv[++i];
+    if (arg == "--sizes") {
+      options.sizes = parse_list(value);
+    } else if (arg == "--concurrency") {
+      options.concurrency = parse_list(value);
+    } else if (arg == "--duration-ms") {
+      options.duration_ms = std::stoull(value);
+    } else if (arg == "--layer") {
+      options.layer = value;
+    } else if (arg == "--paths") {
+      options.paths = std::stoul(value);
+    } else {
+      usage();
+    }
+  }
+  if (kLayers.count(options.layer) == 0 || options.paths == 0) {
+    usage();
+  }
+  return options;
+}
+
+double cpu_seconds() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// Socket::receive returns whatever has arrived, so read until the whole
+// message is in.
+void receive_exactly(Socket &socket, std::size_t size) {
+  std::size_t received = 0;
+  while (received < size) {
+    received += socket.receive().size();
+  }
+}
+
+// Group every paths pairs into one pair of MultipathSockets.
+std::vector<util::PeerPair>
+multipath_pairs(const std::vector<util::PeerPair> &pairs, std::size_t paths) {
+  std::vector<util::PeerPair> grouped;
+  for (std::size_t i = 0; i < pairs.size(); i += paths) {
+    std::vector<std::shared_ptr<Socket>> clients, peers;
+    for (std::size_t j = i; j < i + paths; j++) {
+      clients.push_back(pairs[j].client);
+      peers.push_back(pairs[j].peer);
+    }
+    grouped.push_back(
+        util::PeerPair{std::make_shared<multipath::MultipathSocket>(clients),
+                       std::make_shared<multipath::MultipathSocket>(peers)});
+  }
+  return grouped;
+}
+
+// Echo everything the Client sends until it closes the connection.
+void echo(std::shared_ptr<Socket> peer) {
+  try {
+    while (true) {
+      peer->send(peer->receive());
+    }
+  } catch (const socket::SocketException &e) {
+  }
+}
+
+Result run(const std::vector<util::PeerPair> &pairs, std::size_t size,
+           uint64_t duration_ms) {
+  Result result;
+  std::mutex mutex;
+  std::vector<std::thread> threads;
+  const auto message = std::string(size, 'x');
+  const auto start = Clock::now();
+  const auto deadline = start + std::chrono::milliseconds(duration_ms);
+  const auto start_cpu_s = cpu_seconds();
+
+  for (const auto &pair : pairs) {
+    threads.emplace_back([&, pair]() {
+      std::vector<double> latencies_us;
+      while (Clock::now() < deadline) {
+        const auto sent_at = Clock::now();
+        pair.client->send(message);
+        receive_exactly(*pair.client, size);
+        latencies_us.push_back(
+            std::chrono::duration<double, std::micro>(Clock::now() - sent_at)
+                .count());
+      }
+
+      std::lock_guard<std::mutex> guard(mutex);
+      result.bytes += 2 * size * latencies_us.size();
+      result.latencies_us.insert(result.latencies_us.end(),
+                                 latencies_us.begin(), latencies_us.end());
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  result.elapsed_s =
+      std::chrono::duration<double>(Clock::now() - start).count();
+  result.cpu_s = cpu_seconds() - start_cpu_s;
+  return result;
+}
+}
+}
+}
+
+int main(int argc, char **argv) {
+  using namespace p2psc;
+  using namespace p2psc::bench;
+
+  const auto options = parse_options(argc, argv);
+  if (options.layer == "zstd") {
+    compression::Compression compression;
+    compression.enabled = true;
+    compression::set_compression(compression);
+  } else if (options.layer == "local") {
+    local::set_local_transport_enabled(true);
+  }
+  integration::util::FakeMediator mediator(util::plain_socket_creator());
+  mediator.run();
+
+  std::stringstream report;
+  report << std::setw(10) << "size" << std::setw(6) << "conc" << std::setw(12)
+         << "MB/s" << std::setw(12) << "CPU s/GB" << std::setw(12) << "p50 us"
+         << std::setw(12) << "p99 us" << std::endl;
+  for (const auto concurrency : options.concurrency) {
+    std::vector<util::PeerPair> pairs;
+    try {
+      pairs = util::connect_pairs(mediator.get_mediator_description(),
+                                  util::plain_socket_creator(),
+                                  concurrency * options.paths,
+                                  kConnectTimeoutMs);
+    } catch (const std::runtime_error &e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+    if (options.paths > 1) {
+      pairs = multipath_pairs(pairs, options.paths);
+    }
+    std::vector<std::thread> echo_threads;
+    for (const auto &pair : pairs) {
+      echo_threads.emplace_back(echo, pair.peer);
+    }
+
+    for (const auto size : options.sizes) {
+      auto result = run(pairs, size, options.duration_ms);
+      const auto gb = result.bytes / 1e9;
+      report << std::setw(10) << size << std::setw(6) << concurrency
+             << std::setw(12) << std::fixed << std::setprecision(1)
+             << result.bytes / 1e6 / result.elapsed_s << std::setw(12)
+             << std::setprecision(2) << (gb > 0 ? result.cpu_s / gb : 0)
+             << std::setw(12) << std::setprecision(1)
+             << util::percentile(result.latencies_us, 0.5) << std::setw(12)
+             << util::percentile(result.latencies_us, 0.99) << std::endl;
+    }
+
+    for (const auto &pair : pairs) {
+      pair.client->close();
+    }
+    for (auto &thread : echo_threads) {
+      thread.join();
+    }
+  }
+
+  std::cout << std::endl
+            << "layer: " << options.layer << ", paths: " << options.paths
+            << std::endl
+            << report.str();
+  return 0;
+}
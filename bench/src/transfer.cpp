@@ -0,0 +1,175 @@
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <p2psc/transfer/transfer.h>
+#include <random>
+#include <sstream>
+#include <src/util/fake_mediator.h>
+#include <src/util/peer_pair.h>
+#include <sys/resource.h>
+#include <thread>
+#include <vector>
+
+/**
+ * Measures file transfer throughput over connections set up through the full
+ * p2psc flow against a local FakeMediator.
+ *
+ * Usage:
+ *   p2psc_transfer [--size-mb N] [--connections N,N,...] [--chunk-kb N]
+ *
+ * A file of --size-mb random bytes is written to the temp directory and sent
+ * once per connection count, into a fresh directory each time so that nothing
+ * is resumed. Reported per run: throughput and process CPU time per GB.
+ */
+namespace p2psc {
+namespace bench {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const uint64_t kConnectTimeoutMs = 10000;
+
+struct Options {
+  std::size_t size_mb = 1024;
+  std::vector<std::size_t> connections = {1, 4};
+  std::size_t chunk_kb = 1024;
+};
+
+void usage() {
+  std::cerr << "usage: p2psc_transfer [--size-mb N] [--connections N,N,...] "
+               "[--chunk-kb N]"
+            << std::endl;
+  exit(1);
+}
+
+std::vector<std::size_t> parse_list(const std::string &arg) {
+  std::vector<std::size_t> values;
+  std::stringstream stream(arg);
+  std::string value;
+  while (std::getline(stream, value, ',')) {
+    values.push_back(std::stoul(value));
+  }
+  if (values.empty()) {
+    usage();
+  }
+  return values;
+}
+
+Options parse_options(int argc, char **argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      usage();
+    }
+    const std::string value = argv[++i];
+    if (arg == "--size-mb") {
+      options.size_mb = std::stoul(value);
+    } else if (arg == "--connections") {
+      options.connections = parse_list(value);
+    } else if (arg == "--chunk-kb") {
+      options.chunk_kb = std::stoul(value);
+    } else {
+      usage();
+    }
+  }
+  if (options.chunk_kb == 0) {
+    usage();
+  }
+  return options;
+}
+
+double cpu_seconds() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+void write_random_file(const boost::filesystem::path &path,
+                       std::size_t size_mb) {
+  std::mt19937_64 random(1);
+  std::vector<uint64_t> block((1 << 20) / sizeof(uint64_t));
+  std::ofstream file(path.string(), std::ios::binary);
+  for (std::size_t i = 0; i < size_mb; i++) {
+    for (auto &word : block) {
+      word = random();
+    }
+    file.write(reinterpret_cast<const char *>(block.data()),
+               block.size() * sizeof(uint64_t));
+  }
+}
+}
+}
+}
+
+int main(int argc, char **argv) {
+  using namespace p2psc;
+  using namespace p2psc::bench;
+
+  const auto options = parse_options(argc, argv);
+  integration::util::FakeMediator mediator(util::plain_socket_creator());
+  mediator.run();
+
+  const auto directory = boost::filesystem::temp_directory_path() /
+                         boost::filesystem::unique_path();
+  boost::filesystem::create_directory(directory);
+  const auto source = directory / "source";
+  write_random_file(source, options.size_mb);
+  transfer::TransferOptions transfer_options;
+  transfer_options.chunk_size = options.chunk_kb * 1024;
+
+  std::stringstream report;
+  report << std::setw(6) << "conns" << std::setw(12) << "MB/s" << std::setw(12)
+         << "CPU s/GB" << std::endl;
+  int status = 0;
+  for (const auto connections : options.connections) {
+    const auto destination =
+        directory / ("destination-" + std::to_string(connections));
+    boost::filesystem::create_directory(destination);
+    try {
+      const auto pairs = util::connect_pairs(
+          mediator.get_mediator_description(), util::plain_socket_creator(),
+          connections, kConnectTimeoutMs);
+      std::vector<std::shared_ptr<Socket>> clients, peers;
+      for (const auto &pair : pairs) {
+        clients.push_back(pair.client);
+        peers.push_back(pair.peer);
+      }
+
+      const auto start = Clock::now();
+      const auto start_cpu_s = cpu_seconds();
+      std::thread sender([&]() {
+        transfer::send_file(source.string(), clients, transfer_options);
+      });
+      const auto received = transfer::receive_file(destination.string(), peers);
+      sender.join();
+      const auto elapsed_s =
+          std::chrono::duration<double>(Clock::now() - start).count();
+      const auto gb = received.stats.bytes_transferred / 1e9;
+      report << std::setw(6) << connections << std::setw(12) << std::fixed
+             << std::setprecision(1)
+             << received.stats.bytes_transferred / 1e6 / elapsed_s
+             << std::setw(12) << std::setprecision(2)
+             << (gb > 0 ? (cpu_seconds() - start_cpu_s) / gb : 0) << std::endl;
+      for (const auto &pair : pairs) {
+        pair.client->close();
+        pair.peer->close();
+      }
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      status = 1;
+      break;
+    }
+    boost::filesystem::remove_all(destination);
+  }
+  boost::filesystem::remove_all(directory);
+
+  std::cout << std::endl
+            << "size: " << options.size_mb << "MB, chunk: " << options.chunk_kb
+            << "kB" << std::endl
+            << report.str();
+  return status;
+}
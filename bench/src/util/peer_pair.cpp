@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <future>
+#include <p2psc/connection.h>
+#include <src/util/peer_pair.h>
+#include <stdexcept>
+
+namespace p2psc {
+namespace bench {
+namespace util {
+namespace {
+using SocketPromise = std::promise<std::shared_ptr<Socket>>;
+
+std::shared_future<std::shared_ptr<Socket>>
+connect_async(const key::Keypair &our_keypair, const key::Keypair &their_keypair,
+              const Mediator &mediator, const SocketCreator &socket_creator) {
+  const auto promise = std::make_shared<SocketPromise>();
+  Connection::connect(
+      our_keypair,
+      Peer(key::PublicKey::from_string(
+          their_keypair.get_serialised_public_key())),
+      mediator,
+      [promise](Error error, std::shared_ptr<Socket> socket) {
+        promise->set_value(socket);
+      },
+      socket_creator);
+  return promise->get_future().share();
+}
+
+std::shared_ptr<Socket>
+await(const std::shared_future<std::shared_ptr<Socket>> &socket,
+      std::chrono::steady_clock::time_point deadline) {
+  if (socket.wait_until(deadline) != std::future_status::ready ||
+      !socket.get()) {
+    throw std::runtime_error("Failed to set up connection through Mediator");
+  }
+  return socket.get();
+}
+}
+
+std::vector<KeypairPair> generate_keypairs(std::size_t count) {
+  std::vector<KeypairPair> keypairs;
+  for (std::size_t i = 0; i < count; i++) {
+    keypairs.emplace_back(key::Keypair::generate(), key::Keypair::generate());
+  }
+  return keypairs;
+}
+
+std::vector<PeerPair> connect_pairs(const Mediator &mediator,
+                                    const SocketCreator &socket_creator,
+                                    const std::vector<KeypairPair> &keypairs,
+                                    uint64_t timeout_ms) {
+  std::vector<std::shared_future<std::shared_ptr<Socket>>> clients, peers;
+  for (const auto &keypair : keypairs) {
+    clients.push_back(connect_async(keypair.first, keypair.second, mediator,
+                                    socket_creator));
+    peers.push_back(connect_async(keypair.second, keypair.first, mediator,
+                                  socket_creator));
+  }
+
+  const auto deadline = std::chrono::steady_clock::now() +
+                        std::chrono::milliseconds(timeout_ms);
+  std::vector<PeerPair> pairs;
+  for (std::size_t i = 0; i < keypairs.size(); i++) {
+    pairs.push_back(
+        PeerPair{await(clients[i], deadline), await(peers[i], deadline)});
+  }
+  return pairs;
+}
+
+std::vector<PeerPair> connect_pairs(const Mediator &mediator,
+                                    const SocketCreator &socket_creator,
+                                    std::size_t count, uint64_t timeout_ms) {
+  return connect_pairs(mediator, socket_creator, generate_keypairs(count),
+                       timeout_ms);
+}
+
+SocketCreator plain_socket_creator() {
+  return [](const SocketAddressOrFileDescriptor &param) {
+    if (param.has_socket_address()) {
+      return std::make_shared<Socket>(param.socket_address());
+    } else {
+      return std::make_shared<Socket>(param.sock_fd());
+    }
+  };
+}
+
+double percentile(std::vector<double> &values, double p) {
+  if (values.empty()) {
+    return 0;
+  }
+  std::sort(values.begin(), values.end());
+  return values[static_cast<std::size_t>(p * (values.size() - 1))];
+}
+}
+}
+}
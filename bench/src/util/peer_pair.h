@@ -0,0 +1,49 @@
+#pragma once
+
+#include <p2psc/key/keypair.h>
+#include <p2psc/mediator.h>
+#include <p2psc/socket/socket.h>
+#include <p2psc/socket_creator.h>
+#include <vector>
+
+namespace p2psc {
+namespace bench {
+namespace util {
+
+/*
+ * The two ends of a connection set up through the full p2psc flow.
+ */
+struct PeerPair {
+  std::shared_ptr<Socket> client;
+  std::shared_ptr<Socket> peer;
+};
+
+using KeypairPair = std::pair<key::Keypair, key::Keypair>;
+
+std::vector<KeypairPair> generate_keypairs(std::size_t count);
+
+/*
+ * Set up one connection through the Mediator per pair of keys. Throws
+ * std::runtime_error if any of them fails or does not complete within
+ * timeout_ms.
+ */
+std::vector<PeerPair> connect_pairs(const Mediator &mediator,
+                                    const SocketCreator &socket_creator,
+                                    const std::vector<KeypairPair> &keypairs,
+                                    uint64_t timeout_ms);
+/*
+ * As above, each between a freshly generated pair of keys.
+ */
+std::vector<PeerPair> connect_pairs(const Mediator &mediator,
+                                    const SocketCreator &socket_creator,
+                                    std::size_t count, uint64_t timeout_ms);
+
+SocketCreator plain_socket_creator();
+
+/*
+ * The value below which the given fraction p of values fall. Sorts values.
+ */
+double percentile(std::vector<double> &values, double p);
+}
+}
+}
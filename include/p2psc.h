@@ -20,14 +20,6 @@ namespace p2psc {
  */
 static void connect(const key::Keypair &keypair, const Peer &peer,
                     const Mediator &mediator, const Callback &callback) {
-  Connection::connect(keypair, peer, mediator, callback,
-                      [](const SocketAddressOrFileDescriptor &param) {
-                        if (param.has_socket_address()) {
-                          return std::make_shared<Socket>(
-                              param.socket_address());
-                        } else {
-                          return std::make_shared<Socket>(param.sock_fd());
-                        }
-                      });
+  Connection::connect<PlainSocketFactory>(keypair, peer, mediator, callback);
 }
 }
\ No newline at end of file
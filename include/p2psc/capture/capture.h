@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <p2psc/socket/socket_address.h>
+#include <string>
+
+/**
+ * A capture is a compact binary log of the traffic on one or more sockets. It
+ * is cheap enough to record in production, and can be replayed against a
+ * Mediator with bench/p2psc_replay.
+ *
+ * File layout (all integers little-endian):
+ *   header: "P2PSCCAP" | uint16 format version
+ *   record: uint64 timestamp_us | uint32 connection_id | uint8 event |
+ *           uint32 length | length bytes of data
+ */
+namespace p2psc {
+namespace capture {
+
+static const std::uint16_t kFormatVersion = 1;
+
+enum Event : std::uint8_t {
+  // data holds the remote address, formatted as "ip:port"
+  kEventOpen,
+  kEventSent,
+  kEventReceived,
+  kEventClose
+};
+
+struct Record {
+  // microseconds since the unix epoch
+  std::uint64_t timestamp_us;
+  std::uint32_t connection_id;
+  Event event;
+  std::string data;
+};
+
+class CaptureWriter {
+public:
+  static std::shared_ptr<CaptureWriter> open(const std::string &path);
+  ~CaptureWriter();
+
+  /*
+   * Allocate a connection id for a newly opened socket, and record its remote
+   * address.
+   */
+  std::uint32_t open_connection(const socket::SocketAddress &remote);
+  /*
+   * Never throws, so that capturing can't break the sockets it records: if
+   * writing the capture fails, the error is logged and nothing more is
+   * captured (see failed()).
+   */
+  void record(std::uint32_t connection_id, Event event,
+              const std::string &data);
+  // Throws CaptureException if writing fails.
+  void flush();
+  // whether writing failed, and records are being dropped
+  bool failed() const { return _failed; }
+
+private:
+  CaptureWriter(FILE *file);
+  CaptureWriter(const CaptureWriter &) = delete;
+
+  void _flush_locked();
+
+  FILE *_file;
+  std::mutex _mutex;
+  std::string _buffer;
+  std::atomic<std::uint32_t> _next_connection_id;
+  std::atomic<bool> _failed;
+};
+
+class CaptureReader {
+public:
+  static std::shared_ptr<CaptureReader> open(const std::string &path);
+  ~CaptureReader();
+
+  boost::optional<Record> next();
+
+private:
+  CaptureReader(FILE *file);
+  CaptureReader(const CaptureReader &) = delete;
+
+  FILE *_file;
+};
+}
+}
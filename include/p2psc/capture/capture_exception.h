@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+
+namespace p2psc {
+namespace capture {
+
+class CaptureException : public std::exception {
+public:
+  CaptureException(const std::string &what) : _what(what) {}
+
+  virtual const char *what() const noexcept override { return _what.c_str(); }
+
+private:
+  std::string _what;
+};
+}
+}
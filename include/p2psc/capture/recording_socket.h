@@ -0,0 +1,36 @@
+#pragma once
+
+#include <p2psc/capture/capture.h>
+#include <p2psc/socket/socket.h>
+#include <p2psc/socket_creator.h>
+
+namespace p2psc {
+namespace capture {
+
+/*
+ * A Socket that records everything it sends and receives to a capture. A
+ * capture that can't be written doesn't affect the socket (see
+ * CaptureWriter::record).
+ */
+class RecordingSocket : public Socket {
+public:
+  RecordingSocket(const socket::SocketAddress &socket_address,
+                  std::shared_ptr<CaptureWriter> writer);
+  RecordingSocket(int sock_fd, std::shared_ptr<CaptureWriter> writer);
+  ~RecordingSocket();
+
+  void send(const std::string &) override;
+  std::string receive() override;
+
+private:
+  std::shared_ptr<CaptureWriter> _writer;
+  std::uint32_t _connection_id;
+};
+
+/*
+ * A SocketCreator which creates RecordingSockets, so that every socket p2psc
+ * opens during a connection is captured.
+ */
+SocketCreator recording_socket_creator(std::shared_ptr<CaptureWriter> writer);
+}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <p2psc/compression/compression.h>
+#include <p2psc/socket/socket_layer.h>
+
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+
+namespace p2psc {
+namespace compression {
+
+/*
+ * A Socket that zstd-compresses the data sent on the socket it wraps, and
+ * decompresses the data received from it. Each end keeps a single zstd
+ * stream per direction, so later messages are compressed against everything
+ * sent before them.
+ *
+ * On the wire, every send() is one frame per MiB of data: a one byte kind
+ * (compressed or raw), the payload length (4 bytes, big endian) and the
+ * payload. Raw frames carry messages which were not worth compressing (see
+ * Compression::min_savings). A frame which carries, or decompresses to, more
+ * than a MiB is a stream error. receive() returns the data of all complete
+ * frames that have arrived, and so, like Socket::receive, not necessarily
+ * exactly what one send() sent.
+ *
+ * Stream errors are thrown as SocketExceptions.
+ */
+class CompressedSocket : public socket::SocketLayer {
+public:
+  CompressedSocket(std::shared_ptr<Socket> inner,
+                   const Compression &compression);
+  ~CompressedSocket();
+
+  void send(const std::string &data) override;
+  std::string receive() override;
+
+  // bytes passed to send(), and bytes that were sent on the wrapped socket
+  // for them
+  std::uint64_t bytes_sent() const { return _bytes_sent; }
+  std::uint64_t wire_bytes_sent() const { return _wire_bytes_sent; }
+
+private:
+  void _send_frame(const char *data, std::size_t size);
+  bool _should_compress();
+  void _update_bypass(std::size_t raw_size, std::size_t compressed_size);
+  void _decompress(const char *data, std::size_t size, std::string &out);
+
+  const Compression _compression;
+  ZSTD_CCtx_s *_cctx;
+  ZSTD_DCtx_s *_dctx;
+
+  // send side
+  std::string _frame;
+  // messages left to send raw, and how many to send raw after the next
+  // incompressible message
+  unsigned _bypass_remaining;
+  unsigned _bypass_length;
+  std::uint64_t _bytes_sent;
+  std::uint64_t _wire_bytes_sent;
+
+  // receive side: received bytes which don't yet form a complete frame
+  std::string _pending;
+};
+}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Opt-in zstd compression of the sockets returned by p2psc. Compression is
+ * offered by the Client and accepted by the Peer during the Peer handshake,
+ * so it is only used when both ends have enabled it; either end can be an
+ * older p2psc which knows nothing about it.
+ */
+namespace p2psc {
+namespace compression {
+
+// the only algorithm so far, as named in the handshake
+const std::string kAlgorithmZstd = "zstd";
+
+struct Compression {
+  bool enabled = false;
+  // the zstd level our end compresses with
+  int level = 3;
+  // A dictionary trained on the application's traffic (see
+  // train_dictionary). It is only used if the other end has the same one;
+  // otherwise both ends compress without a dictionary.
+  std::string dictionary;
+  // Messages which compress by less than this fraction count as
+  // incompressible. After one, messages are sent uncompressed for a while
+  // (twice as long after each further one) before compression is tried
+  // again.
+  double min_savings = 0.05;
+};
+
+/*
+ * Set the process-wide compression settings. Applies to connections started
+ * after the call. Throws CompressionException for an unsupported level.
+ */
+void set_compression(const Compression &compression);
+Compression get_compression();
+
+/*
+ * Train a dictionary of at most max_size bytes from samples of the
+ * application's messages. zstd needs a fair number of samples (hundreds at
+ * least) to produce a useful dictionary. Throws CompressionException.
+ */
+std::string train_dictionary(const std::vector<std::string> &samples,
+                             std::size_t max_size = 16 * 1024);
+
+/*
+ * The id which identifies a dictionary in the handshake, or 0 for no
+ * dictionary.
+ */
+std::uint32_t dictionary_id(const std::string &dictionary);
+
+/*
+ * What to compress with, given our settings and what the other end offered
+ * (or accepted): none, unless both ends have enabled zstd, and our dictionary
+ * only if the other end has it too.
+ */
+boost::optional<Compression>
+negotiate(const Compression &ours, const boost::optional<std::string> &theirs,
+          const boost::optional<std::uint32_t> &their_dictionary_id);
+}
+}
@@ -1,13 +1,18 @@
 #pragma once
 
+#include <chrono>
 #include <functional>
 
+#include <boost/optional.hpp>
 #include <p2psc/error.h>
+#include <p2psc/handshake/early_data.h>
+#include <p2psc/handshake/rendezvous.h>
 #include <p2psc/key/keypair.h>
 #include <p2psc/mediator.h>
 #include <p2psc/peer.h>
 #include <p2psc/socket/socket.h>
 #include <p2psc/socket_creator.h>
+#include <p2psc/socket_factory.h>
 
 namespace p2psc {
 
@@ -23,14 +28,91 @@ public:
   static void connect(const key::Keypair &, const Peer &, const Mediator &,
                       const Callback &, const SocketCreator &);
 
+  /*
+   * As above, but with sockets created by SocketFactory, which is chosen at
+   * compile time. SocketFactory must be one of the factories in
+   * socket_factory.h, which connection.cpp is instantiated for.
+   */
+  template <class SocketFactory>
+  static void connect(const key::Keypair &our_keypair, const Peer &peer,
+                      const Mediator &mediator, const Callback &callback) {
+    _execute_asynchronously(std::bind(
+        Connection::_handle_connection<SocketFactory>, our_keypair, peer,
+        mediator, boost::none, handshake::EarlyData(), callback,
+        SocketFactory()));
+  }
+
+  /*
+   * As above, with early data (see early_data.h): if we turn out to be the
+   * Client, early_data.request is sent with the handshake, and the Peer's
+   * reply can be read with handshake::last_early_data_reply() inside the
+   * Callback.
+   */
+  template <class SocketFactory>
+  static void connect(const key::Keypair &our_keypair, const Peer &peer,
+                      const Mediator &mediator,
+                      const handshake::EarlyData &early_data,
+                      const Callback &callback) {
+    _execute_asynchronously(std::bind(
+        Connection::_handle_connection<SocketFactory>, our_keypair, peer,
+        mediator, boost::none, early_data, callback, SocketFactory()));
+  }
+
+  /*
+   * As above, but meeting peer at rendezvous, which another peer has
+   * introduced us to (see introduction.h), rather than through the Mediator.
+   * If that fails, both ends go to the Mediator instead.
+   */
+  static void connect(const key::Keypair &our_keypair, const Peer &peer,
+                      const Mediator &mediator,
+                      const handshake::Rendezvous &rendezvous,
+                      const Callback &callback) {
+    _execute_asynchronously(std::bind(
+        Connection::_handle_connection<PlainSocketFactory>, our_keypair, peer,
+        mediator, rendezvous, handshake::EarlyData(), callback,
+        PlainSocketFactory()));
+  }
+
+  /*
+   * Connect to peer ahead of time: the connection is set up in the
+   * background, at a lower priority, and parked for up to ttl after it's
+   * ready. The next connect() to peer with the same keypair and without an
+   * early data request is handed the parked socket straight away (or, if
+   * it's still being set up, waits for it rather than starting over); one
+   * with a request connects afresh, so that the request is sent. Like any
+   * connection, it's only set up once the other end connects too. A parked
+   * socket nobody takes within ttl is closed.
+   */
+  static void prewarm(const key::Keypair &, const Peer &, const Mediator &,
+                      std::chrono::milliseconds ttl, const SocketCreator &);
+
+  template <class SocketFactory>
+  static void prewarm(const key::Keypair &our_keypair, const Peer &peer,
+                      const Mediator &mediator,
+                      std::chrono::milliseconds ttl) {
+    _execute_asynchronously(std::bind(Connection::_prewarm<SocketFactory>,
+                                      our_keypair, peer, mediator, ttl,
+                                      SocketFactory()));
+  }
+
 private:
   static void _execute_asynchronously(std::function<void()>);
 
-  static void _handle_connection(const key::Keypair &, const Peer &,
-                                 const Mediator &, const Callback &,
-                                 const SocketCreator &);
-  static std::shared_ptr<Socket> _connect(const key::Keypair &, const Peer &,
-                                          const Mediator &,
-                                          const SocketCreator &);
+  template <class SocketFactory>
+  static void _prewarm(const key::Keypair &, const Peer &, const Mediator &,
+                       std::chrono::milliseconds ttl, const SocketFactory &);
+
+  template <class SocketFactory>
+  static void
+  _handle_connection(const key::Keypair &, const Peer &, const Mediator &,
+                     const boost::optional<handshake::Rendezvous> &,
+                     const handshake::EarlyData &, const Callback &,
+                     const SocketFactory &);
+  template <class SocketFactory>
+  static std::shared_ptr<Socket>
+  _connect(const key::Keypair &, const Peer &, const Mediator &,
+           const boost::optional<handshake::Rendezvous> &,
+           const handshake::EarlyData &, const SocketFactory &,
+           boost::optional<std::string> &early_data_reply);
 };
 }
\ No newline at end of file
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <memory>
+#include <p2psc/dht/node.h>
+
+/**
+ * Opt-in rendezvous through a DHT of p2psc nodes (see node.h), without the
+ * Mediator. While connecting, the peer with the smaller fingerprint listens
+ * on an ephemeral port and publishes a record of it under its fingerprint,
+ * signed with its key; the other looks the record up and connects, and the
+ * two go straight to the Peer handshake, which verifies both keys as usual.
+ *
+ * Both peers must have joined the DHT. The record holds the listening peer's
+ * address as other nodes see it, so this only works where that address is
+ * reachable, e.g. between public hosts or within a network. Connecting waits
+ * for up to rendezvous_timeout_ms for the other peer's record or connection
+ * before going to the Mediator; if anything fails after that, both peers go
+ * to the Mediator too.
+ */
+namespace p2psc {
+namespace dht {
+
+/*
+ * Set the process-wide node connections rendezvous through, or nullptr to
+ * stop using the DHT. Applies to connections started after the call.
+ */
+void set_dht(std::shared_ptr<Node> node);
+std::shared_ptr<Node> get_dht();
+}
+}
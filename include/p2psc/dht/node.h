@@ -0,0 +1,136 @@
+#pragma once
+
+#include <boost/optional.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <p2psc/dht/routing_table.h>
+#include <p2psc/key/keypair.h>
+#include <p2psc/message/dht_query.h>
+#include <p2psc/message/dht_response.h>
+#include <p2psc/metrics/instrumented_mutex.h>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * A node of a Kademlia DHT among p2psc processes, which stores signed
+ * DhtRecords saying where a peer waits for another to connect to it. Records
+ * are stored under the fingerprint of the waiting peer's key, on the k nodes
+ * whose ids are closest to it, and only if they are signed by that key.
+ *
+ * Nodes talk over UDP, with a DhtQuery answered by a DhtResponse. A thread
+ * receives on the node's socket, answering queries and passing responses to
+ * the lookups waiting for them; lookups run on the calling thread, alpha
+ * queries at a time. Nodes which don't answer within rpc_timeout_ms are
+ * forgotten.
+ */
+namespace p2psc {
+namespace dht {
+
+struct DhtOptions {
+  // bucket size, and the number of nodes each record is stored on
+  std::size_t k = 8;
+  // queries in flight per lookup
+  std::size_t alpha = 3;
+  std::uint64_t rpc_timeout_ms = 500;
+  // Records older than this (or timestamped this far in the future) are
+  // dropped.
+  std::uint64_t record_ttl_ms = 30000;
+  std::size_t max_records = 10000;
+  // how long connecting waits for the other peer's record, or its connection
+  std::uint64_t rendezvous_timeout_ms = 5000;
+};
+
+class Node {
+public:
+  /*
+   * Receives on port (or an ephemeral one if 0) on every interface. Throws
+   * SocketException if that fails.
+   */
+  explicit Node(std::uint16_t port = 0,
+                const DhtOptions &options = DhtOptions());
+  ~Node();
+
+  /*
+   * Join the DHT through nodes already in it, by looking ourselves up.
+   * Returns the number of nodes we know afterwards.
+   */
+  std::size_t bootstrap(const std::vector<socket::SocketAddress> &nodes);
+  /*
+   * Store a record, signed with keypair, that we wait on port for the peer
+   * whose key has fingerprint to. The address is the one other nodes see us
+   * at. Returns the number of nodes which acknowledged it. Throws
+   * DhtException if no node has told us our address yet.
+   */
+  std::size_t publish(const key::Keypair &keypair, const std::string &to,
+                      std::uint16_t port);
+  /*
+   * The newest valid record stored under fingerprint for the peer whose key
+   * has fingerprint to.
+   */
+  boost::optional<message::DhtRecord> find(const std::string &fingerprint,
+                                           const std::string &to);
+
+  const DhtOptions &options() const { return _options; }
+  std::string id() const { return to_hex(_id); }
+  std::uint16_t port() const { return _port; }
+  std::size_t known_nodes();
+  std::size_t stored_records();
+
+private:
+  Node(const Node &) = delete;
+  Node &operator=(const Node &) = delete;
+
+  struct LookupResult {
+    // the closest nodes to the target which answered, closest first
+    std::vector<Contact> closest;
+    boost::optional<message::DhtRecord> record;
+  };
+
+  struct PendingRpc {
+    socket::SocketAddress address;
+    boost::optional<message::DhtResponse> response;
+  };
+
+  // An iterative FIND_NODE for target, or FIND_VALUE if to is set, which
+  // stops at the first valid record.
+  LookupResult _lookup(const NodeId &target,
+                       const boost::optional<std::string> &to);
+  // Sends every query and waits up to rpc_timeout_ms for their responses.
+  std::vector<boost::optional<message::DhtResponse>>
+  _call(const std::vector<std::pair<socket::SocketAddress, message::DhtQuery>>
+            &queries);
+  message::DhtQuery _query(const std::string &kind);
+  void _receive_loop();
+  void _on_datagram(const std::string &raw_message,
+                    const socket::SocketAddress &sender);
+  message::DhtResponse _answer(const message::DhtQuery &query,
+                               const socket::SocketAddress &sender);
+  void _send(const socket::SocketAddress &address, const std::string &data);
+  // whether record is timestamped within record_ttl_ms of now
+  bool _is_fresh(const message::DhtRecord &record) const;
+  // and signed by its key
+  bool _is_valid(const message::DhtRecord &record) const;
+
+  const DhtOptions _options;
+  const NodeId _id;
+  int _sockfd;
+  std::uint16_t _port;
+  // written to by the destructor, to wake the receiving thread up
+  int _wake_fds[2];
+  std::thread _receiver;
+
+  metrics::InstrumentedMutex _mutex;
+  std::condition_variable_any _cv;
+  RoutingTable _table;
+  std::uint64_t _next_rpc_id;
+  std::map<std::uint64_t, PendingRpc> _pending;
+  // our IP as the last node which answered us saw it
+  std::string _observed_ip;
+  // keyed by the fingerprints of the waiting peer and the one it waits for
+  std::map<std::pair<std::string, std::string>, message::DhtRecord> _records;
+};
+}
+}
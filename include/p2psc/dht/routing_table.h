@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <deque>
+#include <p2psc/socket/socket_address.h>
+#include <string>
+#include <vector>
+
+namespace p2psc {
+namespace dht {
+
+// 256 bit Kademlia ids, the same size as key fingerprints
+using NodeId = std::array<std::uint8_t, 32>;
+
+std::string to_hex(const NodeId &id);
+// boost::none if hex isn't 64 hex digits
+boost::optional<NodeId> from_hex(const std::string &hex);
+NodeId xor_distance(const NodeId &a, const NodeId &b);
+// the number of leading bits a and b have in common
+std::size_t shared_prefix_length(const NodeId &a, const NodeId &b);
+
+struct Contact {
+  NodeId id;
+  socket::SocketAddress address;
+};
+
+/*
+ * The nodes a node knows of, in one bucket per length of the prefix their id
+ * shares with ours, of up to k each. As in Kademlia, long-lived contacts are
+ * preferred: a contact which doesn't fit in its full bucket is dropped, and
+ * room is only made by removing contacts which stopped responding.
+ */
+class RoutingTable {
+public:
+  RoutingTable(const NodeId &self, std::size_t k);
+
+  // Adds contact, or moves it to the back of its bucket if it's known.
+  void update(const Contact &contact);
+  void remove(const NodeId &id);
+  // up to count contacts, closest to target first
+  std::vector<Contact> closest(const NodeId &target, std::size_t count) const;
+  std::size_t size() const;
+
+private:
+  const NodeId _self;
+  const std::size_t _k;
+  // least recently seen first
+  std::array<std::deque<Contact>, 256> _buckets;
+};
+}
+}
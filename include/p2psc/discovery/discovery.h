@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/**
+ * Opt-in discovery of peers on the same LAN, which then connect directly
+ * without going through the Mediator. While connecting, both peers multicast
+ * a LanAnnouncement naming their own key's fingerprint and the one they're
+ * looking for, signed with their key. Once a peer hears a correctly signed
+ * announcement from the one it's looking for, the peer with the smaller
+ * fingerprint accepts a connection from the other, and the two go straight
+ * to the Peer handshake, which verifies both keys as usual.
+ *
+ * Both peers must enable it. Connecting waits for up to timeout_ms for the
+ * other peer to show up on the LAN before going to the Mediator; if anything
+ * fails after it has, both peers go to the Mediator too.
+ */
+namespace p2psc {
+namespace discovery {
+
+struct Discovery {
+  bool enabled = false;
+  // the multicast group and port announcements are sent to
+  std::string group = "239.255.112.50";
+  std::uint16_t port = 47350;
+  std::uint64_t announce_interval_ms = 50;
+  std::uint64_t timeout_ms = 250;
+  // Announcements whose timestamp is further than this from our clock are
+  // ignored, which limits how long a recorded one can be replayed.
+  std::uint64_t max_clock_skew_ms = 30000;
+};
+
+/*
+ * Set the process-wide discovery settings. Applies to connections started
+ * after the call. Throws DiscoveryException if group isn't a multicast
+ * address or announce_interval_ms is 0.
+ */
+void set_discovery(const Discovery &discovery);
+Discovery get_discovery();
+}
+}
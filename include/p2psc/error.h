@@ -7,7 +7,11 @@ namespace error {
 enum Kind {
   kErrorUnknown,
   kErrorPeerUnsupportedProtocolVersion,
-  kErrorMediatorConnectFailure
+  kErrorMediatorConnectFailure,
+  // see rpc::Channel
+  kErrorRpcDeadlineExceeded,
+  kErrorRpcCallFailed,
+  kErrorRpcChannelClosed
 };
 }
 class Error {
@@ -19,7 +23,7 @@ public:
   operator bool() const { return _is_set; }
 
   error::Kind kind() const { return _kind; }
-  std::string reason() const { return _reason; }
+  const std::string &reason() const { return _reason; }
 
 private:
   bool _is_set;
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <boost/optional.hpp>
+#include <chrono>
+#include <p2psc/message/types.h>
+#include <p2psc/socket/socket_address.h>
+#include <string>
+
+namespace p2psc {
+namespace handshake {
+
+/*
+ * Something a handshake state machine needs its driver to do. Drivers report
+ * the outcome back to the machine as events, e.g. Handshake::on_connected.
+ */
+struct Action {
+  enum Type {
+    // send data (a message of type message_type) on the current connection
+    kActionSend,
+    // open a connection to address
+    kActionConnect,
+    // close the connection to the Mediator
+    kActionCloseMediatorConnection,
+    // listen on port and accept a single connection, within delay unless it
+    // is 0
+    kActionListen,
+    // call on_timer after delay
+    kActionStartTimer
+  };
+
+  Type type;
+  std::string data;
+  message::MessageType message_type;
+  boost::optional<socket::SocketAddress> address;
+  std::uint16_t port;
+  std::chrono::milliseconds delay;
+
+  static Action send(message::MessageType message_type,
+                     const std::string &data) {
+    Action action(kActionSend);
+    action.message_type = message_type;
+    action.data = data;
+    return action;
+  }
+
+  static Action connect(const socket::SocketAddress &address) {
+    Action action(kActionConnect);
+    action.address = address;
+    return action;
+  }
+
+  static Action close_mediator_connection() {
+    return Action(kActionCloseMediatorConnection);
+  }
+
+  static Action listen(std::uint16_t port,
+                       std::chrono::milliseconds timeout =
+                           std::chrono::milliseconds(0)) {
+    Action action(kActionListen);
+    action.port = port;
+    action.delay = timeout;
+    return action;
+  }
+
+  static Action start_timer(std::chrono::milliseconds delay) {
+    Action action(kActionStartTimer);
+    action.delay = delay;
+    return action;
+  }
+
+private:
+  Action(Type type)
+      : type(type), message_type(0), port(0), delay(0) {}
+};
+}
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <p2psc/crypto/pki.h>
+#include <p2psc/handshake/state_machine.h>
+#include <p2psc/key/public_key.h>
+#include <p2psc/metrics/instrumented_mutex.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Challenges (nonces encrypted with the public key they challenge) computed
+ * ahead of time for keys which are challenged often, so that answering an
+ * Advertise or a PeerChallenge doesn't wait for an RSA encryption. A Mediator
+ * keeps one for the keys that reconnect to it; p2psc's own handshakes use the
+ * process-wide pool, if one is set, for their challenges of the other peer.
+ *
+ * Once a key has been challenged hot_after times, a thread running at idle
+ * priority (SCHED_IDLE) keeps challenges_per_key challenges ready for it.
+ * Each challenge is only handed out once.
+ */
+namespace p2psc {
+namespace handshake {
+
+struct Challenge {
+  std::string nonce;
+  std::string encrypted_nonce;
+};
+
+struct ChallengePoolOptions {
+  std::size_t challenges_per_key = 4;
+  std::size_t hot_after = 2;
+  // keys tracked at once; the one challenged least recently is dropped
+  std::size_t max_keys = 1024;
+};
+
+struct ChallengePoolStats {
+  // challenges handed out ready, and computed on the spot
+  std::uint64_t hits = 0;
+  std::uint64_t misses = 0;
+  // challenges ready to be handed out
+  std::size_t ready = 0;
+  std::size_t keys = 0;
+};
+
+class ChallengePool {
+public:
+  ChallengePool(const ChallengePoolOptions &options = ChallengePoolOptions(),
+                const NonceGenerator &nonce_generator = generate_nonce);
+  ~ChallengePool();
+
+  /*
+   * A challenge of public_key: a ready one if there is one, otherwise one
+   * computed now. The serialised form only parses the key the first time
+   * it's seen. Throws CryptoException for an invalid key.
+   */
+  Challenge take(const key::PublicKey &public_key);
+  Challenge take(const std::string &serialised_public_key);
+
+  ChallengePoolStats stats();
+
+private:
+  struct Key {
+    Key(const key::PublicKey &public_key) : public_key(public_key) {}
+
+    key::PublicKey public_key;
+    std::vector<Challenge> ready;
+    std::size_t uses = 0;
+    std::uint64_t last_used = 0;
+  };
+
+  ChallengePool(const ChallengePool &) = delete;
+  ChallengePool &operator=(const ChallengePool &) = delete;
+
+  Challenge _take(const std::string &serialised,
+                  const key::PublicKey *public_key);
+  Challenge _compute(const key::PublicKey &public_key);
+  void _refill_loop();
+  // Called with the mutex held. The hot key with the fewest challenges
+  // ready, if any needs more.
+  std::map<std::string, std::unique_ptr<Key>>::iterator _key_to_refill();
+  // Called with the mutex held.
+  void _evict();
+
+  const ChallengePoolOptions _options;
+  const NonceGenerator _nonce_generator;
+  metrics::InstrumentedMutex _mutex;
+  std::condition_variable_any _cv;
+  bool _stopping;
+  // by serialised key
+  std::map<std::string, std::unique_ptr<Key>> _keys;
+  std::uint64_t _clock;
+  ChallengePoolStats _stats;
+  std::thread _refiller;
+};
+
+/*
+ * Set the process-wide pool the Client and Peer handshakes take their
+ * challenges from, or nullptr to compute every challenge on the spot (the
+ * default). Applies to connections started after the call.
+ */
+void set_challenge_pool(std::shared_ptr<ChallengePool> pool);
+std::shared_ptr<ChallengePool> get_challenge_pool();
+
+/*
+ * A challenge of public_key from pool, or without one, computed now with a
+ * nonce from nonce_generator.
+ */
+Challenge make_challenge(const key::PublicKey &public_key,
+                         const std::shared_ptr<ChallengePool> &pool,
+                         const NonceGenerator &nonce_generator);
+}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <p2psc/handshake/extensions.h>
+#include <p2psc/handshake/state_machine.h>
+#include <p2psc/key/keypair.h>
+#include <p2psc/punched_peer.h>
+
+namespace p2psc {
+namespace handshake {
+
+/*
+ * Mutual verification with the Peer, as the side that connected to it.
+ */
+class ClientHandshake : public StateMachine {
+public:
+  ClientHandshake(const key::Keypair &our_keypair,
+                  const PunchedPeer &punched_peer,
+                  const NonceGenerator &nonce_generator = generate_nonce,
+                  const Extensions &extensions = Extensions());
+
+  // the connection to the Peer is open
+  void start();
+  void on_message(const std::string &raw_message);
+
+  bool is_done() const { return _state == kStateDone; }
+  const PunchedPeer &punched_peer() const { return _punched_peer; }
+  // what the socket should be compressed with, once done
+  boost::optional<compression::Compression> negotiated_compression() const {
+    return _negotiated_compression;
+  }
+  // the Unix domain socket to move to, once done
+  boost::optional<std::string> local_socket() const { return _local_socket; }
+  // what we send first on it
+  boost::optional<std::string> local_socket_token() const {
+    return _local_socket_token;
+  }
+  // the Peer's reply to our early request, once done, if it was sent early
+  const boost::optional<std::string> &early_data_reply() const {
+    return _early_data_reply;
+  }
+
+private:
+  enum State {
+    kStateIdle,
+    kStateChallenged,
+    kStateResponded,
+    kStateDone
+  };
+
+  const key::Keypair _our_keypair;
+  const PunchedPeer _punched_peer;
+  const NonceGenerator _nonce_generator;
+  const Extensions _extensions;
+  State _state;
+  std::string _nonce;
+  boost::optional<compression::Compression> _negotiated_compression;
+  boost::optional<std::string> _local_socket;
+  boost::optional<std::string> _local_socket_token;
+  // our secret for the early data key, if we offered early data, and the
+  // key, if the Peer accepted
+  boost::optional<std::string> _early_data_secret;
+  boost::optional<std::string> _early_data_key;
+  boost::optional<std::string> _early_data_reply;
+};
+}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <boost/optional.hpp>
+#include <functional>
+#include <string>
+
+/**
+ * Early data saves request/response workloads the round trip after the
+ * handshake: the Client sends a small request with the PeerResponse, and the
+ * Peer answers it with the PeerAcknowledgement. Both are encrypted with
+ * AES-256-GCM, under a key derived from a secret each end sent the other
+ * encrypted with the other's public key, so only the two verified ends can
+ * read them, and neither can be replayed into another handshake.
+ *
+ * Which end is the Client is only decided while connecting, so both ends
+ * pass both a request and a responder. Either end can be an older p2psc,
+ * in which case nothing is sent early.
+ */
+namespace p2psc {
+namespace handshake {
+
+// Early data rides in handshake messages, base64 encoded and with the GCM
+// nonce and tag added. Keeping it this small keeps those messages to about a
+// segment, so the handshake isn't slowed down, and far below the
+// message::kMaxMessageSize any handshake message may take.
+const std::size_t kMaxEarlyDataSize = 512;
+
+using EarlyDataResponder =
+    std::function<std::string(const std::string &request)>;
+
+struct EarlyData {
+  // Sent if we're the Client, the Peer has a responder, and it isn't larger
+  // than kMaxEarlyDataSize.
+  boost::optional<std::string> request;
+  // Called if we're the Peer and the Client sent a request, on the
+  // connecting thread, before the Callback. What it returns is sent back;
+  // replies larger than kMaxEarlyDataSize fail the handshake.
+  EarlyDataResponder responder;
+};
+
+/*
+ * Inside a Callback: if we were the Client, the Peer's reply to our early
+ * request. boost::none if we were the Peer, or the request wasn't sent
+ * early, in which case it should be sent on the socket as usual.
+ */
+const boost::optional<std::string> &last_early_data_reply();
+// called by Connection before the Callback
+void set_last_early_data_reply(const boost::optional<std::string> &reply);
+
+// The key early data is encrypted with in a handshake, from the secrets the
+// two ends exchanged and the nonces each challenged the other with.
+std::string early_data_key(const std::string &client_secret,
+                           const std::string &peer_secret,
+                           const std::string &client_nonce,
+                           const std::string &peer_nonce);
+}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <boost/optional.hpp>
+#include <memory>
+#include <p2psc/compression/compression.h>
+#include <p2psc/handshake/challenge_pool.h>
+#include <p2psc/handshake/early_data.h>
+#include <string>
+
+namespace p2psc {
+namespace handshake {
+
+/*
+ * Optional features negotiated in the Peer handshake. Each is only used if
+ * both ends enable it; either end can be an older p2psc which knows nothing
+ * about them.
+ */
+struct Extensions {
+  compression::Compression compression;
+  // Our host identifier (see local::host_id), if we'd move to a Unix domain
+  // socket with a peer on the same host. As the Peer, we then listen on
+  // local_socket_name, and the Client proves itself there with
+  // local_socket_token, which only it is told.
+  boost::optional<std::string> host_id;
+  std::string local_socket_name;
+  std::string local_socket_token;
+  EarlyData early_data;
+  // Where our challenges of the other peer come from; this one isn't
+  // negotiated and doesn't concern the other end.
+  std::shared_ptr<ChallengePool> challenge_pool;
+};
+}
+}
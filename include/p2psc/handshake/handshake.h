@@ -0,0 +1,109 @@
+#pragma once
+
+#include <p2psc/handshake/client_handshake.h>
+#include <p2psc/handshake/mediator_handshake.h>
+#include <p2psc/handshake/peer_handshake.h>
+#include <p2psc/handshake/rendezvous.h>
+#include <p2psc/mediator.h>
+
+namespace p2psc {
+namespace handshake {
+
+/*
+ * The whole of Connection::connect: the MediatorHandshake, then either the
+ * ClientHandshake or the PeerHandshake depending on what the Mediator decided,
+ * including retrying (with backoff timers) while the Peer is not yet
+ * listening.
+ *
+ * A driver starts the machine and carries out its actions until is_done();
+ * whenever there is no action left, it waits for a message on the current
+ * connection.
+ */
+class Handshake : public StateMachine {
+public:
+  // The Client keeps trying for longer than the Peer does, so that it is
+  // still trying when the Peer's last attempt to listen succeeds.
+  static const int max_connect_attempts = 6;
+  static const int max_listen_attempts = 5;
+  static constexpr std::chrono::milliseconds introduced_accept_timeout =
+      std::chrono::milliseconds(2000);
+
+  enum Role { kRoleUndecided, kRoleClient, kRolePeer };
+
+  Handshake(const key::Keypair &our_keypair, const Peer &peer,
+            const Mediator &mediator,
+            const NonceGenerator &nonce_generator = generate_nonce,
+            const Extensions &extensions = Extensions());
+
+  void start();
+  /*
+   * Instead of start(): skip the Mediator, as the connection to the Peer
+   * (e.g. one found by discovery) is already open.
+   */
+  void start_as_client(const PunchedPeer &punched_peer);
+  void start_as_peer();
+  /*
+   * Instead of start(): skip the Mediator, and meet the Peer at rendezvous.
+   * As the Peer, we only wait introduced_accept_timeout for the Client, so
+   * that if it gives up we do too.
+   */
+  void start_at(const Rendezvous &rendezvous);
+  // the requested connection is open (for kActionConnect), or a connection
+  // has been accepted (for kActionListen)
+  void on_connected();
+  void on_message(const std::string &raw_message);
+  // sending, receiving or connecting failed
+  void on_socket_error(const std::string &reason);
+  // listening for the Client failed
+  void on_listen_failed(const std::string &reason);
+  void on_timer();
+
+  bool is_done() const;
+  Role role() const { return _role; }
+  // what the socket to the Peer should be compressed with, once done
+  boost::optional<compression::Compression> negotiated_compression() const;
+  // the Unix domain socket to move to from the one to the Peer, once done
+  boost::optional<std::string> local_socket() const;
+  // as the Client, what we prove ourselves with on it
+  boost::optional<std::string> local_socket_token() const;
+  // as the Client, the Peer's reply to our early request, once done
+  boost::optional<std::string> early_data_reply() const;
+
+private:
+  enum State {
+    kStateIdle,
+    kStateConnectingToMediator,
+    kStateMediator,
+    kStateConnectingToPeer,
+    kStateListening,
+    kStatePeer,
+    kStateWaitingToConnect,
+    kStateWaitingToListen
+  };
+
+  void _on_mediator_done();
+  void _connect_to_peer(const PunchedPeer &punched_peer);
+  void _listen_for_client(std::uint16_t port,
+                          std::chrono::milliseconds timeout);
+  void _retry_after_backoff(int max_attempts, State waiting_state,
+                            const std::string &reason);
+  void _forward(StateMachine &machine);
+
+  const key::Keypair _our_keypair;
+  const Peer _peer;
+  const Mediator _mediator;
+  const NonceGenerator _nonce_generator;
+  const Extensions _extensions;
+  State _state;
+  Role _role;
+  MediatorHandshake _mediator_handshake;
+  std::unique_ptr<ClientHandshake> _client_handshake;
+  std::unique_ptr<PeerHandshake> _peer_handshake;
+  int _attempts;
+  std::chrono::milliseconds _backoff;
+  // as the Peer, where we listen for the Client, and for how long
+  std::uint16_t _listening_port;
+  std::chrono::milliseconds _accept_timeout;
+};
+}
+}
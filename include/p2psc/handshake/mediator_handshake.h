@@ -0,0 +1,48 @@
+#pragma once
+
+#include <p2psc/handshake/state_machine.h>
+#include <p2psc/key/keypair.h>
+#include <p2psc/message/peer_disconnect.h>
+#include <p2psc/punched_peer.h>
+
+namespace p2psc {
+namespace handshake {
+
+/*
+ * Advertises us to the Mediator and proves our identity, until the Mediator
+ * either identifies the Peer for us to connect to (we are the Client), or
+ * tells us to disconnect and wait for the Peer to connect to us (we are the
+ * Peer).
+ */
+class MediatorHandshake : public StateMachine {
+public:
+  static const int max_advertise_retries = 5;
+
+  MediatorHandshake(const key::Keypair &our_keypair, const Peer &peer);
+
+  // the connection to the Mediator is open
+  void start();
+  void on_message(const std::string &raw_message);
+
+  bool is_done() const { return _punched_peer || _peer_disconnect; }
+  bool has_punched_peer() const { return _punched_peer.is_initialized(); }
+  PunchedPeer get_punched_peer() const;
+  bool has_peer_disconnect() const { return _peer_disconnect.is_initialized(); }
+  message::PeerDisconnect get_peer_disconnect() const;
+
+private:
+  enum State { kStateIdle, kStateAdvertised, kStateResponded, kStateDone };
+
+  void _advertise();
+  void _on_advertise_response(const std::string &raw_message);
+  void _on_mediator_decision(const std::string &raw_message);
+
+  const key::Keypair _our_keypair;
+  const Peer _peer;
+  State _state;
+  int _advertise_retries;
+  boost::optional<PunchedPeer> _punched_peer;
+  boost::optional<message::PeerDisconnect> _peer_disconnect;
+};
+}
+}
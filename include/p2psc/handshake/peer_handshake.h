@@ -0,0 +1,46 @@
+#pragma once
+
+#include <p2psc/handshake/extensions.h>
+#include <p2psc/handshake/state_machine.h>
+#include <p2psc/key/keypair.h>
+#include <p2psc/peer.h>
+
+namespace p2psc {
+namespace handshake {
+
+/*
+ * Mutual verification with the Client, as the side that accepted its
+ * connection. The early data responder, if any, is called from on_message.
+ */
+class PeerHandshake : public StateMachine {
+public:
+  PeerHandshake(const key::Keypair &our_keypair, const Peer &peer,
+                const NonceGenerator &nonce_generator = generate_nonce,
+                const Extensions &extensions = Extensions());
+
+  void on_message(const std::string &raw_message);
+
+  bool is_done() const { return _state == kStateDone; }
+  // what the socket should be compressed with, once done
+  boost::optional<compression::Compression> negotiated_compression() const {
+    return _negotiated_compression;
+  }
+  // the Unix domain socket to move to, once done
+  boost::optional<std::string> local_socket() const { return _local_socket; }
+
+private:
+  enum State { kStateIdle, kStateChallenged, kStateDone };
+
+  const key::Keypair _our_keypair;
+  const Peer _peer;
+  const NonceGenerator _nonce_generator;
+  const Extensions _extensions;
+  State _state;
+  std::string _nonce;
+  boost::optional<compression::Compression> _negotiated_compression;
+  boost::optional<std::string> _local_socket;
+  // if we accepted the Client's early data
+  boost::optional<std::string> _early_data_key;
+};
+}
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <p2psc/socket/socket_address.h>
+
+namespace p2psc {
+namespace handshake {
+
+/*
+ * Where to meet the Peer when another peer has introduced us to it (see
+ * introduction.h), rather than the Mediator.
+ */
+struct Rendezvous {
+  // whether we connect to the Peer (as the Client), rather than accept its
+  // connection (as the Peer)
+  bool connect;
+  // As the Client, the Peer's address as the introducer sees it. As the
+  // Peer, ours, on whose port we listen.
+  socket::SocketAddress address;
+};
+}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <p2psc/handshake/action.h>
+#include <p2psc/message/message.h>
+#include <p2psc/message/message_decoder.h>
+
+/**
+ * The p2psc protocol as sans-IO state machines. A machine never touches a
+ * socket, clock or thread: its driver feeds it events (such as a received
+ * message) and carries out the Actions it emits, so the same protocol code can
+ * be driven by blocking threads, an event loop or a simulation.
+ *
+ * Each call to on_message must be passed exactly one message, as returned by
+ * Socket::receive. Protocol violations are reported by throwing, exactly as
+ * the blocking implementation always has.
+ */
+namespace p2psc {
+namespace handshake {
+
+using NonceGenerator = std::function<std::string()>;
+
+std::string generate_nonce();
+
+class StateMachine {
+public:
+  /*
+   * The next action for the driver to carry out, if any. Once there are none
+   * left, the machine is waiting for an event.
+   */
+  boost::optional<Action> poll_action();
+  bool has_action() const { return !_actions.empty(); }
+
+protected:
+  void _emit(const Action &action) { _actions.push_back(action); }
+
+  template <class T> void _emit_message(const T &payload) {
+    _emit(Action::send(T::type,
+                       spotify::json::encode(Message<T>(payload).format())));
+  }
+
+  template <class T> static T _decode(const std::string &raw_message) {
+    return message::decode<T>(raw_message).payload;
+  }
+
+private:
+  std::deque<Action> _actions;
+};
+}
+}
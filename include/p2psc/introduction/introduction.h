@@ -0,0 +1,44 @@
+#pragma once
+
+#include <memory>
+#include <p2psc/connection.h>
+
+/**
+ * Introductions of two peers to each other by a third which is already
+ * connected to both, so that they can connect without the Mediator. The
+ * introducer tells each the other's public key and the address it sees the
+ * other at, much as the Mediator would; they then carry out the Peer
+ * handshake, which verifies both keys. Meshes can so grow through the
+ * connections they already have, rather than all through the Mediator.
+ *
+ * Introductions are sent on the connections to the introducer, so both
+ * introduced peers must be waiting in accept, rather than using their
+ * connection to the introducer for anything else, when it introduces them.
+ */
+namespace p2psc {
+namespace introduction {
+
+struct Introducee {
+  std::shared_ptr<Socket> socket;
+  const Peer peer;
+};
+
+/*
+ * Introduce first and second to each other. second is told to listen on the
+ * port we see it at, and is told first, so that it is likely to be listening
+ * by the time first, which is told to connect to it, does. Throws
+ * SocketException.
+ */
+void introduce(const Introducee &first, const Introducee &second);
+
+/*
+ * Wait for an introduction from introducer, then connect to the peer it
+ * introduces as Connection::connect does, calling callback with the socket
+ * or error. If meeting the peer fails, both go to mediator instead. Returns
+ * the peer. Throws SocketException, or IntroductionException if what arrives
+ * isn't a valid introduction.
+ */
+Peer accept(const key::Keypair &our_keypair, Socket &introducer,
+            const Mediator &mediator, const Callback &callback);
+}
+}
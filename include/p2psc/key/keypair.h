@@ -1,18 +1,40 @@
 #pragma once
 
-#include <p2psc/crypto/pki.h>
+#include <cstdint>
 #include <memory>
+#include <p2psc/crypto/pki.h>
+#include <p2psc/version.h>
 
 namespace p2psc {
 namespace key {
 
+struct KeyOptions {
+  std::uint16_t size = kDefaultKeySize;
+  // Primes of the RSA modulus: 3 are allowed for keys of 1024 to 4095 bits,
+  // and other peers still see an ordinary RSA public key. More primes make
+  // private key operations, which dominate the CPU time of the handshake,
+  // cheaper in general, but OpenSSL 3 has a faster path for 2-prime keys of
+  // 2048 bits on CPUs with AVX-512 IFMA. Compare them with p2psc_rsa.
+  int primes = 2;
+};
+
 class Keypair {
 public:
-  static Keypair generate();
+  // Throws CryptoException for unsupported options.
+  static Keypair generate(const KeyOptions &options = KeyOptions());
   static Keypair from_pem(const std::string &path);
+  /*
+   * A key written by write_der. Loading it skips PEM's decoding, which
+   * matters to short-lived tools; from_pem and write_der convert a PEM key
+   * once. Throws CryptoException.
+   */
+  static Keypair from_der(const std::string &path);
+  void write_der(const std::string &path) const;
 
   std::string public_encrypt(const std::string &message) const;
   std::string private_decrypt(const std::string &message) const;
+  // a signature of message, which PublicKey::verify checks
+  std::string sign(const std::string &message) const;
   std::string get_serialised_public_key() const;
 
 private:
@@ -9,7 +9,11 @@ public:
   static PublicKey generate();
 
   std::string encrypt(const std::string &) const;
+  // whether signature is the signature of message by this key's Keypair
+  bool verify(const std::string &message, const std::string &signature) const;
   std::string serialise() const;
+  // the hex SHA-256 of the serialised key
+  std::string fingerprint() const;
 
 private:
   PublicKey(std::shared_ptr<crypto::PKI>);
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <p2psc/socket/socket.h>
+
+namespace p2psc {
+namespace local {
+
+/*
+ * A connected Unix domain socket standing in for the TCP connection between
+ * peer_address and local_address, which get_socket_address and
+ * get_local_address keep reporting.
+ */
+class LocalSocket : public Socket {
+public:
+  LocalSocket(int sock_fd, const socket::SocketAddress &peer_address,
+              const socket::SocketAddress &local_address)
+      : Socket(sock_fd), _peer_address(peer_address),
+        _local_address(local_address) {}
+
+  socket::SocketAddress get_socket_address() override { return _peer_address; }
+  socket::SocketAddress get_local_address() override { return _local_address; }
+
+private:
+  const socket::SocketAddress _peer_address;
+  const socket::SocketAddress _local_address;
+};
+}
+}
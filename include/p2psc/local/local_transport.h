@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+
+/**
+ * Opt-in move of connections between peers on the same host to Unix domain
+ * sockets, so that their data doesn't go through the TCP stack. Both peers
+ * must enable it. The Client sends an identifier of its host (see host_id)
+ * in the Peer handshake; if it matches the Peer's, the Peer names a Unix
+ * domain socket it listens on, the Client connects to it, and both ends
+ * carry on over it instead of the punched TCP connection. If that fails,
+ * they carry on over TCP.
+ *
+ * The sockets are in the abstract namespace, which is per network namespace,
+ * so "the same host" means the same machine and network namespace (e.g.
+ * sidecars in one pod). Names are random and only sent in the handshake.
+ */
+namespace p2psc {
+namespace local {
+
+/*
+ * Applies to connections started after the call.
+ */
+void set_local_transport_enabled(bool enabled);
+bool local_transport_enabled();
+
+/*
+ * A hash of the machine id and network namespace: the same for processes
+ * which can reach each other's abstract Unix domain sockets.
+ */
+std::string host_id();
+}
+}
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <sstream>
 #include <mutex>
+#include <p2psc/metrics/instrumented_mutex.h>
 #include <thread>
 
 namespace p2psc {
@@ -42,7 +43,7 @@ public:
     std::string stream_string = _stream.str();
     const auto end = stream_string.find_last_not_of("\n");
     stream_string.erase(end + 1);
-    std::lock_guard<std::mutex> guard(_mutex());
+    std::lock_guard<metrics::InstrumentedMutex> guard(_mutex());
     std::cout << stream_string << std::endl;
   }
   std::ostringstream &get() {
@@ -55,8 +56,8 @@ public:
 private:
   Log(const Log &);
   Log &operator=(const Log &);
-  static std::mutex &_mutex() {
-    static std::mutex m;
+  static metrics::InstrumentedMutex &_mutex() {
+    static metrics::InstrumentedMutex m("p2psc::Log");
     return m;
   }
 
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <boost/optional.hpp>
+#include <p2psc/message/dht_record.h>
+#include <p2psc/message/types.h>
+#include <spotify/json.hpp>
+#include <spotify/json/boost.hpp>
+
+using namespace spotify::json;
+
+namespace p2psc {
+namespace message {
+
+// what a DhtQuery asks for
+const std::string kDhtPing = "ping";
+const std::string kDhtFindNode = "find_node";
+const std::string kDhtFindValue = "find_value";
+const std::string kDhtStore = "store";
+
+/*
+ * A request from one DHT node to another, answered by a DhtResponse with the
+ * same rpc_id.
+ */
+struct DhtQuery {
+  static const MessageType type = kTypeDhtQuery;
+  std::uint8_t version;
+  std::uint64_t rpc_id;
+  std::string sender_id;
+  std::string kind;
+  // for find_node and find_value, the id to find the closest nodes to
+  boost::optional<std::string> target;
+  // for find_value, the fingerprint records must be waiting for
+  boost::optional<std::string> to;
+  // for store
+  boost::optional<DhtRecord> record;
+};
+
+inline bool operator==(const DhtQuery &lhs, const DhtQuery &rhs) {
+  return lhs.version == rhs.version && lhs.rpc_id == rhs.rpc_id &&
+         lhs.sender_id == rhs.sender_id && lhs.kind == rhs.kind &&
+         lhs.target == rhs.target && lhs.to == rhs.to &&
+         lhs.record == rhs.record;
+}
+}
+}
+
+namespace spotify {
+namespace json {
+template <> struct default_codec_t<p2psc::message::DhtQuery> {
+  static codec::object_t<p2psc::message::DhtQuery> codec() {
+    auto codec = codec::object<p2psc::message::DhtQuery>();
+    codec.required("version", &p2psc::message::DhtQuery::version);
+    codec.required("rpc_id", &p2psc::message::DhtQuery::rpc_id);
+    codec.required("sender_id", &p2psc::message::DhtQuery::sender_id);
+    codec.required("kind", &p2psc::message::DhtQuery::kind);
+    codec.optional("target", &p2psc::message::DhtQuery::target);
+    codec.optional("to", &p2psc::message::DhtQuery::to);
+    codec.optional("record", &p2psc::message::DhtQuery::record);
+    return codec;
+  }
+};
+}
+}
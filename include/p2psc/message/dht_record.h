@@ -0,0 +1,73 @@
+#pragma once
+
+#include <spotify/json.hpp>
+#include <string>
+
+using namespace spotify::json;
+
+namespace p2psc {
+namespace message {
+
+/*
+ * Where a peer waits for another to connect to it, stored in the DHT under
+ * the fingerprint of the waiting peer's key. The signature, by that key,
+ * covers every other field, so that only the peer itself can publish it.
+ */
+struct DhtRecord {
+  std::string public_key;
+  // the fingerprint of the peer it waits for
+  std::string to;
+  std::string ip;
+  std::uint16_t port;
+  std::uint64_t timestamp_ms;
+  std::string signature;
+};
+
+inline bool operator==(const DhtRecord &lhs, const DhtRecord &rhs) {
+  return lhs.public_key == rhs.public_key && lhs.to == rhs.to &&
+         lhs.ip == rhs.ip && lhs.port == rhs.port &&
+         lhs.timestamp_ms == rhs.timestamp_ms &&
+         lhs.signature == rhs.signature;
+}
+
+/*
+ * A DHT node: its id in hex, and the address it receives queries on.
+ */
+struct DhtContact {
+  std::string id;
+  std::string ip;
+  std::uint16_t port;
+};
+
+inline bool operator==(const DhtContact &lhs, const DhtContact &rhs) {
+  return lhs.id == rhs.id && lhs.ip == rhs.ip && lhs.port == rhs.port;
+}
+}
+}
+
+namespace spotify {
+namespace json {
+template <> struct default_codec_t<p2psc::message::DhtRecord> {
+  static codec::object_t<p2psc::message::DhtRecord> codec() {
+    auto codec = codec::object<p2psc::message::DhtRecord>();
+    codec.required("public_key", &p2psc::message::DhtRecord::public_key);
+    codec.required("to", &p2psc::message::DhtRecord::to);
+    codec.required("ip", &p2psc::message::DhtRecord::ip);
+    codec.required("port", &p2psc::message::DhtRecord::port);
+    codec.required("timestamp_ms", &p2psc::message::DhtRecord::timestamp_ms);
+    codec.required("signature", &p2psc::message::DhtRecord::signature);
+    return codec;
+  }
+};
+
+template <> struct default_codec_t<p2psc::message::DhtContact> {
+  static codec::object_t<p2psc::message::DhtContact> codec() {
+    auto codec = codec::object<p2psc::message::DhtContact>();
+    codec.required("id", &p2psc::message::DhtContact::id);
+    codec.required("ip", &p2psc::message::DhtContact::ip);
+    codec.required("port", &p2psc::message::DhtContact::port);
+    return codec;
+  }
+};
+}
+}
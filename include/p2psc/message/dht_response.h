@@ -0,0 +1,48 @@
+#pragma once
+
+#include <p2psc/message/dht_record.h>
+#include <p2psc/message/types.h>
+#include <spotify/json.hpp>
+#include <vector>
+
+using namespace spotify::json;
+
+namespace p2psc {
+namespace message {
+
+struct DhtResponse {
+  static const MessageType type = kTypeDhtResponse;
+  std::uint64_t rpc_id;
+  std::string sender_id;
+  // the querying node's IP as the responder sees it
+  std::string observed_ip;
+  // for find_node, and find_value without matching records: the closest
+  // nodes to the target the responder knows of
+  std::vector<DhtContact> contacts;
+  // for find_value
+  std::vector<DhtRecord> records;
+};
+
+inline bool operator==(const DhtResponse &lhs, const DhtResponse &rhs) {
+  return lhs.rpc_id == rhs.rpc_id && lhs.sender_id == rhs.sender_id &&
+         lhs.observed_ip == rhs.observed_ip && lhs.contacts == rhs.contacts &&
+         lhs.records == rhs.records;
+}
+}
+}
+
+namespace spotify {
+namespace json {
+template <> struct default_codec_t<p2psc::message::DhtResponse> {
+  static codec::object_t<p2psc::message::DhtResponse> codec() {
+    auto codec = codec::object<p2psc::message::DhtResponse>();
+    codec.required("rpc_id", &p2psc::message::DhtResponse::rpc_id);
+    codec.required("sender_id", &p2psc::message::DhtResponse::sender_id);
+    codec.required("observed_ip", &p2psc::message::DhtResponse::observed_ip);
+    codec.required("contacts", &p2psc::message::DhtResponse::contacts);
+    codec.required("records", &p2psc::message::DhtResponse::records);
+    return codec;
+  }
+};
+}
+}
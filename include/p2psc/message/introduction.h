@@ -0,0 +1,48 @@
+#pragma once
+
+#include <p2psc/message/types.h>
+#include <spotify/json.hpp>
+
+using namespace spotify::json;
+
+namespace p2psc {
+namespace message {
+
+/*
+ * Sent by a peer to two of its peers to introduce them to each other (see
+ * introduction.h), naming the other one.
+ */
+struct Introduction {
+  static const MessageType type = kTypeIntroduction;
+  std::uint8_t version;
+  std::string public_key;
+  // whether to connect to the other peer at ip:port, rather than listen on
+  // port for it
+  bool connect;
+  std::string ip;
+  std::uint16_t port;
+};
+
+inline bool operator==(const Introduction &lhs, const Introduction &rhs) {
+  return lhs.version == rhs.version && lhs.public_key == rhs.public_key &&
+         lhs.connect == rhs.connect && lhs.ip == rhs.ip &&
+         lhs.port == rhs.port;
+}
+}
+}
+
+namespace spotify {
+namespace json {
+template <> struct default_codec_t<p2psc::message::Introduction> {
+  static codec::object_t<p2psc::message::Introduction> codec() {
+    auto codec = codec::object<p2psc::message::Introduction>();
+    codec.required("version", &p2psc::message::Introduction::version);
+    codec.required("public_key", &p2psc::message::Introduction::public_key);
+    codec.required("connect", &p2psc::message::Introduction::connect);
+    codec.required("ip", &p2psc::message::Introduction::ip);
+    codec.required("port", &p2psc::message::Introduction::port);
+    return codec;
+  }
+};
+}
+}
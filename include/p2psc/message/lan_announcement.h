@@ -0,0 +1,53 @@
+#pragma once
+
+#include <p2psc/message/types.h>
+#include <spotify/json.hpp>
+
+using namespace spotify::json;
+
+namespace p2psc {
+namespace message {
+
+/*
+ * Multicast on the LAN by a peer looking for another (see discovery.h).
+ * Peers are identified by the fingerprints of their public keys; the
+ * signature, by from's key, covers every other field.
+ */
+struct LanAnnouncement {
+  static const MessageType type = kTypeLanAnnouncement;
+  std::uint8_t version;
+  std::string from;
+  std::string to;
+  // where from accepts the connection, or 0 if it will connect instead
+  std::uint16_t port;
+  std::uint64_t timestamp_ms;
+  std::string signature;
+};
+
+inline bool operator==(const LanAnnouncement &lhs,
+                       const LanAnnouncement &rhs) {
+  return lhs.version == rhs.version && lhs.from == rhs.from &&
+         lhs.to == rhs.to && lhs.port == rhs.port &&
+         lhs.timestamp_ms == rhs.timestamp_ms &&
+         lhs.signature == rhs.signature;
+}
+}
+}
+
+namespace spotify {
+namespace json {
+template <> struct default_codec_t<p2psc::message::LanAnnouncement> {
+  static codec::object_t<p2psc::message::LanAnnouncement> codec() {
+    auto codec = codec::object<p2psc::message::LanAnnouncement>();
+    codec.required("version", &p2psc::message::LanAnnouncement::version);
+    codec.required("from", &p2psc::message::LanAnnouncement::from);
+    codec.required("to", &p2psc::message::LanAnnouncement::to);
+    codec.required("port", &p2psc::message::LanAnnouncement::port);
+    codec.required("timestamp_ms",
+                   &p2psc::message::LanAnnouncement::timestamp_ms);
+    codec.required("signature", &p2psc::message::LanAnnouncement::signature);
+    return codec;
+  }
+};
+}
+}
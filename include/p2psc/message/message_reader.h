@@ -0,0 +1,45 @@
+#pragma once
+
+#include <boost/optional.hpp>
+#include <p2psc/socket/socket.h>
+#include <string>
+
+namespace p2psc {
+namespace message {
+
+// larger messages are taken for garbage rather than waited for
+const std::size_t kMaxMessageSize = 64 * 1024;
+
+/*
+ * Finds whole JSON messages in what a Socket receives, which may be part of
+ * a message (one larger than a segment arrives in pieces, and receive()
+ * returns what has arrived) or more than one.
+ */
+class MessageReader {
+public:
+  // Throws MessageException once more than kMaxMessageSize bytes of a
+  // message have arrived.
+  void append(const std::string &data);
+  // the next whole message, if it has arrived
+  boost::optional<std::string> next();
+  // what has arrived after the last whole message
+  std::string take_rest();
+
+private:
+  std::string _buffer;
+  // how far into _buffer we've looked for the end of the next message, and
+  // what we found on the way
+  std::size_t _scanned = 0;
+  std::size_t _depth = 0;
+  bool _in_string = false;
+  bool _escaped = false;
+};
+
+/*
+ * Receive one whole message from socket, putting back whatever arrived after
+ * it for the next receive. Throws SocketException, or MessageException if
+ * the message is too large.
+ */
+std::string receive_message(Socket &socket);
+}
+}
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <boost/optional.hpp>
 #include <p2psc/message/types.h>
 #include <spotify/json.hpp>
+#include <spotify/json/boost.hpp>
 
 using namespace spotify::json;
 
@@ -10,7 +12,18 @@ namespace message {
 
 struct PeerAcknowledgement {
   static const MessageType type = kTypePeerAcknowledgement;
+  // the Peer's reply to the early request, sealed like it
+  boost::optional<std::string> early_data;
+  // what the Client sends first on the Peer's Unix domain socket, to show
+  // that it's the end of this connection, if the Peer offered one
+  boost::optional<std::string> local_socket_token;
 };
+
+inline bool operator==(const PeerAcknowledgement &lhs,
+                       const PeerAcknowledgement &rhs) {
+  return lhs.early_data == rhs.early_data &&
+         lhs.local_socket_token == rhs.local_socket_token;
+}
 }
 }
 
@@ -19,6 +32,10 @@ namespace json {
 template <> struct default_codec_t<p2psc::message::PeerAcknowledgement> {
   static codec::object_t<p2psc::message::PeerAcknowledgement> codec() {
     auto codec = codec::object<p2psc::message::PeerAcknowledgement>();
+    codec.optional("early_data",
+                   &p2psc::message::PeerAcknowledgement::early_data);
+    codec.optional("local_socket_token",
+                   &p2psc::message::PeerAcknowledgement::local_socket_token);
     return codec;
   }
 };
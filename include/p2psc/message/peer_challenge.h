@@ -1,7 +1,9 @@
 #pragma once
 
+#include <boost/optional.hpp>
 #include <p2psc/message/types.h>
 #include <spotify/json.hpp>
+#include <spotify/json/boost.hpp>
 
 using namespace spotify::json;
 
@@ -11,10 +13,23 @@ namespace message {
 struct PeerChallenge {
   static const MessageType type = kTypePeerChallenge;
   std::string encrypted_nonce;
+  // the compression algorithm the Client offers, and the id of its dictionary
+  boost::optional<std::string> compression;
+  boost::optional<std::uint32_t> compression_dictionary;
+  // identifies the Client's host, if it would move to a Unix domain socket
+  // with a Peer on the same one
+  boost::optional<std::string> host_id;
+  // a secret for the early data key (see early_data.h), encrypted with the
+  // Peer's key, if the Client has an early request
+  boost::optional<std::string> early_data_secret;
 };
 
 inline bool operator==(const PeerChallenge &lhs, const PeerChallenge &rhs) {
-  return lhs.encrypted_nonce == rhs.encrypted_nonce;
+  return lhs.encrypted_nonce == rhs.encrypted_nonce &&
+         lhs.compression == rhs.compression &&
+         lhs.compression_dictionary == rhs.compression_dictionary &&
+         lhs.host_id == rhs.host_id &&
+         lhs.early_data_secret == rhs.early_data_secret;
 }
 }
 }
@@ -26,6 +41,12 @@ template <> struct default_codec_t<p2psc::message::PeerChallenge> {
     auto codec = codec::object<p2psc::message::PeerChallenge>();
     codec.required("encrypted_nonce",
                    &p2psc::message::PeerChallenge::encrypted_nonce);
+    codec.optional("compression", &p2psc::message::PeerChallenge::compression);
+    codec.optional("compression_dictionary",
+                   &p2psc::message::PeerChallenge::compression_dictionary);
+    codec.optional("host_id", &p2psc::message::PeerChallenge::host_id);
+    codec.optional("early_data_secret",
+                   &p2psc::message::PeerChallenge::early_data_secret);
     return codec;
   }
 };
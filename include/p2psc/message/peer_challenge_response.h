@@ -1,7 +1,9 @@
 #pragma once
 
+#include <boost/optional.hpp>
 #include <p2psc/message/types.h>
 #include <spotify/json.hpp>
+#include <spotify/json/boost.hpp>
 
 using namespace spotify::json;
 
@@ -12,12 +14,25 @@ struct PeerChallengeResponse {
   static const MessageType type = kTypePeerChallengeResponse;
   std::string encrypted_nonce;
   std::string decrypted_nonce;
+  // the compression algorithm the Peer accepted, and the id of the
+  // dictionary to use with it (0 for none)
+  boost::optional<std::string> compression;
+  boost::optional<std::uint32_t> compression_dictionary;
+  // the Unix domain socket the Peer listens on, if it's on the Client's host
+  boost::optional<std::string> local_socket;
+  // the Peer's secret for the early data key, encrypted with the Client's
+  // key, if the Peer accepts early data
+  boost::optional<std::string> early_data_secret;
 };
 
 inline bool operator==(const PeerChallengeResponse &lhs,
                        const PeerChallengeResponse &rhs) {
   return lhs.encrypted_nonce == rhs.encrypted_nonce &&
-         lhs.decrypted_nonce == rhs.decrypted_nonce;
+         lhs.decrypted_nonce == rhs.decrypted_nonce &&
+         lhs.compression == rhs.compression &&
+         lhs.compression_dictionary == rhs.compression_dictionary &&
+         lhs.local_socket == rhs.local_socket &&
+         lhs.early_data_secret == rhs.early_data_secret;
 }
 }
 }
@@ -31,6 +46,13 @@ template <> struct default_codec_t<p2psc::message::PeerChallengeResponse> {
                    &p2psc::message::PeerChallengeResponse::encrypted_nonce);
     codec.required("decrypted_nonce",
                    &p2psc::message::PeerChallengeResponse::decrypted_nonce);
+    codec.optional("compression", &p2psc::message::PeerChallengeResponse::compression);
+    codec.optional("compression_dictionary",
+                   &p2psc::message::PeerChallengeResponse::compression_dictionary);
+    codec.optional("local_socket",
+                   &p2psc::message::PeerChallengeResponse::local_socket);
+    codec.optional("early_data_secret",
+                   &p2psc::message::PeerChallengeResponse::early_data_secret);
     return codec;
   }
 };
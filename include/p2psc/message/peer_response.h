@@ -1,7 +1,9 @@
 #pragma once
 
+#include <boost/optional.hpp>
 #include <p2psc/message/types.h>
 #include <spotify/json.hpp>
+#include <spotify/json/boost.hpp>
 
 using namespace spotify::json;
 
@@ -11,10 +13,14 @@ namespace message {
 struct PeerResponse {
   static const MessageType type = kTypePeerResponse;
   std::string decrypted_nonce;
+  // the Client's early request, sealed with the early data key and base64
+  // encoded
+  boost::optional<std::string> early_data;
 };
 
 inline bool operator==(const PeerResponse &lhs, const PeerResponse &rhs) {
-  return lhs.decrypted_nonce == rhs.decrypted_nonce;
+  return lhs.decrypted_nonce == rhs.decrypted_nonce &&
+         lhs.early_data == rhs.early_data;
 }
 }
 }
@@ -26,6 +32,7 @@ template <> struct default_codec_t<p2psc::message::PeerResponse> {
     auto codec = codec::object<p2psc::message::PeerResponse>();
     codec.required("decrypted_nonce",
                    &p2psc::message::PeerResponse::decrypted_nonce);
+    codec.optional("early_data", &p2psc::message::PeerResponse::early_data);
     return codec;
   }
 };
@@ -18,6 +18,10 @@ static const MessageType kTypePeerChallenge = 7;
 static const MessageType kTypePeerChallengeResponse = 8;
 static const MessageType kTypePeerResponse = 9;
 static const MessageType kTypePeerAcknowledgement = 10;
+static const MessageType kTypeLanAnnouncement = 11;
+static const MessageType kTypeIntroduction = 12;
+static const MessageType kTypeDhtQuery = 13;
+static const MessageType kTypeDhtResponse = 14;
 
 inline std::string message_type_string(MessageType type) {
   switch (type) {
@@ -43,6 +47,14 @@ inline std::string message_type_string(MessageType type) {
     return "PeerResponse";
   case kTypePeerAcknowledgement:
     return "PeerAcknowledgement";
+  case kTypeLanAnnouncement:
+    return "LanAnnouncement";
+  case kTypeIntroduction:
+    return "Introduction";
+  case kTypeDhtQuery:
+    return "DhtQuery";
+  case kTypeDhtResponse:
+    return "DhtResponse";
   default:
     return "Unknown (" + std::to_string(type) + ")";
   }
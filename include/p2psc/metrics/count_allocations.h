@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdlib>
+#include <new>
+#include <p2psc/metrics/handshake_stats.h>
+
+/**
+ * Replaces the global operator new and delete so that heap allocations made
+ * during a handshake are reported in HandshakeStats. p2psc does not do this
+ * itself, as the replacement applies to the whole program: include this
+ * header in exactly one translation unit of the application to opt in.
+ */
+
+void *operator new(std::size_t size) {
+  p2psc::metrics::count_allocation(size);
+  if (void *ptr = std::malloc(size ? size : 1)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  p2psc::metrics::count_allocation(size);
+  return std::malloc(size ? size : 1);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept {
+  return operator new(size, tag);
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
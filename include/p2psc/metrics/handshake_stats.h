@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+/**
+ * Optional per-handshake instrumentation. When a handler is installed, every
+ * handshake started by Connection::connect counts the syscalls, crypto
+ * operations and (if the application opted in, see count_allocations.h) the
+ * heap allocations made on its thread, from the first Mediator connection up
+ * to, but not including, the Callback.
+ */
+namespace p2psc {
+namespace metrics {
+
+struct HandshakeStats {
+  uint64_t allocations = 0;
+  uint64_t allocated_bytes = 0;
+  uint64_t connect_calls = 0;
+  uint64_t send_calls = 0;
+  uint64_t read_calls = 0;
+  uint64_t ioctl_calls = 0;
+  uint64_t crypto_operations = 0;
+  uint64_t duration_us = 0;
+};
+
+using HandshakeStatsHandler = std::function<void(const HandshakeStats &)>;
+
+/*
+ * Install a handler to be called with the stats of each handshake once it
+ * finishes (successfully or not), before the Callback. Passing an empty
+ * handler disables instrumentation, which is the default.
+ */
+void set_handshake_stats_handler(const HandshakeStatsHandler &);
+
+/*
+ * The stats of the last handshake finished on the calling thread. Inside a
+ * Callback these are the stats of the handshake that produced it.
+ */
+const HandshakeStats &last_handshake_stats();
+
+/*
+ * Counts everything done on the current thread for as long as it is alive,
+ * if instrumentation is enabled. On destruction the stats are published to
+ * the handler and last_handshake_stats(). Scopes do not nest.
+ */
+class HandshakeStatsScope {
+public:
+  HandshakeStatsScope();
+  ~HandshakeStatsScope();
+
+private:
+  HandshakeStatsScope(const HandshakeStatsScope &) = delete;
+
+  HandshakeStats _stats;
+  HandshakeStatsHandler _handler;
+  uint64_t _start_us;
+};
+
+enum Syscall { kSyscallConnect, kSyscallSend, kSyscallRead, kSyscallIoctl };
+
+/*
+ * Called by the instrumented code. These are cheap no-ops on threads that are
+ * not inside a HandshakeStatsScope.
+ */
+void count_syscall(Syscall);
+void count_crypto_operation();
+void count_allocation(std::size_t size);
+}
+}
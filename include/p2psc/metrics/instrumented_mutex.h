@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+/**
+ * A drop-in replacement for std::mutex that records, per lock site, how often
+ * the lock was taken, how often it was already held (contention), and how long
+ * threads waited for and held it. Every mutex constructed with the same site
+ * name shares one set of counters, so e.g. all instances of a class can be
+ * profiled as one site.
+ *
+ * Profiling is off by default, in which case the overhead is a relaxed atomic
+ * load per lock. Use std::condition_variable_any to wait on these.
+ */
+namespace p2psc {
+namespace metrics {
+
+struct LockStats {
+  uint64_t acquisitions = 0;
+  uint64_t contentions = 0;
+  uint64_t wait_ns = 0;
+  uint64_t max_wait_ns = 0;
+  uint64_t hold_ns = 0;
+  uint64_t max_hold_ns = 0;
+  // threads blocked waiting for the lock right now (not cleared by
+  // reset_lock_stats)
+  uint64_t waiting = 0;
+};
+
+struct LockSite;
+
+class InstrumentedMutex {
+public:
+  explicit InstrumentedMutex(const std::string &site);
+
+  void lock();
+  bool try_lock();
+  void unlock();
+
+private:
+  InstrumentedMutex(const InstrumentedMutex &) = delete;
+  InstrumentedMutex &operator=(const InstrumentedMutex &) = delete;
+
+  std::mutex _mutex;
+  LockSite *_site;
+  // when the current holder acquired the lock, or 0 if it is not profiled
+  uint64_t _locked_at_ns;
+};
+
+void set_lock_profiling_enabled(bool enabled);
+bool lock_profiling_enabled();
+
+/*
+ * A snapshot of the stats of every lock site, keyed by site name.
+ */
+std::map<std::string, LockStats> lock_stats();
+void reset_lock_stats();
+}
+}
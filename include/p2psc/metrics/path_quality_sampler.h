@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <p2psc/metrics/instrumented_mutex.h>
+#include <p2psc/socket/socket.h>
+#include <set>
+#include <string>
+#include <thread>
+
+/**
+ * Samples the PathQuality (see Socket::get_path_quality) of a set of sockets
+ * periodically on a thread of its own, so that e.g. a scheduler can choose
+ * between peers or paths by their measured quality. The latest sample of each
+ * socket is kept, and passed to an optional handler, e.g. to export it. All
+ * sampling, and so every call of the handler, happens on that thread.
+ */
+namespace p2psc {
+namespace metrics {
+
+using PathQualityHandler = std::function<void(
+    const std::string &name, const socket::PathQuality &quality)>;
+
+class PathQualitySampler {
+public:
+  PathQualitySampler(std::chrono::milliseconds interval,
+                     const PathQualityHandler &handler = PathQualityHandler());
+  ~PathQualitySampler();
+
+  /*
+   * Sample socket under name, starting straight away (the sampler's thread
+   * is woken up for it), until it is removed or destroyed: the sampler
+   * doesn't keep it alive. Sockets which aren't TCP connections have no
+   * samples.
+   */
+  void add(const std::string &name, std::weak_ptr<Socket> socket);
+  void remove(const std::string &name);
+  // the latest sample of every socket, keyed by name
+  std::map<std::string, socket::PathQuality> latest();
+
+private:
+  PathQualitySampler(const PathQualitySampler &) = delete;
+  PathQualitySampler &operator=(const PathQualitySampler &) = delete;
+
+  using Clock = std::chrono::steady_clock;
+
+  void _run();
+  // Samples socket and records the result. Called on the sampler's thread,
+  // without the mutex held.
+  void _sample(const std::string &name, const Socket &socket);
+
+  const std::chrono::milliseconds _interval;
+  const PathQualityHandler _handler;
+  InstrumentedMutex _mutex;
+  std::condition_variable_any _cv;
+  bool _stopping;
+  std::map<std::string, std::weak_ptr<Socket>> _sockets;
+  // added since the thread last sampled, for it to sample straight away
+  std::set<std::string> _added;
+  std::map<std::string, socket::PathQuality> _latest;
+  std::thread _thread;
+};
+}
+}
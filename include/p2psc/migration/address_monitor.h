@@ -0,0 +1,43 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace p2psc {
+namespace migration {
+
+struct AddressChange {
+  enum Kind { kAdded, kRemoved };
+
+  Kind kind;
+  std::string ip;
+};
+
+/*
+ * Watches the host's IPv4 addresses over netlink, calling handler (from the
+ * monitor's thread) whenever one is added or removed. Throws
+ * MigrationException if netlink isn't available.
+ */
+class AddressMonitor {
+public:
+  using Handler = std::function<void(const AddressChange &)>;
+
+  explicit AddressMonitor(const Handler &handler);
+  ~AddressMonitor();
+
+private:
+  AddressMonitor(const AddressMonitor &) = delete;
+  AddressMonitor &operator=(const AddressMonitor &) = delete;
+
+  void _run();
+  void _handle(const char *buffer, std::size_t size);
+
+  const Handler _handler;
+  int _netlink_fd;
+  // written to by the destructor to stop _thread
+  int _stop_fd;
+  std::thread _thread;
+};
+}
+}
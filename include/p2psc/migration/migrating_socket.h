@@ -0,0 +1,70 @@
+#pragma once
+
+#include <p2psc/connection.h>
+#include <p2psc/migration/address_monitor.h>
+#include <p2psc/multipath/multipath_socket.h>
+
+/**
+ * Sockets which survive a change of local address, e.g. a laptop moving
+ * between networks or a DHCP lease changing, without the application seeing
+ * a disconnect.
+ *
+ * A MigratingSocket is a MultipathSocket (see multipath_socket.h) which
+ * starts with a single path. When that path fails, because a local address
+ * it used was removed (watched over netlink) or because nothing, not even a
+ * heartbeat, has arrived on it for a while, both ends connect again through
+ * the Mediator with the keys they used the first time and carry on over the
+ * new connection. Data which hadn't been acknowledged on the old connection
+ * is sent again, and send() and receive() block meanwhile.
+ */
+namespace p2psc {
+namespace migration {
+
+struct MigrationOptions {
+  // see multipath::MultipathOptions; the other end notices that a path has
+  // failed after path_timeout_ms
+  std::uint64_t heartbeat_interval_ms = 500;
+  std::uint64_t path_timeout_ms = 2000;
+  // How long to keep trying to reconnect, after which send() and receive()
+  // throw SocketExceptions.
+  std::uint64_t reconnect_timeout_ms = 60000;
+};
+
+class MigratingSocket : public socket::SocketLayer {
+public:
+  MigratingSocket(std::shared_ptr<Socket> socket, const key::Keypair &keypair,
+                  const Peer &peer, const Mediator &mediator,
+                  const MigrationOptions &options = MigrationOptions());
+  ~MigratingSocket();
+
+  void close() override;
+
+  /*
+   * Called by the netlink monitor. Applications which learn of address
+   * changes some other way (or where netlink isn't available) can call it
+   * too.
+   */
+  void handle_address_change(const AddressChange &change);
+
+  // how many times the connection has been moved to a new one
+  std::uint64_t migrations() const;
+
+private:
+  struct Reconnector;
+
+  void _stop();
+
+  std::shared_ptr<multipath::MultipathSocket> _stream;
+  std::shared_ptr<Reconnector> _reconnector;
+  std::unique_ptr<AddressMonitor> _address_monitor;
+};
+
+/*
+ * As p2psc::connect, but the socket is a MigratingSocket. The peer must
+ * connect this way too.
+ */
+void connect(const key::Keypair &keypair, const Peer &peer,
+             const Mediator &mediator, const Callback &callback,
+             const MigrationOptions &options = MigrationOptions());
+}
+}
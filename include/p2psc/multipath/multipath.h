@@ -0,0 +1,22 @@
+#pragma once
+
+#include <p2psc/connection.h>
+#include <p2psc/multipath/multipath_socket.h>
+
+namespace p2psc {
+namespace multipath {
+
+/*
+ * Set up paths connections to peer through the Mediator, one after the
+ * other, and pass them to callback as one MultipathSocket. The peer must
+ * connect with the same number of paths. Each connection gets its own local
+ * port, so the paths may take different routes through the network. If any
+ * connection fails, the ones already set up are closed and callback gets the
+ * error.
+ */
+void connect(const key::Keypair &keypair, const Peer &peer,
+             const Mediator &mediator, std::size_t paths,
+             const Callback &callback,
+             const MultipathOptions &options = MultipathOptions());
+}
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <boost/optional.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <p2psc/metrics/instrumented_mutex.h>
+#include <p2psc/socket/socket_layer.h>
+#include <thread>
+#include <vector>
+
+/**
+ * A Socket which spreads one stream of data over several connections
+ * ("paths") to the same peer, so that it isn't limited by the congestion
+ * window of a single TCP connection. Both ends must wrap their ends of the
+ * same connections; the order doesn't matter.
+ *
+ * send() splits data into segments and queues each on the path expected to
+ * deliver it first, given the path's smoothed round trip time and send
+ * throughput and what is already queued on it. Every path has a thread which
+ * sends its queue and one which receives from it. The receiver puts segments
+ * back in order and acknowledges each one on the path it arrived on; the
+ * acknowledgements give the round trip times. If a path fails, the segments
+ * it hasn't had acknowledged are sent again on the others (or on the next
+ * path added), so the stream survives as long as one path does.
+ *
+ * send() returns as soon as its data is queued, and only blocks while every
+ * path already has MultipathOptions::max_pending_bytes queued or in flight.
+ * Once the other end has closed, or all paths have failed (unless
+ * wait_for_paths is set), send() throws a SocketException, and receive() does
+ * so after returning whatever had arrived. The socket address and incoming
+ * CPU are those of the first path.
+ */
+namespace p2psc {
+namespace multipath {
+
+struct MultipathOptions {
+  // also the largest segment accepted from the other end, which fails the
+  // path it arrives on
+  std::size_t segment_size = 64 * 1024;
+  // per path, bytes queued or sent but not yet acknowledged
+  std::size_t max_pending_bytes = 4 * 1024 * 1024;
+  // received bytes which receive() hasn't returned yet, after which paths
+  // stop reading
+  std::size_t max_buffered_bytes = 16 * 1024 * 1024;
+  // Idle paths send a heartbeat this often (0 for never). A path on which
+  // nothing has been received for path_timeout_ms (0 for no limit) fails;
+  // it should be a few times the other end's heartbeat interval.
+  std::uint64_t heartbeat_interval_ms = 1000;
+  std::uint64_t path_timeout_ms = 0;
+  // When every path has failed, wait for add_path rather than failing.
+  bool wait_for_paths = false;
+};
+
+struct PathStats {
+  std::uint64_t bytes_sent = 0;
+  // smoothed, or 0 until the first acknowledgement
+  double rtt_us = 0;
+  // smoothed bytes per second ::send accepted, or 0 until the first segment
+  double throughput = 0;
+  bool failed = false;
+  // the path's connection, as the kernel sees it
+  boost::optional<socket::PathQuality> quality;
+};
+
+class MultipathSocket : public socket::SocketLayer {
+public:
+  MultipathSocket(const std::vector<std::shared_ptr<Socket>> &paths,
+                  const MultipathOptions &options = MultipathOptions());
+  ~MultipathSocket();
+
+  void send(const std::string &data) override;
+  std::string receive() override;
+  /*
+   * Waits (for up to a few seconds) until the other end has acknowledged
+   * everything sent, tells it that we're closing and closes every path.
+   */
+  void close() override;
+
+  /*
+   * Start using another connection to the peer, which the other end must add
+   * too. Segments of failed paths which no other path has taken are sent on
+   * it.
+   */
+  void add_path(std::shared_ptr<Socket> path);
+  /*
+   * Fail the paths whose local address is ip, e.g. because it has been
+   * removed from the host.
+   */
+  void drop_paths_from(const std::string &ip, const std::string &reason);
+  /*
+   * With wait_for_paths, handler is called whenever the last live path
+   * fails, from the thread which noticed, while the socket is locked: it
+   * must not block or call back into the socket.
+   */
+  void set_disconnect_handler(std::function<void()> handler);
+  /*
+   * Stop waiting for paths: send() and receive() throw with reason from now
+   * on.
+   */
+  void abandon(const std::string &reason);
+
+  std::vector<PathStats> path_stats();
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Segment {
+    std::uint64_t sequence;
+    std::string data;
+    Clock::time_point sent_at;
+  };
+
+  struct Path {
+    std::shared_ptr<Socket> socket;
+    // segments waiting to be sent, and sent but not yet acknowledged
+    std::deque<Segment> queued;
+    std::deque<Segment> unacknowledged;
+    std::size_t queued_bytes = 0;
+    std::size_t pending_bytes = 0;
+    // sequence numbers of received segments to acknowledge
+    std::vector<std::uint64_t> acknowledgements;
+    Clock::time_point last_sent;
+    Clock::time_point last_received;
+    PathStats stats;
+    std::thread sender;
+    std::thread receiver;
+  };
+
+  void _start(Path *path);
+  void _send_loop(Path *path);
+  void _receive_loop(Path *path);
+  // The live path expected to deliver size more bytes first. If
+  // must_have_room, only paths with room for them under max_pending_bytes
+  // count, and there may be none.
+  Path *_choose_path(std::size_t size, bool must_have_room);
+  void _queue(Path *path, Segment segment);
+  void _on_acknowledgement(Path *path, std::uint64_t sequence);
+  void _on_segment(std::uint64_t sequence, std::string data);
+  // moves the path's segments to the other paths
+  void _fail(Path *path, const std::string &reason);
+  bool _has_live_path() const;
+  // whether send() and receive() should give up
+  bool _is_finished() const;
+  std::string _finished_reason() const;
+
+  const MultipathOptions _options;
+  std::vector<std::unique_ptr<Path>> _paths;
+
+  metrics::InstrumentedMutex _mutex;
+  std::condition_variable_any _cv;
+  bool _closing;
+  bool _remote_closed;
+  bool _abandoned;
+  // the reason the last path failed, or the socket was abandoned
+  std::string _failure;
+  std::function<void()> _disconnect_handler;
+  std::uint64_t _next_sequence;
+  // segments of failed paths, waiting for a path to be added
+  std::deque<Segment> _unsent;
+
+  // receive side: the in-order data receive() hasn't returned yet, and
+  // segments which arrived ahead of it
+  std::string _received;
+  std::uint64_t _next_received_sequence;
+  std::map<std::uint64_t, std::string> _out_of_order;
+};
+}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * Control over which CPUs the threads created by p2psc run on. By default
+ * threads are left to the scheduler; on multi-socket hosts, pinning them to
+ * the cores (or NUMA node) that service the NIC avoids cross-core cache
+ * traffic during handshakes.
+ */
+namespace p2psc {
+namespace placement {
+
+class CpuSet {
+public:
+  CpuSet() {}
+
+  /*
+   * Parse a Linux cpu list, e.g. "0-3,8,10-11".
+   */
+  static CpuSet parse(const std::string &cpu_list);
+  /*
+   * All CPUs belonging to a NUMA node, as reported by sysfs.
+   */
+  static CpuSet of_numa_node(int node);
+
+  void add(int cpu);
+  bool contains(int cpu) const;
+  bool empty() const { return _cpus.empty(); }
+  const std::vector<int> &cpus() const { return _cpus; }
+  std::string to_string() const;
+
+private:
+  // sorted, without duplicates
+  std::vector<int> _cpus;
+};
+
+struct Placement {
+  // CPUs that connection threads may run on. Empty means unrestricted.
+  CpuSet connection_cpus;
+  // Pin each connection thread to a single CPU of connection_cpus, assigned
+  // round robin, rather than letting it float across the whole set.
+  bool pin_to_single_cpu = false;
+  // When we accept a connection from the Client, move the handshake thread
+  // to the CPU the connection arrived on (see SO_INCOMING_CPU), provided it
+  // is in connection_cpus.
+  bool follow_incoming_cpu = false;
+};
+
+/*
+ * Set the process-wide placement of p2psc's threads. Applies to connections
+ * started after the call.
+ */
+void set_placement(const Placement &placement);
+Placement get_placement();
+
+/*
+ * Pin the calling thread to the given CPUs. Throws PlacementException.
+ */
+void pin_current_thread(const CpuSet &cpus);
+int current_cpu();
+int numa_node_of_cpu(int cpu);
+
+/*
+ * Called by p2psc on each new connection thread, and when a connection from
+ * the Client has been accepted. These never throw; a placement that cannot be
+ * applied is logged and otherwise ignored.
+ */
+void apply_to_connection_thread();
+void apply_incoming_cpu(int incoming_cpu);
+}
+}
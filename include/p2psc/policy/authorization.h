@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Which keys may connect to which, for a Mediator to check on every
+ * Advertise. Keys are named by their fingerprints (see
+ * key::PublicKey::fingerprint()), and a pair (from, to) allows from to
+ * connect to to; mutual connections need both pairs.
+ *
+ * The pairs are compiled into a file which is memory mapped, so that millions
+ * of them cost little more than their size on disk and nothing to load: a
+ * blocked Bloom filter, which turns away most pairs that aren't allowed with
+ * a single cache line, in front of a sorted table of the allowed pairs. Pairs
+ * are identified by the first 64 bits of both fingerprints.
+ */
+namespace p2psc {
+namespace policy {
+
+using FingerprintPair = std::pair<std::string, std::string>;
+
+struct AuthorizationFilterOptions {
+  // Bloom filter size; 12 bits per pair let through about 0.5% of the pairs
+  // which aren't allowed to the table
+  std::size_t bloom_bits_per_pair = 12;
+};
+
+class AuthorizationFilter {
+public:
+  /*
+   * Compile pairs into a filter file at path. The file is written next to
+   * path and renamed into place, so a filter being opened concurrently is
+   * either the old one or the new one. Throws PolicyException.
+   */
+  static void build(const std::vector<FingerprintPair> &pairs,
+                    const std::string &path,
+                    const AuthorizationFilterOptions &options =
+                        AuthorizationFilterOptions());
+  /*
+   * Map a filter file built by build(). Throws PolicyException if it can't
+   * be read or isn't a filter file. The file must be replaced rather than
+   * written over while it's mapped.
+   */
+  static std::shared_ptr<const AuthorizationFilter>
+  open(const std::string &path);
+  ~AuthorizationFilter();
+
+  /*
+   * Whether from may connect to to. Never throws; malformed fingerprints
+   * aren't allowed anything.
+   */
+  bool allows(const std::string &from_fingerprint,
+              const std::string &to_fingerprint) const;
+
+  std::uint64_t pairs() const;
+  // of the mapping
+  std::uint64_t size() const { return _size; }
+
+private:
+  struct Header;
+  struct Entry;
+
+  AuthorizationFilter(int fd, std::uint64_t size, const std::string &path);
+  AuthorizationFilter(const AuthorizationFilter &) = delete;
+
+  const int _fd;
+  const std::uint64_t _size;
+  const char *_data;
+  const Header *_header;
+  const std::uint64_t *_bloom;
+  const std::uint64_t *_directory;
+  const Entry *_entries;
+};
+
+/*
+ * An AuthorizationFilter that can be replaced while it's being checked:
+ * reload() maps the file at path again, and checks which already started
+ * finish against the filter they started with. Each check takes a reference
+ * to the current filter; a thread checking many pairs in a row can hold on
+ * to filter() instead.
+ */
+class Authorization {
+public:
+  // Throws PolicyException.
+  explicit Authorization(const std::string &path);
+
+  bool allows(const std::string &from_fingerprint,
+              const std::string &to_fingerprint) const;
+  /*
+   * Throws PolicyException if the file can't be opened, in which case the
+   * current filter stays in place.
+   */
+  void reload();
+  std::shared_ptr<const AuthorizationFilter> filter() const;
+
+private:
+  const std::string _path;
+  // only accessed with std::atomic_load/atomic_store
+  std::shared_ptr<const AuthorizationFilter> _filter;
+};
+}
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <atomic>
+#include <boost/utility/string_ref.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <p2psc/error.h>
+#include <p2psc/metrics/instrumented_mutex.h>
+#include <p2psc/socket/socket.h>
+#include <set>
+#include <string>
+#include <thread>
+
+/**
+ * Request/response calls in both directions over a socket p2psc returned.
+ * Each end wraps its end of the connection in a Channel. Calls are tagged
+ * with an id, so any number can be outstanding at once and their responses
+ * can come back in any order. Every call has a deadline, after which it
+ * fails locally; a response arriving later is dropped.
+ *
+ * Received payloads are passed to handlers and callbacks as views into the
+ * channel's receive buffer, which are only valid until they return.
+ * Handlers, and callbacks with a response, run on the channel's receive
+ * thread, so they must not block: a handler with slow work to do should hand
+ * its Responder to another thread, which can respond whenever it is done.
+ * A callback failing its call runs on whichever thread noticed the failure:
+ * the channel's deadline thread, the receive thread, the thread calling
+ * close(), or the thread calling call() itself if the request couldn't be
+ * sent. Callbacks must therefore be safe to run on any of these, and
+ * mustn't block either.
+ */
+namespace p2psc {
+namespace rpc {
+
+using Payload = boost::string_ref;
+
+struct ChannelOptions {
+  // Larger requests and responses are refused when sending, and close the
+  // channel when received.
+  std::size_t max_payload_size = 64 * 1024 * 1024;
+};
+
+class Channel;
+
+/*
+ * Answers one request. Can be copied, and used from any thread; only the
+ * first response counts. Responses for a channel which has been closed are
+ * dropped.
+ */
+class Responder {
+public:
+  void respond(const std::string &response);
+  // Fails the call with kErrorRpcCallFailed and reason.
+  void fail(const std::string &reason);
+
+private:
+  friend class Channel;
+  struct Writer;
+
+  Responder(std::weak_ptr<Writer> writer, std::uint64_t id);
+
+  std::weak_ptr<Writer> _writer;
+  std::uint64_t _id;
+  std::shared_ptr<std::atomic<bool>> _responded;
+};
+
+/*
+ * Called with each request the other end makes. If it throws a
+ * std::exception before responding, the call fails with what().
+ */
+using Handler = std::function<void(const std::string &method,
+                                   Payload request, Responder responder)>;
+
+/*
+ * Called once per call: with the response, or with an Error of kind
+ * kErrorRpcDeadlineExceeded, kErrorRpcCallFailed (the other end failed it)
+ * or kErrorRpcChannelClosed.
+ */
+using ResponseCallback = std::function<void(Error error, Payload response)>;
+
+class Channel {
+public:
+  /*
+   * Starts receiving on socket. Requests are answered by handler; without
+   * one, they fail.
+   */
+  Channel(std::shared_ptr<Socket> socket, const Handler &handler = Handler(),
+          const ChannelOptions &options = ChannelOptions());
+  ~Channel();
+
+  /*
+   * Call method on the other end. Returns once the request has been sent;
+   * callback is called when the call completes, which is straight away, on
+   * this thread, if the channel is closed or the request can't be sent.
+   */
+  void call(const std::string &method, const std::string &request,
+            std::chrono::milliseconds timeout,
+            const ResponseCallback &callback);
+  /*
+   * As above, but blocks for the response. Throws an RpcException if the
+   * call fails. Mustn't be called from a handler or callback.
+   */
+  std::string call(const std::string &method, const std::string &request,
+                   std::chrono::milliseconds timeout);
+
+  /*
+   * Closes the socket, failing outstanding calls. Mustn't be called from a
+   * handler or callback.
+   */
+  void close();
+
+  // calls waiting for a response
+  std::size_t outstanding_calls();
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Call {
+    ResponseCallback callback;
+    Clock::time_point deadline;
+  };
+
+  Channel(const Channel &) = delete;
+  Channel &operator=(const Channel &) = delete;
+
+  void _receive_loop();
+  void _deadline_loop();
+  void _on_frame(char kind, std::uint64_t id, Payload method,
+                 Payload payload);
+  void _on_request(std::uint64_t id, Payload method, Payload payload);
+  // Removes the call, if it's still outstanding, and completes it.
+  void _complete(std::uint64_t id, const Error &error, Payload response);
+  // Fails every outstanding call, and any made from now on, with error
+  // unless the channel has already failed.
+  void _fail_all(const Error &error);
+  // once, from close() or when the receive side fails
+  void _close_socket();
+
+  const std::shared_ptr<Socket> _socket;
+  const Handler _handler;
+  const ChannelOptions _options;
+  const std::shared_ptr<Responder::Writer> _writer;
+
+  metrics::InstrumentedMutex _mutex;
+  std::condition_variable_any _cv;
+  bool _closing;
+  bool _socket_closed;
+  // set once the channel can't make calls any more
+  Error _failure;
+  std::uint64_t _next_id;
+  std::map<std::uint64_t, Call> _calls;
+  std::set<std::pair<Clock::time_point, std::uint64_t>> _deadlines;
+
+  std::thread _receiver;
+  std::thread _deadline_thread;
+};
+}
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <boost/optional.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <p2psc/metrics/instrumented_mutex.h>
+#include <p2psc/socket/socket_layer.h>
+#include <thread>
+
+namespace p2psc {
+namespace socket {
+
+struct BufferedOptions {
+  // send() writes the buffer straight away once it holds this many bytes
+  std::size_t max_buffered_bytes = 16 * 1024;
+  // how long data may wait in the buffer before it is written
+  std::uint64_t flush_delay_us = 200;
+};
+
+/*
+ * A Socket which coalesces small sends into fewer, larger writes on the
+ * socket it wraps, for applications which send many small messages. send()
+ * only appends to a buffer. The buffer is written once it reaches
+ * max_buffered_bytes, by flush(), before receive() and otherwise by a thread
+ * of its own once its oldest data has waited flush_delay_us.
+ *
+ * Writes made because the buffer is full use send_more, so the kernel can
+ * hold back their last partial segment for the data which follows; the
+ * deadline write pushes it out. The buffer takes the place of Nagle's
+ * algorithm, which it turns off on the wrapped socket: otherwise a deadline
+ * write could wait for the ACK of an earlier one, which may be delayed by
+ * tens of milliseconds. A write which fails on the thread is thrown by the
+ * next send() or flush().
+ */
+class BufferedSocket : public SocketLayer {
+public:
+  BufferedSocket(std::shared_ptr<Socket> inner,
+                 const BufferedOptions &options = BufferedOptions());
+  // writes what is still buffered, ignoring errors
+  ~BufferedSocket();
+
+  void send(const std::string &data) override;
+  std::string receive() override;
+  void send_file(int file_fd, off_t offset, std::size_t size) override;
+  // Writes what is buffered, and closes the wrapped socket.
+  void close() override;
+
+  // Writes what is buffered now.
+  void flush();
+
+  // bytes passed to send(), and the writes made on the wrapped socket for
+  // them
+  std::uint64_t bytes_sent() const { return _bytes_sent; }
+  std::uint64_t writes() const { return _writes; }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  BufferedSocket(const BufferedSocket &) = delete;
+  BufferedSocket &operator=(const BufferedSocket &) = delete;
+
+  void _flush_loop();
+  // Called with the mutex held. Throws what the thread failed with, if
+  // anything.
+  void _check_error();
+  // Called with the mutex held.
+  void _write(bool more);
+  void _stop();
+
+  const BufferedOptions _options;
+  metrics::InstrumentedMutex _mutex;
+  std::condition_variable_any _cv;
+  std::string _buffer;
+  // when the buffer must be written by, if it has anything to write
+  boost::optional<Clock::time_point> _deadline;
+  // whether send_more may have left data in the kernel which hasn't been
+  // pushed yet
+  bool _held_back;
+  bool _stopping;
+  std::string _error;
+  std::atomic<std::uint64_t> _bytes_sent;
+  std::atomic<std::uint64_t> _writes;
+  std::thread _flusher;
+};
+}
+}
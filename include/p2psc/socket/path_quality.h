@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+namespace p2psc {
+namespace socket {
+
+/*
+ * The kernel's view of a TCP connection's path (see tcp(7), TCP_INFO).
+ */
+struct PathQuality {
+  // smoothed round trip time, and its mean deviation
+  std::uint32_t rtt_us = 0;
+  std::uint32_t rtt_var_us = 0;
+  // segments retransmitted over the connection's lifetime
+  std::uint32_t total_retransmits = 0;
+  // the congestion window, in segments of mss bytes
+  std::uint32_t congestion_window = 0;
+  std::uint32_t mss = 0;
+  // bytes per second, as of the most recent acknowledgement, or 0 if the
+  // kernel doesn't report it
+  std::uint64_t delivery_rate = 0;
+  // sent but neither acknowledged nor presumed lost
+  std::uint64_t bytes_in_flight = 0;
+};
+}
+}
@@ -1,10 +1,14 @@
 #pragma once
 
+#include <atomic>
+#include <boost/optional.hpp>
 #include <iostream>
 #include <netinet/in.h>
+#include <p2psc/socket/path_quality.h>
 #include <p2psc/socket/socket_address.h>
 #include <p2psc/socket/socket_exception.h>
 #include <sys/socket.h>
+#include <sys/types.h>
 
 namespace p2psc {
 namespace socket {
@@ -15,21 +19,58 @@ class Socket {
 public:
   Socket(const socket::SocketAddress &socket_address);
   Socket(int sock_fd);
-  ~Socket();
+  virtual ~Socket();
 
   virtual void send(const std::string &);
   virtual std::string receive();
-  socket::SocketAddress get_socket_address();
-  void close();
+  // Like send, but tells the kernel that more data follows shortly
+  // (MSG_MORE), so that it may hold back a partial segment until then.
+  virtual void send_more(const std::string &);
+  // Send whatever send_more held back without waiting for more data.
+  virtual void push();
+  // Turn off Nagle's algorithm (TCP_NODELAY), so that a small send or push()
+  // goes out without waiting for earlier data to be acknowledged.
+  virtual void set_no_delay();
+  // Send size bytes of the file file_fd from offset. The data doesn't pass
+  // through userspace (see sendfile(2)).
+  virtual void send_file(int file_fd, off_t offset, std::size_t size);
+  // Block until exactly size bytes have been received into buffer.
+  virtual void receive_exactly(char *buffer, std::size_t size);
+  // Have the next receive or receive_exactly return data before anything
+  // else, e.g. what was received past the end of a message.
+  virtual void put_back(const std::string &data);
+  virtual socket::SocketAddress get_socket_address();
+  // The address of our end of the connection.
+  virtual socket::SocketAddress get_local_address();
+  // The CPU whose RX queue received this connection's packets, or -1 if
+  // unknown.
+  virtual int get_incoming_cpu() const;
+  // The kernel's measurements of the connection, or boost::none if it isn't
+  // a TCP connection. Safe to call while other threads use the socket.
+  virtual boost::optional<socket::PathQuality> get_path_quality() const;
+  // Wake up threads blocked on this socket, which throw, as do later sends
+  // and receives. Unlike close(), the file descriptor stays ours, so another
+  // thread still using it can't find it reused.
+  virtual void shutdown();
+  // Threads blocked in receive() on this socket are woken up and throw.
+  virtual void close();
+
+protected:
+  // For socket layers (see SocketLayer), which wrap another Socket rather
+  // than owning a file descriptor.
+  Socket();
 
 private:
   Socket(const Socket &) = delete;
 
   void _connect();
+  void _send(const std::string &message, int flags);
   void _check_is_open();
 
   int _sock_fd;
-  bool _is_open;
+  std::string _put_back;
+  // read by threads using the socket while another closes it
+  std::atomic<bool> _is_open;
   struct sockaddr_in _address;
 };
 }
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <memory>
+#include <p2psc/socket/socket.h>
+
+namespace p2psc {
+namespace socket {
+
+/*
+ * A Socket which adds behaviour (e.g. compression) on top of another Socket.
+ * Everything a layer doesn't override is passed through to the wrapped
+ * socket, except send_file, send_more and receive_exactly, which go through
+ * the layer's send and receive. Data left over from a receive_exactly is only
+ * returned by later calls to receive_exactly, so the two shouldn't be mixed.
+ */
+class SocketLayer : public Socket {
+public:
+  SocketLayer(std::shared_ptr<Socket> inner) : _inner(inner) {}
+
+  void send(const std::string &data) override { _inner->send(data); }
+  std::string receive() override { return _inner->receive(); }
+  void send_more(const std::string &data) override { send(data); }
+  void push() override { _inner->push(); }
+  void set_no_delay() override { _inner->set_no_delay(); }
+  void send_file(int file_fd, off_t offset, std::size_t size) override;
+  void receive_exactly(char *buffer, std::size_t size) override;
+  void put_back(const std::string &data) override { _inner->put_back(data); }
+  SocketAddress get_socket_address() override {
+    return _inner->get_socket_address();
+  }
+  SocketAddress get_local_address() override {
+    return _inner->get_local_address();
+  }
+  int get_incoming_cpu() const override { return _inner->get_incoming_cpu(); }
+  boost::optional<PathQuality> get_path_quality() const override {
+    return _inner->get_path_quality();
+  }
+  void shutdown() override { _inner->shutdown(); }
+  void close() override { _inner->close(); }
+
+protected:
+  const std::shared_ptr<Socket> _inner;
+
+private:
+  std::string _received;
+};
+}
+}
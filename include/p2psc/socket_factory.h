@@ -0,0 +1,70 @@
+#pragma once
+
+#include <memory>
+#include <p2psc/socket/socket.h>
+#include <p2psc/socket/socket_address.h>
+#include <p2psc/socket_creator.h>
+
+/**
+ * Socket factories are the compile time alternative to SocketCreator. A
+ * factory is a type with:
+ *
+ *   using socket_type = ...; // Socket or a subclass of it
+ *   std::shared_ptr<socket_type> create(const socket::SocketAddress &) const;
+ *   std::shared_ptr<socket_type> create(int sock_fd) const;
+ *
+ * Code templated on a factory knows the concrete socket type, so there is no
+ * std::function call or SocketAddressOrFileDescriptor per socket, and, for a
+ * final socket_type, no virtual call per send or receive.
+ */
+namespace p2psc {
+
+/*
+ * A Socket which can't be extended, so calls through it need no virtual
+ * dispatch.
+ */
+class PlainSocket final : public Socket {
+public:
+  using Socket::Socket;
+};
+
+/*
+ * Creates PlainSockets. This is what p2psc::connect uses.
+ */
+struct PlainSocketFactory {
+  using socket_type = PlainSocket;
+
+  std::shared_ptr<PlainSocket>
+  create(const socket::SocketAddress &socket_address) const {
+    return std::make_shared<PlainSocket>(socket_address);
+  }
+
+  std::shared_ptr<PlainSocket> create(int sock_fd) const {
+    return std::make_shared<PlainSocket>(sock_fd);
+  }
+};
+
+/*
+ * Creates sockets with a SocketCreator, for when the socket type is chosen at
+ * run time, e.g. to mock or record sockets.
+ */
+class SocketCreatorFactory {
+public:
+  using socket_type = Socket;
+
+  SocketCreatorFactory(const SocketCreator &socket_creator)
+      : _socket_creator(socket_creator) {}
+
+  std::shared_ptr<Socket>
+  create(const socket::SocketAddress &socket_address) const {
+    return _socket_creator(socket_address);
+  }
+
+  std::shared_ptr<Socket> create(int sock_fd) const {
+    return _socket_creator(sock_fd);
+  }
+
+private:
+  SocketCreator _socket_creator;
+};
+}
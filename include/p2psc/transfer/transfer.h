@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <p2psc/socket/socket.h>
+#include <string>
+#include <vector>
+
+/**
+ * Transfer of files between peers over one or more p2psc connections.
+ *
+ * The file is split into chunks which are spread over all the connections
+ * in parallel, each connection taking the next chunk as soon as it has sent
+ * the last. The sender reads chunks with sendfile(2); the receiver receives
+ * them straight into the mmap(2)ed destination file.
+ *
+ * Integrity is checked with a tree hash (see TreeHash): the sender first
+ * announces the hash of every chunk and the root over them, and each chunk is
+ * checked against its hash as it arrives. The receiver writes to
+ * "<name>.partial" and only renames it once every chunk has been verified. If
+ * a transfer is interrupted, sending the same file again resumes it: chunks
+ * of the partial file which already match their hash aren't sent again.
+ *
+ * Both ends must pass their ends of the same connections, with the same
+ * connection first; it also carries the transfer's control messages. Failures
+ * are thrown as TransferExceptions, after which the connections should be
+ * closed: the other end may still be waiting on them. (When receiving a
+ * chunk fails, receive_file closes that connection itself, so that the
+ * sender stops, and shuts down the others.)
+ */
+namespace p2psc {
+namespace transfer {
+
+struct TransferOptions {
+  // At most 2^32 - 9 bytes, so that a chunk fits in one frame, and large
+  // enough that the file has at most about a million chunks, whose hashes
+  // fit in the 64 MiB a manifest may take.
+  std::size_t chunk_size = 1 << 20;
+};
+
+struct TransferStats {
+  std::uint64_t chunks = 0;
+  // chunks (and their bytes) actually sent, i.e. not already at the receiver
+  std::uint64_t chunks_transferred = 0;
+  std::uint64_t bytes_transferred = 0;
+};
+
+TransferStats send_file(const std::string &path,
+                        const std::vector<std::shared_ptr<Socket>> &sockets,
+                        const TransferOptions &options = TransferOptions());
+
+struct ReceivedFile {
+  std::string path;
+  TransferStats stats;
+};
+
+/*
+ * Receive a file into directory, under the name the sender gave it.
+ */
+ReceivedFile receive_file(const std::string &directory,
+                          const std::vector<std::shared_ptr<Socket>> &sockets);
+}
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace p2psc {
+namespace transfer {
+
+/*
+ * A SHA-256 Merkle tree over the chunks of a file. Leaves are the hashes of
+ * 0x00 followed by a chunk; inner nodes are the hashes of 0x01 followed by
+ * their two children. A node without a sibling is carried up a level as it
+ * is. Hashes are raw 32 byte strings.
+ */
+class TreeHash {
+public:
+  explicit TreeHash(const std::vector<std::string> &leaves);
+
+  static std::string hash_chunk(const char *data, std::size_t size);
+
+  const std::vector<std::string> &leaves() const { return _leaves; }
+  const std::string &root() const { return _root; }
+
+private:
+  std::vector<std::string> _leaves;
+  std::string _root;
+};
+}
+}
@@ -1,9 +1,22 @@
+#include <boost/filesystem.hpp>
 #include <boost/test/unit_test.hpp>
+#include <p2psc/capture/capture.h>
+#include <p2psc/capture/recording_socket.h>
+#include <p2psc/connection.h>
+#include <p2psc/dht/dht.h>
+#include <p2psc/discovery/discovery.h>
+#include <p2psc/introduction/introduction.h>
+#include <p2psc/local/local_socket.h>
+#include <p2psc/local/local_transport.h>
 #include <p2psc/message/advertise.h>
+#include <p2psc/message/advertise_abort.h>
 #include <p2psc/message/advertise_challenge.h>
 #include <p2psc/message/advertise_response.h>
 #include <p2psc/message/message_decoder.h>
 #include <p2psc/message/peer_identification.h>
+#include <p2psc/metrics/handshake_stats.h>
+#include <p2psc/migration/migrating_socket.h>
+#include <p2psc/policy/authorization.h>
 #include <src/util/client.h>
 #include <src/util/fake_mediator.h>
 
@@ -11,6 +24,7 @@ namespace p2psc {
 namespace integration {
 namespace {
 const uint64_t kDefaultPeerConnectTimeout = 100;
+const uint64_t kDefaultHandshakeTimeout = 5000;
 
 void block(uint64_t ms) {
   std::this_thread::sleep_for(std::chrono::milliseconds(ms));
@@ -79,6 +93,37 @@ BOOST_AUTO_TEST_CASE(ShouldCorrectlyProveIdentityWithNonce) {
   BOOST_ASSERT(decrypted_nonce == advertise_response.payload.nonce);
 }
 
+BOOST_AUTO_TEST_CASE(ShouldAbortAdvertiseOfUnauthorizedPair) {
+  const auto keypair = key::Keypair::generate();
+  const auto peer_pub_key = key::PublicKey::generate();
+  const auto our_fingerprint =
+      key::PublicKey::from_string(keypair.get_serialised_public_key())
+          .fingerprint();
+  // the peer may connect to us, but not the other way round
+  const auto path = (boost::filesystem::temp_directory_path() /
+                     boost::filesystem::unique_path())
+                        .string();
+  policy::AuthorizationFilter::build(
+      {{peer_pub_key.fingerprint(), our_fingerprint}}, path);
+  util::FakeMediator mediator(stateful_socket_creator);
+  mediator.set_authorization(std::make_shared<policy::Authorization>(path));
+  boost::filesystem::remove(path);
+  mediator.quit_after(message::kTypeAdvertiseAbort);
+  mediator.run();
+
+  auto peer = util::Client(Peer(peer_pub_key),
+                           mediator.get_mediator_description(), keypair);
+  const auto socket = peer.connect_sync(kDefaultPeerConnectTimeout);
+
+  BOOST_ASSERT(socket == nullptr);
+  mediator.await_shutdown();
+  const auto sent_messages = mediator.get_sent_messages();
+  BOOST_ASSERT(sent_messages.size() == 1);
+  const auto advertise_abort =
+      message::decode<message::AdvertiseAbort>(sent_messages[0]);
+  BOOST_ASSERT(advertise_abort.payload.reason == "Not authorized");
+}
+
 BOOST_AUTO_TEST_CASE(ShouldSendPeerIdentificationToFirstPeer) {
   util::FakeMediator mediator(stateful_socket_creator);
   mediator.quit_after(message::kTypePeerIdentification);
@@ -91,14 +136,17 @@ BOOST_AUTO_TEST_CASE(ShouldSendPeerIdentificationToFirstPeer) {
                        peer_keypair.get_serialised_public_key())),
                    mediator.get_mediator_description(), client_keypair);
   // the client connects first
-  const auto client_socket = client.connect_async();
+  const auto client_connection = client.connect_async();
   block(kDefaultPeerConnectTimeout);
   auto peer = util::Client(Peer(key::PublicKey::from_string(
                                client_keypair.get_serialised_public_key())),
                            mediator.get_mediator_description(), peer_keypair);
-  const auto peer_socket = peer.connect_async();
+  const auto peer_connection = peer.connect_async();
   mediator.await_shutdown();
-  block(kDefaultPeerConnectTimeout);
+  const auto client_socket =
+      util::Client::await(client_connection, kDefaultHandshakeTimeout);
+  const auto peer_socket =
+      util::Client::await(peer_connection, kDefaultHandshakeTimeout);
 
   BOOST_ASSERT(client_socket != nullptr);
   BOOST_ASSERT(peer_socket != nullptr);
@@ -129,14 +177,17 @@ BOOST_AUTO_TEST_CASE(ShouldCompletePeerHandshake) {
                        peer_keypair.get_serialised_public_key())),
                    mediator.get_mediator_description(), client_keypair);
   // the client connects first
-  const auto client_socket = client.connect_async();
+  const auto client_connection = client.connect_async();
   block(kDefaultPeerConnectTimeout);
   auto peer = util::Client(Peer(key::PublicKey::from_string(
                                client_keypair.get_serialised_public_key())),
                            mediator.get_mediator_description(), peer_keypair);
-  const auto peer_socket = peer.connect_async();
+  const auto peer_connection = peer.connect_async();
   mediator.await_shutdown();
-  block(kDefaultPeerConnectTimeout);
+  const auto client_socket =
+      util::Client::await(client_connection, kDefaultHandshakeTimeout);
+  const auto peer_socket =
+      util::Client::await(peer_connection, kDefaultHandshakeTimeout);
 
   BOOST_ASSERT(client_socket->get_sent_messages().size() == 2);
   BOOST_ASSERT(peer_socket->get_sent_messages().size() == 2);
@@ -153,6 +204,482 @@ BOOST_AUTO_TEST_CASE(ShouldCompletePeerHandshake) {
   BOOST_ASSERT(received_message == message);
 }
 
+BOOST_AUTO_TEST_CASE(ShouldCaptureCompleteHandshake) {
+  const auto filename = "/tmp/p2psc_capture_it_testfile";
+  util::FakeMediator mediator(stateful_socket_creator);
+  mediator.run();
+
+  const auto writer = capture::CaptureWriter::open(filename);
+  const auto socket_creator = capture::recording_socket_creator(writer);
+  const auto client_keypair = key::Keypair::generate();
+  const auto peer_keypair = key::Keypair::generate();
+  const auto client_socket =
+      std::make_shared<std::promise<std::shared_ptr<Socket>>>();
+  const auto peer_socket =
+      std::make_shared<std::promise<std::shared_ptr<Socket>>>();
+  Connection::connect(client_keypair,
+                      Peer(key::PublicKey::from_string(
+                          peer_keypair.get_serialised_public_key())),
+                      mediator.get_mediator_description(),
+                      [client_socket](Error error,
+                                      std::shared_ptr<Socket> socket) {
+                        client_socket->set_value(socket);
+                      },
+                      socket_creator);
+  block(kDefaultPeerConnectTimeout);
+  Connection::connect(peer_keypair,
+                      Peer(key::PublicKey::from_string(
+                          client_keypair.get_serialised_public_key())),
+                      mediator.get_mediator_description(),
+                      [peer_socket](Error error,
+                                    std::shared_ptr<Socket> socket) {
+                        peer_socket->set_value(socket);
+                      },
+                      socket_creator);
+  const auto timeout = std::chrono::milliseconds(kDefaultHandshakeTimeout);
+  auto client_result = client_socket->get_future();
+  auto peer_result = peer_socket->get_future();
+  const auto client_status = client_result.wait_for(timeout);
+  const auto peer_status = peer_result.wait_for(timeout);
+  BOOST_ASSERT(client_status == std::future_status::ready);
+  BOOST_ASSERT(peer_status == std::future_status::ready);
+  BOOST_ASSERT(client_result.get() != nullptr);
+  BOOST_ASSERT(peer_result.get() != nullptr);
+  writer->flush();
+
+  // two connections to the Mediator, plus one connection per side between
+  // the Client and the Peer, each sending two messages.
+  const auto reader = capture::CaptureReader::open(filename);
+  int opened = 0, sent = 0;
+  while (const auto record = reader->next()) {
+    if (record->event == capture::kEventOpen) {
+      opened++;
+    } else if (record->event == capture::kEventSent) {
+      BOOST_ASSERT(!record->data.empty());
+      sent++;
+    }
+  }
+  BOOST_ASSERT(opened == 4);
+  BOOST_ASSERT(sent == 8);
+  remove(filename);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldReportHandshakeStats) {
+  std::mutex mutex;
+  std::vector<metrics::HandshakeStats> handshake_stats;
+  metrics::set_handshake_stats_handler(
+      [&](const metrics::HandshakeStats &stats) {
+        std::lock_guard<std::mutex> guard(mutex);
+        handshake_stats.push_back(stats);
+      });
+  util::FakeMediator mediator(stateful_socket_creator);
+  mediator.run();
+
+  const auto client_keypair = key::Keypair::generate();
+  const auto peer_keypair = key::Keypair::generate();
+  auto client =
+      util::Client(Peer(key::PublicKey::from_string(
+                       peer_keypair.get_serialised_public_key())),
+                   mediator.get_mediator_description(), client_keypair);
+  const auto client_connection = client.connect_async();
+  block(kDefaultPeerConnectTimeout);
+  auto peer = util::Client(Peer(key::PublicKey::from_string(
+                               client_keypair.get_serialised_public_key())),
+                           mediator.get_mediator_description(), peer_keypair);
+  const auto peer_connection = peer.connect_async();
+  mediator.await_shutdown();
+  util::Client::await(client_connection, kDefaultHandshakeTimeout);
+  util::Client::await(peer_connection, kDefaultHandshakeTimeout);
+  metrics::set_handshake_stats_handler(nullptr);
+
+  // each side decrypts the Mediator's nonce, encrypts a nonce for the other
+  // side and decrypts theirs. The Client connects to the Peer, the Peer waits
+  // for it.
+  std::lock_guard<std::mutex> guard(mutex);
+  BOOST_ASSERT(handshake_stats.size() == 2);
+  uint64_t connect_calls = 0;
+  for (const auto &stats : handshake_stats) {
+    BOOST_ASSERT(stats.crypto_operations >= 3);
+    BOOST_ASSERT(stats.send_calls >= 4);
+    BOOST_ASSERT(stats.read_calls >= 4);
+    BOOST_ASSERT(stats.duration_us > 0);
+    connect_calls += stats.connect_calls;
+  }
+  BOOST_ASSERT(connect_calls >= 3);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldMigrateConnectionWhenLocalAddressIsRemoved) {
+  util::FakeMediator mediator(stateful_socket_creator);
+  mediator.run();
+
+  migration::MigrationOptions options;
+  options.heartbeat_interval_ms = 50;
+  options.path_timeout_ms = 500;
+  const auto client_keypair = key::Keypair::generate();
+  const auto peer_keypair = key::Keypair::generate();
+  std::promise<std::shared_ptr<Socket>> client_promise, peer_promise;
+  migration::connect(client_keypair,
+                     Peer(key::PublicKey::from_string(
+                         peer_keypair.get_serialised_public_key())),
+                     mediator.get_mediator_description(),
+                     [&](Error, std::shared_ptr<Socket> socket) {
+                       client_promise.set_value(socket);
+                     },
+                     options);
+  migration::connect(peer_keypair,
+                     Peer(key::PublicKey::from_string(
+                         client_keypair.get_serialised_public_key())),
+                     mediator.get_mediator_description(),
+                     [&](Error, std::shared_ptr<Socket> socket) {
+                       peer_promise.set_value(socket);
+                     },
+                     options);
+  const auto client = std::dynamic_pointer_cast<migration::MigratingSocket>(
+      client_promise.get_future().get());
+  const auto peer = std::dynamic_pointer_cast<migration::MigratingSocket>(
+      peer_promise.get_future().get());
+  BOOST_ASSERT(client && peer);
+
+  client->send("banana");
+  BOOST_ASSERT(peer->receive() == "banana");
+  client->handle_address_change(migration::AddressChange{
+      migration::AddressChange::kRemoved, socket::local_ip});
+  // carried over the new connection once both ends have reconnected
+  client->send("rama!");
+  BOOST_ASSERT(peer->receive() == "rama!");
+  BOOST_ASSERT(client->migrations() == 1);
+  BOOST_ASSERT(peer->migrations() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldMoveSameHostConnectionToUnixDomainSocket) {
+  util::FakeMediator mediator(stateful_socket_creator);
+  mediator.run();
+  local::set_local_transport_enabled(true);
+
+  const auto client_keypair = key::Keypair::generate();
+  const auto peer_keypair = key::Keypair::generate();
+  std::promise<std::shared_ptr<Socket>> client_promise, peer_promise;
+  Connection::connect(client_keypair,
+                      Peer(key::PublicKey::from_string(
+                          peer_keypair.get_serialised_public_key())),
+                      mediator.get_mediator_description(),
+                      [&](Error, std::shared_ptr<Socket> socket) {
+                        client_promise.set_value(socket);
+                      },
+                      stateful_socket_creator);
+  Connection::connect(peer_keypair,
+                      Peer(key::PublicKey::from_string(
+                          client_keypair.get_serialised_public_key())),
+                      mediator.get_mediator_description(),
+                      [&](Error, std::shared_ptr<Socket> socket) {
+                        peer_promise.set_value(socket);
+                      },
+                      stateful_socket_creator);
+  const auto client = std::dynamic_pointer_cast<local::LocalSocket>(
+      client_promise.get_future().get());
+  const auto peer = std::dynamic_pointer_cast<local::LocalSocket>(
+      peer_promise.get_future().get());
+  local::set_local_transport_enabled(false);
+  BOOST_ASSERT(client && peer);
+
+  client->send("banana");
+  BOOST_ASSERT(peer->receive() == "banana");
+  peer->send("rama!");
+  BOOST_ASSERT(client->receive() == "rama!");
+}
+
+BOOST_AUTO_TEST_CASE(ShouldHandPrewarmedConnectionToConnect) {
+  util::FakeMediator mediator(stateful_socket_creator);
+  mediator.run();
+  const auto client_keypair = key::Keypair::generate();
+  const auto peer_keypair = key::Keypair::generate();
+  const auto client_peer = Peer(
+      key::PublicKey::from_string(peer_keypair.get_serialised_public_key()));
+  Connection::prewarm(client_keypair, client_peer,
+                      mediator.get_mediator_description(),
+                      std::chrono::milliseconds(10000),
+                      stateful_socket_creator);
+  std::promise<std::shared_ptr<Socket>> client_promise, peer_promise;
+  Connection::connect(peer_keypair,
+                      Peer(key::PublicKey::from_string(
+                          client_keypair.get_serialised_public_key())),
+                      mediator.get_mediator_description(),
+                      [&](Error, std::shared_ptr<Socket> socket) {
+                        peer_promise.set_value(socket);
+                      },
+                      stateful_socket_creator);
+  const auto peer = peer_promise.get_future().get();
+  BOOST_ASSERT(peer);
+
+  // the handshake is over, so this can only be the prewarmed connection
+  mediator.stop();
+  Connection::connect(client_keypair, client_peer,
+                      mediator.get_mediator_description(),
+                      [&](Error, std::shared_ptr<Socket> socket) {
+                        client_promise.set_value(socket);
+                      },
+                      stateful_socket_creator);
+  const auto client = client_promise.get_future().get();
+  BOOST_ASSERT(client);
+
+  client->send("banana");
+  BOOST_ASSERT(peer->receive() == "banana");
+  peer->send("rama!");
+  BOOST_ASSERT(client->receive() == "rama!");
+}
+
+BOOST_AUTO_TEST_CASE(ShouldSendEarlyDataWithHandshake) {
+  util::FakeMediator mediator(stateful_socket_creator);
+  mediator.run();
+  const auto client_keypair = key::Keypair::generate();
+  const auto peer_keypair = key::Keypair::generate();
+  // we don't know which end will be the Client, so both send a request
+  std::atomic<int> requests(0);
+  const auto early_data = [&](const std::string &name) {
+    handshake::EarlyData early_data;
+    early_data.request = "hello from " + name;
+    early_data.responder = [&requests, name](const std::string &request) {
+      requests++;
+      return name + " got " + request;
+    };
+    return early_data;
+  };
+  std::promise<boost::optional<std::string>> client_reply, peer_reply;
+  Connection::connect<PlainSocketFactory>(
+      client_keypair,
+      Peer(key::PublicKey::from_string(
+          peer_keypair.get_serialised_public_key())),
+      mediator.get_mediator_description(), early_data("a"),
+      [&](Error, std::shared_ptr<Socket> socket) {
+        BOOST_ASSERT(socket);
+        client_reply.set_value(handshake::last_early_data_reply());
+      });
+  Connection::connect<PlainSocketFactory>(
+      peer_keypair,
+      Peer(key::PublicKey::from_string(
+          client_keypair.get_serialised_public_key())),
+      mediator.get_mediator_description(), early_data("b"),
+      [&](Error, std::shared_ptr<Socket> socket) {
+        BOOST_ASSERT(socket);
+        peer_reply.set_value(handshake::last_early_data_reply());
+      });
+  const auto first = client_reply.get_future().get();
+  const auto second = peer_reply.get_future().get();
+  BOOST_ASSERT(requests == 1);
+  BOOST_ASSERT(static_cast<bool>(first) != static_cast<bool>(second));
+  BOOST_ASSERT(first ? *first == "b got hello from a"
+                     : *second == "a got hello from b");
+}
+
+BOOST_AUTO_TEST_CASE(ShouldNotHandPrewarmedConnectionToEarlyData) {
+  util::FakeMediator mediator(stateful_socket_creator);
+  mediator.run();
+  const auto client_keypair = key::Keypair::generate();
+  const auto peer_keypair = key::Keypair::generate();
+  const auto client_peer = Peer(
+      key::PublicKey::from_string(peer_keypair.get_serialised_public_key()));
+  const auto peer_peer = Peer(
+      key::PublicKey::from_string(client_keypair.get_serialised_public_key()));
+  Connection::prewarm<PlainSocketFactory>(
+      client_keypair, client_peer, mediator.get_mediator_description(),
+      std::chrono::milliseconds(10000));
+  std::promise<std::shared_ptr<Socket>> prewarmed;
+  Connection::connect<PlainSocketFactory>(
+      peer_keypair, peer_peer, mediator.get_mediator_description(),
+      [&](Error, std::shared_ptr<Socket> socket) {
+        prewarmed.set_value(socket);
+      });
+  BOOST_ASSERT(prewarmed.get_future().get());
+
+  // the prewarmed connection is parked, but would drop the request
+  std::atomic<int> requests(0);
+  const auto early_data = [&](const std::string &name) {
+    handshake::EarlyData early_data;
+    early_data.request = "hello from " + name;
+    early_data.responder = [&requests, name](const std::string &request) {
+      requests++;
+      return name + " got " + request;
+    };
+    return early_data;
+  };
+  std::promise<boost::optional<std::string>> client_reply, peer_reply;
+  Connection::connect<PlainSocketFactory>(
+      client_keypair, client_peer, mediator.get_mediator_description(),
+      early_data("a"), [&](Error, std::shared_ptr<Socket> socket) {
+        BOOST_ASSERT(socket);
+        client_reply.set_value(handshake::last_early_data_reply());
+      });
+  Connection::connect<PlainSocketFactory>(
+      peer_keypair, peer_peer, mediator.get_mediator_description(),
+      early_data("b"), [&](Error, std::shared_ptr<Socket> socket) {
+        BOOST_ASSERT(socket);
+        peer_reply.set_value(handshake::last_early_data_reply());
+      });
+  auto client_future = client_reply.get_future();
+  auto peer_future = peer_reply.get_future();
+  // had the Client taken the prewarmed connection, the Peer would be left
+  // waiting for a Client which never comes
+  BOOST_ASSERT(peer_future.wait_for(std::chrono::seconds(10)) ==
+               std::future_status::ready);
+  const auto first = client_future.get();
+  const auto second = peer_future.get();
+  BOOST_ASSERT(requests == 1);
+  BOOST_ASSERT(static_cast<bool>(first) != static_cast<bool>(second));
+}
+
+BOOST_AUTO_TEST_CASE(ShouldConnectOnLanWithoutMediator) {
+  discovery::Discovery discovery;
+  discovery.enabled = true;
+  discovery::set_discovery(discovery);
+  // nothing listens here, so connecting only succeeds without the Mediator
+  const auto mediator = Mediator("127.0.0.1", 1);
+
+  const auto client_keypair = key::Keypair::generate();
+  const auto peer_keypair = key::Keypair::generate();
+  std::promise<std::shared_ptr<Socket>> client_promise, peer_promise;
+  Connection::connect(client_keypair,
+                      Peer(key::PublicKey::from_string(
+                          peer_keypair.get_serialised_public_key())),
+                      mediator,
+                      [&](Error, std::shared_ptr<Socket> socket) {
+                        client_promise.set_value(socket);
+                      },
+                      stateful_socket_creator);
+  Connection::connect(peer_keypair,
+                      Peer(key::PublicKey::from_string(
+                          client_keypair.get_serialised_public_key())),
+                      mediator,
+                      [&](Error, std::shared_ptr<Socket> socket) {
+                        peer_promise.set_value(socket);
+                      },
+                      stateful_socket_creator);
+  const auto client = client_promise.get_future().get();
+  const auto peer = peer_promise.get_future().get();
+  discovery::set_discovery(discovery::Discovery());
+  BOOST_ASSERT(client && peer);
+
+  client->send("banana");
+  BOOST_ASSERT(peer->receive() == "banana");
+  peer->send("rama!");
+  BOOST_ASSERT(client->receive() == "rama!");
+}
+
+BOOST_AUTO_TEST_CASE(ShouldConnectThroughDhtWithoutMediator) {
+  std::vector<std::unique_ptr<dht::Node>> network;
+  for (auto i = 0; i < 8; i++) {
+    network.push_back(std::make_unique<dht::Node>());
+  }
+  const socket::SocketAddress seed(socket::local_ip, network[0]->port());
+  for (const auto &node : network) {
+    node->bootstrap({seed});
+  }
+  // both ends are in this process, so they share a node
+  const auto node = std::make_shared<dht::Node>();
+  BOOST_ASSERT(node->bootstrap({seed}) > 0);
+  dht::set_dht(node);
+  // nothing listens here, so connecting only succeeds without the Mediator
+  const auto mediator = Mediator("127.0.0.1", 1);
+
+  const auto client_keypair = key::Keypair::generate();
+  const auto peer_keypair = key::Keypair::generate();
+  std::promise<std::shared_ptr<Socket>> client_promise, peer_promise;
+  Connection::connect(client_keypair,
+                      Peer(key::PublicKey::from_string(
+                          peer_keypair.get_serialised_public_key())),
+                      mediator,
+                      [&](Error, std::shared_ptr<Socket> socket) {
+                        client_promise.set_value(socket);
+                      },
+                      stateful_socket_creator);
+  Connection::connect(peer_keypair,
+                      Peer(key::PublicKey::from_string(
+                          client_keypair.get_serialised_public_key())),
+                      mediator,
+                      [&](Error, std::shared_ptr<Socket> socket) {
+                        peer_promise.set_value(socket);
+                      },
+                      stateful_socket_creator);
+  const auto client = client_promise.get_future().get();
+  const auto peer = peer_promise.get_future().get();
+  dht::set_dht(nullptr);
+  BOOST_ASSERT(client && peer);
+
+  client->send("banana");
+  BOOST_ASSERT(peer->receive() == "banana");
+  peer->send("rama!");
+  BOOST_ASSERT(client->receive() == "rama!");
+}
+
+BOOST_AUTO_TEST_CASE(ShouldConnectIntroducedPeersWithoutMediator) {
+  util::FakeMediator mediator(stateful_socket_creator);
+  mediator.run();
+  const auto connect = [&](const key::Keypair &ours,
+                           const key::Keypair &theirs) {
+    auto promise =
+        std::make_shared<std::promise<std::shared_ptr<Socket>>>();
+    Connection::connect(ours,
+                        Peer(key::PublicKey::from_string(
+                            theirs.get_serialised_public_key())),
+                        mediator.get_mediator_description(),
+                        [promise](Error, std::shared_ptr<Socket> socket) {
+                          promise->set_value(socket);
+                        },
+                        stateful_socket_creator);
+    return promise->get_future();
+  };
+  const auto peer_of = [](const key::Keypair &keypair) {
+    return Peer(
+        key::PublicKey::from_string(keypair.get_serialised_public_key()));
+  };
+
+  // the introducer is already connected to both
+  const auto introducer_keypair = key::Keypair::generate();
+  const auto first_keypair = key::Keypair::generate();
+  const auto second_keypair = key::Keypair::generate();
+  auto to_first = connect(introducer_keypair, first_keypair);
+  auto first_to_introducer = connect(first_keypair, introducer_keypair);
+  const auto introducer_first = to_first.get();
+  const auto first_introducer = first_to_introducer.get();
+  auto to_second = connect(introducer_keypair, second_keypair);
+  auto second_to_introducer = connect(second_keypair, introducer_keypair);
+  const auto introducer_second = to_second.get();
+  const auto second_introducer = second_to_introducer.get();
+  BOOST_ASSERT(introducer_first && introducer_second);
+
+  // nothing listens here, so connecting only succeeds without the Mediator
+  const auto no_mediator = Mediator("127.0.0.1", 1);
+  std::promise<std::shared_ptr<Socket>> first_promise, second_promise;
+  auto first_introduced = std::async(std::launch::async, [&]() {
+    return introduction::accept(
+        first_keypair, *first_introducer, no_mediator,
+        [&](Error, std::shared_ptr<Socket> socket) {
+          first_promise.set_value(socket);
+        });
+  });
+  auto second_introduced = std::async(std::launch::async, [&]() {
+    return introduction::accept(
+        second_keypair, *second_introducer, no_mediator,
+        [&](Error, std::shared_ptr<Socket> socket) {
+          second_promise.set_value(socket);
+        });
+  });
+  introduction::introduce(
+      introduction::Introducee{introducer_first, peer_of(first_keypair)},
+      introduction::Introducee{introducer_second, peer_of(second_keypair)});
+  BOOST_ASSERT(first_introduced.get().public_key.serialise() ==
+               second_keypair.get_serialised_public_key());
+  BOOST_ASSERT(second_introduced.get().public_key.serialise() ==
+               first_keypair.get_serialised_public_key());
+
+  const auto first = first_promise.get_future().get();
+  const auto second = second_promise.get_future().get();
+  BOOST_ASSERT(first && second);
+  first->send("banana");
+  BOOST_ASSERT(second->receive() == "banana");
+  second->send("rama!");
+  BOOST_ASSERT(first->receive() == "rama!");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 }
\ No newline at end of file
@@ -1,16 +1,19 @@
 #include <chrono>
-#include <condition_variable>
-#include <mutex>
+#include <future>
 #include <src/util/client.h>
 
 namespace p2psc {
 namespace integration {
 namespace util {
-std::shared_ptr<StatefulSocket> Client::connect_async() {
-  std::shared_ptr<StatefulSocket> socket;
+std::shared_future<std::shared_ptr<StatefulSocket>> Client::connect_async() {
+  // the callback runs on p2psc's connection thread, possibly long after this
+  // method has returned, so it must not reference anything on our stack.
+  const auto promise =
+      std::make_shared<std::promise<std::shared_ptr<StatefulSocket>>>();
   const p2psc::Callback callback =
-      [&socket](Error error, std::shared_ptr<Socket> created_socket) {
-        socket = std::static_pointer_cast<StatefulSocket>(created_socket);
+      [promise](Error error, std::shared_ptr<Socket> created_socket) {
+        promise->set_value(
+            std::static_pointer_cast<StatefulSocket>(created_socket));
       };
   p2psc::Connection::connect(
       _keypair, _peer, _mediator, callback,
@@ -21,32 +24,22 @@ std::shared_ptr<StatefulSocket> Client::connect_async() {
           return std::make_shared<StatefulSocket>(param.sock_fd());
         }
       });
-  return socket;
+  return promise->get_future().share();
 }
 
 std::shared_ptr<StatefulSocket> Client::connect_sync(uint64_t timeout_ms) {
-  std::shared_ptr<StatefulSocket> socket;
-  std::mutex mutex;
-  std::condition_variable cv;
-  std::unique_lock<std::mutex> lock(mutex);
-  const p2psc::Callback callback =
-      [&socket, &cv](Error error, std::shared_ptr<Socket> created_socket) {
-        socket = std::static_pointer_cast<StatefulSocket>(created_socket);
-        cv.notify_all();
-      };
-  p2psc::Connection::connect(
-      _keypair, _peer, _mediator, callback,
-      [](const SocketAddressOrFileDescriptor &param) {
-        if (param.has_socket_address()) {
-          return std::make_shared<StatefulSocket>(param.socket_address());
-        } else {
-          return std::make_shared<StatefulSocket>(param.sock_fd());
-        }
-      });
-  std::chrono::milliseconds wait_ms(timeout_ms);
-  cv.wait_for(lock, wait_ms);
-  return socket;
+  return await(connect_async(), timeout_ms);
+}
+
+std::shared_ptr<StatefulSocket> Client::await(
+    const std::shared_future<std::shared_ptr<StatefulSocket>> &socket,
+    uint64_t timeout_ms) {
+  if (socket.wait_for(std::chrono::milliseconds(timeout_ms)) !=
+      std::future_status::ready) {
+    return nullptr;
+  }
+  return socket.get();
+}
 }
 }
 }
-}
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <future>
 #include <p2psc.h>
 #include <src/util/stateful_socket.h>
 
@@ -13,9 +14,17 @@ public:
          const p2psc::key::Keypair &keypair)
       : _peer(peer), _mediator(mediator), _keypair(keypair) {}
 
-  std::shared_ptr<StatefulSocket> connect_async();
+  std::shared_future<std::shared_ptr<StatefulSocket>> connect_async();
   std::shared_ptr<StatefulSocket> connect_sync(uint64_t timeout_ms);
 
+  /*
+   * Wait for a socket returned by connect_async. Returns nullptr if the
+   * connection failed or did not complete within timeout_ms.
+   */
+  static std::shared_ptr<StatefulSocket>
+  await(const std::shared_future<std::shared_ptr<StatefulSocket>> &socket,
+        uint64_t timeout_ms);
+
 private:
   p2psc::Peer _peer;
   p2psc::Mediator _mediator;
@@ -1,4 +1,6 @@
-#include <crypto/rsa.h>
+#include <algorithm>
+#include <limits>
+#include <p2psc/crypto/crypto_exception.h>
 #include <p2psc/log.h>
 #include <p2psc/message/advertise.h>
 #include <p2psc/message/advertise_abort.h>
@@ -13,24 +15,32 @@
   if (message_type == quit_indicator) {                                        \
     LOG(level::Debug) << "Finishing connection handling (after "               \
                       << message::message_type_string(quit_indicator) << ")";  \
-    _shutdown_cv.notify_all();                                                 \
     return;                                                                    \
   }
 
 namespace p2psc {
 namespace integration {
 namespace util {
+namespace {
+// a message type that is never sent, so by default we never quit early
+const message::MessageType kNeverQuit =
+    std::numeric_limits<message::MessageType>::max();
+}
 
 FakeMediator::FakeMediator(const SocketCreator &socket_creator)
     : _socket(std::make_unique<socket::LocalListeningSocket>(socket_creator)),
       _mediator(_socket->get_socket_address().ip(),
                 _socket->get_socket_address().port()),
-      _is_running(false), _protocol_version(kVersion) {}
+      _is_running(false), _quit_after(kNeverQuit),
+      _has_finished_handler(false), _record_messages(true),
+      _protocol_version(kVersion) {}
 
 FakeMediator::FakeMediator(const SocketCreator &socket_creator,
                            const p2psc::Mediator &mediator)
     : _socket(std::make_unique<socket::LocalListeningSocket>(socket_creator)),
-      _mediator(mediator), _is_running(false), _protocol_version(kVersion) {}
+      _mediator(mediator), _is_running(false), _quit_after(kNeverQuit),
+      _has_finished_handler(false), _record_messages(true),
+      _protocol_version(kVersion) {}
 
 FakeMediator::~FakeMediator() throw() {
   if (_is_running) {
@@ -58,14 +68,57 @@ void FakeMediator::quit_after(message::MessageType message_type) {
   _quit_after = message_type;
 }
 
+void FakeMediator::set_record_messages(bool record_messages) {
+  std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+  _record_messages = record_messages;
+}
+
+void FakeMediator::set_authorization(
+    std::shared_ptr<policy::Authorization> authorization) {
+  std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+  _authorization = authorization;
+}
+
 void FakeMediator::_run() {
   while (_is_running) {
     auto socket = _socket->accept();
     if (!socket) {
       continue;
     }
+    _reap_finished_handlers();
     _handler_pool.emplace_back(
-        std::thread(&FakeMediator::_handle_connection, this, socket));
+        std::thread(&FakeMediator::_run_handler, this, socket));
+  }
+}
+
+void FakeMediator::_run_handler(std::shared_ptr<Socket> session_socket) {
+  try {
+    _handle_connection(session_socket);
+  } catch (const std::exception &e) {
+    LOG(level::Error) << "Failed to handle connection: " << e.what();
+  }
+  {
+    std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+    _finished_handlers.push_back(std::this_thread::get_id());
+    _has_finished_handler = true;
+  }
+  _shutdown_cv.notify_all();
+}
+
+void FakeMediator::_reap_finished_handlers() {
+  std::vector<std::thread::id> finished_handlers;
+  {
+    std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+    finished_handlers.swap(_finished_handlers);
+  }
+  for (const auto &id : finished_handlers) {
+    const auto handler = std::find_if(
+        _handler_pool.begin(), _handler_pool.end(),
+        [&id](const std::thread &thread) { return thread.get_id() == id; });
+    if (handler != _handler_pool.end()) {
+      handler->join();
+      _handler_pool.erase(handler);
+    }
   }
 }
 
@@ -88,15 +141,24 @@ void FakeMediator::_handle_connection(std::shared_ptr<Socket> session_socket) {
     return;
   }
 
+  if (!_is_authorized(advertise.format().payload)) {
+    const auto advertise_abort = Message<message::AdvertiseAbort>(
+        message::AdvertiseAbort{"Not authorized"});
+    _send_and_log(session_socket, advertise_abort);
+    LOG(level::Error) << "Received Advertise for a pair of keys which isn't "
+                         "authorized";
+    QUIT_IF_REQUESTED(advertise_abort.format().type, _quit_after);
+    return;
+  }
+
   /*
    * AdvertiseChallenge
    */
-  const auto nonce = 1337;
-  const auto peer_pub_key =
-      crypto::RSA::from_public_key(advertise.format().payload.our_key);
-  const auto advertise_challenge =
-      Message<message::AdvertiseChallenge>(message::AdvertiseChallenge{
-          peer_pub_key->public_encrypt(std::to_string(nonce))});
+  // peers reconnecting with the same key get a precomputed challenge
+  const auto challenge =
+      _challenge_pool.take(advertise.format().payload.our_key);
+  const auto advertise_challenge = Message<message::AdvertiseChallenge>(
+      message::AdvertiseChallenge{challenge.encrypted_nonce});
   _send_and_log(session_socket, advertise_challenge);
   QUIT_IF_REQUESTED(advertise_challenge.format().type, _quit_after);
 
@@ -107,16 +169,16 @@ void FakeMediator::_handle_connection(std::shared_ptr<Socket> session_socket) {
       _receive_and_log<message::AdvertiseResponse>(session_socket);
   QUIT_IF_REQUESTED(advertise_response.format().type, _quit_after);
 
-  const auto maybe_peer =
-      _key_to_identifier_store.get(advertise.format().payload.their_key);
+  const auto maybe_peer = _key_to_identifier_store.put_and_get(
+      advertise.format().payload.our_key,
+      PeerIdentifier(session_socket->get_socket_address(),
+                     advertise.format().payload.version),
+      advertise.format().payload.their_key);
   if (!maybe_peer) {
     // In this case, this peer is the Client, and we are waiting for the Peer to
-    // come online. We store the Clients address and wait for the other peer to
-    // come online so we can send a PeerIdentification back to the Client.
-    _key_to_identifier_store.put(
-        advertise.format().payload.our_key,
-        PeerIdentifier(session_socket->get_socket_address(),
-                       advertise.format().payload.version));
+    // come online. We have stored the Clients address and wait for the other
+    // peer to come online so we can send a PeerIdentification back to the
+    // Client.
     // Timeout after 2 seconds
     const auto awaited_peer = _key_to_identifier_store.await(
         advertise.format().payload.their_key, 2000);
@@ -124,6 +186,7 @@ void FakeMediator::_handle_connection(std::shared_ptr<Socket> session_socket) {
       // if we never receive an awaited peer, we can't continue
       LOG(level::Error) << "Never received Advertise from peer:" << std::endl
                         << advertise.format().payload.their_key;
+      _key_to_identifier_store.erase(advertise.format().payload.our_key);
       return;
     }
 
@@ -131,6 +194,9 @@ void FakeMediator::_handle_connection(std::shared_ptr<Socket> session_socket) {
     // until after the Peer has received its PeerDisconnect, otherwise we can't
     // guarantee that the Peer will be listening for incoming requests
     _wait_for_disconnect(awaited_peer->socket_address);
+    // both sides are done with the store now
+    _key_to_identifier_store.erase(advertise.format().payload.our_key);
+    _key_to_identifier_store.erase(advertise.format().payload.their_key);
 
     /*
      * PeerIdentification
@@ -144,10 +210,6 @@ void FakeMediator::_handle_connection(std::shared_ptr<Socket> session_socket) {
   } else {
     // In this case, this peer is the Peer, since the Client has already come
     // online. The Mediator is done with this peer now.
-    _key_to_identifier_store.put(
-        advertise.format().payload.our_key,
-        PeerIdentifier(session_socket->get_socket_address(),
-                       advertise.format().payload.version));
     LOG(level::Debug) << "Registered Peer with address: "
                       << session_socket->get_socket_address()
                       << ". Client is already registered as: "
@@ -164,25 +226,41 @@ void FakeMediator::_handle_connection(std::shared_ptr<Socket> session_socket) {
 
     QUIT_IF_REQUESTED(peer_disconnect.format().type, _quit_after);
   }
+}
 
-  _shutdown_cv.notify_all();
+bool FakeMediator::_is_authorized(const message::Advertise &advertise) {
+  std::shared_ptr<policy::Authorization> authorization;
+  {
+    std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+    authorization = _authorization;
+  }
+  if (!authorization) {
+    return true;
+  }
+  try {
+    return authorization->allows(
+        key::PublicKey::from_string(advertise.our_key).fingerprint(),
+        key::PublicKey::from_string(advertise.their_key).fingerprint());
+  } catch (const crypto::CryptoException &e) {
+    return false;
+  }
 }
 
 void FakeMediator::await_shutdown() {
-  std::unique_lock<std::mutex> lock(_mutex);
-  _disconnect_cv.wait(lock);
+  std::unique_lock<metrics::InstrumentedMutex> lock(_mutex);
+  _shutdown_cv.wait(lock, [&]() { return _has_finished_handler; });
 }
 
 void FakeMediator::_add_to_disconnects(const socket::SocketAddress &address) {
   {
-    std::lock_guard<std::mutex> guard(_mutex);
+    std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
     _completed_disconnects.insert(address);
   }
   _disconnect_cv.notify_all();
 }
 
 void FakeMediator::_wait_for_disconnect(const socket::SocketAddress &address) {
-  std::unique_lock<std::mutex> lock(_mutex);
+  std::unique_lock<metrics::InstrumentedMutex> lock(_mutex);
   _disconnect_cv.wait(lock, [&]() {
     return _completed_disconnects.find(address) != _completed_disconnects.end();
   });
@@ -195,7 +273,12 @@ void FakeMediator::_send_and_log(std::shared_ptr<Socket> socket,
   const auto json = encode(message.format());
   socket->send(json);
   const auto message_type = message::message_type_string(message.format().type);
-  _sent_messages.push_back(json);
+  {
+    std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+    if (_record_messages) {
+      _sent_messages.push_back(json);
+    }
+  }
   LOG(level::Debug) << "Sending " << message_type << " to "
                     << socket->get_socket_address().ip() << ":"
                     << socket->get_socket_address().port() << ": " << json;
@@ -206,7 +289,12 @@ Message<T> FakeMediator::_receive_and_log(std::shared_ptr<Socket> socket) {
   const auto raw_message = socket->receive();
   auto message = message::decode<T>(raw_message);
   const auto message_type = message::message_type_string(message.type);
-  _received_messages.push_back(raw_message);
+  {
+    std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+    if (_record_messages) {
+      _received_messages.push_back(raw_message);
+    }
+  }
   LOG(level::Debug) << "Received " << message_type << " from "
                     << socket->get_socket_address().ip() << ":"
                     << socket->get_socket_address().port() << ": "
@@ -219,10 +307,12 @@ p2psc::Mediator FakeMediator::get_mediator_description() const {
 }
 
 std::vector<std::string> FakeMediator::get_received_messages() const {
+  std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
   return _received_messages;
 }
 
 std::vector<std::string> FakeMediator::get_sent_messages() const {
+  std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
   return _sent_messages;
 }
 }
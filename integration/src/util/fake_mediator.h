@@ -1,9 +1,13 @@
 #pragma once
 
 #include <condition_variable>
+#include <p2psc/handshake/challenge_pool.h>
 #include <p2psc/mediator.h>
 #include <p2psc/message/message.h>
 #include <p2psc/message/types.h>
+#include <p2psc/message/advertise.h>
+#include <p2psc/metrics/instrumented_mutex.h>
+#include <p2psc/policy/authorization.h>
 #include <socket/local_listening_socket.h>
 #include <src/util/key_to_identifier_store.h>
 #include <thread>
@@ -24,6 +28,16 @@ public:
   void stop();
 
   void quit_after(message::MessageType message_type);
+  // Whether to keep every message sent and received for
+  // get_sent_messages/get_received_messages. Defaults to true; long running
+  // users should turn it off.
+  void set_record_messages(bool record_messages);
+  // Only accept Advertises from keys authorization allows to connect to the
+  // key they name, answering the rest with an AdvertiseAbort.
+  void set_authorization(std::shared_ptr<policy::Authorization> authorization);
+  // Block until handling a connection has finished, whether it completed,
+  // failed or quit after quit_after's message, and everything it sent has
+  // been recorded.
   void await_shutdown();
 
   p2psc::Mediator get_mediator_description() const;
@@ -38,16 +52,24 @@ private:
   message::MessageType _quit_after;
   std::thread _worker_thread;
   std::vector<std::thread> _handler_pool;
+  std::vector<std::thread::id> _finished_handlers;
+  bool _has_finished_handler;
+  bool _record_messages;
   std::vector<std::string> _received_messages;
   std::vector<std::string> _sent_messages;
-  std::condition_variable _disconnect_cv;
-  std::condition_variable _shutdown_cv;
-  std::mutex _mutex;
+  std::condition_variable_any _disconnect_cv;
+  std::condition_variable_any _shutdown_cv;
+  mutable metrics::InstrumentedMutex _mutex{"FakeMediator"};
   std::unordered_set<socket::SocketAddress> _completed_disconnects;
   std::uint8_t _protocol_version;
+  handshake::ChallengePool _challenge_pool;
+  std::shared_ptr<policy::Authorization> _authorization;
 
   void _run();
+  void _run_handler(std::shared_ptr<Socket> session_socket);
+  void _reap_finished_handlers();
   void _handle_connection(std::shared_ptr<Socket> session_socket);
+  bool _is_authorized(const message::Advertise &advertise);
   void _add_to_disconnects(const socket::SocketAddress &address);
   void _wait_for_disconnect(const socket::SocketAddress &address);
   template <class T>
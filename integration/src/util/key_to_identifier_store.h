@@ -5,6 +5,7 @@
 #include <include/util/peer_identifier.h>
 #include <map>
 #include <mutex>
+#include <p2psc/metrics/instrumented_mutex.h>
 #include <p2psc/socket/socket_address.h>
 #include <string>
 
@@ -16,13 +17,22 @@ public:
   void put(const std::string &key, const PeerIdentifier &peer_identifier);
   boost::optional<PeerIdentifier> get(const std::string &key);
   boost::optional<PeerIdentifier> await(const std::string &key, uint64_t ms);
+  /*
+   * Atomically put key and get other_key, so that of two peers looking for
+   * each other exactly one finds the other already present.
+   */
+  boost::optional<PeerIdentifier> put_and_get(const std::string &key,
+                                              const PeerIdentifier &,
+                                              const std::string &other_key);
+  void erase(const std::string &key);
+  std::size_t size();
 
 private:
   boost::optional<PeerIdentifier> _get(const std::string &id);
 
   std::map<std::string, PeerIdentifier> _store;
-  std::mutex _mutex;
-  std::condition_variable _cv;
+  metrics::InstrumentedMutex _mutex{"KeyToIdentifierStore"};
+  std::condition_variable_any _cv;
 };
 }
 }
\ No newline at end of file
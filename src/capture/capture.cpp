@@ -0,0 +1,170 @@
+#include <chrono>
+#include <cstring>
+#include <p2psc/capture/capture.h>
+#include <p2psc/capture/capture_exception.h>
+#include <p2psc/log.h>
+#include <sstream>
+
+namespace p2psc {
+namespace capture {
+namespace {
+
+const char kMagic[] = "P2PSCCAP";
+const std::size_t kMagicLength = sizeof(kMagic) - 1;
+const std::size_t kRecordHeaderLength = 8 + 4 + 1 + 4;
+// buffered records are written out once they exceed this many bytes, so the
+// recording path is normally just an append to memory.
+const std::size_t kFlushThreshold = 64 * 1024;
+
+std::uint64_t now_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+template <class T> void append_le(std::string &out, T value) {
+  for (std::size_t i = 0; i < sizeof(T); i++) {
+    out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+template <class T> T read_le(const unsigned char *in) {
+  T value = 0;
+  for (std::size_t i = 0; i < sizeof(T); i++) {
+    value |= static_cast<T>(in[i]) << (8 * i);
+  }
+  return value;
+}
+}
+
+std::shared_ptr<CaptureWriter> CaptureWriter::open(const std::string &path) {
+  FILE *file = fopen(path.c_str(), "wb");
+  if (!file) {
+    throw CaptureException("Could not open capture file " + path +
+                           " for writing: " + strerror(errno));
+  }
+  return std::shared_ptr<CaptureWriter>(new CaptureWriter(file));
+}
+
+CaptureWriter::CaptureWriter(FILE *file)
+    : _file(file), _next_connection_id(0), _failed(false) {
+  _buffer.append(kMagic, kMagicLength);
+  append_le<std::uint16_t>(_buffer, kFormatVersion);
+}
+
+CaptureWriter::~CaptureWriter() {
+  std::lock_guard<std::mutex> guard(_mutex);
+  if (!_failed) {
+    try {
+      _flush_locked();
+    } catch (const CaptureException &e) {
+      // nothing sensible to do with a failed write while tearing down
+    }
+  }
+  fclose(_file);
+}
+
+std::uint32_t
+CaptureWriter::open_connection(const socket::SocketAddress &remote) {
+  const auto connection_id = _next_connection_id++;
+  std::stringstream address;
+  address << remote;
+  record(connection_id, kEventOpen, address.str());
+  return connection_id;
+}
+
+void CaptureWriter::record(std::uint32_t connection_id, Event event,
+                           const std::string &data) {
+  const auto timestamp_us = now_us();
+  std::lock_guard<std::mutex> guard(_mutex);
+  if (_failed) {
+    return;
+  }
+  _buffer.reserve(_buffer.size() + kRecordHeaderLength + data.size());
+  append_le<std::uint64_t>(_buffer, timestamp_us);
+  append_le<std::uint32_t>(_buffer, connection_id);
+  append_le<std::uint8_t>(_buffer, event);
+  append_le<std::uint32_t>(_buffer, data.size());
+  _buffer += data;
+  if (_buffer.size() >= kFlushThreshold) {
+    try {
+      _flush_locked();
+    } catch (const CaptureException &e) {
+      LOG(level::Error) << e.what() << ". Capturing stopped";
+    }
+  }
+}
+
+void CaptureWriter::flush() {
+  std::lock_guard<std::mutex> guard(_mutex);
+  if (_failed) {
+    throw CaptureException("Capturing stopped after a failed write");
+  }
+  _flush_locked();
+}
+
+void CaptureWriter::_flush_locked() {
+  if (_buffer.empty()) {
+    return;
+  }
+  if (fwrite(_buffer.data(), 1, _buffer.size(), _file) != _buffer.size() ||
+      fflush(_file) != 0) {
+    // what was written of the buffer is unknown, so stop here
+    _failed = true;
+    _buffer.clear();
+    throw CaptureException("Failed to write capture: " +
+                           std::string(strerror(errno)));
+  }
+  _buffer.clear();
+}
+
+std::shared_ptr<CaptureReader> CaptureReader::open(const std::string &path) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (!file) {
+    throw CaptureException("Could not open capture file " + path +
+                           " for reading: " + strerror(errno));
+  }
+  char magic[kMagicLength];
+  unsigned char version[2];
+  if (fread(magic, 1, kMagicLength, file) != kMagicLength ||
+      memcmp(magic, kMagic, kMagicLength) != 0 ||
+      fread(version, 1, sizeof(version), file) != sizeof(version)) {
+    fclose(file);
+    throw CaptureException(path + " is not a p2psc capture");
+  }
+  if (read_le<std::uint16_t>(version) != kFormatVersion) {
+    fclose(file);
+    throw CaptureException(
+        "Unsupported capture format version " +
+        std::to_string(read_le<std::uint16_t>(version)) + ". Require " +
+        std::to_string(kFormatVersion));
+  }
+  return std::shared_ptr<CaptureReader>(new CaptureReader(file));
+}
+
+CaptureReader::CaptureReader(FILE *file) : _file(file) {}
+
+CaptureReader::~CaptureReader() { fclose(_file); }
+
+boost::optional<Record> CaptureReader::next() {
+  unsigned char header[kRecordHeaderLength];
+  const auto read = fread(header, 1, kRecordHeaderLength, _file);
+  if (read == 0) {
+    return boost::none;
+  } else if (read != kRecordHeaderLength) {
+    throw CaptureException("Truncated capture record header");
+  }
+
+  Record record;
+  record.timestamp_us = read_le<std::uint64_t>(header);
+  record.connection_id = read_le<std::uint32_t>(header + 8);
+  record.event = static_cast<Event>(header[12]);
+  const auto length = read_le<std::uint32_t>(header + 13);
+  record.data.resize(length);
+  if (length > 0 && fread(&record.data[0], 1, length, _file) != length) {
+    throw CaptureException("Truncated capture record data");
+  }
+  return record;
+}
+}
+}
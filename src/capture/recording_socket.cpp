@@ -0,0 +1,42 @@
+#include <p2psc/capture/recording_socket.h>
+
+namespace p2psc {
+namespace capture {
+
+RecordingSocket::RecordingSocket(const socket::SocketAddress &socket_address,
+                                 std::shared_ptr<CaptureWriter> writer)
+    : Socket(socket_address), _writer(writer),
+      _connection_id(_writer->open_connection(socket_address)) {}
+
+RecordingSocket::RecordingSocket(int sock_fd,
+                                 std::shared_ptr<CaptureWriter> writer)
+    : Socket(sock_fd), _writer(writer),
+      _connection_id(_writer->open_connection(get_socket_address())) {}
+
+RecordingSocket::~RecordingSocket() {
+  _writer->record(_connection_id, kEventClose, "");
+}
+
+void RecordingSocket::send(const std::string &message) {
+  Socket::send(message);
+  _writer->record(_connection_id, kEventSent, message);
+}
+
+std::string RecordingSocket::receive() {
+  const auto message = Socket::receive();
+  _writer->record(_connection_id, kEventReceived, message);
+  return message;
+}
+
+SocketCreator recording_socket_creator(std::shared_ptr<CaptureWriter> writer) {
+  return [writer](const SocketAddressOrFileDescriptor &param)
+             -> std::shared_ptr<Socket> {
+    if (param.has_socket_address()) {
+      return std::make_shared<RecordingSocket>(param.socket_address(), writer);
+    } else {
+      return std::make_shared<RecordingSocket>(param.sock_fd(), writer);
+    }
+  };
+}
+}
+}
@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <p2psc/compression/compressed_socket.h>
+#include <p2psc/compression/compression_exception.h>
+#include <util/big_endian.h>
+#include <zstd.h>
+
+namespace p2psc {
+namespace compression {
+namespace {
+
+enum FrameKind : char { kFrameRaw = 0, kFrameZstd = 1 };
+
+const std::size_t kHeaderSize = 5;
+// The most data a frame carries. Larger sends are split, so that the other
+// end can refuse larger frames, and frames which decompress to more, rather
+// than buffer whatever a frame header claims.
+const std::size_t kMaxFrameData = 1024 * 1024;
+// the longest run of raw messages between attempts to compress
+const unsigned kMaxBypassLength = 64;
+
+void check(std::size_t result, const char *action) {
+  if (ZSTD_isError(result)) {
+    throw socket::SocketException(std::string(action) + " failed. Reason: " +
+                                  ZSTD_getErrorName(result));
+  }
+}
+
+std::string frame_header(FrameKind kind, std::uint32_t size) {
+  std::string header(1, kind);
+  util::write_integer(header, size, 4);
+  return header;
+}
+}
+
+CompressedSocket::CompressedSocket(std::shared_ptr<Socket> inner,
+                                   const Compression &compression)
+    : SocketLayer(inner), _compression(compression),
+      _cctx(ZSTD_createCCtx()), _dctx(ZSTD_createDCtx()),
+      _bypass_remaining(0), _bypass_length(1), _bytes_sent(0),
+      _wire_bytes_sent(0) {
+  if (!_cctx || !_dctx) {
+    ZSTD_freeCCtx(_cctx);
+    ZSTD_freeDCtx(_dctx);
+    throw CompressionException("Failed to create zstd contexts");
+  }
+  ZSTD_CCtx_setParameter(_cctx, ZSTD_c_compressionLevel, compression.level);
+  if (!compression.dictionary.empty()) {
+    ZSTD_CCtx_loadDictionary(_cctx, compression.dictionary.data(),
+                             compression.dictionary.size());
+    ZSTD_DCtx_loadDictionary(_dctx, compression.dictionary.data(),
+                             compression.dictionary.size());
+  }
+}
+
+CompressedSocket::~CompressedSocket() {
+  ZSTD_freeCCtx(_cctx);
+  ZSTD_freeDCtx(_dctx);
+}
+
+void CompressedSocket::send(const std::string &data) {
+  std::size_t offset = 0;
+  do {
+    const auto size = std::min(kMaxFrameData, data.size() - offset);
+    _send_frame(data.data() + offset, size);
+    offset += size;
+  } while (offset < data.size());
+}
+
+void CompressedSocket::_send_frame(const char *data, std::size_t size) {
+  if (!_should_compress()) {
+    // assigned into rather than replaced, to keep the buffer's capacity
+    _frame.assign(1, kFrameRaw);
+    util::write_integer(_frame, size, 4);
+    _frame.append(data, size);
+  } else {
+    _frame.resize(kHeaderSize + ZSTD_compressBound(size));
+    ZSTD_inBuffer input = {data, size, 0};
+    ZSTD_outBuffer output = {&_frame[kHeaderSize],
+                             _frame.size() - kHeaderSize, 0};
+    // flushing makes everything sent so far decodable by the other end
+    std::size_t remaining;
+    do {
+      remaining = ZSTD_compressStream2(_cctx, &output, &input, ZSTD_e_flush);
+      check(remaining, "Compression");
+      if (remaining != 0) {
+        _frame.resize(_frame.size() + remaining);
+        output.dst = &_frame[kHeaderSize];
+        output.size = _frame.size() - kHeaderSize;
+      }
+    } while (remaining != 0);
+    _frame.resize(kHeaderSize + output.pos);
+    _frame.replace(0, kHeaderSize, frame_header(kFrameZstd, output.pos));
+    _update_bypass(size, output.pos);
+  }
+  _inner->send(_frame);
+  _bytes_sent += size;
+  _wire_bytes_sent += _frame.size();
+}
+
+std::string CompressedSocket::receive() {
+  std::string data;
+  while (data.empty()) {
+    _pending += _inner->receive();
+    std::size_t offset = 0;
+    while (_pending.size() - offset >= kHeaderSize) {
+      const auto size = util::read_integer(&_pending[offset + 1], 4);
+      if (size > ZSTD_compressBound(kMaxFrameData)) {
+        throw socket::SocketException("Compression frame of " +
+                                      std::to_string(size) +
+                                      " bytes is too large");
+      }
+      if (_pending.size() - offset - kHeaderSize < size) {
+        break;
+      }
+      const auto *payload = _pending.data() + offset + kHeaderSize;
+      switch (_pending[offset]) {
+      case kFrameRaw:
+        data.append(payload, size);
+        break;
+      case kFrameZstd:
+        _decompress(payload, size, data);
+        break;
+      default:
+        throw socket::SocketException("Unknown compression frame kind " +
+                                      std::to_string(_pending[offset]));
+      }
+      offset += kHeaderSize + size;
+    }
+    _pending.erase(0, offset);
+  }
+  return data;
+}
+
+bool CompressedSocket::_should_compress() {
+  if (_bypass_remaining == 0) {
+    return true;
+  }
+  _bypass_remaining--;
+  return false;
+}
+
+void CompressedSocket::_update_bypass(std::size_t raw_size,
+                                      std::size_t compressed_size) {
+  if (compressed_size < raw_size * (1 - _compression.min_savings)) {
+    _bypass_length = 1;
+    return;
+  }
+  _bypass_remaining = _bypass_length;
+  _bypass_length = std::min(_bypass_length * 2, kMaxBypassLength);
+}
+
+void CompressedSocket::_decompress(const char *data, std::size_t size,
+                                   std::string &out) {
+  ZSTD_inBuffer input = {data, size, 0};
+  const auto chunk_size = ZSTD_DStreamOutSize();
+  const auto start = out.size();
+  bool output_full;
+  // a full output buffer may mean that zstd has more to flush
+  do {
+    const auto offset = out.size();
+    out.resize(offset + chunk_size);
+    ZSTD_outBuffer output = {&out[offset], chunk_size, 0};
+    check(ZSTD_decompressStream(_dctx, &output, &input), "Decompression");
+    out.resize(offset + output.pos);
+    if (out.size() - start > kMaxFrameData) {
+      throw socket::SocketException(
+          "Compression frame decompresses to more than " +
+          std::to_string(kMaxFrameData) + " bytes");
+    }
+    output_full = output.pos == chunk_size;
+  } while (input.pos < input.size || output_full);
+}
+}
+}
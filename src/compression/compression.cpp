@@ -0,0 +1,78 @@
+#include <mutex>
+#include <numeric>
+#include <p2psc/compression/compression.h>
+#include <p2psc/compression/compression_exception.h>
+#include <zdict.h>
+#include <zstd.h>
+
+namespace p2psc {
+namespace compression {
+namespace {
+
+std::mutex &compression_mutex() {
+  static std::mutex m;
+  return m;
+}
+
+Compression &global_compression() {
+  static Compression compression;
+  return compression;
+}
+}
+
+void set_compression(const Compression &compression) {
+  if (compression.level < ZSTD_minCLevel() ||
+      compression.level > ZSTD_maxCLevel()) {
+    throw CompressionException("Unsupported zstd level " +
+                               std::to_string(compression.level));
+  }
+  std::lock_guard<std::mutex> guard(compression_mutex());
+  global_compression() = compression;
+}
+
+Compression get_compression() {
+  std::lock_guard<std::mutex> guard(compression_mutex());
+  return global_compression();
+}
+
+std::string train_dictionary(const std::vector<std::string> &samples,
+                             std::size_t max_size) {
+  std::string concatenated_samples;
+  std::vector<std::size_t> sample_sizes;
+  for (const auto &sample : samples) {
+    concatenated_samples += sample;
+    sample_sizes.push_back(sample.size());
+  }
+  std::string dictionary(max_size, '\0');
+  const auto size = ZDICT_trainFromBuffer(
+      &dictionary[0], dictionary.size(), concatenated_samples.data(),
+      sample_sizes.data(), sample_sizes.size());
+  if (ZDICT_isError(size)) {
+    throw CompressionException("Failed to train dictionary. Reason: " +
+                               std::string(ZDICT_getErrorName(size)));
+  }
+  dictionary.resize(size);
+  return dictionary;
+}
+
+std::uint32_t dictionary_id(const std::string &dictionary) {
+  if (dictionary.empty()) {
+    return 0;
+  }
+  return ZSTD_getDictID_fromDict(dictionary.data(), dictionary.size());
+}
+boost::optional<Compression>
+negotiate(const Compression &ours, const boost::optional<std::string> &theirs,
+          const boost::optional<std::uint32_t> &their_dictionary_id) {
+  if (!ours.enabled || theirs != kAlgorithmZstd) {
+    return boost::none;
+  }
+  auto negotiated = ours;
+  if (!their_dictionary_id || *their_dictionary_id == 0 ||
+      *their_dictionary_id != dictionary_id(ours.dictionary)) {
+    negotiated.dictionary.clear();
+  }
+  return negotiated;
+}
+}
+}
@@ -1,136 +1,182 @@
-#include <mediator_connection.h>
+#include <dht/dht_rendezvous.h>
+#include <discovery/lan_discovery.h>
+#include <local/local_listener.h>
+#include <p2psc/compression/compressed_socket.h>
 #include <p2psc/connection.h>
 #include <p2psc/connection_exception.h>
-#include <p2psc/crypto/crypto_exception.h>
+#include <p2psc/dht/dht.h>
+#include <p2psc/discovery/discovery.h>
+#include <p2psc/handshake/handshake.h>
+#include <p2psc/local/local_transport.h>
 #include <p2psc/log.h>
-#include <p2psc/message/message.h>
-#include <p2psc/message/message_util.h>
-#include <p2psc/message/peer_acknowledgement.h>
-#include <p2psc/message/peer_challenge_response.h>
-#include <p2psc/message/peer_response.h>
+#include <p2psc/message/message_exception.h>
+#include <p2psc/message/message_reader.h>
+#include <p2psc/metrics/handshake_stats.h>
+#include <p2psc/placement/placement.h>
+#include <prewarm/warm_set.h>
 #include <socket/local_listening_socket.h>
 
 namespace p2psc {
 namespace {
 
-const auto backoff_duration_ms = std::chrono::milliseconds(10);
+const auto kLocalAcceptTimeout = std::chrono::seconds(1);
 
-std::string generate_nonce() {
-  std::srand(std::time(0));
-  return std::to_string(std::rand());
+/*
+ * Carries out a Listen action: listen on port and accept a single connection
+ * (within timeout, unless it is 0). Returns nullptr if listening failed,
+ * after reporting it to the handshake.
+ */
+template <class SocketFactory>
+std::shared_ptr<typename SocketFactory::socket_type>
+_listen(handshake::Handshake &handshake, std::uint16_t port,
+        std::chrono::milliseconds timeout,
+        const SocketFactory &socket_factory) {
+  std::unique_ptr<socket::LocalListeningSocket> listening_socket;
+  try {
+    listening_socket = std::make_unique<socket::LocalListeningSocket>(port);
+  } catch (const std::runtime_error &e) {
+    handshake.on_listen_failed(e.what());
+    return nullptr;
+  }
+  const auto socket = listening_socket->accept(socket_factory, timeout);
+  if (!socket) {
+    throw socket::SocketException("Failed to accept connection on port " +
+                                  std::to_string(port));
+  }
+  placement::apply_incoming_cpu(socket->get_incoming_cpu());
+  handshake.on_connected();
+  return socket;
 }
 
-std::shared_ptr<Socket>
-_connect_as_client(MediatorConnection &mediator_connection,
-                   const key::Keypair &our_keypair,
-                   const SocketCreator &socket_creator) {
-  LOG(level::Info) << "Attempting connection as Client (to "
-                   << mediator_connection.get_punched_peer().address << ")";
-  // close mediator socket and attempt to connect to the Peer specified in the
-  // punched_peer.
-  mediator_connection.close_socket();
+/*
+ * Carries out handshake's actions until it is done, blocking on socket
+ * whenever it is waiting for a message.
+ */
+template <class SocketFactory>
+void _drive(handshake::Handshake &handshake,
+            std::shared_ptr<typename SocketFactory::socket_type> &socket,
+            const SocketFactory &socket_factory) {
+  while (!handshake.is_done() || handshake.has_action()) {
+    const auto action = handshake.poll_action();
+    if (!action) {
+      std::string raw_message;
+      try {
+        // messages with 3072-bit keys and up are larger than a segment
+        raw_message = message::receive_message(*socket);
+      } catch (const socket::SocketException &e) {
+        handshake.on_socket_error(e.what());
+        continue;
+      } catch (const message::MessageException &e) {
+        handshake.on_socket_error(e.what());
+        continue;
+      }
+      LOG(level::Debug) << "Received message from "
+                        << socket->get_socket_address() << ": "
+                        << raw_message;
+      handshake.on_message(raw_message);
+      continue;
+    }
 
-  const auto punched_peer = mediator_connection.get_punched_peer();
-  if (punched_peer.version != kVersion) {
-    LOG(level::Error) << "Peer has incompatible protocol version "
-                      << punched_peer.version << ". Require " << kVersion;
-    throw ConnectionException(error::kErrorPeerUnsupportedProtocolVersion,
-                              "Peer has incompatible protocol version " +
-                                  std::to_string(punched_peer.version) +
-                                  ". Require " + std::to_string(kVersion));
+    switch (action->type) {
+    case handshake::Action::kActionSend:
+      try {
+        socket->send(action->data);
+      } catch (const socket::SocketException &e) {
+        handshake.on_socket_error(e.what());
+        break;
+      }
+      LOG(level::Debug) << "Sending "
+                        << message::message_type_string(action->message_type)
+                        << " to " << socket->get_socket_address() << ": "
+                        << action->data;
+      break;
+    case handshake::Action::kActionConnect:
+      try {
+        socket = socket_factory.create(*action->address);
+      } catch (const socket::SocketException &e) {
+        handshake.on_socket_error(e.what());
+        break;
+      }
+      handshake.on_connected();
+      break;
+    case handshake::Action::kActionCloseMediatorConnection:
+      LOG(level::Debug) << "Closing mediator socket";
+      socket->close();
+      socket = nullptr;
+      break;
+    case handshake::Action::kActionListen:
+      socket =
+          _listen(handshake, action->port, action->delay, socket_factory);
+      break;
+    case handshake::Action::kActionStartTimer:
+      std::this_thread::sleep_for(action->delay);
+      handshake.on_timer();
+      break;
+    }
   }
+}
 
-  std::shared_ptr<Socket> socket;
-  // it's possible that the Peer hasn't had time to create its listening
-  // socket yet, so if the connection fails we retry again once.
-  try {
-    socket = socket_creator(mediator_connection.get_punched_peer().address);
-  } catch (const socket::SocketException &e) {
-    LOG(level::Warning) << "Failed to connect to "
-                        << mediator_connection.get_punched_peer().address
-                        << ", retrying in " << backoff_duration_ms.count()
-                        << "ms. Reason: " << e.what();
-    std::this_thread::sleep_for(backoff_duration_ms);
-    socket = socket_creator(mediator_connection.get_punched_peer().address);
+/*
+ * Find the Peer on the LAN and open the connection to it, which handshake is
+ * then started on. Returns nullptr if the Peer isn't on the LAN, or didn't
+ * connect to us.
+ */
+template <class SocketFactory>
+std::shared_ptr<typename SocketFactory::socket_type>
+_connect_on_lan(handshake::Handshake &handshake,
+                const key::Keypair &our_keypair, const Peer &peer,
+                const SocketFactory &socket_factory) {
+  discovery::LanDiscovery lan_discovery(our_keypair, peer,
+                                        discovery::get_discovery());
+  const auto address = lan_discovery.find();
+  if (!address) {
+    LOG(level::Info) << "Peer not found on LAN";
+    return nullptr;
   }
-
-  // send peer challenge
-  const std::string nonce = generate_nonce();
-  const auto encrypted_nonce =
-      mediator_connection.get_punched_peer().peer.public_key.encrypt(nonce);
-  const auto peer_challenge =
-      Message<message::PeerChallenge>(message::PeerChallenge{encrypted_nonce});
-  message::send_and_log(socket, peer_challenge);
-
-  // receive peer challenge response
-  const auto peer_challenge_response =
-      message::receive_and_log<message::PeerChallengeResponse>(socket);
-
-  if (peer_challenge_response.format().payload.decrypted_nonce != nonce) {
-    throw std::runtime_error(
-        "PeerChallengeResponse: peer did not pass verification");
+  if (lan_discovery.is_client()) {
+    const auto socket = socket_factory.create(*address);
+    handshake.start_as_client(PunchedPeer(peer, *address, kVersion));
+    return socket;
   }
-  std::string decrypted_peer_nonce;
-  try {
-    decrypted_peer_nonce = our_keypair.private_decrypt(
-        peer_challenge_response.format().payload.encrypted_nonce);
-  } catch (crypto::CryptoException &e) {
-    throw std::runtime_error(
-        "PeerChallengeResponse: Could not decrypt encrypted_nonce");
+  const auto sock_fd = lan_discovery.accept();
+  if (sock_fd == -1) {
+    LOG(level::Warning) << "Peer found on LAN did not connect";
+    return nullptr;
   }
-
-  // send peer response
-  const auto peer_response = Message<message::PeerResponse>(
-      message::PeerResponse{decrypted_peer_nonce});
-  message::send_and_log(socket, peer_response);
-
-  // receive peer acknowledgement
-  message::receive_and_log<message::PeerAcknowledgement>(socket);
-
+  const auto socket = socket_factory.create(sock_fd);
+  handshake.start_as_peer();
   return socket;
 }
 
-std::shared_ptr<Socket>
-_connect_as_peer(MediatorConnection &mediator_connection,
-                 const key::Keypair &our_keypair, const Peer &peer,
-                 const SocketCreator &socket_creator) {
-  const auto socket_address = socket::SocketAddress(
-      socket::local_ip, mediator_connection.get_peer_disconnect().port);
-  LOG(level::Info) << "Attempting connection as Peer (on " << socket_address
-                   << ")";
-  // close mediator socket and create new socket to listen for peer challenge
-  LOG(level::Debug) << "Closing mediator socket to begin listening on "
-                    << socket_address;
-  mediator_connection.close_socket();
-  const auto listening_socket = std::make_unique<socket::LocalListeningSocket>(
-      socket_creator, mediator_connection.get_peer_disconnect().port);
-  const auto socket = listening_socket->accept();
-
-  // receive peer challenge
-  const auto peer_challenge =
-      message::receive_and_log<message::PeerChallenge>(socket);
-  const auto decrypted_nonce = our_keypair.private_decrypt(
-      peer_challenge.format().payload.encrypted_nonce);
-
-  // send peer challenge response
-  const auto client_nonce = generate_nonce();
-  const auto encrypted_client_nonce = peer.public_key.encrypt(client_nonce);
-  const auto peer_challenge_response = Message<message::PeerChallengeResponse>(
-      message::PeerChallengeResponse{encrypted_client_nonce, decrypted_nonce});
-  message::send_and_log(socket, peer_challenge_response);
-
-  // receive peer response
-  const auto peer_response =
-      message::receive_and_log<message::PeerResponse>(socket);
-  if (peer_response.format().payload.decrypted_nonce != client_nonce) {
-    throw std::runtime_error("PeerResponse: peer did not pass verification");
+/*
+ * Meet the Peer through the DHT and open the connection to it, which
+ * handshake is then started on. Returns nullptr if the Peer's record wasn't
+ * found, or the Peer didn't connect to us.
+ */
+template <class SocketFactory>
+std::shared_ptr<typename SocketFactory::socket_type>
+_connect_through_dht(handshake::Handshake &handshake,
+                     const key::Keypair &our_keypair, const Peer &peer,
+                     std::shared_ptr<dht::Node> node,
+                     const SocketFactory &socket_factory) {
+  dht::DhtRendezvous rendezvous(our_keypair, peer, node);
+  if (rendezvous.is_client()) {
+    const auto address = rendezvous.find();
+    if (!address) {
+      LOG(level::Info) << "Peer's record not found in DHT";
+      return nullptr;
+    }
+    const auto socket = socket_factory.create(*address);
+    handshake.start_as_client(PunchedPeer(peer, *address, kVersion));
+    return socket;
   }
-
-  // send peer acknowledgement
-  const auto peer_acknowledgement =
-      Message<message::PeerAcknowledgement>(message::PeerAcknowledgement{});
-  message::send_and_log(socket, peer_acknowledgement);
-
+  const auto sock_fd = rendezvous.accept();
+  if (sock_fd == -1) {
+    LOG(level::Warning) << "Peer did not connect through DHT";
+    return nullptr;
+  }
+  const auto socket = socket_factory.create(sock_fd);
+  handshake.start_as_peer();
   return socket;
 }
 }
@@ -138,22 +184,59 @@ _connect_as_peer(MediatorConnection &mediator_connection,
 void Connection::connect(const key::Keypair &our_keypair, const Peer &peer,
                          const Mediator &mediator, const Callback &callback,
                          const SocketCreator &socket_creator) {
-  _execute_asynchronously(std::bind(Connection::_handle_connection, our_keypair,
-                                    peer, mediator, callback, socket_creator));
+  _execute_asynchronously(
+      std::bind(Connection::_handle_connection<SocketCreatorFactory>,
+                our_keypair, peer, mediator, boost::none,
+                handshake::EarlyData(), callback,
+                SocketCreatorFactory(socket_creator)));
+}
+
+void Connection::prewarm(const key::Keypair &our_keypair, const Peer &peer,
+                         const Mediator &mediator,
+                         std::chrono::milliseconds ttl,
+                         const SocketCreator &socket_creator) {
+  _execute_asynchronously(std::bind(Connection::_prewarm<SocketCreatorFactory>,
+                                    our_keypair, peer, mediator, ttl,
+                                    SocketCreatorFactory(socket_creator)));
 }
 
 void Connection::_execute_asynchronously(std::function<void()> f) {
-  std::thread thread(f);
+  std::thread thread([f]() {
+    placement::apply_to_connection_thread();
+    f();
+  });
   thread.detach();
 }
 
-void Connection::_handle_connection(const key::Keypair &our_keypair,
-                                    const Peer &peer, const Mediator &mediator,
-                                    const Callback &callback,
-                                    const SocketCreator &socket_creator) {
+template <class SocketFactory>
+void Connection::_handle_connection(
+    const key::Keypair &our_keypair, const Peer &peer, const Mediator &mediator,
+    const boost::optional<handshake::Rendezvous> &rendezvous,
+    const handshake::EarlyData &early_data, const Callback &callback,
+    const SocketFactory &socket_factory) {
+  // the thread may be reused by the Callback for other connections
+  handshake::set_last_early_data_reply(boost::none);
   try {
-    std::shared_ptr<Socket> socket =
-        _connect(our_keypair, peer, mediator, socket_creator);
+    std::shared_ptr<Socket> socket;
+    boost::optional<std::string> early_data_reply;
+    {
+      // closed before the callback, so that last_handshake_stats() can be
+      // read from within it.
+      metrics::HandshakeStatsScope stats_scope;
+      // a prewarmed connection's handshake is over, so it can't carry an
+      // early request; that's left parked for a connect() without one
+      if (!early_data.request) {
+        socket = prewarm::warm_set().take(
+            prewarm::WarmSet::key_of(our_keypair, peer));
+      }
+      if (socket) {
+        LOG(level::Info) << "Using prewarmed connection";
+      } else {
+        socket = _connect(our_keypair, peer, mediator, rendezvous, early_data,
+                          socket_factory, early_data_reply);
+      }
+    }
+    handshake::set_last_early_data_reply(early_data_reply);
     LOG(level::Info) << "Successfully created socket (on "
                      << socket->get_socket_address() << ")";
     callback(Error(), socket);
@@ -173,31 +256,154 @@ void Connection::_handle_connection(const key::Keypair &our_keypair,
   }
 }
 
+template <class SocketFactory>
+void Connection::_prewarm(const key::Keypair &our_keypair, const Peer &peer,
+                          const Mediator &mediator,
+                          std::chrono::milliseconds ttl,
+                          const SocketFactory &socket_factory) {
+  auto &warm_set = prewarm::warm_set();
+  const auto key = prewarm::WarmSet::key_of(our_keypair, peer);
+  if (!warm_set.start(key)) {
+    LOG(level::Debug) << "Connection to peer is already prewarmed";
+    return;
+  }
+  prewarm::lower_thread_priority();
+  std::shared_ptr<Socket> socket;
+  try {
+    boost::optional<std::string> early_data_reply;
+    socket = _connect(our_keypair, peer, mediator, boost::none,
+                      handshake::EarlyData(), socket_factory,
+                      early_data_reply);
+    LOG(level::Info) << "Prewarmed connection (on "
+                     << socket->get_socket_address() << ")";
+  } catch (const std::exception &e) {
+    LOG(level::Warning) << "Failed to prewarm connection to peer: "
+                        << e.what();
+  }
+  warm_set.park(key, socket, ttl);
+}
+
+template <class SocketFactory>
 std::shared_ptr<Socket>
 Connection::_connect(const key::Keypair &our_keypair, const Peer &peer,
                      const Mediator &mediator,
-                     const SocketCreator &socket_creator) {
+                     const boost::optional<handshake::Rendezvous> &rendezvous,
+                     const handshake::EarlyData &early_data,
+                     const SocketFactory &socket_factory,
+                     boost::optional<std::string> &early_data_reply) {
   // Depending on who handshakes with the Mediator first, either we will have
   // to connect to the Peer (we handshake first) or the Peer will connect
-  // with us (they handshake first).
-  //
-  // If they connect with us, we don't have to do anything; the mediator
-  // connection will yield a socket with the peer over which we must then
-  // verify our identities. Otherwise, we first must create a socket with the
-  // Peer before verification can happen.
-  auto mediator_connection = MediatorConnection(mediator, socket_creator);
-  try {
-    mediator_connection.connect(our_keypair, peer);
-  } catch (const socket::SocketException &e) {
-    throw ConnectionException(error::kErrorMediatorConnectFailure, e.what());
-  }
-  if (mediator_connection.has_punched_peer()) {
-    return _connect_as_client(mediator_connection, our_keypair, socket_creator);
-  } else if (mediator_connection.has_peer_disconnect()) {
-    return _connect_as_peer(mediator_connection, our_keypair, peer,
-                            socket_creator);
-  } else {
-    throw std::runtime_error("No PunchedPeer or PeerDisconnect");
+  // with us (they handshake first). The handshake decides which; all we do
+  // here is carry out its actions, blocking on the socket whenever it is
+  // waiting for a message. If we've been introduced to the Peer, we meet it
+  // where the introducer told us to. Otherwise, with discovery, we first look
+  // for it on the LAN, and with a DHT, we then meet it through that. Either
+  // way, we only go to the Mediator if that fails.
+  handshake::Extensions extensions;
+  extensions.compression = compression::get_compression();
+  extensions.early_data = early_data;
+  extensions.challenge_pool = handshake::get_challenge_pool();
+  // We don't know yet whether we'll be the Peer, so listen either way.
+  std::unique_ptr<local::LocalListener> local_listener;
+  if (local::local_transport_enabled()) {
+    try {
+      local_listener = std::make_unique<local::LocalListener>();
+      extensions.host_id = local::host_id();
+      extensions.local_socket_name = local_listener->name();
+      extensions.local_socket_token = local_listener->token();
+    } catch (const socket::SocketException &e) {
+      LOG(level::Warning) << e.what();
+    }
+  }
+  const auto create_handshake = [&]() {
+    return std::make_unique<handshake::Handshake>(
+        our_keypair, peer, mediator, handshake::generate_nonce, extensions);
+  };
+  std::unique_ptr<handshake::Handshake> handshake;
+  std::shared_ptr<typename SocketFactory::socket_type> socket;
+  if (rendezvous) {
+    handshake = create_handshake();
+    try {
+      handshake->start_at(*rendezvous);
+      _drive(*handshake, socket, socket_factory);
+    } catch (const std::exception &e) {
+      LOG(level::Warning) << "Failed to meet introduced Peer, going to "
+                             "Mediator: "
+                          << e.what();
+      socket = nullptr;
+    }
+  } else if (discovery::get_discovery().enabled) {
+    handshake = create_handshake();
+    try {
+      socket = _connect_on_lan(*handshake, our_keypair, peer, socket_factory);
+      if (socket) {
+        _drive(*handshake, socket, socket_factory);
+      }
+    } catch (const std::exception &e) {
+      // the other end fails too, and also goes to the Mediator
+      LOG(level::Warning) << "Failed to connect on LAN, going to Mediator: "
+                          << e.what();
+      socket = nullptr;
+    }
+  }
+  const auto node = dht::get_dht();
+  if (!socket && !rendezvous && node) {
+    handshake = create_handshake();
+    try {
+      socket = _connect_through_dht(*handshake, our_keypair, peer, node,
+                                    socket_factory);
+      if (socket) {
+        _drive(*handshake, socket, socket_factory);
+      }
+    } catch (const std::exception &e) {
+      LOG(level::Warning) << "Failed to connect through DHT, going to "
+                             "Mediator: "
+                          << e.what();
+      socket = nullptr;
+    }
+  }
+  if (!socket) {
+    handshake = create_handshake();
+    handshake->start();
+    _drive(*handshake, socket, socket_factory);
   }
+  early_data_reply = handshake->early_data_reply();
+  if (const auto name = handshake->local_socket()) {
+    // Compressing would only cost CPU on a Unix domain socket.
+    const auto local_socket =
+        local_listener && *name == local_listener->name()
+            ? local_listener->accept(*socket, kLocalAcceptTimeout)
+            : local::connect(*name, *handshake->local_socket_token(),
+                             *socket, 2 * kLocalAcceptTimeout);
+    if (local_socket) {
+      LOG(level::Info) << "Moved connection to Unix domain socket " << *name;
+      return local_socket;
+    }
+  }
+  if (const auto compression = handshake->negotiated_compression()) {
+    LOG(level::Info) << "Compressing connection with zstd (level "
+                     << compression->level << ", "
+                     << (compression->dictionary.empty() ? "no" : "with")
+                     << " dictionary)";
+    return std::make_shared<compression::CompressedSocket>(socket,
+                                                           *compression);
+  }
+  return socket;
+}
+
+template void Connection::_handle_connection<PlainSocketFactory>(
+    const key::Keypair &, const Peer &, const Mediator &,
+    const boost::optional<handshake::Rendezvous> &,
+    const handshake::EarlyData &, const Callback &, const PlainSocketFactory &);
+template void Connection::_prewarm<PlainSocketFactory>(
+    const key::Keypair &, const Peer &, const Mediator &,
+    std::chrono::milliseconds, const PlainSocketFactory &);
+template void Connection::_prewarm<SocketCreatorFactory>(
+    const key::Keypair &, const Peer &, const Mediator &,
+    std::chrono::milliseconds, const SocketCreatorFactory &);
+template void Connection::_handle_connection<SocketCreatorFactory>(
+    const key::Keypair &, const Peer &, const Mediator &,
+    const boost::optional<handshake::Rendezvous> &,
+    const handshake::EarlyData &, const Callback &,
+    const SocketCreatorFactory &);
 }
-}
\ No newline at end of file
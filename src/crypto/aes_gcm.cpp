@@ -0,0 +1,103 @@
+#include <crypto/aes_gcm.h>
+#include <memory>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <p2psc/crypto/crypto_exception.h>
+#include <p2psc/metrics/handshake_stats.h>
+
+namespace p2psc {
+namespace crypto {
+namespace {
+
+using CIPHER_CTX_ptr =
+    std::unique_ptr<EVP_CIPHER_CTX, decltype(&::EVP_CIPHER_CTX_free)>;
+
+const int kNonceSize = 12;
+const int kTagSize = 16;
+
+const unsigned char *bytes(const std::string &string) {
+  return reinterpret_cast<const unsigned char *>(string.data());
+}
+
+CIPHER_CTX_ptr create_context(const std::string &key, const char *nonce,
+                              bool encrypt) {
+  if (key.size() != kAesGcmKeySize) {
+    throw CryptoException("AES-256-GCM key must be " +
+                          std::to_string(kAesGcmKeySize) + " bytes");
+  }
+  CIPHER_CTX_ptr context(EVP_CIPHER_CTX_new(), ::EVP_CIPHER_CTX_free);
+  if (!context ||
+      EVP_CipherInit_ex(context.get(), EVP_aes_256_gcm(), nullptr, bytes(key),
+                        reinterpret_cast<const unsigned char *>(nonce),
+                        encrypt) != 1) {
+    throw CryptoException("Failed to initialise AES-256-GCM");
+  }
+  return context;
+}
+
+void add_associated_data(EVP_CIPHER_CTX *context,
+                         const std::string &associated_data) {
+  int length;
+  if (EVP_CipherUpdate(context, nullptr, &length, bytes(associated_data),
+                       associated_data.size()) != 1) {
+    throw CryptoException("Failed to authenticate associated data");
+  }
+}
+}
+
+std::string generate_secret() {
+  std::string secret(kAesGcmKeySize, '\0');
+  if (RAND_bytes(reinterpret_cast<unsigned char *>(&secret[0]),
+                 secret.size()) != 1) {
+    throw CryptoException("Failed to generate secret");
+  }
+  return secret;
+}
+
+std::string seal(const std::string &key, const std::string &plaintext,
+                 const std::string &associated_data) {
+  metrics::count_crypto_operation();
+  std::string sealed(kNonceSize + plaintext.size() + kTagSize, '\0');
+  auto *out = reinterpret_cast<unsigned char *>(&sealed[0]);
+  if (RAND_bytes(out, kNonceSize) != 1) {
+    throw CryptoException("Failed to generate nonce");
+  }
+  const auto context = create_context(key, &sealed[0], true);
+  add_associated_data(context.get(), associated_data);
+  int length;
+  if (EVP_CipherUpdate(context.get(), out + kNonceSize, &length,
+                       bytes(plaintext), plaintext.size()) != 1 ||
+      EVP_CipherFinal_ex(context.get(), out + kNonceSize + length, &length) !=
+          1 ||
+      EVP_CIPHER_CTX_ctrl(context.get(), EVP_CTRL_GCM_GET_TAG, kTagSize,
+                          out + kNonceSize + plaintext.size()) != 1) {
+    throw CryptoException("Failed to encrypt with AES-256-GCM");
+  }
+  return sealed;
+}
+
+std::string open(const std::string &key, const std::string &sealed,
+                 const std::string &associated_data) {
+  metrics::count_crypto_operation();
+  if (sealed.size() < kNonceSize + kTagSize) {
+    throw CryptoException("Sealed data too short");
+  }
+  const auto size = sealed.size() - kNonceSize - kTagSize;
+  std::string plaintext(size, '\0');
+  auto *out = reinterpret_cast<unsigned char *>(&plaintext[0]);
+  const auto context = create_context(key, sealed.data(), false);
+  add_associated_data(context.get(), associated_data);
+  std::string tag = sealed.substr(kNonceSize + size);
+  int length;
+  if (EVP_CipherUpdate(context.get(), out, &length,
+                       bytes(sealed) + kNonceSize, size) != 1 ||
+      EVP_CIPHER_CTX_ctrl(context.get(), EVP_CTRL_GCM_SET_TAG, kTagSize,
+                          &tag[0]) != 1 ||
+      EVP_CipherFinal_ex(context.get(), out + length, &length) != 1) {
+    throw CryptoException("Failed to decrypt with AES-256-GCM: "
+                          "wrong key or tampered data");
+  }
+  return plaintext;
+}
+}
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+
+/**
+ * Authenticated encryption with AES-256-GCM, for data protected by a key the
+ * two ends of a handshake derived. Each message gets a random 96 bit nonce,
+ * so a key can seal any number of messages.
+ */
+namespace p2psc {
+namespace crypto {
+
+const std::size_t kAesGcmKeySize = 32;
+
+// kAesGcmKeySize random bytes
+std::string generate_secret();
+// the nonce, ciphertext and tag of plaintext, concatenated
+std::string seal(const std::string &key, const std::string &plaintext,
+                 const std::string &associated_data);
+// Throws CryptoException unless sealed was sealed with key and
+// associated_data and hasn't been tampered with.
+std::string open(const std::string &key, const std::string &sealed,
+                 const std::string &associated_data);
+}
+}
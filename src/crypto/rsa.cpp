@@ -1,8 +1,10 @@
 #include <base64/base64.h>
 #include <boost/optional.hpp>
 #include <crypto/rsa.h>
+#include <mutex>
 #include <openssl/err.h>
 #include <p2psc/crypto/crypto_exception.h>
+#include <p2psc/metrics/handshake_stats.h>
 #include <string.h>
 
 namespace p2psc {
@@ -11,15 +13,8 @@ namespace crypto {
 namespace {
 
 using BN_ptr = std::unique_ptr<BIGNUM, decltype(&::BN_free)>;
+using BIO_ptr = std::unique_ptr<BIO, decltype(&::BIO_free_all)>;
 
-::RSA *generate_new_key() {
-  ::RSA *rsa(RSA_new());
-  BN_ptr bn(BN_new(), ::BN_free);
-  BN_set_word(bn.get(), RSA_F4);
-
-  RSA_generate_key_ex(rsa, kDefaultKeySize, bn.get(), NULL);
-  return rsa;
-}
 
 std::string bio_to_string(BIO *bio) {
   char *bptr;
@@ -28,11 +23,9 @@ std::string bio_to_string(BIO *bio) {
 }
 
 ::RSA *string_to_key(const std::string &key_str) {
-  // TODO: does this leak?
-  BIO *bio = BIO_new_mem_buf(
-      reinterpret_cast<void *>(const_cast<char *>(key_str.c_str())),
-      key_str.length());
-  ::RSA *key = PEM_read_bio_RSAPublicKey(bio, 0, 0, 0);
+  BIO_ptr bio(BIO_new_mem_buf(key_str.c_str(), key_str.length()),
+              ::BIO_free_all);
+  ::RSA *key = PEM_read_bio_RSAPublicKey(bio.get(), 0, 0, 0);
   if (!key) {
     throw CryptoException("Could not load RSA public key from string");
   }
@@ -45,6 +38,31 @@ std::string get_openssl_error_str() {
   return "OpenSSL exception: " + std::string(errbuf);
 }
 
+// the most primes OpenSSL allows for a modulus of bits (see
+// ossl_rsa_multip_cap), so that they stay large enough to resist factoring
+int max_primes(std::uint16_t bits) {
+  return bits < 1024 ? 2 : bits < 4096 ? 3 : bits < 8192 ? 4 : 5;
+}
+
+::RSA *generate_new_key(std::uint16_t key_size, int primes) {
+  if (primes < 2 || primes > max_primes(key_size)) {
+    throw CryptoException("Cannot generate a " + std::to_string(key_size) +
+                          " bit RSA key with " + std::to_string(primes) +
+                          " primes");
+  }
+  ::RSA *rsa(RSA_new());
+  BN_ptr bn(BN_new(), ::BN_free);
+  BN_set_word(bn.get(), RSA_F4);
+
+  if (RSA_generate_multi_prime_key(rsa, key_size, primes, bn.get(), NULL) !=
+      1) {
+    RSA_free(rsa);
+    throw CryptoException("Could not generate RSA key: " +
+                          get_openssl_error_str());
+  }
+  return rsa;
+}
+
 int password_callback(char *buf, int size, int rwflag, void *userdata) {
   const char *pw = (const char *)userdata;
   const auto len = strlen(pw);
@@ -57,18 +75,44 @@ int password_callback(char *buf, int size, int rwflag, void *userdata) {
   return len;
 }
 
+// The cipher tables are only needed for encrypted PEM files, so short-lived
+// tools with unencrypted keys never load them.
+void load_ciphers() {
+  static std::once_flag loaded;
+  std::call_once(loaded, []() { OpenSSL_add_all_algorithms(); });
+}
+
 ::RSA *file_to_key(const std::string &path,
                    const boost::optional<std::string> &password) {
-  OpenSSL_add_all_algorithms();
-  BIO *bio = BIO_new(BIO_s_file());
-  BIO_read_filename(bio, path.c_str());
+  if (password) {
+    load_ciphers();
+  }
+  BIO_ptr bio(BIO_new(BIO_s_file()), ::BIO_free_all);
+  if (BIO_read_filename(bio.get(), path.c_str()) <= 0) {
+    throw CryptoException("Could not open key file: " + path + ". " +
+                          get_openssl_error_str());
+  }
 
   // if `password` is not set, we still pass an empty password which will
   // result in a "bad password read" error. this is to prevent openssl from
   // prompting for a PEM password over stdin if the user fails to supply a
   // password for a protected PEM file.
   ::RSA *key = PEM_read_bio_RSAPrivateKey(
-      bio, 0, password_callback, (void *)(password ? password->c_str() : ""));
+      bio.get(), 0, password_callback, (void *)(password ? password->c_str() : ""));
+  if (!key) {
+    throw CryptoException("Could not restore key from file: " + path + ". " +
+                          get_openssl_error_str());
+  }
+  return key;
+}
+
+::RSA *der_file_to_key(const std::string &path) {
+  BIO_ptr bio(BIO_new_file(path.c_str(), "rb"), ::BIO_free_all);
+  if (!bio) {
+    throw CryptoException("Could not open key file: " + path + ". " +
+                          get_openssl_error_str());
+  }
+  ::RSA *key = d2i_RSAPrivateKey_bio(bio.get(), 0);
   if (!key) {
     throw CryptoException("Could not restore key from file: " + path + ". " +
                           get_openssl_error_str());
@@ -83,11 +127,9 @@ inline void check_error(const std::string &method, int size) {
 }
 
 std::string key_to_string_public(::RSA *key) {
-  BIO *mem = BIO_new(BIO_s_mem());
-  PEM_write_bio_RSAPublicKey(mem, key);
-  const auto key_string = bio_to_string(mem);
-  BIO_free(mem);
-  return key_string;
+  BIO_ptr mem(BIO_new(BIO_s_mem()), ::BIO_free_all);
+  PEM_write_bio_RSAPublicKey(mem.get(), key);
+  return bio_to_string(mem.get());
 }
 }
 
@@ -104,8 +146,13 @@ std::shared_ptr<RSA> RSA::from_pem(const std::string &path,
   return std::shared_ptr<RSA>(new RSA(file_to_key(path, password), true));
 }
 
-std::shared_ptr<RSA> RSA::generate() {
-  return std::shared_ptr<RSA>(new RSA(generate_new_key(), true));
+std::shared_ptr<RSA> RSA::from_der(const std::string &path) {
+  return std::shared_ptr<RSA>(new RSA(der_file_to_key(path), true));
+}
+
+std::shared_ptr<RSA> RSA::generate(std::uint16_t key_size, int primes) {
+  return std::shared_ptr<RSA>(
+      new RSA(generate_new_key(key_size, primes), true));
 }
 
 RSA::RSA(::RSA *key, bool has_private_key)
@@ -113,8 +160,15 @@ RSA::RSA(::RSA *key, bool has_private_key)
 
 RSA::~RSA() { RSA_free(_key); }
 
+std::uint16_t RSA::key_size() const { return RSA_bits(_key); }
+
+int RSA::primes() const {
+  return _has_private_key ? 2 + RSA_get_multi_prime_extra_count(_key) : 0;
+}
+
 std::string RSA::public_encrypt(const std::string &key_str) const {
   unsigned char buf[RSA_size(_key)];
+  metrics::count_crypto_operation();
   int size = RSA_public_encrypt(key_str.length(),
                                 (const unsigned char *)key_str.c_str(), buf,
                                 _key, RSA_PKCS1_PADDING);
@@ -125,6 +179,7 @@ std::string RSA::public_encrypt(const std::string &key_str) const {
 std::string RSA::public_decrypt(const std::string &encrypted) const {
   const auto decoded = base64_decode(encrypted);
   unsigned char buf[RSA_size(_key)];
+  metrics::count_crypto_operation();
   int size = RSA_public_decrypt(decoded.length(),
                                 (const unsigned char *)decoded.c_str(), buf,
                                 _key, RSA_PKCS1_PADDING);
@@ -138,6 +193,7 @@ std::string RSA::private_decrypt(const std::string &encrypted) const {
   }
   const auto decoded = base64_decode(encrypted);
   unsigned char buf[RSA_size(_key)];
+  metrics::count_crypto_operation();
   int size = RSA_private_decrypt(decoded.length(),
                                  (const unsigned char *)decoded.c_str(), buf,
                                  _key, RSA_PKCS1_PADDING);
@@ -150,6 +206,7 @@ std::string RSA::private_encrypt(const std::string &key_str) const {
     throw CryptoException("This RSA structure has no private key");
   }
   unsigned char buf[RSA_size(_key)];
+  metrics::count_crypto_operation();
   int size = RSA_private_encrypt(key_str.length(),
                                  (const unsigned char *)key_str.c_str(), buf,
                                  _key, RSA_PKCS1_PADDING);
@@ -158,16 +215,25 @@ std::string RSA::private_encrypt(const std::string &key_str) const {
 }
 
 std::string RSA::get_public_key_string() const {
-  return key_to_string_public(_key);
+  // sent with every Advertise, and hashed for every fingerprint
+  std::call_once(_public_key_string_once, [this]() {
+    _public_key_string = key_to_string_public(_key);
+  });
+  return _public_key_string;
 }
 
 void RSA::write_to_file(const std::string &path) const {
-  BIO *bio = BIO_new_file(path.c_str(), "w");
-  int ret = PEM_write_bio_RSAPrivateKey(bio, _key, 0, 0, 0, 0, 0);
-  if (!ret) {
+  BIO_ptr bio(BIO_new_file(path.c_str(), "w"), ::BIO_free_all);
+  if (!bio || !PEM_write_bio_RSAPrivateKey(bio.get(), _key, 0, 0, 0, 0, 0)) {
+    throw CryptoException("Could not write to file.");
+  }
+}
+
+void RSA::write_der_to_file(const std::string &path) const {
+  BIO_ptr bio(BIO_new_file(path.c_str(), "wb"), ::BIO_free_all);
+  if (!bio || !i2d_RSAPrivateKey_bio(bio.get(), _key)) {
     throw CryptoException("Could not write to file.");
   }
-  BIO_free_all(bio);
 }
 
 void RSA::write_to_file(const std::string &path, const std::string &password,
@@ -178,19 +244,17 @@ void RSA::write_to_file(const std::string &path, const std::string &password,
                           std::to_string(min_password_length) +
                           " characters long");
   }
-  OpenSSL_add_all_algorithms();
-  BIO *bio = BIO_new_file(path.c_str(), "w");
+  load_ciphers();
   const evp_cipher_st *cipher_st = EVP_get_cipherbyname(cipher.c_str());
   if (!cipher_st) {
     throw CryptoException("Unknown cipher \"" + cipher + "\".");
   }
-  int ret = PEM_write_bio_RSAPrivateKey(bio, _key, cipher_st,
-                                        (unsigned char *)password.c_str(),
-                                        password.length(), 0, 0);
-  if (!ret) {
+  BIO_ptr bio(BIO_new_file(path.c_str(), "w"), ::BIO_free_all);
+  if (!bio || !PEM_write_bio_RSAPrivateKey(bio.get(), _key, cipher_st,
+                                           (unsigned char *)password.c_str(),
+                                           password.length(), 0, 0)) {
     throw CryptoException("Could not write to file.");
   }
-  BIO_free_all(bio);
 }
 }
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <cassert>
 #include <iostream>
 #include <memory>
+#include <mutex>
 
 #include <openssl/bn.h>
 #include <openssl/pem.h>
@@ -24,7 +25,16 @@ public:
   static std::shared_ptr<RSA> from_pem(const std::string &path);
   static std::shared_ptr<RSA> from_pem(const std::string &path,
                                        const std::string &password);
-  static std::shared_ptr<RSA> generate();
+  // an unencrypted PKCS#1 DER private key, as written by write_der_to_file
+  static std::shared_ptr<RSA> from_der(const std::string &path);
+  /*
+   * Generates a key of key_size bits whose modulus is the product of primes
+   * primes; the public key is an ordinary RSA public key. Throws
+   * CryptoException if OpenSSL doesn't allow that many primes: up to 3
+   * below 4096 bits, 4 below 8192 and 5 above.
+   */
+  static std::shared_ptr<RSA>
+  generate(std::uint16_t key_size = kDefaultKeySize, int primes = 2);
 
   std::string public_encrypt(const std::string &message) const override;
   std::string public_decrypt(const std::string &message) const override;
@@ -33,9 +43,14 @@ public:
 
   std::string get_public_key_string() const override;
 
+  std::uint16_t key_size() const;
+  // the number of primes of the modulus, or 0 without the private key
+  int primes() const;
+
   void write_to_file(const std::string &path) const override;
   void write_to_file(const std::string &path, const std::string &password,
                      const std::string &cipher) const override;
+  void write_der_to_file(const std::string &path) const override;
 
   ~RSA();
 
@@ -44,6 +59,8 @@ private:
 
   ::RSA *_key;
   bool _has_private_key;
+  mutable std::once_flag _public_key_string_once;
+  mutable std::string _public_key_string;
 };
 }
 }
\ No newline at end of file
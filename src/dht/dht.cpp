@@ -0,0 +1,29 @@
+#include <mutex>
+#include <p2psc/dht/dht.h>
+
+namespace p2psc {
+namespace dht {
+namespace {
+
+std::mutex &dht_mutex() {
+  static std::mutex m;
+  return m;
+}
+
+std::shared_ptr<Node> &global_node() {
+  static std::shared_ptr<Node> node;
+  return node;
+}
+}
+
+void set_dht(std::shared_ptr<Node> node) {
+  std::lock_guard<std::mutex> guard(dht_mutex());
+  global_node() = node;
+}
+
+std::shared_ptr<Node> get_dht() {
+  std::lock_guard<std::mutex> guard(dht_mutex());
+  return global_node();
+}
+}
+}
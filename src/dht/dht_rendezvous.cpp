@@ -0,0 +1,69 @@
+#include <arpa/inet.h>
+#include <chrono>
+#include <dht/dht_rendezvous.h>
+#include <p2psc/dht/dht_exception.h>
+#include <p2psc/log.h>
+#include <poll.h>
+#include <socket/socket_util.h>
+#include <thread>
+#include <unistd.h>
+
+namespace p2psc {
+namespace dht {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// between lookups of a record which hasn't been published yet
+const auto kRetryInterval = std::chrono::milliseconds(100);
+}
+
+DhtRendezvous::DhtRendezvous(const key::Keypair &our_keypair,
+                             const Peer &peer, std::shared_ptr<Node> node)
+    : _our_keypair(our_keypair), _node(node),
+      _our_fingerprint(
+          key::PublicKey::from_string(our_keypair.get_serialised_public_key())
+              .fingerprint()),
+      _their_fingerprint(peer.public_key.fingerprint()),
+      _is_client(_our_fingerprint > _their_fingerprint),
+      _listening_fd(_is_client ? -1 : socket::create_listening_socket()) {}
+
+DhtRendezvous::~DhtRendezvous() {
+  if (_listening_fd != -1) {
+    ::close(_listening_fd);
+  }
+}
+
+boost::optional<socket::SocketAddress> DhtRendezvous::find() {
+  BOOST_ASSERT(_is_client);
+  const auto timeout_ms = _node->options().rendezvous_timeout_ms;
+  const auto deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+  // a record from before then is left over from an earlier connection
+  const auto published_after_ms = socket::now_ms() - timeout_ms;
+  while (true) {
+    const auto record = _node->find(_their_fingerprint, _our_fingerprint);
+    if (record && record->timestamp_ms >= published_after_ms) {
+      return socket::SocketAddress(record->ip, record->port);
+    }
+    if (Clock::now() + kRetryInterval >= deadline) {
+      return boost::none;
+    }
+    std::this_thread::sleep_for(kRetryInterval);
+  }
+}
+
+int DhtRendezvous::accept() {
+  BOOST_ASSERT(!_is_client);
+  const auto port = socket::port_of(_listening_fd);
+  if (_node->publish(_our_keypair, _their_fingerprint, port) == 0) {
+    throw DhtException("No DHT node stored our record");
+  }
+  LOG(level::Debug) << "Published DHT record for port " << port;
+  struct pollfd fd = {_listening_fd, POLLIN, 0};
+  if (poll(&fd, 1, _node->options().rendezvous_timeout_ms) != 1) {
+    return -1;
+  }
+  return ::accept4(_listening_fd, nullptr, nullptr, SOCK_CLOEXEC);
+}
+}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <boost/optional.hpp>
+#include <memory>
+#include <p2psc/dht/node.h>
+#include <p2psc/key/keypair.h>
+#include <p2psc/peer.h>
+#include <p2psc/socket/socket_address.h>
+
+namespace p2psc {
+namespace dht {
+
+/*
+ * One attempt to meet peer through the DHT (see dht.h). Throws
+ * SocketException if, as the peer which accepts the connection, we can't
+ * listen for it.
+ */
+class DhtRendezvous {
+public:
+  DhtRendezvous(const key::Keypair &our_keypair, const Peer &peer,
+                std::shared_ptr<Node> node);
+  ~DhtRendezvous();
+
+  // whether we connect to peer, rather than accept its connection
+  bool is_client() const { return _is_client; }
+  /*
+   * Look up peer's record for us until it has been published, for up to
+   * rendezvous_timeout_ms. Returns the address it waits for us on.
+   */
+  boost::optional<socket::SocketAddress> find();
+  /*
+   * Publish our record for peer, and wait up to rendezvous_timeout_ms for
+   * its connection. Returns its file descriptor, or -1 if it doesn't arrive.
+   * Throws DhtException if the record can't be published.
+   */
+  int accept();
+
+private:
+  DhtRendezvous(const DhtRendezvous &) = delete;
+  DhtRendezvous &operator=(const DhtRendezvous &) = delete;
+
+  const key::Keypair _our_keypair;
+  const std::shared_ptr<Node> _node;
+  const std::string _our_fingerprint;
+  const std::string _their_fingerprint;
+  const bool _is_client;
+  int _listening_fd;
+};
+}
+}
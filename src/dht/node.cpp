@@ -0,0 +1,451 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <openssl/rand.h>
+#include <p2psc/dht/dht_exception.h>
+#include <p2psc/dht/node.h>
+#include <p2psc/key/public_key.h>
+#include <p2psc/log.h>
+#include <p2psc/message/message.h>
+#include <p2psc/message/message_decoder.h>
+#include <p2psc/message/message_exception.h>
+#include <p2psc/socket/socket_exception.h>
+#include <poll.h>
+#include <socket/socket_util.h>
+#include <unistd.h>
+
+namespace p2psc {
+namespace dht {
+namespace {
+
+const std::size_t kMaxDatagramSize = 65536;
+
+NodeId random_id() {
+  NodeId id;
+  if (RAND_bytes(id.data(), id.size()) != 1) {
+    throw DhtException("Failed to generate node id");
+  }
+  return id;
+}
+
+std::uint64_t random_rpc_id() {
+  std::uint64_t id;
+  if (RAND_bytes(reinterpret_cast<unsigned char *>(&id), sizeof(id)) != 1) {
+    throw DhtException("Failed to generate RPC id");
+  }
+  return id;
+}
+
+// what the signature covers
+std::string signed_fields(const message::DhtRecord &record) {
+  return record.public_key + "|" + record.to + "|" + record.ip + "|" +
+         std::to_string(record.port) + "|" +
+         std::to_string(record.timestamp_ms);
+}
+
+[[noreturn]] void throw_socket_error(const std::string &what) {
+  throw socket::SocketException(what + ". Reason: " + strerror(errno));
+}
+
+int create_socket(std::uint16_t port) {
+  const auto fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (fd == -1) {
+    throw_socket_error("Failed to create DHT socket");
+  }
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+  if (bind(fd, (const struct sockaddr *)&address, sizeof(address)) != 0) {
+    const auto error = errno;
+    ::close(fd);
+    errno = error;
+    throw_socket_error("Failed to bind DHT socket to port " +
+                       std::to_string(port));
+  }
+  return fd;
+}
+
+message::DhtContact to_message(const Contact &contact) {
+  return message::DhtContact{to_hex(contact.id), contact.address.ip(),
+                             contact.address.port()};
+}
+
+// One node in a lookup's shortlist.
+struct Candidate {
+  Contact contact;
+  NodeId distance;
+  bool queried;
+  bool answered;
+};
+}
+
+Node::Node(std::uint16_t port, const DhtOptions &options)
+    : _options(options), _id(random_id()), _sockfd(create_socket(port)),
+      _port(socket::port_of(_sockfd)), _mutex("dht::Node"),
+      _table(_id, options.k), _next_rpc_id(random_rpc_id()) {
+  if (pipe2(_wake_fds, O_CLOEXEC) != 0) {
+    ::close(_sockfd);
+    throw_socket_error("Failed to create DHT wake-up pipe");
+  }
+  _receiver = std::thread(&Node::_receive_loop, this);
+}
+
+Node::~Node() {
+  const char wake = 0;
+  if (write(_wake_fds[1], &wake, 1) != 1) {
+    LOG(level::Error) << "Failed to stop DHT node: " << strerror(errno);
+  }
+  _receiver.join();
+  ::close(_wake_fds[0]);
+  ::close(_wake_fds[1]);
+  ::close(_sockfd);
+}
+
+std::size_t Node::bootstrap(const std::vector<socket::SocketAddress> &nodes) {
+  // Ping them first, to learn their ids.
+  std::vector<std::pair<socket::SocketAddress, message::DhtQuery>> pings;
+  for (const auto &address : nodes) {
+    pings.emplace_back(address, _query(message::kDhtPing));
+  }
+  _call(pings);
+  _lookup(_id, boost::none);
+  return known_nodes();
+}
+
+std::size_t Node::publish(const key::Keypair &keypair, const std::string &to,
+                          std::uint16_t port) {
+  const auto public_key = keypair.get_serialised_public_key();
+  const auto target =
+      from_hex(key::PublicKey::from_string(public_key).fingerprint());
+  BOOST_ASSERT(target);
+  const auto closest = _lookup(*target, boost::none).closest;
+
+  message::DhtRecord record{public_key, to, "", port, socket::now_ms(), ""};
+  {
+    std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+    if (_observed_ip.empty()) {
+      throw DhtException("No DHT node has seen our address yet");
+    }
+    record.ip = _observed_ip;
+  }
+  record.signature = keypair.sign(signed_fields(record));
+  std::vector<std::pair<socket::SocketAddress, message::DhtQuery>> stores;
+  for (const auto &contact : closest) {
+    auto query = _query(message::kDhtStore);
+    query.record = record;
+    stores.emplace_back(contact.address, query);
+  }
+  const auto responses = _call(stores);
+  return std::count_if(
+      responses.begin(), responses.end(),
+      [](const boost::optional<message::DhtResponse> &response) {
+        return static_cast<bool>(response);
+      });
+}
+
+boost::optional<message::DhtRecord> Node::find(const std::string &fingerprint,
+                                               const std::string &to) {
+  const auto target = from_hex(fingerprint);
+  if (!target) {
+    throw DhtException("Not a key fingerprint: " + fingerprint);
+  }
+  return _lookup(*target, to).record;
+}
+
+std::size_t Node::known_nodes() {
+  std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+  return _table.size();
+}
+
+std::size_t Node::stored_records() {
+  std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+  return _records.size();
+}
+
+Node::LookupResult Node::_lookup(const NodeId &target,
+                                 const boost::optional<std::string> &to) {
+  std::vector<Candidate> shortlist;
+  const auto add = [&](const Contact &contact) {
+    if (contact.id == _id ||
+        std::any_of(shortlist.begin(), shortlist.end(),
+                    [&](const Candidate &candidate) {
+                      return candidate.contact.id == contact.id;
+                    })) {
+      return;
+    }
+    shortlist.push_back(
+        Candidate{contact, xor_distance(contact.id, target), false, false});
+  };
+  {
+    std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+    for (const auto &contact : _table.closest(target, _options.k)) {
+      add(contact);
+    }
+  }
+
+  LookupResult result;
+  while (true) {
+    std::sort(shortlist.begin(), shortlist.end(),
+              [](const Candidate &a, const Candidate &b) {
+                return a.distance < b.distance;
+              });
+    // Query the closest unqueried candidates among the k closest which
+    // haven't failed; once all of those have answered, the lookup is done.
+    std::vector<Candidate *> batch;
+    std::size_t live = 0;
+    for (auto &candidate : shortlist) {
+      if (live == _options.k || batch.size() == _options.alpha) {
+        break;
+      }
+      if (candidate.queried && !candidate.answered) {
+        continue;
+      }
+      live++;
+      if (!candidate.queried) {
+        batch.push_back(&candidate);
+      }
+    }
+    if (batch.empty()) {
+      break;
+    }
+
+    std::vector<std::pair<socket::SocketAddress, message::DhtQuery>> queries;
+    for (const auto candidate : batch) {
+      candidate->queried = true;
+      auto query =
+          _query(to ? message::kDhtFindValue : message::kDhtFindNode);
+      query.target = to_hex(target);
+      query.to = to;
+      queries.emplace_back(candidate->contact.address, query);
+    }
+    const auto responses = _call(queries);
+    std::vector<Contact> learned;
+    for (std::size_t i = 0; i < batch.size(); i++) {
+      if (!responses[i]) {
+        continue;
+      }
+      batch[i]->answered = true;
+      for (const auto &record : responses[i]->records) {
+        // any node can answer, so check the record is the one we asked for
+        if (to && record.to == *to && _is_valid(record) &&
+            from_hex(key::PublicKey::from_string(record.public_key)
+                         .fingerprint()) == target &&
+            (!result.record ||
+             record.timestamp_ms > result.record->timestamp_ms)) {
+          result.record = record;
+        }
+      }
+      for (const auto &contact : responses[i]->contacts) {
+        if (const auto id = from_hex(contact.id)) {
+          learned.push_back(
+              Contact{*id, socket::SocketAddress(contact.ip, contact.port)});
+        }
+      }
+    }
+    if (result.record) {
+      return result;
+    }
+    for (const auto &contact : learned) {
+      add(contact);
+    }
+  }
+
+  for (const auto &candidate : shortlist) {
+    if (candidate.answered && result.closest.size() < _options.k) {
+      result.closest.push_back(candidate.contact);
+    }
+  }
+  return result;
+}
+
+std::vector<boost::optional<message::DhtResponse>> Node::_call(
+    const std::vector<std::pair<socket::SocketAddress, message::DhtQuery>>
+        &queries) {
+  {
+    std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+    for (const auto &query : queries) {
+      _pending.emplace(query.second.rpc_id,
+                       PendingRpc{query.first, boost::none});
+    }
+  }
+  for (const auto &query : queries) {
+    _send(query.first,
+          encode(Message<message::DhtQuery>(query.second).format()));
+  }
+
+  const auto deadline = std::chrono::steady_clock::now() +
+                        std::chrono::milliseconds(_options.rpc_timeout_ms);
+  std::unique_lock<metrics::InstrumentedMutex> lock(_mutex);
+  _cv.wait_until(lock, deadline, [&]() {
+    return std::all_of(queries.begin(), queries.end(), [&](const auto &query) {
+      return static_cast<bool>(_pending.at(query.second.rpc_id).response);
+    });
+  });
+  std::vector<boost::optional<message::DhtResponse>> responses;
+  for (const auto &query : queries) {
+    const auto it = _pending.find(query.second.rpc_id);
+    responses.push_back(it->second.response);
+    _pending.erase(it);
+    if (!responses.back()) {
+      LOG(level::Debug) << "DHT node " << query.first << " did not answer";
+      // we don't know its id if it was a bootstrap ping
+      for (const auto &contact : _table.closest(_id, _table.size())) {
+        if (contact.address == query.first) {
+          _table.remove(contact.id);
+        }
+      }
+    }
+  }
+  return responses;
+}
+
+message::DhtQuery Node::_query(const std::string &kind) {
+  std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+  return message::DhtQuery{kVersion,    _next_rpc_id++, to_hex(_id),
+                           kind,        boost::none,    boost::none,
+                           boost::none};
+}
+
+void Node::_receive_loop() {
+  char buffer[kMaxDatagramSize];
+  while (true) {
+    struct pollfd fds[2] = {{_sockfd, POLLIN, 0}, {_wake_fds[0], POLLIN, 0}};
+    if (poll(fds, 2, -1) <= 0) {
+      continue;
+    }
+    if (fds[1].revents != 0) {
+      return;
+    }
+    struct sockaddr_in sender;
+    socklen_t sender_length = sizeof(sender);
+    const auto size = recvfrom(_sockfd, buffer, sizeof(buffer), 0,
+                               (struct sockaddr *)&sender, &sender_length);
+    if (size <= 0) {
+      continue;
+    }
+    _on_datagram(std::string(buffer, size),
+                 socket::SocketAddress(socket::ip_of(sender),
+                                       ntohs(sender.sin_port)));
+  }
+}
+
+void Node::_on_datagram(const std::string &raw_message,
+                        const socket::SocketAddress &sender) {
+  try {
+    const auto type = message::decode_message_type(raw_message);
+    if (type == message::kTypeDhtQuery) {
+      const auto query =
+          message::decode<message::DhtQuery>(raw_message).payload;
+      if (query.version != kVersion) {
+        return;
+      }
+      const auto response = _answer(query, sender);
+      _send(sender, encode(Message<message::DhtResponse>(response).format()));
+    } else if (type == message::kTypeDhtResponse) {
+      const auto response =
+          message::decode<message::DhtResponse>(raw_message).payload;
+      const auto id = from_hex(response.sender_id);
+      std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+      const auto it = _pending.find(response.rpc_id);
+      // ignore late responses, and responses from nodes we didn't ask
+      if (!id || it == _pending.end() || !(it->second.address == sender)) {
+        return;
+      }
+      _table.update(Contact{*id, sender});
+      _observed_ip = response.observed_ip;
+      it->second.response = response;
+      _cv.notify_all();
+    }
+  } catch (const message::MessageException &e) {
+    LOG(level::Debug) << "Ignoring invalid DHT message from " << sender;
+  }
+}
+
+message::DhtResponse Node::_answer(const message::DhtQuery &query,
+                                   const socket::SocketAddress &sender) {
+  message::DhtResponse response{query.rpc_id, to_hex(_id), sender.ip(), {},
+                                {}};
+  const auto record_valid = query.record && _is_valid(*query.record);
+  std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+  if (const auto id = from_hex(query.sender_id)) {
+    _table.update(Contact{*id, sender});
+  }
+
+  if (query.kind == message::kDhtStore && record_valid) {
+    const auto fingerprint =
+        key::PublicKey::from_string(query.record->public_key).fingerprint();
+    const auto key = std::make_pair(fingerprint, query.record->to);
+    if (_records.size() >= _options.max_records && !_records.count(key)) {
+      for (auto it = _records.begin(); it != _records.end();) {
+        it = _is_fresh(it->second) ? std::next(it) : _records.erase(it);
+      }
+    }
+    const auto it = _records.find(key);
+    if (it != _records.end() &&
+        it->second.timestamp_ms < query.record->timestamp_ms) {
+      it->second = *query.record;
+    } else if (it == _records.end() &&
+               _records.size() < _options.max_records) {
+      _records.emplace(key, *query.record);
+    }
+  } else if (query.kind == message::kDhtStore) {
+    LOG(level::Warning) << "Ignoring invalid DHT record from " << sender;
+  }
+
+  if (!query.target) {
+    return response;
+  }
+  if (query.kind == message::kDhtFindValue && query.to) {
+    const auto it = _records.find(std::make_pair(*query.target, *query.to));
+    if (it != _records.end() && _is_fresh(it->second)) {
+      response.records.push_back(it->second);
+      return response;
+    }
+  }
+  if (const auto target = from_hex(*query.target)) {
+    for (const auto &contact : _table.closest(*target, _options.k)) {
+      response.contacts.push_back(to_message(contact));
+    }
+  }
+  return response;
+}
+
+void Node::_send(const socket::SocketAddress &address,
+                 const std::string &data) {
+  struct sockaddr_in destination;
+  memset(&destination, 0, sizeof(destination));
+  destination.sin_family = AF_INET;
+  destination.sin_port = htons(address.port());
+  if (inet_pton(AF_INET, address.ip().c_str(), &destination.sin_addr) != 1 ||
+      sendto(_sockfd, data.data(), data.size(), 0,
+             (const struct sockaddr *)&destination,
+             sizeof(destination)) == -1) {
+    LOG(level::Warning) << "Failed to send DHT message to " << address << ": "
+                        << strerror(errno);
+  }
+}
+
+bool Node::_is_fresh(const message::DhtRecord &record) const {
+  const auto now = socket::now_ms();
+  const auto age_ms = std::max(now, record.timestamp_ms) -
+                      std::min(now, record.timestamp_ms);
+  return age_ms <= _options.record_ttl_ms;
+}
+
+bool Node::_is_valid(const message::DhtRecord &record) const {
+  if (!_is_fresh(record)) {
+    return false;
+  }
+  try {
+    return key::PublicKey::from_string(record.public_key)
+        .verify(signed_fields(record), record.signature);
+  } catch (const std::exception &e) {
+    return false;
+  }
+}
+}
+}
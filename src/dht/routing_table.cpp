@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <boost/algorithm/hex.hpp>
+#include <iterator>
+#include <p2psc/dht/routing_table.h>
+
+namespace p2psc {
+namespace dht {
+
+std::string to_hex(const NodeId &id) {
+  std::string hex;
+  boost::algorithm::hex_lower(id.begin(), id.end(), std::back_inserter(hex));
+  return hex;
+}
+
+boost::optional<NodeId> from_hex(const std::string &hex) {
+  if (hex.size() != 2 * std::tuple_size<NodeId>::value) {
+    return boost::none;
+  }
+  NodeId id;
+  try {
+    boost::algorithm::unhex(hex.begin(), hex.end(), id.begin());
+  } catch (const boost::algorithm::hex_decode_error &e) {
+    return boost::none;
+  }
+  return id;
+}
+
+NodeId xor_distance(const NodeId &a, const NodeId &b) {
+  NodeId distance;
+  for (std::size_t i = 0; i < distance.size(); i++) {
+    distance[i] = a[i] ^ b[i];
+  }
+  return distance;
+}
+
+std::size_t shared_prefix_length(const NodeId &a, const NodeId &b) {
+  for (std::size_t i = 0; i < a.size(); i++) {
+    const std::uint8_t difference = a[i] ^ b[i];
+    if (difference != 0) {
+      std::size_t length = 8 * i;
+      for (auto bit = 0x80; (difference & bit) == 0; bit >>= 1) {
+        length++;
+      }
+      return length;
+    }
+  }
+  return 8 * a.size();
+}
+
+RoutingTable::RoutingTable(const NodeId &self, std::size_t k)
+    : _self(self), _k(k) {}
+
+void RoutingTable::update(const Contact &contact) {
+  if (contact.id == _self) {
+    return;
+  }
+  auto &bucket = _buckets[shared_prefix_length(_self, contact.id)];
+  const auto it =
+      std::find_if(bucket.begin(), bucket.end(), [&](const Contact &known) {
+        return known.id == contact.id;
+      });
+  if (it != bucket.end()) {
+    bucket.erase(it);
+  } else if (bucket.size() >= _k) {
+    return;
+  }
+  bucket.push_back(contact);
+}
+
+void RoutingTable::remove(const NodeId &id) {
+  if (id == _self) {
+    return;
+  }
+  auto &bucket = _buckets[shared_prefix_length(_self, id)];
+  bucket.erase(std::remove_if(bucket.begin(), bucket.end(),
+                              [&](const Contact &known) {
+                                return known.id == id;
+                              }),
+               bucket.end());
+}
+
+std::vector<Contact> RoutingTable::closest(const NodeId &target,
+                                           std::size_t count) const {
+  std::vector<Contact> contacts;
+  for (const auto &bucket : _buckets) {
+    contacts.insert(contacts.end(), bucket.begin(), bucket.end());
+  }
+  const auto closer = [&](const Contact &a, const Contact &b) {
+    return xor_distance(a.id, target) < xor_distance(b.id, target);
+  };
+  if (contacts.size() > count) {
+    std::partial_sort(contacts.begin(), contacts.begin() + count,
+                      contacts.end(), closer);
+    contacts.erase(contacts.begin() + count, contacts.end());
+  } else {
+    std::sort(contacts.begin(), contacts.end(), closer);
+  }
+  return contacts;
+}
+
+std::size_t RoutingTable::size() const {
+  std::size_t size = 0;
+  for (const auto &bucket : _buckets) {
+    size += bucket.size();
+  }
+  return size;
+}
+}
+}
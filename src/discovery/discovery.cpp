@@ -0,0 +1,40 @@
+#include <arpa/inet.h>
+#include <mutex>
+#include <p2psc/discovery/discovery.h>
+#include <p2psc/discovery/discovery_exception.h>
+
+namespace p2psc {
+namespace discovery {
+namespace {
+
+std::mutex &discovery_mutex() {
+  static std::mutex m;
+  return m;
+}
+
+Discovery &global_discovery() {
+  static Discovery discovery;
+  return discovery;
+}
+}
+
+void set_discovery(const Discovery &discovery) {
+  struct in_addr group;
+  if (inet_pton(AF_INET, discovery.group.c_str(), &group) != 1 ||
+      !IN_MULTICAST(ntohl(group.s_addr))) {
+    throw DiscoveryException("Not an IPv4 multicast group: " +
+                             discovery.group);
+  }
+  if (discovery.announce_interval_ms == 0) {
+    throw DiscoveryException("announce_interval_ms must be positive");
+  }
+  std::lock_guard<std::mutex> guard(discovery_mutex());
+  global_discovery() = discovery;
+}
+
+Discovery get_discovery() {
+  std::lock_guard<std::mutex> guard(discovery_mutex());
+  return global_discovery();
+}
+}
+}
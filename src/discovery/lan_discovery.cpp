@@ -0,0 +1,195 @@
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstring>
+#include <discovery/lan_discovery.h>
+#include <p2psc/log.h>
+#include <p2psc/message/lan_announcement.h>
+#include <p2psc/message/message.h>
+#include <p2psc/message/message_decoder.h>
+#include <p2psc/message/message_exception.h>
+#include <p2psc/socket/socket_exception.h>
+#include <poll.h>
+#include <socket/socket_util.h>
+#include <unistd.h>
+
+namespace p2psc {
+namespace discovery {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const std::size_t kMaxDatagramSize = 4096;
+
+// what the signature covers
+std::string signed_fields(const message::LanAnnouncement &announcement) {
+  return std::to_string(announcement.version) + "|" + announcement.from +
+         "|" + announcement.to + "|" + std::to_string(announcement.port) +
+         "|" + std::to_string(announcement.timestamp_ms);
+}
+
+[[noreturn]] void throw_socket_error(const std::string &what, int fd) {
+  const auto error = errno;
+  if (fd != -1) {
+    ::close(fd);
+  }
+  throw socket::SocketException(what + ". Reason: " + strerror(error));
+}
+
+int create_multicast_socket(const struct sockaddr_in &group) {
+  const auto fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (fd == -1) {
+    throw_socket_error("Failed to create discovery socket", fd);
+  }
+  // every connection in the process, and other processes on the host, listen
+  // on the same port
+  const int enable = 1;
+  if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) != 0) {
+    throw_socket_error("Failed to set SO_REUSEADDR", fd);
+  }
+  // binding to the group rather than INADDR_ANY keeps out unicast datagrams
+  // and other groups' traffic on the port
+  if (bind(fd, (const struct sockaddr *)&group, sizeof(group)) != 0) {
+    throw_socket_error("Failed to bind discovery socket", fd);
+  }
+  struct ip_mreq membership;
+  membership.imr_multiaddr = group.sin_addr;
+  membership.imr_interface.s_addr = htonl(INADDR_ANY);
+  if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership,
+                 sizeof(membership)) != 0) {
+    throw_socket_error("Failed to join discovery group", fd);
+  }
+  return fd;
+}
+
+int remaining_ms(Clock::time_point deadline) {
+  const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+      deadline - Clock::now());
+  return std::max<int>(0, remaining.count());
+}
+}
+
+LanDiscovery::LanDiscovery(const key::Keypair &our_keypair, const Peer &peer,
+                           const Discovery &options)
+    : _peer(peer), _options(options),
+      _our_fingerprint(
+          key::PublicKey::from_string(our_keypair.get_serialised_public_key())
+              .fingerprint()),
+      _their_fingerprint(peer.public_key.fingerprint()),
+      _is_client(_our_fingerprint > _their_fingerprint), _listening_fd(-1) {
+  memset(&_group, 0, sizeof(_group));
+  _group.sin_family = AF_INET;
+  _group.sin_port = htons(_options.port);
+  inet_pton(AF_INET, _options.group.c_str(), &_group.sin_addr);
+  _multicast_fd = create_multicast_socket(_group);
+  if (!_is_client) {
+    try {
+      _listening_fd = socket::create_listening_socket();
+    } catch (const socket::SocketException &e) {
+      ::close(_multicast_fd);
+      throw;
+    }
+  }
+
+  message::LanAnnouncement announcement{
+      kVersion, _our_fingerprint, _their_fingerprint,
+      static_cast<std::uint16_t>(_is_client ? 0
+                                            : socket::port_of(_listening_fd)),
+      socket::now_ms(), ""};
+  announcement.signature = our_keypair.sign(signed_fields(announcement));
+  _announcement =
+      encode(Message<message::LanAnnouncement>(announcement).format());
+}
+
+LanDiscovery::~LanDiscovery() {
+  ::close(_multicast_fd);
+  if (_listening_fd != -1) {
+    ::close(_listening_fd);
+  }
+}
+
+boost::optional<socket::SocketAddress> LanDiscovery::find() {
+  const auto deadline =
+      Clock::now() + std::chrono::milliseconds(_options.timeout_ms);
+  const auto interval =
+      std::chrono::milliseconds(_options.announce_interval_ms);
+  auto next_announcement = Clock::now();
+  while (Clock::now() < deadline) {
+    if (Clock::now() >= next_announcement) {
+      _announce();
+      next_announcement += interval;
+    }
+    struct pollfd fd = {_multicast_fd, POLLIN, 0};
+    if (poll(&fd, 1,
+             remaining_ms(std::min(deadline, next_announcement))) != 1) {
+      continue;
+    }
+    char buffer[kMaxDatagramSize];
+    struct sockaddr_in sender;
+    socklen_t sender_length = sizeof(sender);
+    const auto size = recvfrom(_multicast_fd, buffer, sizeof(buffer), 0,
+                               (struct sockaddr *)&sender, &sender_length);
+    if (size <= 0) {
+      continue;
+    }
+    if (const auto address =
+            _on_datagram(std::string(buffer, size), sender)) {
+      // the peer may have started after our last announcement
+      _announce();
+      return address;
+    }
+  }
+  return boost::none;
+}
+
+int LanDiscovery::accept() {
+  BOOST_ASSERT(!_is_client);
+  struct pollfd fd = {_listening_fd, POLLIN, 0};
+  if (poll(&fd, 1, _options.timeout_ms) != 1) {
+    return -1;
+  }
+  return ::accept4(_listening_fd, nullptr, nullptr, SOCK_CLOEXEC);
+}
+
+void LanDiscovery::_announce() {
+  if (sendto(_multicast_fd, _announcement.data(), _announcement.size(), 0,
+             (const struct sockaddr *)&_group, sizeof(_group)) == -1) {
+    LOG(level::Warning) << "Failed to send LAN announcement: "
+                        << strerror(errno);
+  }
+}
+
+boost::optional<socket::SocketAddress>
+LanDiscovery::_on_datagram(const std::string &raw_message,
+                           const struct sockaddr_in &sender) {
+  message::LanAnnouncement announcement;
+  try {
+    if (message::decode_message_type(raw_message) !=
+        message::kTypeLanAnnouncement) {
+      return boost::none;
+    }
+    announcement = message::decode<message::LanAnnouncement>(raw_message)
+                       .payload;
+  } catch (const message::MessageException &e) {
+    return boost::none;
+  }
+  // most announcements are our own, or for other peers
+  if (announcement.from != _their_fingerprint ||
+      announcement.to != _our_fingerprint) {
+    return boost::none;
+  }
+  const auto skew_ms = std::max(socket::now_ms(), announcement.timestamp_ms) -
+                       std::min(socket::now_ms(), announcement.timestamp_ms);
+  if (announcement.version != kVersion ||
+      skew_ms > _options.max_clock_skew_ms ||
+      !_peer.public_key.verify(signed_fields(announcement),
+                               announcement.signature) ||
+      (!_is_client && announcement.port != 0) ||
+      (_is_client && announcement.port == 0)) {
+    LOG(level::Warning) << "Ignoring invalid LAN announcement from "
+                        << socket::ip_of(sender);
+    return boost::none;
+  }
+  return socket::SocketAddress(socket::ip_of(sender), announcement.port);
+}
+}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <boost/optional.hpp>
+#include <netinet/in.h>
+#include <p2psc/discovery/discovery.h>
+#include <p2psc/key/keypair.h>
+#include <p2psc/peer.h>
+#include <p2psc/socket/socket_address.h>
+
+namespace p2psc {
+namespace discovery {
+
+/*
+ * One attempt to find peer on the LAN (see discovery.h). Throws
+ * SocketException if the multicast socket (or, if we're to accept the
+ * connection, the listening socket) can't be set up.
+ */
+class LanDiscovery {
+public:
+  LanDiscovery(const key::Keypair &our_keypair, const Peer &peer,
+               const Discovery &options);
+  ~LanDiscovery();
+
+  /*
+   * Announce ourselves until peer's announcement arrives, for up to
+   * timeout_ms. Returns the address peer announced from, and, if it
+   * accepts the connection, the port it accepts it on.
+   */
+  boost::optional<socket::SocketAddress> find();
+  // whether we connect to peer, rather than accept its connection
+  bool is_client() const { return _is_client; }
+  // The file descriptor of peer's connection, or -1 if it doesn't arrive
+  // within timeout_ms.
+  int accept();
+
+private:
+  LanDiscovery(const LanDiscovery &) = delete;
+  LanDiscovery &operator=(const LanDiscovery &) = delete;
+
+  void _announce();
+  // The address in raw_message, if it's a valid announcement from peer to
+  // us.
+  boost::optional<socket::SocketAddress>
+  _on_datagram(const std::string &raw_message,
+               const struct sockaddr_in &sender);
+
+  const Peer _peer;
+  const Discovery _options;
+  const std::string _our_fingerprint;
+  const std::string _their_fingerprint;
+  const bool _is_client;
+  int _multicast_fd;
+  int _listening_fd;
+  struct sockaddr_in _group;
+  // signed once, and sent as is every announce_interval_ms
+  std::string _announcement;
+};
+}
+}
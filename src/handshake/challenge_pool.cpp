@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <boost/optional.hpp>
+#include <cstring>
+#include <mutex>
+#include <p2psc/crypto/crypto_exception.h>
+#include <p2psc/handshake/challenge_pool.h>
+#include <p2psc/log.h>
+#include <pthread.h>
+#include <sched.h>
+
+namespace p2psc {
+namespace handshake {
+namespace {
+
+std::mutex &pool_mutex() {
+  static std::mutex m;
+  return m;
+}
+
+std::shared_ptr<ChallengePool> &global_pool() {
+  static std::shared_ptr<ChallengePool> pool;
+  return pool;
+}
+
+// Precomputing is only worth it with CPU time nothing else wants.
+void run_at_idle_priority() {
+  struct sched_param param;
+  memset(&param, 0, sizeof(param));
+  const auto error =
+      pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+  if (error != 0) {
+    LOG(level::Debug) << "Could not run challenge pool at idle priority: "
+                      << strerror(error);
+  }
+}
+}
+
+ChallengePool::ChallengePool(const ChallengePoolOptions &options,
+                             const NonceGenerator &nonce_generator)
+    : _options(options), _nonce_generator(nonce_generator),
+      _mutex("handshake::ChallengePool"), _stopping(false), _clock(0),
+      _refiller(&ChallengePool::_refill_loop, this) {}
+
+ChallengePool::~ChallengePool() {
+  {
+    std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+    _stopping = true;
+  }
+  _cv.notify_all();
+  _refiller.join();
+}
+
+Challenge ChallengePool::take(const key::PublicKey &public_key) {
+  return _take(public_key.serialise(), &public_key);
+}
+
+Challenge ChallengePool::take(const std::string &serialised_public_key) {
+  return _take(serialised_public_key, nullptr);
+}
+
+ChallengePoolStats ChallengePool::stats() {
+  std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+  auto stats = _stats;
+  stats.keys = _keys.size();
+  return stats;
+}
+
+Challenge ChallengePool::_take(const std::string &serialised,
+                               const key::PublicKey *public_key) {
+  std::unique_lock<metrics::InstrumentedMutex> lock(_mutex);
+  auto it = _keys.find(serialised);
+  if (it == _keys.end()) {
+    // parsing is as slow as the encryption, so not under the lock
+    lock.unlock();
+    const auto parsed =
+        public_key ? *public_key : key::PublicKey::from_string(serialised);
+    lock.lock();
+    it = _keys.emplace(serialised, std::make_unique<Key>(parsed)).first;
+  }
+  auto &key = *it->second;
+  key.uses++;
+  key.last_used = ++_clock;
+  _evict();
+
+  if (!key.ready.empty()) {
+    auto challenge = std::move(key.ready.back());
+    key.ready.pop_back();
+    _stats.hits++;
+    _stats.ready--;
+    _cv.notify_one();
+    return challenge;
+  }
+  _stats.misses++;
+  if (key.uses >= _options.hot_after) {
+    _cv.notify_one();
+  }
+  const auto key_to_encrypt_with = key.public_key;
+  lock.unlock();
+  return _compute(key_to_encrypt_with);
+}
+
+Challenge ChallengePool::_compute(const key::PublicKey &public_key) {
+  auto nonce = _nonce_generator();
+  auto encrypted_nonce = public_key.encrypt(nonce);
+  return Challenge{std::move(nonce), std::move(encrypted_nonce)};
+}
+
+void ChallengePool::_refill_loop() {
+  run_at_idle_priority();
+  std::unique_lock<metrics::InstrumentedMutex> lock(_mutex);
+  while (!_stopping) {
+    const auto it = _key_to_refill();
+    if (it == _keys.end()) {
+      _cv.wait(lock);
+      continue;
+    }
+    const auto serialised = it->first;
+    const auto public_key = it->second->public_key;
+    lock.unlock();
+    boost::optional<Challenge> challenge;
+    try {
+      challenge = _compute(public_key);
+    } catch (const crypto::CryptoException &e) {
+      LOG(level::Warning) << "Failed to precompute a challenge: " << e.what();
+    }
+    lock.lock();
+    // the key may have been dropped meanwhile
+    const auto key = _keys.find(serialised);
+    if (!challenge) {
+      if (key != _keys.end()) {
+        key->second->uses = 0;
+      }
+    } else if (key != _keys.end() &&
+               key->second->ready.size() < _options.challenges_per_key) {
+      key->second->ready.push_back(std::move(*challenge));
+      _stats.ready++;
+    }
+  }
+}
+
+std::map<std::string, std::unique_ptr<ChallengePool::Key>>::iterator
+ChallengePool::_key_to_refill() {
+  auto chosen = _keys.end();
+  for (auto it = _keys.begin(); it != _keys.end(); ++it) {
+    const auto &key = *it->second;
+    if (key.uses >= _options.hot_after &&
+        key.ready.size() < _options.challenges_per_key &&
+        (chosen == _keys.end() ||
+         key.ready.size() < chosen->second->ready.size())) {
+      chosen = it;
+    }
+  }
+  return chosen;
+}
+
+void ChallengePool::_evict() {
+  while (_keys.size() > std::max<std::size_t>(_options.max_keys, 1)) {
+    const auto oldest = std::min_element(
+        _keys.begin(), _keys.end(), [](const auto &a, const auto &b) {
+          return a.second->last_used < b.second->last_used;
+        });
+    _stats.ready -= oldest->second->ready.size();
+    _keys.erase(oldest);
+  }
+}
+
+void set_challenge_pool(std::shared_ptr<ChallengePool> pool) {
+  std::lock_guard<std::mutex> guard(pool_mutex());
+  global_pool() = pool;
+}
+
+std::shared_ptr<ChallengePool> get_challenge_pool() {
+  std::lock_guard<std::mutex> guard(pool_mutex());
+  return global_pool();
+}
+
+Challenge make_challenge(const key::PublicKey &public_key,
+                         const std::shared_ptr<ChallengePool> &pool,
+                         const NonceGenerator &nonce_generator) {
+  if (pool) {
+    return pool->take(public_key);
+  }
+  auto nonce = nonce_generator();
+  auto encrypted_nonce = public_key.encrypt(nonce);
+  return Challenge{std::move(nonce), std::move(encrypted_nonce)};
+}
+}
+}
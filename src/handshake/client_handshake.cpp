@@ -0,0 +1,127 @@
+#include <base64/base64.h>
+#include <crypto/aes_gcm.h>
+#include <p2psc/crypto/crypto_exception.h>
+#include <p2psc/handshake/client_handshake.h>
+#include <p2psc/message/peer_acknowledgement.h>
+#include <p2psc/message/peer_challenge.h>
+#include <p2psc/message/peer_challenge_response.h>
+#include <p2psc/message/peer_response.h>
+
+namespace p2psc {
+namespace handshake {
+
+ClientHandshake::ClientHandshake(const key::Keypair &our_keypair,
+                                 const PunchedPeer &punched_peer,
+                                 const NonceGenerator &nonce_generator,
+                                 const Extensions &extensions)
+    : _our_keypair(our_keypair), _punched_peer(punched_peer),
+      _nonce_generator(nonce_generator), _extensions(extensions),
+      _state(kStateIdle) {}
+
+void ClientHandshake::start() {
+  BOOST_ASSERT(_state == kStateIdle);
+  // send peer challenge
+  auto challenge = make_challenge(_punched_peer.peer.public_key,
+                                  _extensions.challenge_pool,
+                                  _nonce_generator);
+  _nonce = challenge.nonce;
+  auto peer_challenge = message::PeerChallenge{challenge.encrypted_nonce};
+  if (_extensions.compression.enabled) {
+    peer_challenge.compression = compression::kAlgorithmZstd;
+    peer_challenge.compression_dictionary =
+        compression::dictionary_id(_extensions.compression.dictionary);
+  }
+  peer_challenge.host_id = _extensions.host_id;
+  const auto &request = _extensions.early_data.request;
+  if (request && request->size() <= kMaxEarlyDataSize) {
+    _early_data_secret = crypto::generate_secret();
+    peer_challenge.early_data_secret =
+        _punched_peer.peer.public_key.encrypt(*_early_data_secret);
+  }
+  _emit_message(peer_challenge);
+  _state = kStateChallenged;
+}
+
+void ClientHandshake::on_message(const std::string &raw_message) {
+  if (_state == kStateChallenged) {
+    // receive peer challenge response
+    const auto peer_challenge_response =
+        _decode<message::PeerChallengeResponse>(raw_message);
+    if (peer_challenge_response.decrypted_nonce != _nonce) {
+      throw std::runtime_error(
+          "PeerChallengeResponse: peer did not pass verification");
+    }
+    std::string decrypted_peer_nonce;
+    try {
+      decrypted_peer_nonce = _our_keypair.private_decrypt(
+          peer_challenge_response.encrypted_nonce);
+    } catch (crypto::CryptoException &e) {
+      throw std::runtime_error(
+          "PeerChallengeResponse: Could not decrypt encrypted_nonce");
+    }
+
+    _negotiated_compression = compression::negotiate(
+        _extensions.compression, peer_challenge_response.compression,
+        peer_challenge_response.compression_dictionary);
+    // the Peer only offers one if we're on the same host
+    if (_extensions.host_id) {
+      _local_socket = peer_challenge_response.local_socket;
+    }
+
+    // send peer response, with our early request if the Peer accepts it
+    auto peer_response = message::PeerResponse{decrypted_peer_nonce};
+    if (_early_data_secret && peer_challenge_response.early_data_secret) {
+      std::string peer_secret;
+      try {
+        peer_secret = _our_keypair.private_decrypt(
+            *peer_challenge_response.early_data_secret);
+      } catch (crypto::CryptoException &e) {
+        throw std::runtime_error(
+            "PeerChallengeResponse: Could not decrypt early_data_secret");
+      }
+      _early_data_key =
+          early_data_key(*_early_data_secret, peer_secret, _nonce,
+                         decrypted_peer_nonce);
+      const auto sealed = crypto::seal(
+          *_early_data_key, *_extensions.early_data.request, "request");
+      peer_response.early_data = base64_encode(
+          reinterpret_cast<const unsigned char *>(sealed.data()),
+          sealed.size());
+    }
+    _emit_message(peer_response);
+    _state = kStateResponded;
+  } else if (_state == kStateResponded) {
+    // receive peer acknowledgement
+    const auto peer_acknowledgement =
+        _decode<message::PeerAcknowledgement>(raw_message);
+    if (_local_socket) {
+      if (!peer_acknowledgement.local_socket_token) {
+        throw std::runtime_error(
+            "PeerAcknowledgement: Peer did not send local_socket_token");
+      }
+      _local_socket_token = peer_acknowledgement.local_socket_token;
+    }
+    if (_early_data_key) {
+      if (!peer_acknowledgement.early_data) {
+        throw std::runtime_error(
+            "PeerAcknowledgement: Peer did not reply to early data");
+      }
+      try {
+        _early_data_reply =
+            crypto::open(*_early_data_key,
+                         base64_decode(*peer_acknowledgement.early_data),
+                         "reply");
+      } catch (crypto::CryptoException &e) {
+        throw std::runtime_error(
+            "PeerAcknowledgement: Could not decrypt early_data");
+      }
+    }
+    _state = kStateDone;
+  } else {
+    throw std::runtime_error("Unexpected message from Peer: " +
+                             message::message_type_string(
+                                 message::decode_message_type(raw_message)));
+  }
+}
+}
+}
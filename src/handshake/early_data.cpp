@@ -0,0 +1,39 @@
+#include <openssl/sha.h>
+#include <p2psc/handshake/early_data.h>
+
+namespace p2psc {
+namespace handshake {
+namespace {
+
+thread_local boost::optional<std::string> last_reply;
+
+// length-prefixed, so that no two sets of inputs hash the same bytes
+void append_field(std::string &data, const std::string &field) {
+  data += std::to_string(field.size()) + ":" + field;
+}
+}
+
+const boost::optional<std::string> &last_early_data_reply() {
+  return last_reply;
+}
+
+void set_last_early_data_reply(const boost::optional<std::string> &reply) {
+  last_reply = reply;
+}
+
+std::string early_data_key(const std::string &client_secret,
+                           const std::string &peer_secret,
+                           const std::string &client_nonce,
+                           const std::string &peer_nonce) {
+  std::string data = "p2psc early data";
+  append_field(data, client_secret);
+  append_field(data, peer_secret);
+  append_field(data, client_nonce);
+  append_field(data, peer_nonce);
+  unsigned char digest[SHA256_DIGEST_LENGTH];
+  SHA256(reinterpret_cast<const unsigned char *>(data.data()), data.size(),
+         digest);
+  return std::string(digest, digest + sizeof(digest));
+}
+}
+}
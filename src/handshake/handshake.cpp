@@ -0,0 +1,238 @@
+#include <p2psc/connection_exception.h>
+#include <p2psc/handshake/handshake.h>
+#include <p2psc/log.h>
+#include <p2psc/socket/socket_exception.h>
+
+namespace p2psc {
+namespace handshake {
+namespace {
+const auto initial_backoff = std::chrono::milliseconds(10);
+}
+
+constexpr std::chrono::milliseconds Handshake::introduced_accept_timeout;
+
+Handshake::Handshake(const key::Keypair &our_keypair, const Peer &peer,
+                     const Mediator &mediator,
+                     const NonceGenerator &nonce_generator,
+                     const Extensions &extensions)
+    : _our_keypair(our_keypair), _peer(peer), _mediator(mediator),
+      _nonce_generator(nonce_generator), _extensions(extensions),
+      _state(kStateIdle),
+      _role(kRoleUndecided), _mediator_handshake(our_keypair, peer),
+      _attempts(0), _backoff(initial_backoff), _listening_port(0),
+      _accept_timeout(0) {}
+
+void Handshake::start() {
+  BOOST_ASSERT(_state == kStateIdle);
+  LOG(level::Info) << "Connecting to Mediator (on " << _mediator.socket_address
+                   << ")";
+  _emit(Action::connect(_mediator.socket_address));
+  _state = kStateConnectingToMediator;
+}
+
+void Handshake::start_as_client(const PunchedPeer &punched_peer) {
+  BOOST_ASSERT(_state == kStateIdle);
+  LOG(level::Info) << "Attempting connection as Client (to "
+                   << punched_peer.address << ")";
+  _role = kRoleClient;
+  _client_handshake = std::make_unique<ClientHandshake>(
+      _our_keypair, punched_peer, _nonce_generator, _extensions);
+  _client_handshake->start();
+  _forward(*_client_handshake);
+  _state = kStatePeer;
+}
+
+void Handshake::start_as_peer() {
+  BOOST_ASSERT(_state == kStateIdle);
+  LOG(level::Info) << "Attempting connection as Peer";
+  _role = kRolePeer;
+  _peer_handshake = std::make_unique<PeerHandshake>(
+      _our_keypair, _peer, _nonce_generator, _extensions);
+  _state = kStatePeer;
+}
+
+void Handshake::start_at(const Rendezvous &rendezvous) {
+  BOOST_ASSERT(_state == kStateIdle);
+  if (rendezvous.connect) {
+    _connect_to_peer(PunchedPeer(_peer, rendezvous.address, kVersion));
+  } else {
+    _listen_for_client(rendezvous.address.port(), introduced_accept_timeout);
+  }
+}
+
+void Handshake::on_connected() {
+  switch (_state) {
+  case kStateConnectingToMediator:
+    _mediator_handshake.start();
+    _forward(_mediator_handshake);
+    _state = kStateMediator;
+    break;
+  case kStateConnectingToPeer:
+    _client_handshake->start();
+    _forward(*_client_handshake);
+    _state = kStatePeer;
+    break;
+  case kStateListening:
+    _state = kStatePeer;
+    break;
+  default:
+    BOOST_ASSERT_MSG(false, "on_connected without a pending connection");
+  }
+}
+
+void Handshake::on_message(const std::string &raw_message) {
+  if (_state == kStateMediator) {
+    _mediator_handshake.on_message(raw_message);
+    _forward(_mediator_handshake);
+    if (_mediator_handshake.is_done()) {
+      _on_mediator_done();
+    }
+  } else if (_state == kStatePeer && _client_handshake) {
+    _client_handshake->on_message(raw_message);
+    _forward(*_client_handshake);
+  } else if (_state == kStatePeer && _peer_handshake) {
+    _peer_handshake->on_message(raw_message);
+    _forward(*_peer_handshake);
+  } else {
+    throw std::runtime_error("Unexpected message: " + raw_message);
+  }
+}
+
+void Handshake::on_socket_error(const std::string &reason) {
+  switch (_state) {
+  case kStateConnectingToMediator:
+  case kStateMediator:
+    throw ConnectionException(error::kErrorMediatorConnectFailure, reason);
+  case kStateConnectingToPeer:
+    // it's possible that the Peer hasn't had time to create its listening
+    // socket yet, so if the connection fails we retry.
+    _retry_after_backoff(max_connect_attempts, kStateWaitingToConnect,
+                         reason);
+    break;
+  default:
+    throw socket::SocketException(reason);
+  }
+}
+
+void Handshake::on_listen_failed(const std::string &reason) {
+  BOOST_ASSERT(_state == kStateListening);
+  // our end of the Mediator connection holds on to the port until the
+  // Mediator has closed its end too.
+  _retry_after_backoff(max_listen_attempts, kStateWaitingToListen, reason);
+}
+
+void Handshake::on_timer() {
+  if (_state == kStateWaitingToConnect) {
+    _emit(Action::connect(_client_handshake->punched_peer().address));
+    _state = kStateConnectingToPeer;
+  } else if (_state == kStateWaitingToListen) {
+    _emit(Action::listen(_listening_port, _accept_timeout));
+    _state = kStateListening;
+  }
+}
+
+bool Handshake::is_done() const {
+  return (_client_handshake && _client_handshake->is_done()) ||
+         (_peer_handshake && _peer_handshake->is_done());
+}
+
+boost::optional<compression::Compression>
+Handshake::negotiated_compression() const {
+  if (_client_handshake) {
+    return _client_handshake->negotiated_compression();
+  } else if (_peer_handshake) {
+    return _peer_handshake->negotiated_compression();
+  }
+  return boost::none;
+}
+
+boost::optional<std::string> Handshake::local_socket() const {
+  if (_client_handshake) {
+    return _client_handshake->local_socket();
+  } else if (_peer_handshake) {
+    return _peer_handshake->local_socket();
+  }
+  return boost::none;
+}
+
+boost::optional<std::string> Handshake::local_socket_token() const {
+  if (_client_handshake) {
+    return _client_handshake->local_socket_token();
+  }
+  return boost::none;
+}
+
+boost::optional<std::string> Handshake::early_data_reply() const {
+  if (_client_handshake) {
+    return _client_handshake->early_data_reply();
+  }
+  return boost::none;
+}
+
+void Handshake::_on_mediator_done() {
+  _emit(Action::close_mediator_connection());
+  if (_mediator_handshake.has_punched_peer()) {
+    const auto punched_peer = _mediator_handshake.get_punched_peer();
+    if (punched_peer.version != kVersion) {
+      LOG(level::Error) << "Peer has incompatible protocol version "
+                        << punched_peer.version << ". Require " << kVersion;
+      throw ConnectionException(error::kErrorPeerUnsupportedProtocolVersion,
+                                "Peer has incompatible protocol version " +
+                                    std::to_string(punched_peer.version) +
+                                    ". Require " + std::to_string(kVersion));
+    }
+    _connect_to_peer(punched_peer);
+  } else {
+    _listen_for_client(_mediator_handshake.get_peer_disconnect().port,
+                       std::chrono::milliseconds(0));
+  }
+}
+
+void Handshake::_connect_to_peer(const PunchedPeer &punched_peer) {
+  LOG(level::Info) << "Attempting connection as Client (to "
+                   << punched_peer.address << ")";
+  _role = kRoleClient;
+  _client_handshake = std::make_unique<ClientHandshake>(
+      _our_keypair, punched_peer, _nonce_generator, _extensions);
+  _emit(Action::connect(punched_peer.address));
+  _state = kStateConnectingToPeer;
+  _attempts = 1;
+}
+
+void Handshake::_listen_for_client(std::uint16_t port,
+                                   std::chrono::milliseconds timeout) {
+  LOG(level::Info) << "Attempting connection as Peer (on port " << port
+                   << ")";
+  _role = kRolePeer;
+  _peer_handshake = std::make_unique<PeerHandshake>(
+      _our_keypair, _peer, _nonce_generator, _extensions);
+  _listening_port = port;
+  _accept_timeout = timeout;
+  _emit(Action::listen(port, timeout));
+  _state = kStateListening;
+  _attempts = 1;
+}
+
+void Handshake::_retry_after_backoff(int max_attempts, State waiting_state,
+                                     const std::string &reason) {
+  if (_attempts == max_attempts) {
+    if (waiting_state == kStateWaitingToConnect) {
+      throw socket::SocketException(reason);
+    }
+    throw std::runtime_error(reason);
+  }
+  LOG(level::Warning) << "Attempt " << _attempts << " failed, retrying in "
+                      << _backoff.count() << "ms. Reason: " << reason;
+  _emit(Action::start_timer(_backoff));
+  _backoff *= 2;
+  _attempts++;
+  _state = waiting_state;
+}
+
+void Handshake::_forward(StateMachine &machine) {
+  while (const auto action = machine.poll_action()) {
+    _emit(*action);
+  }
+}
+}
+}
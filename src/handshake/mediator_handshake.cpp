@@ -0,0 +1,112 @@
+#include <p2psc/crypto/crypto_exception.h>
+#include <p2psc/handshake/mediator_handshake.h>
+#include <p2psc/log.h>
+#include <p2psc/message/advertise.h>
+#include <p2psc/message/advertise_abort.h>
+#include <p2psc/message/advertise_challenge.h>
+#include <p2psc/message/advertise_response.h>
+#include <p2psc/message/advertise_retry.h>
+#include <p2psc/message/peer_identification.h>
+
+namespace p2psc {
+namespace handshake {
+
+MediatorHandshake::MediatorHandshake(const key::Keypair &our_keypair,
+                                     const Peer &peer)
+    : _our_keypair(our_keypair), _peer(peer), _state(kStateIdle),
+      _advertise_retries(0) {}
+
+void MediatorHandshake::start() {
+  BOOST_ASSERT(_state == kStateIdle);
+  _advertise();
+}
+
+void MediatorHandshake::on_message(const std::string &raw_message) {
+  switch (_state) {
+  case kStateAdvertised:
+    _on_advertise_response(raw_message);
+    break;
+  case kStateResponded:
+    _on_mediator_decision(raw_message);
+    break;
+  default:
+    throw std::runtime_error(
+        "Unexpected message from Mediator: " +
+        message::message_type_string(
+            message::decode_message_type(raw_message)));
+  }
+}
+
+PunchedPeer MediatorHandshake::get_punched_peer() const {
+  BOOST_ASSERT(_punched_peer);
+  return *_punched_peer;
+}
+
+message::PeerDisconnect MediatorHandshake::get_peer_disconnect() const {
+  BOOST_ASSERT(_peer_disconnect);
+  return *_peer_disconnect;
+}
+
+void MediatorHandshake::_advertise() {
+  _emit_message(message::Advertise{kVersion,
+                                   _our_keypair.get_serialised_public_key(),
+                                   _peer.public_key.serialise()});
+  _state = kStateAdvertised;
+}
+
+void MediatorHandshake::_on_advertise_response(
+    const std::string &raw_message) {
+  const auto message_type = message::decode_message_type(raw_message);
+  if (message_type == message::kTypeAdvertiseAbort) {
+    const auto advertise_abort = _decode<message::AdvertiseAbort>(raw_message);
+    throw std::runtime_error("AdvertiseAbort: " + advertise_abort.reason);
+  } else if (message_type == message::kTypeAdvertiseRetry) {
+    const auto advertise_retry = _decode<message::AdvertiseRetry>(raw_message);
+    if (_advertise_retries == max_advertise_retries) {
+      throw std::runtime_error(
+          "AdvertiseRetry: Retried " + std::to_string(_advertise_retries) +
+          " times, aborting. Reason: " + advertise_retry.reason);
+    }
+    LOG(level::Info) << "Advertise rejected by Mediator. Retrying. Reason: "
+                     << advertise_retry.reason;
+    _advertise_retries++;
+    _advertise();
+  } else if (message_type == message::kTypeAdvertiseChallenge) {
+    const auto advertise_challenge =
+        _decode<message::AdvertiseChallenge>(raw_message);
+    std::string decrypted_nonce;
+    try {
+      decrypted_nonce =
+          _our_keypair.private_decrypt(advertise_challenge.encrypted_nonce);
+    } catch (crypto::CryptoException &e) {
+      throw std::runtime_error(
+          "AdvertiseChallenge: Could not decrypt encrypted_nonce");
+    }
+    _emit_message(message::AdvertiseResponse{decrypted_nonce});
+    _state = kStateResponded;
+  } else {
+    throw std::runtime_error("Unexpected message type: " +
+                             message::message_type_string(message_type));
+  }
+}
+
+void MediatorHandshake::_on_mediator_decision(const std::string &raw_message) {
+  // now we wait for either a PeerIdentification or PeerDisconnect.
+  const auto message_type = message::decode_message_type(raw_message);
+  if (message_type == message::kTypePeerIdentification) {
+    const auto peer_identification =
+        _decode<message::PeerIdentification>(raw_message);
+    _punched_peer = PunchedPeer(
+        _peer,
+        socket::SocketAddress(peer_identification.ip, peer_identification.port),
+        peer_identification.version);
+  } else if (message_type == message::kTypePeerDisconnect) {
+    _peer_disconnect = _decode<message::PeerDisconnect>(raw_message);
+  } else {
+    throw std::runtime_error("Unexpected message type: " +
+                             message::message_type_string(message_type));
+  }
+  _state = kStateDone;
+}
+}
+}
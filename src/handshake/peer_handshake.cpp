@@ -0,0 +1,103 @@
+#include <base64/base64.h>
+#include <crypto/aes_gcm.h>
+#include <p2psc/crypto/crypto_exception.h>
+#include <p2psc/handshake/peer_handshake.h>
+#include <p2psc/message/peer_acknowledgement.h>
+#include <p2psc/message/peer_challenge.h>
+#include <p2psc/message/peer_challenge_response.h>
+#include <p2psc/message/peer_response.h>
+
+namespace p2psc {
+namespace handshake {
+
+PeerHandshake::PeerHandshake(const key::Keypair &our_keypair, const Peer &peer,
+                             const NonceGenerator &nonce_generator,
+                             const Extensions &extensions)
+    : _our_keypair(our_keypair), _peer(peer),
+      _nonce_generator(nonce_generator), _extensions(extensions),
+      _state(kStateIdle) {}
+
+void PeerHandshake::on_message(const std::string &raw_message) {
+  if (_state == kStateIdle) {
+    // receive peer challenge
+    const auto peer_challenge = _decode<message::PeerChallenge>(raw_message);
+    const auto decrypted_nonce =
+        _our_keypair.private_decrypt(peer_challenge.encrypted_nonce);
+
+    _negotiated_compression = compression::negotiate(
+        _extensions.compression, peer_challenge.compression,
+        peer_challenge.compression_dictionary);
+    if (_extensions.host_id && peer_challenge.host_id == _extensions.host_id) {
+      _local_socket = _extensions.local_socket_name;
+    }
+
+    // send peer challenge response
+    auto challenge = make_challenge(
+        _peer.public_key, _extensions.challenge_pool, _nonce_generator);
+    _nonce = challenge.nonce;
+    auto peer_challenge_response = message::PeerChallengeResponse{
+        challenge.encrypted_nonce, decrypted_nonce};
+    if (_negotiated_compression) {
+      peer_challenge_response.compression = compression::kAlgorithmZstd;
+      peer_challenge_response.compression_dictionary =
+          compression::dictionary_id(_negotiated_compression->dictionary);
+    }
+    peer_challenge_response.local_socket = _local_socket;
+    if (peer_challenge.early_data_secret && _extensions.early_data.responder) {
+      const auto client_secret =
+          _our_keypair.private_decrypt(*peer_challenge.early_data_secret);
+      const auto our_secret = crypto::generate_secret();
+      peer_challenge_response.early_data_secret =
+          _peer.public_key.encrypt(our_secret);
+      _early_data_key = early_data_key(client_secret, our_secret,
+                                       decrypted_nonce, _nonce);
+    }
+    _emit_message(peer_challenge_response);
+    _state = kStateChallenged;
+  } else if (_state == kStateChallenged) {
+    // receive peer response
+    const auto peer_response = _decode<message::PeerResponse>(raw_message);
+    if (peer_response.decrypted_nonce != _nonce) {
+      throw std::runtime_error("PeerResponse: peer did not pass verification");
+    }
+
+    // send peer acknowledgement, with the reply to the early request
+    auto peer_acknowledgement = message::PeerAcknowledgement{};
+    // only now that the Client has proven itself
+    if (_local_socket) {
+      peer_acknowledgement.local_socket_token =
+          _extensions.local_socket_token;
+    }
+    if (peer_response.early_data) {
+      if (!_early_data_key) {
+        throw std::runtime_error("PeerResponse: unexpected early_data");
+      }
+      std::string request;
+      try {
+        request = crypto::open(*_early_data_key,
+                               base64_decode(*peer_response.early_data),
+                               "request");
+      } catch (crypto::CryptoException &e) {
+        throw std::runtime_error("PeerResponse: Could not decrypt early_data");
+      }
+      const auto reply = _extensions.early_data.responder(request);
+      if (reply.size() > kMaxEarlyDataSize) {
+        throw std::runtime_error("Early data reply of " +
+                                 std::to_string(reply.size()) +
+                                 " bytes is too large");
+      }
+      const auto sealed = crypto::seal(*_early_data_key, reply, "reply");
+      peer_acknowledgement.early_data = base64_encode(
+          reinterpret_cast<const unsigned char *>(sealed.data()),
+          sealed.size());
+    }
+    _emit_message(peer_acknowledgement);
+    _state = kStateDone;
+  } else {
+    throw std::runtime_error("Unexpected message from Client: " +
+                             message::message_type_string(
+                                 message::decode_message_type(raw_message)));
+  }
+}
+}
+}
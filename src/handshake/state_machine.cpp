@@ -0,0 +1,31 @@
+#include <boost/algorithm/hex.hpp>
+#include <iterator>
+#include <openssl/rand.h>
+#include <p2psc/handshake/state_machine.h>
+
+namespace p2psc {
+namespace handshake {
+
+std::string generate_nonce() {
+  // the early data key is derived from nonces too, so they must not be
+  // predictable
+  unsigned char nonce[16];
+  if (RAND_bytes(nonce, sizeof(nonce)) != 1) {
+    throw std::runtime_error("Failed to generate nonce");
+  }
+  std::string hex;
+  boost::algorithm::hex_lower(nonce, nonce + sizeof(nonce),
+                              std::back_inserter(hex));
+  return hex;
+}
+
+boost::optional<Action> StateMachine::poll_action() {
+  if (_actions.empty()) {
+    return boost::none;
+  }
+  const auto action = _actions.front();
+  _actions.pop_front();
+  return action;
+}
+}
+}
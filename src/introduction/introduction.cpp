@@ -0,0 +1,77 @@
+#include <p2psc/crypto/crypto_exception.h>
+#include <p2psc/introduction/introduction.h>
+#include <p2psc/introduction/introduction_exception.h>
+#include <p2psc/log.h>
+#include <p2psc/message/introduction.h>
+#include <p2psc/message/message.h>
+#include <p2psc/message/message_decoder.h>
+#include <p2psc/message/message_exception.h>
+#include <p2psc/message/message_reader.h>
+
+namespace p2psc {
+namespace introduction {
+namespace {
+
+void send(Socket &socket, const message::Introduction &introduction) {
+  socket.send(
+      encode(Message<message::Introduction>(introduction).format()));
+}
+
+message::Introduction receive(Socket &socket) {
+  try {
+    const auto raw_message = message::receive_message(socket);
+    if (message::decode_message_type(raw_message) !=
+        message::kTypeIntroduction) {
+      throw IntroductionException("Expected an Introduction, got " +
+                                  raw_message);
+    }
+    return message::decode<message::Introduction>(raw_message).payload;
+  } catch (const message::MessageException &e) {
+    throw IntroductionException(e.what());
+  }
+}
+}
+
+void introduce(const Introducee &first, const Introducee &second) {
+  const auto first_address = first.socket->get_socket_address();
+  const auto second_address = second.socket->get_socket_address();
+  LOG(level::Info) << "Introducing " << first_address << " to "
+                   << second_address;
+  send(*second.socket,
+       message::Introduction{kVersion, first.peer.public_key.serialise(),
+                             false, first_address.ip(),
+                             second_address.port()});
+  send(*first.socket,
+       message::Introduction{kVersion, second.peer.public_key.serialise(),
+                             true, second_address.ip(),
+                             second_address.port()});
+}
+
+Peer accept(const key::Keypair &our_keypair, Socket &introducer,
+            const Mediator &mediator, const Callback &callback) {
+  const auto introduction = receive(introducer);
+  if (introduction.version != kVersion) {
+    throw IntroductionException(
+        "Introduced peer has incompatible protocol version " +
+        std::to_string(introduction.version) + ". Require " +
+        std::to_string(kVersion));
+  }
+  std::unique_ptr<Peer> peer;
+  try {
+    peer = std::make_unique<Peer>(
+        key::PublicKey::from_string(introduction.public_key));
+  } catch (const crypto::CryptoException &e) {
+    throw IntroductionException(e.what());
+  }
+  LOG(level::Info) << "Introduced by " << introducer.get_socket_address()
+                   << " to peer at " << introduction.ip;
+  Connection::connect(
+      our_keypair, *peer, mediator,
+      handshake::Rendezvous{introduction.connect,
+                            socket::SocketAddress(introduction.ip,
+                                                  introduction.port)},
+      callback);
+  return *peer;
+}
+}
+}
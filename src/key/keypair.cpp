@@ -1,15 +1,26 @@
 #include <crypto/rsa.h>
+#include <openssl/sha.h>
 #include <p2psc/key/keypair.h>
 
 namespace p2psc {
 namespace key {
 
-Keypair Keypair::generate() { return Keypair(crypto::RSA::generate()); }
+Keypair Keypair::generate(const KeyOptions &options) {
+  return Keypair(crypto::RSA::generate(options.size, options.primes));
+}
 
 Keypair Keypair::from_pem(const std::string &path) {
   return Keypair(crypto::RSA::from_pem(path));
 }
 
+Keypair Keypair::from_der(const std::string &path) {
+  return Keypair(crypto::RSA::from_der(path));
+}
+
+void Keypair::write_der(const std::string &path) const {
+  _pki->write_der_to_file(path);
+}
+
 Keypair::Keypair(std::shared_ptr<crypto::PKI> pki) : _pki(pki) {}
 
 std::string Keypair::public_encrypt(const std::string &message) const {
@@ -20,6 +31,13 @@ std::string Keypair::private_decrypt(const std::string &encrypted) const {
   return _pki->private_decrypt(encrypted);
 }
 
+std::string Keypair::sign(const std::string &message) const {
+  unsigned char digest[SHA256_DIGEST_LENGTH];
+  SHA256(reinterpret_cast<const unsigned char *>(message.data()),
+         message.size(), digest);
+  return _pki->private_encrypt(std::string(digest, digest + sizeof(digest)));
+}
+
 std::string Keypair::get_serialised_public_key() const {
   return _pki->get_public_key_string();
 }
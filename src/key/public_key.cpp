@@ -1,8 +1,21 @@
+#include <boost/algorithm/hex.hpp>
 #include <crypto/rsa.h>
+#include <iterator>
+#include <openssl/sha.h>
+#include <p2psc/crypto/crypto_exception.h>
 #include <p2psc/key/public_key.h>
 
 namespace p2psc {
 namespace key {
+namespace {
+
+std::string sha256(const std::string &data) {
+  unsigned char digest[SHA256_DIGEST_LENGTH];
+  SHA256(reinterpret_cast<const unsigned char *>(data.data()), data.size(),
+         digest);
+  return std::string(digest, digest + sizeof(digest));
+}
+}
 
 PublicKey PublicKey::from_string(const std::string &string) {
   return PublicKey(crypto::RSA::from_public_key(string));
@@ -16,8 +29,24 @@ std::string PublicKey::encrypt(const std::string &message) const {
   return _pki->public_encrypt(message);
 }
 
+bool PublicKey::verify(const std::string &message,
+                       const std::string &signature) const {
+  try {
+    return _pki->public_decrypt(signature) == sha256(message);
+  } catch (const crypto::CryptoException &e) {
+    return false;
+  }
+}
+
 std::string PublicKey::serialise() const {
   return _pki->get_public_key_string();
 }
+
+std::string PublicKey::fingerprint() const {
+  const auto digest = sha256(serialise());
+  std::string hex;
+  boost::algorithm::hex_lower(digest, std::back_inserter(hex));
+  return hex;
+}
 }
 }
\ No newline at end of file
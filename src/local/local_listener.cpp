@@ -0,0 +1,178 @@
+#include <boost/algorithm/hex.hpp>
+#include <cstring>
+#include <iterator>
+#include <local/local_listener.h>
+#include <openssl/crypto.h>
+#include <openssl/rand.h>
+#include <p2psc/local/local_socket.h>
+#include <p2psc/log.h>
+#include <poll.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace p2psc {
+namespace local {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// what the Peer answers a Client which proved itself with
+const char kAccepted = 1;
+
+// 16 random bytes, hex encoded
+std::string random_hex() {
+  unsigned char random[16];
+  if (RAND_bytes(random, sizeof(random)) != 1) {
+    throw socket::SocketException("Failed to generate random bytes");
+  }
+  std::string hex;
+  boost::algorithm::hex_lower(random, random + sizeof(random),
+                              std::back_inserter(hex));
+  return hex;
+}
+
+// false if size bytes didn't arrive by deadline
+bool receive_exactly(int sock_fd, char *buffer, std::size_t size,
+                     Clock::time_point deadline) {
+  std::size_t received = 0;
+  while (received < size) {
+    const auto remaining =
+        std::chrono::duration_cast<std::chrono::milliseconds>(deadline -
+                                                              Clock::now());
+    struct pollfd fd = {sock_fd, POLLIN, 0};
+    if (remaining.count() <= 0 || poll(&fd, 1, remaining.count()) != 1) {
+      return false;
+    }
+    const auto count = ::recv(sock_fd, buffer + received, size - received, 0);
+    if (count <= 0) {
+      return false;
+    }
+    received += count;
+  }
+  return true;
+}
+
+// whether the process at the other end of sock_fd runs as our user
+bool is_same_user(int sock_fd) {
+  struct ucred credentials;
+  socklen_t length = sizeof(credentials);
+  return getsockopt(sock_fd, SOL_SOCKET, SO_PEERCRED, &credentials,
+                    &length) == 0 &&
+         credentials.uid == geteuid();
+}
+
+// The leading NUL puts the name in the abstract namespace.
+socklen_t abstract_address(const std::string &name,
+                           struct sockaddr_un &address) {
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  memcpy(address.sun_path + 1, name.data(), name.size());
+  return offsetof(struct sockaddr_un, sun_path) + 1 + name.size();
+}
+
+std::shared_ptr<Socket> replace(int sock_fd, Socket &tcp_socket) {
+  const auto socket = std::make_shared<LocalSocket>(
+      sock_fd, tcp_socket.get_socket_address(),
+      tcp_socket.get_local_address());
+  tcp_socket.close();
+  return socket;
+}
+}
+
+LocalListener::LocalListener()
+    : _sock_fd(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) {
+  if (_sock_fd == -1) {
+    throw socket::SocketException(
+        "Failed to create Unix domain socket. Reason: " +
+        std::string(strerror(errno)));
+  }
+  try {
+    _name = "p2psc-" + random_hex();
+    _token = random_hex();
+  } catch (const socket::SocketException &) {
+    ::close(_sock_fd);
+    throw;
+  }
+  struct sockaddr_un address;
+  const auto length = abstract_address(_name, address);
+  if (bind(_sock_fd, (struct sockaddr *)&address, length) != 0 ||
+      listen(_sock_fd, 1) != 0) {
+    const auto error = errno;
+    ::close(_sock_fd);
+    throw socket::SocketException(
+        "Failed to listen on Unix domain socket. Reason: " +
+        std::string(strerror(error)));
+  }
+}
+
+LocalListener::~LocalListener() { ::close(_sock_fd); }
+
+std::shared_ptr<Socket>
+LocalListener::accept(Socket &tcp_socket, std::chrono::milliseconds timeout) {
+  // The name can be seen in /proc/net/unix, so whoever connects first needn't
+  // be the Client: it has to run as our user, and send the token first.
+  const auto deadline = Clock::now() + timeout;
+  while (true) {
+    const auto remaining =
+        std::chrono::duration_cast<std::chrono::milliseconds>(deadline -
+                                                              Clock::now());
+    struct pollfd fd = {_sock_fd, POLLIN, 0};
+    if (remaining.count() <= 0 || poll(&fd, 1, remaining.count()) != 1) {
+      LOG(level::Warning) << "Client did not connect to Unix domain socket, "
+                             "staying on TCP";
+      return nullptr;
+    }
+    const auto sock_fd = accept4(_sock_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (sock_fd == -1) {
+      LOG(level::Warning) << "Failed to accept on Unix domain socket, staying "
+                             "on TCP: "
+                          << strerror(errno);
+      return nullptr;
+    }
+    std::string token(_token.size(), '\0');
+    if (!is_same_user(sock_fd)) {
+      LOG(level::Warning) << "Rejected connection to Unix domain socket from "
+                             "another user";
+    } else if (!receive_exactly(sock_fd, &token[0], token.size(), deadline) ||
+               CRYPTO_memcmp(token.data(), _token.data(), token.size()) !=
+                   0) {
+      LOG(level::Warning) << "Rejected connection to Unix domain socket "
+                             "without the Client's token";
+    } else if (::send(sock_fd, &kAccepted, 1, MSG_NOSIGNAL) == 1) {
+      return replace(sock_fd, tcp_socket);
+    }
+    ::close(sock_fd);
+  }
+}
+
+std::shared_ptr<Socket> connect(const std::string &name,
+                                const std::string &token, Socket &tcp_socket,
+                                std::chrono::milliseconds timeout) {
+  const auto sock_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  struct sockaddr_un address;
+  const auto length = abstract_address(name, address);
+  if (sock_fd == -1 ||
+      ::connect(sock_fd, (struct sockaddr *)&address, length) != 0) {
+    LOG(level::Warning) << "Failed to connect to Unix domain socket, staying "
+                           "on TCP: "
+                        << strerror(errno);
+    if (sock_fd != -1) {
+      ::close(sock_fd);
+    }
+    return nullptr;
+  }
+  // the Peer only moves once it has accepted us, and tells us so
+  char accepted = 0;
+  if (::send(sock_fd, token.data(), token.size(), MSG_NOSIGNAL) !=
+          static_cast<ssize_t>(token.size()) ||
+      !receive_exactly(sock_fd, &accepted, 1, Clock::now() + timeout) ||
+      accepted != kAccepted) {
+    LOG(level::Warning) << "Peer did not accept us on Unix domain socket, "
+                           "staying on TCP";
+    ::close(sock_fd);
+    return nullptr;
+  }
+  return replace(sock_fd, tcp_socket);
+}
+}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <p2psc/socket/socket.h>
+
+namespace p2psc {
+namespace local {
+
+/*
+ * A Unix domain socket in the abstract namespace, under a random name, which
+ * a Peer on the same host as its Client connects to. Anyone on the host can
+ * find the name, so the Client proves itself with a random token, which the
+ * Peer only tells it over the authenticated TCP connection. Throws
+ * SocketException if it can't be created.
+ */
+class LocalListener {
+public:
+  LocalListener();
+  ~LocalListener();
+
+  const std::string &name() const { return _name; }
+  const std::string &token() const { return _token; }
+
+  /*
+   * Accept the Client's connection, which replaces tcp_socket. Connections
+   * from other users, or which don't start with token, are closed. Returns
+   * nullptr if the Client's doesn't arrive within timeout.
+   */
+  std::shared_ptr<Socket> accept(Socket &tcp_socket,
+                                 std::chrono::milliseconds timeout);
+
+private:
+  LocalListener(const LocalListener &) = delete;
+  LocalListener &operator=(const LocalListener &) = delete;
+
+  std::string _name;
+  std::string _token;
+  int _sock_fd;
+};
+
+/*
+ * Connect to the Peer's LocalListener and prove ourselves with token,
+ * replacing tcp_socket once the Peer has accepted us. Returns nullptr if
+ * that fails, or the Peer doesn't accept us within timeout, which should
+ * outlast its accept().
+ */
+std::shared_ptr<Socket> connect(const std::string &name,
+                                const std::string &token, Socket &tcp_socket,
+                                std::chrono::milliseconds timeout);
+}
+}
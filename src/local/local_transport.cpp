@@ -0,0 +1,59 @@
+#include <atomic>
+#include <boost/algorithm/hex.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <openssl/sha.h>
+#include <p2psc/local/local_transport.h>
+#include <p2psc/log.h>
+#include <unistd.h>
+
+namespace p2psc {
+namespace local {
+namespace {
+
+std::atomic<bool> enabled(false);
+
+std::string read_first_line(const std::string &path) {
+  std::ifstream file(path);
+  std::string line;
+  std::getline(file, line);
+  boost::algorithm::trim(line);
+  return line;
+}
+
+std::string compute_host_id() {
+  // boot_id changes on every boot, but is there when machine-id isn't
+  auto machine = read_first_line("/etc/machine-id");
+  if (machine.empty()) {
+    machine = read_first_line("/proc/sys/kernel/random/boot_id");
+  }
+  char network_namespace[64] = {0};
+  if (readlink("/proc/self/ns/net", network_namespace,
+               sizeof(network_namespace) - 1) == -1) {
+    LOG(level::Warning) << "Failed to read network namespace: "
+                        << strerror(errno);
+  }
+  // machine-id is meant to stay private, so only a hash of it is sent
+  const auto id = machine + "/" + network_namespace;
+  unsigned char digest[SHA256_DIGEST_LENGTH];
+  SHA256(reinterpret_cast<const unsigned char *>(id.data()), id.size(),
+         digest);
+  std::string hex;
+  boost::algorithm::hex_lower(digest, digest + sizeof(digest),
+                              std::back_inserter(hex));
+  return hex;
+}
+}
+
+void set_local_transport_enabled(bool enable) { enabled = enable; }
+
+bool local_transport_enabled() { return enabled; }
+
+std::string host_id() {
+  static const auto id = compute_host_id();
+  return id;
+}
+}
+}
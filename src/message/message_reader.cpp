@@ -0,0 +1,70 @@
+#include <cctype>
+#include <p2psc/message/message_exception.h>
+#include <p2psc/message/message_reader.h>
+
+namespace p2psc {
+namespace message {
+
+void MessageReader::append(const std::string &data) {
+  _buffer += data;
+}
+
+boost::optional<std::string> MessageReader::next() {
+  for (; _scanned < _buffer.size(); _scanned++) {
+    const auto c = _buffer[_scanned];
+    if (_in_string) {
+      if (_escaped) {
+        _escaped = false;
+      } else if (c == '\\') {
+        _escaped = true;
+      } else if (c == '"') {
+        _in_string = false;
+      }
+    } else if (c == '"') {
+      _in_string = true;
+    } else if (c == '{' || c == '[') {
+      _depth++;
+    } else if ((c == '}' || c == ']') && _depth > 0 && --_depth == 0) {
+      const auto message = _buffer.substr(0, _scanned + 1);
+      _buffer.erase(0, _scanned + 1);
+      _scanned = 0;
+      return message;
+    } else if (_depth == 0 && !isspace(c)) {
+      // not JSON: hand it all over, for decoding to fail on
+      std::string message;
+      message.swap(_buffer);
+      _scanned = 0;
+      return message;
+    }
+  }
+  if (_buffer.size() > kMaxMessageSize) {
+    throw MessageException("Message larger than " +
+                           std::to_string(kMaxMessageSize) + " bytes");
+  }
+  return boost::none;
+}
+
+std::string MessageReader::take_rest() {
+  std::string rest;
+  rest.swap(_buffer);
+  _scanned = 0;
+  _depth = 0;
+  _in_string = false;
+  _escaped = false;
+  return rest;
+}
+
+std::string receive_message(Socket &socket) {
+  MessageReader reader;
+  boost::optional<std::string> message;
+  while (!(message = reader.next())) {
+    reader.append(socket.receive());
+  }
+  const auto rest = reader.take_rest();
+  if (!rest.empty()) {
+    socket.put_back(rest);
+  }
+  return *message;
+}
+}
+}
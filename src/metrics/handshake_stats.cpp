@@ -0,0 +1,98 @@
+#include <chrono>
+#include <mutex>
+#include <p2psc/log.h>
+#include <p2psc/metrics/handshake_stats.h>
+
+namespace p2psc {
+namespace metrics {
+namespace {
+
+std::mutex &handler_mutex() {
+  static std::mutex m;
+  return m;
+}
+
+HandshakeStatsHandler &global_handler() {
+  static HandshakeStatsHandler handler;
+  return handler;
+}
+
+// The stats being counted on this thread, or nullptr outside of a scope. A
+// plain pointer so that checking it never allocates, which matters when it is
+// called from operator new.
+thread_local HandshakeStats *current_stats = nullptr;
+thread_local HandshakeStats last_stats;
+
+uint64_t now_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+}
+
+void set_handshake_stats_handler(const HandshakeStatsHandler &handler) {
+  std::lock_guard<std::mutex> guard(handler_mutex());
+  global_handler() = handler;
+}
+
+const HandshakeStats &last_handshake_stats() { return last_stats; }
+
+HandshakeStatsScope::HandshakeStatsScope() : _start_us(0) {
+  {
+    std::lock_guard<std::mutex> guard(handler_mutex());
+    _handler = global_handler();
+  }
+  if (_handler && !current_stats) {
+    _start_us = now_us();
+    current_stats = &_stats;
+  }
+}
+
+HandshakeStatsScope::~HandshakeStatsScope() {
+  if (current_stats != &_stats) {
+    return;
+  }
+  current_stats = nullptr;
+  _stats.duration_us = now_us() - _start_us;
+  last_stats = _stats;
+  try {
+    _handler(_stats);
+  } catch (const std::exception &e) {
+    LOG(level::Warning) << "HandshakeStatsHandler threw: " << e.what();
+  }
+}
+
+void count_syscall(Syscall syscall) {
+  if (!current_stats) {
+    return;
+  }
+  switch (syscall) {
+  case kSyscallConnect:
+    current_stats->connect_calls++;
+    break;
+  case kSyscallSend:
+    current_stats->send_calls++;
+    break;
+  case kSyscallRead:
+    current_stats->read_calls++;
+    break;
+  case kSyscallIoctl:
+    current_stats->ioctl_calls++;
+    break;
+  }
+}
+
+void count_crypto_operation() {
+  if (current_stats) {
+    current_stats->crypto_operations++;
+  }
+}
+
+void count_allocation(std::size_t size) {
+  if (current_stats) {
+    current_stats->allocations++;
+    current_stats->allocated_bytes += size;
+  }
+}
+}
+}
@@ -0,0 +1,136 @@
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <p2psc/metrics/instrumented_mutex.h>
+
+namespace p2psc {
+namespace metrics {
+
+struct LockSite {
+  std::atomic<uint64_t> acquisitions{0};
+  std::atomic<uint64_t> contentions{0};
+  std::atomic<uint64_t> wait_ns{0};
+  std::atomic<uint64_t> max_wait_ns{0};
+  std::atomic<uint64_t> hold_ns{0};
+  std::atomic<uint64_t> max_hold_ns{0};
+  std::atomic<uint64_t> waiting{0};
+};
+
+namespace {
+
+std::atomic<bool> profiling_enabled(false);
+
+std::mutex &sites_mutex() {
+  static std::mutex m;
+  return m;
+}
+
+// Deliberately leaked: mutexes with static storage duration (such as the Log
+// mutex) keep pointers to their sites and may be used during exit.
+std::map<std::string, std::unique_ptr<LockSite>> &sites() {
+  static auto *sites = new std::map<std::string, std::unique_ptr<LockSite>>();
+  return *sites;
+}
+
+uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void update_max(std::atomic<uint64_t> &max, uint64_t value) {
+  auto current = max.load(std::memory_order_relaxed);
+  while (value > current &&
+         !max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    ;
+}
+}
+
+InstrumentedMutex::InstrumentedMutex(const std::string &site)
+    : _locked_at_ns(0) {
+  std::lock_guard<std::mutex> guard(sites_mutex());
+  auto &entry = sites()[site];
+  if (!entry) {
+    entry = std::make_unique<LockSite>();
+  }
+  _site = entry.get();
+}
+
+void InstrumentedMutex::lock() {
+  if (!profiling_enabled.load(std::memory_order_relaxed)) {
+    _mutex.lock();
+    _locked_at_ns = 0;
+    return;
+  }
+  if (_mutex.try_lock()) {
+    _locked_at_ns = now_ns();
+  } else {
+    const auto start_ns = now_ns();
+    _site->waiting.fetch_add(1, std::memory_order_relaxed);
+    _mutex.lock();
+    _site->waiting.fetch_sub(1, std::memory_order_relaxed);
+    _locked_at_ns = now_ns();
+    const auto waited_ns = _locked_at_ns - start_ns;
+    _site->contentions.fetch_add(1, std::memory_order_relaxed);
+    _site->wait_ns.fetch_add(waited_ns, std::memory_order_relaxed);
+    update_max(_site->max_wait_ns, waited_ns);
+  }
+  _site->acquisitions.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool InstrumentedMutex::try_lock() {
+  if (!_mutex.try_lock()) {
+    return false;
+  }
+  if (profiling_enabled.load(std::memory_order_relaxed)) {
+    _locked_at_ns = now_ns();
+    _site->acquisitions.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    _locked_at_ns = 0;
+  }
+  return true;
+}
+
+void InstrumentedMutex::unlock() {
+  const auto locked_at_ns = _locked_at_ns;
+  if (locked_at_ns != 0) {
+    const auto held_ns = now_ns() - locked_at_ns;
+    _site->hold_ns.fetch_add(held_ns, std::memory_order_relaxed);
+    update_max(_site->max_hold_ns, held_ns);
+  }
+  _mutex.unlock();
+}
+
+void set_lock_profiling_enabled(bool enabled) { profiling_enabled = enabled; }
+
+bool lock_profiling_enabled() { return profiling_enabled; }
+
+std::map<std::string, LockStats> lock_stats() {
+  std::lock_guard<std::mutex> guard(sites_mutex());
+  std::map<std::string, LockStats> stats;
+  for (const auto &site : sites()) {
+    auto &s = stats[site.first];
+    s.acquisitions = site.second->acquisitions;
+    s.contentions = site.second->contentions;
+    s.wait_ns = site.second->wait_ns;
+    s.max_wait_ns = site.second->max_wait_ns;
+    s.hold_ns = site.second->hold_ns;
+    s.max_hold_ns = site.second->max_hold_ns;
+    s.waiting = site.second->waiting;
+  }
+  return stats;
+}
+
+void reset_lock_stats() {
+  std::lock_guard<std::mutex> guard(sites_mutex());
+  for (const auto &site : sites()) {
+    site.second->acquisitions = 0;
+    site.second->contentions = 0;
+    site.second->wait_ns = 0;
+    site.second->max_wait_ns = 0;
+    site.second->hold_ns = 0;
+    site.second->max_hold_ns = 0;
+  }
+}
+}
+}
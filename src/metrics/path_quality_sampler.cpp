@@ -0,0 +1,101 @@
+#include <p2psc/metrics/path_quality_sampler.h>
+#include <vector>
+
+namespace p2psc {
+namespace metrics {
+
+PathQualitySampler::PathQualitySampler(std::chrono::milliseconds interval,
+                                       const PathQualityHandler &handler)
+    : _interval(interval), _handler(handler),
+      _mutex("metrics::PathQualitySampler"), _stopping(false),
+      _thread(&PathQualitySampler::_run, this) {}
+
+PathQualitySampler::~PathQualitySampler() {
+  {
+    std::lock_guard<InstrumentedMutex> guard(_mutex);
+    _stopping = true;
+  }
+  _cv.notify_all();
+  _thread.join();
+}
+
+void PathQualitySampler::add(const std::string &name,
+                             std::weak_ptr<Socket> socket) {
+  {
+    std::lock_guard<InstrumentedMutex> guard(_mutex);
+    _sockets[name] = socket;
+    _added.insert(name);
+  }
+  _cv.notify_all();
+}
+
+void PathQualitySampler::remove(const std::string &name) {
+  std::lock_guard<InstrumentedMutex> guard(_mutex);
+  _sockets.erase(name);
+  _added.erase(name);
+  _latest.erase(name);
+}
+
+std::map<std::string, socket::PathQuality> PathQualitySampler::latest() {
+  std::lock_guard<InstrumentedMutex> guard(_mutex);
+  return _latest;
+}
+
+void PathQualitySampler::_run() {
+  std::unique_lock<InstrumentedMutex> lock(_mutex);
+  auto next_round = Clock::now() + _interval;
+  const auto woken = [this]() { return _stopping || !_added.empty(); };
+  while (true) {
+    _cv.wait_until(lock, next_round, woken);
+    if (_stopping) {
+      return;
+    }
+    // woken up by add() before the round is due: only sample what was added
+    const auto is_round = Clock::now() >= next_round;
+    std::vector<std::pair<std::string, std::shared_ptr<Socket>>> sockets;
+    for (auto it = _sockets.begin(); it != _sockets.end();) {
+      const auto socket = it->second.lock();
+      if (!socket) {
+        _latest.erase(it->first);
+        it = _sockets.erase(it);
+        continue;
+      }
+      if (is_round || _added.count(it->first) != 0) {
+        sockets.emplace_back(it->first, socket);
+      }
+      ++it;
+    }
+    _added.clear();
+    // getsockopt and the handler run unlocked, so latest() doesn't wait
+    lock.unlock();
+    for (const auto &socket : sockets) {
+      _sample(socket.first, *socket.second);
+    }
+    lock.lock();
+    if (is_round) {
+      next_round = Clock::now() + _interval;
+    }
+  }
+}
+
+void PathQualitySampler::_sample(const std::string &name,
+                                 const Socket &socket) {
+  const auto quality = socket.get_path_quality();
+  {
+    std::lock_guard<InstrumentedMutex> guard(_mutex);
+    // it may have been removed meanwhile
+    if (_sockets.count(name) == 0) {
+      return;
+    }
+    if (quality) {
+      _latest[name] = *quality;
+    } else {
+      _latest.erase(name);
+    }
+  }
+  if (quality && _handler) {
+    _handler(name, *quality);
+  }
+}
+}
+}
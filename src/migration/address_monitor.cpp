@@ -0,0 +1,114 @@
+#include <arpa/inet.h>
+#include <cstring>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <p2psc/log.h>
+#include <p2psc/migration/address_monitor.h>
+#include <p2psc/migration/migration_exception.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace p2psc {
+namespace migration {
+
+AddressMonitor::AddressMonitor(const Handler &handler)
+    : _handler(handler),
+      _netlink_fd(::socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE)),
+      _stop_fd(-1) {
+  if (_netlink_fd == -1) {
+    throw MigrationException("Failed to open netlink socket. Reason: " +
+                             std::string(strerror(errno)));
+  }
+  struct sockaddr_nl address;
+  memset(&address, 0, sizeof(address));
+  address.nl_family = AF_NETLINK;
+  address.nl_groups = RTMGRP_IPV4_IFADDR;
+  if (bind(_netlink_fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+    const auto error = errno;
+    ::close(_netlink_fd);
+    throw MigrationException("Failed to bind netlink socket. Reason: " +
+                             std::string(strerror(error)));
+  }
+  _stop_fd = eventfd(0, EFD_CLOEXEC);
+  if (_stop_fd == -1) {
+    const auto error = errno;
+    ::close(_netlink_fd);
+    throw MigrationException("Failed to create eventfd. Reason: " +
+                             std::string(strerror(error)));
+  }
+  _thread = std::thread(&AddressMonitor::_run, this);
+}
+
+AddressMonitor::~AddressMonitor() {
+  const uint64_t stop = 1;
+  if (write(_stop_fd, &stop, sizeof(stop)) != sizeof(stop)) {
+    LOG(level::Error) << "Failed to stop address monitor: " << strerror(errno);
+  }
+  _thread.join();
+  ::close(_stop_fd);
+  ::close(_netlink_fd);
+}
+
+void AddressMonitor::_run() {
+  struct pollfd fds[] = {{_netlink_fd, POLLIN, 0}, {_stop_fd, POLLIN, 0}};
+  char buffer[8192];
+  while (true) {
+    if (poll(fds, 2, -1) == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG(level::Error) << "Address monitor failed: " << strerror(errno);
+      return;
+    }
+    if (fds[1].revents) {
+      return;
+    }
+    const auto size = recv(_netlink_fd, buffer, sizeof(buffer), 0);
+    if (size > 0) {
+      _handle(buffer, size);
+    } else if (size == -1 && errno == ENOBUFS) {
+      // we fell behind and lost some changes; the next ones still arrive
+      LOG(level::Warning) << "Address monitor missed address changes";
+    }
+  }
+}
+
+void AddressMonitor::_handle(const char *buffer, std::size_t size) {
+  int remaining = size;
+  for (auto *header = reinterpret_cast<const struct nlmsghdr *>(buffer);
+       NLMSG_OK(header, remaining); header = NLMSG_NEXT(header, remaining)) {
+    if (header->nlmsg_type != RTM_NEWADDR &&
+        header->nlmsg_type != RTM_DELADDR) {
+      continue;
+    }
+    const auto *message =
+        static_cast<const struct ifaddrmsg *>(NLMSG_DATA(header));
+    if (message->ifa_family != AF_INET) {
+      continue;
+    }
+    // IFA_ADDRESS is the other end's address on point-to-point links, so
+    // IFA_LOCAL takes precedence
+    const void *address = nullptr;
+    int attributes_size = IFA_PAYLOAD(header);
+    for (auto *attribute = IFA_RTA(message);
+         RTA_OK(attribute, attributes_size);
+         attribute = RTA_NEXT(attribute, attributes_size)) {
+      if (attribute->rta_type == IFA_LOCAL ||
+          (attribute->rta_type == IFA_ADDRESS && !address)) {
+        address = RTA_DATA(attribute);
+      }
+    }
+    if (!address) {
+      continue;
+    }
+    char ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, address, ip, sizeof(ip));
+    _handler(AddressChange{header->nlmsg_type == RTM_NEWADDR
+                               ? AddressChange::kAdded
+                               : AddressChange::kRemoved,
+                           ip});
+  }
+}
+}
+}
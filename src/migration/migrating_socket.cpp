@@ -0,0 +1,155 @@
+#include <atomic>
+#include <p2psc/log.h>
+#include <p2psc/migration/migrating_socket.h>
+#include <p2psc/migration/migration_exception.h>
+
+namespace p2psc {
+namespace migration {
+namespace {
+const auto kInitialBackoff = std::chrono::milliseconds(100);
+const auto kMaxBackoff = std::chrono::seconds(5);
+
+multipath::MultipathOptions multipath_options(const MigrationOptions &options) {
+  multipath::MultipathOptions multipath_options;
+  multipath_options.heartbeat_interval_ms = options.heartbeat_interval_ms;
+  multipath_options.path_timeout_ms = options.path_timeout_ms;
+  multipath_options.wait_for_paths = true;
+  return multipath_options;
+}
+}
+
+/*
+ * Connects again when the stream has lost its last path. Shared with the
+ * connections it starts, which may outlive the MigratingSocket.
+ */
+struct MigratingSocket::Reconnector
+    : std::enable_shared_from_this<Reconnector> {
+  Reconnector(const key::Keypair &keypair, const Peer &peer,
+              const Mediator &mediator, const MigrationOptions &options,
+              std::weak_ptr<multipath::MultipathSocket> stream)
+      : keypair(keypair), peer(peer), mediator(mediator), options(options),
+        stream(stream), reconnecting(false), migrations(0) {}
+
+  void on_disconnect() {
+    if (reconnecting.exchange(true)) {
+      return;
+    }
+    LOG(level::Info) << "Connection lost, reconnecting through the Mediator";
+    deadline = std::chrono::steady_clock::now() +
+               std::chrono::milliseconds(options.reconnect_timeout_ms);
+    reconnect(kInitialBackoff);
+  }
+
+  void reconnect(std::chrono::milliseconds backoff) {
+    const std::weak_ptr<Reconnector> weak_this = shared_from_this();
+    Connection::connect<PlainSocketFactory>(
+        keypair, peer, mediator,
+        [weak_this, backoff](Error error, std::shared_ptr<Socket> socket) {
+          const auto reconnector = weak_this.lock();
+          const auto stream =
+              reconnector ? reconnector->stream.lock() : nullptr;
+          if (!stream) {
+            if (socket) {
+              socket->close();
+            }
+            return;
+          }
+          if (error) {
+            reconnector->on_failure(error, backoff);
+            return;
+          }
+          LOG(level::Info) << "Reconnected, moving the connection to "
+                           << socket->get_local_address().ip();
+          reconnector->migrations++;
+          // before adding the path, which may fail again straight away
+          reconnector->reconnecting = false;
+          stream->add_path(socket);
+        });
+  }
+
+  void on_failure(const Error &error, std::chrono::milliseconds backoff) {
+    if (std::chrono::steady_clock::now() + backoff > deadline) {
+      if (const auto stream = this->stream.lock()) {
+        stream->abandon("Failed to reconnect: " + error.reason());
+      }
+      return;
+    }
+    LOG(level::Warning) << "Failed to reconnect, retrying in "
+                        << backoff.count() << "ms: " << error.reason();
+    std::this_thread::sleep_for(backoff);
+    reconnect(std::min<std::chrono::milliseconds>(2 * backoff, kMaxBackoff));
+  }
+
+  const key::Keypair keypair;
+  const Peer peer;
+  const Mediator mediator;
+  const MigrationOptions options;
+  const std::weak_ptr<multipath::MultipathSocket> stream;
+  std::atomic<bool> reconnecting;
+  std::atomic<std::uint64_t> migrations;
+  std::chrono::steady_clock::time_point deadline;
+};
+
+MigratingSocket::MigratingSocket(std::shared_ptr<Socket> socket,
+                                 const key::Keypair &keypair, const Peer &peer,
+                                 const Mediator &mediator,
+                                 const MigrationOptions &options)
+    : SocketLayer(std::make_shared<multipath::MultipathSocket>(
+          std::vector<std::shared_ptr<Socket>>{socket},
+          multipath_options(options))),
+      _stream(std::static_pointer_cast<multipath::MultipathSocket>(_inner)),
+      _reconnector(std::make_shared<Reconnector>(keypair, peer, mediator,
+                                                 options, _stream)) {
+  const std::weak_ptr<Reconnector> reconnector = _reconnector;
+  _stream->set_disconnect_handler([reconnector]() {
+    if (const auto locked = reconnector.lock()) {
+      locked->on_disconnect();
+    }
+  });
+  try {
+    _address_monitor = std::make_unique<AddressMonitor>(
+        [this](const AddressChange &change) { handle_address_change(change); });
+  } catch (const MigrationException &e) {
+    LOG(level::Warning) << "Not watching local addresses: " << e.what();
+  }
+}
+
+MigratingSocket::~MigratingSocket() { _stop(); }
+
+void MigratingSocket::close() {
+  _stop();
+  _stream->close();
+}
+
+void MigratingSocket::handle_address_change(const AddressChange &change) {
+  if (change.kind == AddressChange::kRemoved) {
+    _stream->drop_paths_from(change.ip,
+                             "Local address " + change.ip + " was removed");
+  }
+}
+
+std::uint64_t MigratingSocket::migrations() const {
+  return _reconnector->migrations;
+}
+
+void MigratingSocket::_stop() {
+  _address_monitor.reset();
+  _stream->set_disconnect_handler(nullptr);
+}
+
+void connect(const key::Keypair &keypair, const Peer &peer,
+             const Mediator &mediator, const Callback &callback,
+             const MigrationOptions &options) {
+  Connection::connect<PlainSocketFactory>(
+      keypair, peer, mediator,
+      [=](Error error, std::shared_ptr<Socket> socket) {
+        if (error) {
+          callback(error, nullptr);
+          return;
+        }
+        callback(Error(), std::make_shared<MigratingSocket>(
+                              socket, keypair, peer, mediator, options));
+      });
+}
+}
+}
@@ -0,0 +1,52 @@
+#include <p2psc/multipath/multipath.h>
+
+namespace p2psc {
+namespace multipath {
+namespace {
+using Sockets = std::vector<std::shared_ptr<Socket>>;
+
+void connect_next(const key::Keypair &keypair, const Peer &peer,
+                  const Mediator &mediator, std::size_t paths,
+                  const Callback &callback, const MultipathOptions &options,
+                  std::shared_ptr<Sockets> sockets) {
+  Connection::connect<PlainSocketFactory>(
+      keypair, peer, mediator,
+      [=](Error error, std::shared_ptr<Socket> socket) {
+        if (error) {
+          for (const auto &connected : *sockets) {
+            connected->close();
+          }
+          callback(error, nullptr);
+          return;
+        }
+        sockets->push_back(socket);
+        if (sockets->size() < paths) {
+          connect_next(keypair, peer, mediator, paths, callback, options,
+                       sockets);
+          return;
+        }
+        std::shared_ptr<Socket> multipath_socket;
+        try {
+          multipath_socket = std::make_shared<MultipathSocket>(*sockets, options);
+        } catch (const std::exception &e) {
+          callback(Error(error::kErrorUnknown, e.what()), nullptr);
+          return;
+        }
+        callback(Error(), multipath_socket);
+      });
+}
+}
+
+void connect(const key::Keypair &keypair, const Peer &peer,
+             const Mediator &mediator, std::size_t paths,
+             const Callback &callback, const MultipathOptions &options) {
+  if (paths == 0) {
+    callback(Error(error::kErrorUnknown, "At least one path is needed"),
+             nullptr);
+    return;
+  }
+  connect_next(keypair, peer, mediator, paths, callback, options,
+               std::make_shared<Sockets>());
+}
+}
+}
@@ -0,0 +1,457 @@
+#include <algorithm>
+#include <boost/assert.hpp>
+#include <p2psc/log.h>
+#include <p2psc/multipath/multipath_socket.h>
+#include <util/big_endian.h>
+
+namespace p2psc {
+namespace multipath {
+namespace {
+
+/*
+ * Every frame is a one byte kind, a sequence number (8 bytes, big endian),
+ * the payload length (4 bytes, big endian) and the payload. Only segments
+ * have a payload; acknowledgements carry the sequence number of the segment
+ * they acknowledge, and the other kinds none.
+ */
+enum FrameKind : char {
+  kFrameSegment = 0,
+  kFrameAcknowledgement = 1,
+  kFrameHeartbeat = 2,
+  // the other end is closing every path
+  kFrameClose = 3
+};
+
+const std::size_t kHeaderSize = 13;
+// weight of each new sample in the smoothed round trip time and throughput
+const double kSmoothing = 1.0 / 8;
+// until a path's throughput has been measured, assume this many bytes/s
+const double kDefaultThroughput = 1e9;
+const auto kCloseTimeout = std::chrono::seconds(5);
+
+std::string frame_header(FrameKind kind, std::uint64_t sequence,
+                         std::uint32_t size) {
+  std::string header(1, kind);
+  util::write_integer(header, sequence, 8);
+  util::write_integer(header, size, 4);
+  return header;
+}
+
+void smooth(double &average, double sample) {
+  average = average == 0 ? sample : average + kSmoothing * (sample - average);
+}
+}
+
+MultipathSocket::MultipathSocket(
+    const std::vector<std::shared_ptr<Socket>> &paths,
+    const MultipathOptions &options)
+    : SocketLayer(paths.empty() ? nullptr : paths.front()), _options(options),
+      _mutex("p2psc::MultipathSocket"), _closing(false), _remote_closed(false),
+      _abandoned(false), _next_sequence(0), _next_received_sequence(0) {
+  if (paths.empty()) {
+    throw socket::SocketException("A multipath socket needs at least one path");
+  }
+  std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+  for (const auto &socket : paths) {
+    _paths.push_back(std::make_unique<Path>());
+    _paths.back()->socket = socket;
+  }
+  for (auto &path : _paths) {
+    _start(path.get());
+  }
+}
+
+MultipathSocket::~MultipathSocket() {
+  if (!_closing) {
+    close();
+  }
+}
+
+void MultipathSocket::send(const std::string &data) {
+  std::unique_lock<metrics::InstrumentedMutex> lock(_mutex);
+  for (std::size_t offset = 0; offset < data.size();
+       offset += _options.segment_size) {
+    const auto size = std::min(_options.segment_size, data.size() - offset);
+    Segment segment{_next_sequence, frame_header(kFrameSegment, _next_sequence,
+                                                 size),
+                    Clock::time_point()};
+    segment.data.append(data, offset, size);
+
+    Path *path = nullptr;
+    _cv.wait(lock, [&]() {
+      return _is_finished() ||
+             (path = _choose_path(segment.data.size(), true));
+    });
+    if (_is_finished()) {
+      throw socket::SocketException(_finished_reason());
+    }
+    _next_sequence++;
+    _queue(path, std::move(segment));
+  }
+}
+
+std::string MultipathSocket::receive() {
+  std::unique_lock<metrics::InstrumentedMutex> lock(_mutex);
+  _cv.wait(lock, [this]() { return !_received.empty() || _is_finished(); });
+  if (_received.empty()) {
+    throw socket::SocketException(_finished_reason());
+  }
+  std::string data;
+  data.swap(_received);
+  _cv.notify_all();
+  return data;
+}
+
+void MultipathSocket::close() {
+  {
+    std::unique_lock<metrics::InstrumentedMutex> lock(_mutex);
+    BOOST_ASSERT(!_closing);
+    // closing a path with acknowledgements still unread would reset it,
+    // possibly before the other end has read the data sent on it
+    _cv.wait_for(lock, kCloseTimeout, [this]() {
+      return _remote_closed ||
+             std::all_of(_paths.begin(), _paths.end(),
+                         [](const std::unique_ptr<Path> &path) {
+                           return path->stats.failed ||
+                                  path->pending_bytes == 0;
+                         });
+    });
+    _closing = true;
+  }
+  // senders tell the other end that we're closing before they exit
+  _cv.notify_all();
+  for (auto &path : _paths) {
+    path->sender.join();
+  }
+  {
+    std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+    for (auto &path : _paths) {
+      path->socket->shutdown();
+    }
+  }
+  for (auto &path : _paths) {
+    path->receiver.join();
+  }
+  // only now that no thread uses them can their descriptors be reused
+  for (auto &path : _paths) {
+    try {
+      path->socket->close();
+    } catch (const socket::SocketException &e) {
+      LOG(level::Warning) << "Failed to close path: " << e.what();
+    }
+  }
+}
+
+void MultipathSocket::add_path(std::shared_ptr<Socket> socket) {
+  std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+  if (_closing) {
+    socket->close();
+    return;
+  }
+  _paths.push_back(std::make_unique<Path>());
+  auto *path = _paths.back().get();
+  path->socket = socket;
+  while (!_unsent.empty()) {
+    _queue(path, std::move(_unsent.front()));
+    _unsent.pop_front();
+  }
+  _start(path);
+  _cv.notify_all();
+}
+
+void MultipathSocket::drop_paths_from(const std::string &ip,
+                                      const std::string &reason) {
+  std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+  for (auto &path : _paths) {
+    if (!path->stats.failed && path->socket->get_local_address().ip() == ip) {
+      _fail(path.get(), reason);
+    }
+  }
+}
+
+void MultipathSocket::set_disconnect_handler(std::function<void()> handler) {
+  std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+  _disconnect_handler = handler;
+}
+
+void MultipathSocket::abandon(const std::string &reason) {
+  std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+  _abandoned = true;
+  _failure = reason;
+  _cv.notify_all();
+}
+
+std::vector<PathStats> MultipathSocket::path_stats() {
+  std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+  std::vector<PathStats> stats;
+  for (const auto &path : _paths) {
+    stats.push_back(path->stats);
+    stats.back().quality = path->socket->get_path_quality();
+  }
+  return stats;
+}
+
+void MultipathSocket::_start(Path *path) {
+  path->last_sent = path->last_received = Clock::now();
+  path->sender = std::thread(&MultipathSocket::_send_loop, this, path);
+  path->receiver = std::thread(&MultipathSocket::_receive_loop, this, path);
+}
+
+void MultipathSocket::_send_loop(Path *path) {
+  const auto heartbeat_interval =
+      std::chrono::milliseconds(_options.heartbeat_interval_ms);
+  const auto path_timeout = std::chrono::milliseconds(_options.path_timeout_ms);
+  std::unique_lock<metrics::InstrumentedMutex> lock(_mutex);
+  while (true) {
+    const auto has_work = [this, path]() {
+      return _closing || path->stats.failed ||
+             !path->acknowledgements.empty() || !path->queued.empty();
+    };
+    if (_options.heartbeat_interval_ms == 0) {
+      _cv.wait(lock, has_work);
+    } else {
+      _cv.wait_until(lock, path->last_sent + heartbeat_interval, has_work);
+    }
+    if (path->stats.failed) {
+      return;
+    }
+    if (_closing) {
+      lock.unlock();
+      try {
+        path->socket->send(frame_header(kFrameClose, 0, 0));
+      } catch (const socket::SocketException &e) {
+      }
+      return;
+    }
+    if (_options.path_timeout_ms != 0 &&
+        Clock::now() - path->last_received > path_timeout) {
+      _fail(path, "Nothing received for " +
+                      std::to_string(_options.path_timeout_ms) + "ms");
+      return;
+    }
+
+    // acknowledgements go first so that the other end's round trip times
+    // don't include our queue
+    std::string frames;
+    for (const auto sequence : path->acknowledgements) {
+      frames += frame_header(kFrameAcknowledgement, sequence, 0);
+    }
+    path->acknowledgements.clear();
+    std::size_t segment_size = 0;
+    if (!path->queued.empty()) {
+      auto &segment = path->queued.front();
+      segment.sent_at = Clock::now();
+      segment_size = segment.data.size();
+      frames += segment.data;
+      path->queued_bytes -= segment_size;
+      path->unacknowledged.push_back(std::move(segment));
+      path->queued.pop_front();
+    }
+    if (frames.empty()) {
+      frames = frame_header(kFrameHeartbeat, 0, 0);
+    }
+
+    lock.unlock();
+    const auto start = Clock::now();
+    try {
+      path->socket->send(frames);
+    } catch (const socket::SocketException &e) {
+      lock.lock();
+      _fail(path, e.what());
+      return;
+    }
+    const auto elapsed = std::chrono::duration<double>(Clock::now() - start);
+    lock.lock();
+
+    path->last_sent = Clock::now();
+    if (segment_size != 0) {
+      path->stats.bytes_sent += segment_size;
+      if (elapsed.count() > 0) {
+        smooth(path->stats.throughput, frames.size() / elapsed.count());
+      }
+    }
+  }
+}
+
+void MultipathSocket::_receive_loop(Path *path) {
+  try {
+    char header[kHeaderSize];
+    while (true) {
+      path->socket->receive_exactly(header, kHeaderSize);
+      const auto sequence = util::read_integer(header + 1, 8);
+      const auto size = util::read_integer(header + 9, 4);
+      // checked before allocating, and so that we don't lose our place in
+      // the stream by skipping a payload
+      if (header[0] != kFrameSegment && size != 0) {
+        throw socket::SocketException("Multipath frame of kind " +
+                                      std::to_string(header[0]) +
+                                      " has a payload");
+      } else if (size > _options.segment_size) {
+        throw socket::SocketException(
+            "Multipath segment of " + std::to_string(size) +
+            " bytes is larger than " + std::to_string(_options.segment_size));
+      }
+      std::string data(size, '\0');
+      if (size != 0) {
+        path->socket->receive_exactly(&data[0], size);
+      }
+
+      std::unique_lock<metrics::InstrumentedMutex> lock(_mutex);
+      path->last_received = Clock::now();
+      switch (header[0]) {
+      case kFrameSegment:
+        path->acknowledgements.push_back(sequence);
+        _on_segment(sequence, std::move(data));
+        break;
+      case kFrameAcknowledgement:
+        _on_acknowledgement(path, sequence);
+        break;
+      case kFrameHeartbeat:
+        break;
+      case kFrameClose:
+        _remote_closed = true;
+        break;
+      default:
+        throw socket::SocketException("Unknown multipath frame kind " +
+                                      std::to_string(header[0]));
+      }
+      _cv.notify_all();
+      _cv.wait(lock, [this]() {
+        return _closing || _received.size() < _options.max_buffered_bytes;
+      });
+      if (_closing) {
+        return;
+      }
+    }
+  } catch (const socket::SocketException &e) {
+    std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+    _fail(path, e.what());
+  }
+}
+
+MultipathSocket::Path *MultipathSocket::_choose_path(std::size_t size,
+                                                     bool must_have_room) {
+  Path *best = nullptr;
+  double best_delivery_s = 0;
+  for (auto &path : _paths) {
+    if (path->stats.failed ||
+        (must_have_room && path->pending_bytes != 0 &&
+         path->pending_bytes + size > _options.max_pending_bytes)) {
+      continue;
+    }
+    const auto throughput = path->stats.throughput != 0
+                                ? path->stats.throughput
+                                : kDefaultThroughput;
+    const auto delivery_s = path->stats.rtt_us / 1e6 +
+                            (path->queued_bytes + size) / throughput;
+    if (!best || delivery_s < best_delivery_s) {
+      best = path.get();
+      best_delivery_s = delivery_s;
+    }
+  }
+  return best;
+}
+
+void MultipathSocket::_queue(Path *path, Segment segment) {
+  path->queued_bytes += segment.data.size();
+  path->pending_bytes += segment.data.size();
+  path->queued.push_back(std::move(segment));
+  _cv.notify_all();
+}
+
+void MultipathSocket::_on_acknowledgement(Path *path, std::uint64_t sequence) {
+  // segments are acknowledged in the order they were sent on a path
+  const auto segment =
+      std::find_if(path->unacknowledged.begin(), path->unacknowledged.end(),
+                   [sequence](const Segment &segment) {
+                     return segment.sequence == sequence;
+                   });
+  if (segment == path->unacknowledged.end()) {
+    return;
+  }
+  smooth(path->stats.rtt_us, std::chrono::duration<double, std::micro>(
+                                 Clock::now() - segment->sent_at)
+                                 .count());
+  path->pending_bytes -= segment->data.size();
+  path->unacknowledged.erase(segment);
+}
+
+void MultipathSocket::_on_segment(std::uint64_t sequence, std::string data) {
+  if (sequence < _next_received_sequence) {
+    // sent again after a path failed, but it had arrived after all
+    return;
+  } else if (sequence > _next_received_sequence) {
+    _out_of_order.emplace(sequence, std::move(data));
+    return;
+  }
+  _received += data;
+  _next_received_sequence++;
+  auto next = _out_of_order.begin();
+  while (next != _out_of_order.end() &&
+         next->first == _next_received_sequence) {
+    _received += next->second;
+    _next_received_sequence++;
+    next = _out_of_order.erase(next);
+  }
+}
+
+void MultipathSocket::_fail(Path *path, const std::string &reason) {
+  if (_closing || path->stats.failed) {
+    return;
+  }
+  path->stats.failed = true;
+  _failure = reason;
+  // wakes up the path's other thread, which may still be using the socket;
+  // close() closes it once both have exited
+  path->socket->shutdown();
+
+  std::deque<Segment> segments;
+  segments.swap(path->unacknowledged);
+  std::move(path->queued.begin(), path->queued.end(),
+            std::back_inserter(segments));
+  path->queued.clear();
+  path->queued_bytes = 0;
+  path->pending_bytes = 0;
+  path->acknowledgements.clear();
+  if (!_remote_closed) {
+    LOG(level::Warning) << "Multipath path failed with " << segments.size()
+                        << " unacknowledged segments: " << reason;
+  }
+  for (auto &segment : segments) {
+    const auto other = _choose_path(segment.data.size(), false);
+    if (other) {
+      _queue(other, std::move(segment));
+    } else {
+      _unsent.push_back(std::move(segment));
+    }
+  }
+  if (!_has_live_path() && _options.wait_for_paths && !_remote_closed &&
+      _disconnect_handler) {
+    _disconnect_handler();
+  }
+  _cv.notify_all();
+}
+
+bool MultipathSocket::_has_live_path() const {
+  return std::any_of(
+      _paths.begin(), _paths.end(),
+      [](const std::unique_ptr<Path> &path) { return !path->stats.failed; });
+}
+
+bool MultipathSocket::_is_finished() const {
+  return _closing || _remote_closed || _abandoned ||
+         (!_options.wait_for_paths && !_has_live_path());
+}
+
+std::string MultipathSocket::_finished_reason() const {
+  if (_closing) {
+    return "Socket is closed";
+  } else if (_remote_closed) {
+    return "receive failed: Peer closed connection";
+  } else if (_abandoned) {
+    return _failure;
+  }
+  return "All paths failed. Last failure: " + _failure;
+}
+}
+}
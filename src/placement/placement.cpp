@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <mutex>
+#include <p2psc/log.h>
+#include <p2psc/placement/placement.h>
+#include <p2psc/placement/placement_exception.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+
+namespace p2psc {
+namespace placement {
+namespace {
+
+std::mutex &placement_mutex() {
+  static std::mutex m;
+  return m;
+}
+
+Placement &global_placement() {
+  static Placement placement;
+  return placement;
+}
+
+// the next CPU to hand out when pin_to_single_cpu is set
+std::atomic<unsigned> next_cpu_index(0);
+}
+
+CpuSet CpuSet::parse(const std::string &cpu_list) {
+  CpuSet set;
+  std::stringstream stream(cpu_list);
+  std::string range;
+  while (std::getline(stream, range, ',')) {
+    range.erase(std::remove_if(range.begin(), range.end(), ::isspace),
+                range.end());
+    if (range.empty()) {
+      continue;
+    }
+    try {
+      const auto dash = range.find('-');
+      const int first = std::stoi(range.substr(0, dash));
+      const int last =
+          dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+      if (first < 0 || last < first) {
+        throw std::invalid_argument(range);
+      }
+      for (int cpu = first; cpu <= last; cpu++) {
+        set.add(cpu);
+      }
+    } catch (const std::logic_error &e) {
+      throw PlacementException("Invalid cpu list \"" + cpu_list + "\"");
+    }
+  }
+  return set;
+}
+
+CpuSet CpuSet::of_numa_node(int node) {
+  const auto path =
+      "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist";
+  std::ifstream file(path);
+  std::string cpu_list;
+  if (!file || !std::getline(file, cpu_list)) {
+    throw PlacementException("Unknown NUMA node " + std::to_string(node));
+  }
+  return parse(cpu_list);
+}
+
+void CpuSet::add(int cpu) {
+  const auto it = std::lower_bound(_cpus.begin(), _cpus.end(), cpu);
+  if (it == _cpus.end() || *it != cpu) {
+    _cpus.insert(it, cpu);
+  }
+}
+
+bool CpuSet::contains(int cpu) const {
+  return std::binary_search(_cpus.begin(), _cpus.end(), cpu);
+}
+
+std::string CpuSet::to_string() const {
+  std::stringstream out;
+  for (std::size_t i = 0; i < _cpus.size();) {
+    std::size_t j = i;
+    while (j + 1 < _cpus.size() && _cpus[j + 1] == _cpus[j] + 1) {
+      j++;
+    }
+    out << (i == 0 ? "" : ",") << _cpus[i];
+    if (j > i) {
+      out << "-" << _cpus[j];
+    }
+    i = j + 1;
+  }
+  return out.str();
+}
+
+void set_placement(const Placement &placement) {
+  std::lock_guard<std::mutex> guard(placement_mutex());
+  global_placement() = placement;
+}
+
+Placement get_placement() {
+  std::lock_guard<std::mutex> guard(placement_mutex());
+  return global_placement();
+}
+
+void pin_current_thread(const CpuSet &cpus) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (const auto cpu : cpus.cpus()) {
+    if (cpu >= CPU_SETSIZE) {
+      throw PlacementException("CPU " + std::to_string(cpu) +
+                               " is out of range");
+    }
+    CPU_SET(cpu, &set);
+  }
+  const auto error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (error != 0) {
+    throw PlacementException("Failed to pin thread to CPUs " +
+                             cpus.to_string() + ": " + strerror(error));
+  }
+}
+
+int current_cpu() { return sched_getcpu(); }
+
+int numa_node_of_cpu(int cpu) {
+  // each cpu directory contains a "nodeN" link to the node it belongs to
+  const auto path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+  DIR *dir = opendir(path.c_str());
+  if (!dir) {
+    throw PlacementException("Unknown CPU " + std::to_string(cpu));
+  }
+  int node = 0;
+  while (const auto entry = readdir(dir)) {
+    if (strncmp(entry->d_name, "node", 4) == 0 &&
+        isdigit(static_cast<unsigned char>(entry->d_name[4]))) {
+      node = std::stoi(entry->d_name + 4);
+      break;
+    }
+  }
+  closedir(dir);
+  return node;
+}
+
+void apply_to_connection_thread() {
+  const auto placement = get_placement();
+  if (placement.connection_cpus.empty()) {
+    return;
+  }
+  CpuSet cpus = placement.connection_cpus;
+  if (placement.pin_to_single_cpu) {
+    const auto &all = placement.connection_cpus.cpus();
+    cpus = CpuSet();
+    cpus.add(all[next_cpu_index++ % all.size()]);
+  }
+  try {
+    pin_current_thread(cpus);
+  } catch (const PlacementException &e) {
+    LOG(level::Warning) << "Ignoring connection thread placement: "
+                        << e.what();
+  }
+}
+
+void apply_incoming_cpu(int incoming_cpu) {
+  const auto placement = get_placement();
+  if (!placement.follow_incoming_cpu || incoming_cpu < 0) {
+    return;
+  }
+  if (!placement.connection_cpus.empty() &&
+      !placement.connection_cpus.contains(incoming_cpu)) {
+    return;
+  }
+  CpuSet cpus;
+  cpus.add(incoming_cpu);
+  try {
+    pin_current_thread(cpus);
+    LOG(level::Debug) << "Moved handshake to incoming CPU " << incoming_cpu;
+  } catch (const PlacementException &e) {
+    LOG(level::Warning) << "Could not follow incoming CPU: " << e.what();
+  }
+}
+}
+}
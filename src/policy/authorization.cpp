@@ -0,0 +1,308 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <p2psc/policy/authorization.h>
+#include <p2psc/policy/policy_exception.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * File layout, in the host's byte order (the file is mapped, not parsed):
+ *
+ *   Header                                   64 bytes
+ *   Bloom filter        bloom_blocks blocks of 64 bytes (one cache line)
+ *   Directory           2^directory_bits + 1 entry indices, 8 bytes each
+ *   Entries             pairs entries of 16 bytes, sorted by (from, to)
+ *
+ * A pair sets bloom_probes bits of the one block its hash picks. The
+ * directory holds, for every value of the top directory_bits bits of from,
+ * the index of the first entry with at least that value.
+ */
+namespace p2psc {
+namespace policy {
+
+struct AuthorizationFilter::Header {
+  char magic[8];
+  std::uint32_t byte_order;
+  std::uint32_t bloom_probes;
+  std::uint64_t pairs;
+  std::uint64_t bloom_blocks;
+  std::uint64_t directory_bits;
+  std::uint64_t reserved[3];
+};
+
+struct AuthorizationFilter::Entry {
+  std::uint64_t from;
+  std::uint64_t to;
+
+  bool operator<(const Entry &other) const {
+    return from < other.from || (from == other.from && to < other.to);
+  }
+  bool operator==(const Entry &other) const {
+    return from == other.from && to == other.to;
+  }
+};
+
+namespace {
+
+const char kMagic[8] = {'P', '2', 'P', 'S', 'C', 'A', 'F', '1'};
+const std::uint32_t kByteOrder = 0x01020304;
+// hex SHA-256
+const std::size_t kFingerprintLength = 64;
+const std::size_t kBlockWords = 8;
+// each probe takes 9 bits of a 64 bit hash
+const std::uint32_t kMaxProbes = 7;
+// entries per directory bucket to aim for
+const std::uint64_t kBucketSize = 4;
+
+std::string error_string() { return std::string(strerror(errno)); }
+
+struct HexDigits {
+  HexDigits() {
+    memset(values, -1, sizeof(values));
+    for (int i = 0; i < 10; i++) {
+      values['0' + i] = i;
+    }
+    for (int i = 0; i < 6; i++) {
+      values['a' + i] = values['A' + i] = 10 + i;
+    }
+  }
+
+  // -1 for characters which aren't hex digits
+  std::int8_t values[256];
+};
+
+const HexDigits kHexDigits;
+
+bool parse_prefix(const std::string &fingerprint, std::uint64_t &prefix) {
+  if (fingerprint.size() != kFingerprintLength) {
+    return false;
+  }
+  std::uint64_t value = 0;
+  std::int8_t invalid = 0;
+  for (std::size_t i = 0; i < 16; i++) {
+    const auto digit =
+        kHexDigits.values[static_cast<unsigned char>(fingerprint[i])];
+    invalid |= digit;
+    value = value << 4 | static_cast<std::uint64_t>(digit & 15);
+  }
+  // only -1 has the sign bit set
+  if (invalid < 0) {
+    return false;
+  }
+  prefix = value;
+  return true;
+}
+
+// the splitmix64 finaliser
+std::uint64_t mix(std::uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+std::uint64_t block_of(std::uint64_t hash, std::uint64_t blocks) {
+  return static_cast<std::uint64_t>(
+      (static_cast<unsigned __int128>(hash) * blocks) >> 64);
+}
+
+std::uint64_t bucket_of(std::uint64_t from, std::uint64_t directory_bits) {
+  return directory_bits == 0 ? 0 : from >> (64 - directory_bits);
+}
+
+std::uint64_t file_size(std::uint64_t bloom_blocks,
+                        std::uint64_t directory_bits, std::uint64_t pairs) {
+  return 64 + bloom_blocks * kBlockWords * 8 +
+         ((std::uint64_t(1) << directory_bits) + 1) * 8 + pairs * 16;
+}
+}
+
+void AuthorizationFilter::build(const std::vector<FingerprintPair> &pairs,
+                                const std::string &path,
+                                const AuthorizationFilterOptions &options) {
+  std::vector<Entry> entries;
+  entries.reserve(pairs.size());
+  for (const auto &pair : pairs) {
+    Entry entry;
+    if (!parse_prefix(pair.first, entry.from) ||
+        !parse_prefix(pair.second, entry.to)) {
+      throw PolicyException("Invalid fingerprint pair: " + pair.first + " " +
+                            pair.second);
+    }
+    entries.push_back(entry);
+  }
+  std::sort(entries.begin(), entries.end());
+  entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+  static_assert(sizeof(Header) == 64 && sizeof(Entry) == 16, "");
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.byte_order = kByteOrder;
+  header.pairs = entries.size();
+  const auto bits_per_pair =
+      std::max<std::size_t>(options.bloom_bits_per_pair, 1);
+  header.bloom_probes = std::max<std::uint32_t>(
+      1, std::min<std::uint32_t>(kMaxProbes, std::lround(bits_per_pair *
+                                                         std::log(2.0))));
+  header.bloom_blocks = std::max<std::uint64_t>(
+      1, (entries.size() * bits_per_pair + 511) / 512);
+  while (header.directory_bits < 32 &&
+         (std::uint64_t(2) << header.directory_bits) * kBucketSize <=
+             entries.size()) {
+    header.directory_bits++;
+  }
+
+  std::vector<std::uint64_t> bloom(header.bloom_blocks * kBlockWords, 0);
+  for (const auto &entry : entries) {
+    const auto hash = mix(entry.from ^ mix(entry.to));
+    auto *block = &bloom[block_of(hash, header.bloom_blocks) * kBlockWords];
+    auto probes = mix(hash);
+    for (std::uint32_t i = 0; i < header.bloom_probes; i++, probes >>= 9) {
+      block[(probes >> 6) & 7] |= std::uint64_t(1) << (probes & 63);
+    }
+  }
+  std::vector<std::uint64_t> directory(
+      (std::uint64_t(1) << header.directory_bits) + 1);
+  std::uint64_t index = 0;
+  for (std::uint64_t bucket = 0; bucket < directory.size(); bucket++) {
+    while (index < entries.size() &&
+           bucket_of(entries[index].from, header.directory_bits) < bucket) {
+      index++;
+    }
+    directory[bucket] = index;
+  }
+  directory.back() = entries.size();
+
+  const auto temporary_path = path + ".tmp";
+  {
+    std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(bloom.data()),
+               bloom.size() * sizeof(bloom[0]));
+    file.write(reinterpret_cast<const char *>(directory.data()),
+               directory.size() * sizeof(directory[0]));
+    file.write(reinterpret_cast<const char *>(entries.data()),
+               entries.size() * sizeof(entries[0]));
+    file.close();
+    if (!file) {
+      std::remove(temporary_path.c_str());
+      throw PolicyException("Failed to write " + temporary_path);
+    }
+  }
+  if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+    const auto reason = error_string();
+    std::remove(temporary_path.c_str());
+    throw PolicyException("Failed to replace " + path + ". Reason: " + reason);
+  }
+}
+
+std::shared_ptr<const AuthorizationFilter>
+AuthorizationFilter::open(const std::string &path) {
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw PolicyException("Failed to open " + path +
+                          ". Reason: " + error_string());
+  }
+  struct stat stats;
+  if (fstat(fd, &stats) != 0) {
+    const auto reason = error_string();
+    ::close(fd);
+    throw PolicyException("Failed to stat " + path + ". Reason: " + reason);
+  }
+  return std::shared_ptr<const AuthorizationFilter>(
+      new AuthorizationFilter(fd, stats.st_size, path));
+}
+
+AuthorizationFilter::AuthorizationFilter(int fd, std::uint64_t size,
+                                         const std::string &path)
+    : _fd(fd), _size(size), _data(nullptr) {
+  if (size < sizeof(Header)) {
+    ::close(fd);
+    throw PolicyException(path + " is not an authorization filter");
+  }
+  void *data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) {
+    const auto reason = error_string();
+    ::close(fd);
+    throw PolicyException("Failed to map " + path + ". Reason: " + reason);
+  }
+  _data = static_cast<const char *>(data);
+  _header = reinterpret_cast<const Header *>(_data);
+  if (memcmp(_header->magic, kMagic, sizeof(kMagic)) != 0 ||
+      _header->byte_order != kByteOrder || _header->bloom_blocks == 0 ||
+      _header->bloom_probes == 0 || _header->bloom_probes > kMaxProbes ||
+      _header->directory_bits > 32 ||
+      file_size(_header->bloom_blocks, _header->directory_bits,
+                _header->pairs) != size) {
+    munmap(data, size);
+    ::close(fd);
+    throw PolicyException(path + " is not an authorization filter");
+  }
+  // checks land anywhere in the file
+  madvise(data, size, MADV_RANDOM);
+  _bloom = reinterpret_cast<const std::uint64_t *>(_data + sizeof(Header));
+  _directory = _bloom + _header->bloom_blocks * kBlockWords;
+  _entries = reinterpret_cast<const Entry *>(
+      _directory + (std::uint64_t(1) << _header->directory_bits) + 1);
+}
+
+AuthorizationFilter::~AuthorizationFilter() {
+  munmap(const_cast<char *>(_data), _size);
+  ::close(_fd);
+}
+
+bool AuthorizationFilter::allows(const std::string &from_fingerprint,
+                                 const std::string &to_fingerprint) const {
+  Entry entry;
+  if (!parse_prefix(from_fingerprint, entry.from) ||
+      !parse_prefix(to_fingerprint, entry.to)) {
+    return false;
+  }
+
+  const auto hash = mix(entry.from ^ mix(entry.to));
+  const auto *block =
+      _bloom + block_of(hash, _header->bloom_blocks) * kBlockWords;
+  const auto bucket = bucket_of(entry.from, _header->directory_bits);
+  // both are likely cache misses; wait for them together
+  __builtin_prefetch(block);
+  __builtin_prefetch(_directory + bucket);
+  auto probes = mix(hash);
+  for (std::uint32_t i = 0; i < _header->bloom_probes; i++, probes >>= 9) {
+    if (!(block[(probes >> 6) & 7] & (std::uint64_t(1) << (probes & 63)))) {
+      return false;
+    }
+  }
+
+  const auto *first = _entries + _directory[bucket];
+  const auto *last = _entries + _directory[bucket + 1];
+  const auto it = std::lower_bound(first, last, entry);
+  return it != last && *it == entry;
+}
+
+std::uint64_t AuthorizationFilter::pairs() const { return _header->pairs; }
+
+Authorization::Authorization(const std::string &path)
+    : _path(path), _filter(AuthorizationFilter::open(path)) {}
+
+bool Authorization::allows(const std::string &from_fingerprint,
+                           const std::string &to_fingerprint) const {
+  return filter()->allows(from_fingerprint, to_fingerprint);
+}
+
+void Authorization::reload() {
+  std::atomic_store(&_filter, AuthorizationFilter::open(_path));
+}
+
+std::shared_ptr<const AuthorizationFilter> Authorization::filter() const {
+  return std::atomic_load(&_filter);
+}
+}
+}
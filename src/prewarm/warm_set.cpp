@@ -0,0 +1,94 @@
+#include <cstring>
+#include <p2psc/log.h>
+#include <prewarm/warm_set.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace p2psc {
+namespace prewarm {
+
+std::string WarmSet::key_of(const key::Keypair &our_keypair,
+                            const Peer &peer) {
+  return our_keypair.get_serialised_public_key() + "\n" +
+         peer.public_key.serialise();
+}
+
+bool WarmSet::start(const std::string &key) {
+  std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+  return _entries.emplace(key, std::make_shared<Entry>()).second;
+}
+
+void WarmSet::park(const std::string &key, std::shared_ptr<Socket> socket,
+                   std::chrono::milliseconds ttl) {
+  std::unique_lock<metrics::InstrumentedMutex> lock(_mutex);
+  const auto it = _entries.find(key);
+  if (it == _entries.end()) {
+    return;
+  }
+  const auto entry = it->second;
+  entry->ready = true;
+  entry->socket = socket;
+  if (!socket) {
+    _entries.erase(it);
+    _cv.notify_all();
+    return;
+  }
+  _cv.notify_all();
+  if (_cv.wait_for(lock, ttl, [&]() { return entry->taken; })) {
+    return;
+  }
+  // by now, key may belong to a later prewarm
+  const auto current = _entries.find(key);
+  if (current != _entries.end() && current->second == entry) {
+    _entries.erase(current);
+  }
+  entry->socket = nullptr;
+  lock.unlock();
+  LOG(level::Info) << "Closing prewarmed connection which wasn't used";
+  socket->close();
+}
+
+std::shared_ptr<Socket> WarmSet::take(const std::string &key) {
+  std::unique_lock<metrics::InstrumentedMutex> lock(_mutex);
+  const auto it = _entries.find(key);
+  if (it == _entries.end()) {
+    return nullptr;
+  }
+  const auto entry = it->second;
+  if (!entry->ready) {
+    LOG(level::Info) << "Waiting for connection being prewarmed";
+  }
+  _cv.wait(lock, [&]() { return entry->ready; });
+  if (entry->taken || !entry->socket) {
+    return nullptr;
+  }
+  entry->taken = true;
+  const auto current = _entries.find(key);
+  if (current != _entries.end() && current->second == entry) {
+    _entries.erase(current);
+  }
+  _cv.notify_all();
+  return std::move(entry->socket);
+}
+
+std::size_t WarmSet::size() {
+  std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+  return _entries.size();
+}
+
+WarmSet &warm_set() {
+  static WarmSet set;
+  return set;
+}
+
+void lower_thread_priority() {
+  // with a thread id, setpriority only applies to that thread
+  const auto tid = static_cast<id_t>(syscall(SYS_gettid));
+  if (setpriority(PRIO_PROCESS, tid, kPrewarmNice) != 0) {
+    LOG(level::Debug) << "Could not lower prewarm thread priority: "
+                      << strerror(errno);
+  }
+}
+}
+}
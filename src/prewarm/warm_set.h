@@ -0,0 +1,69 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <p2psc/key/keypair.h>
+#include <p2psc/metrics/instrumented_mutex.h>
+#include <p2psc/peer.h>
+#include <p2psc/socket/socket.h>
+#include <string>
+
+namespace p2psc {
+namespace prewarm {
+
+/*
+ * Connections set up ahead of the connect() that needs them (see
+ * Connection::prewarm), by the pair of keys they connect. A connection is
+ * either being prewarmed, in which case a connect() waits for it rather than
+ * starting a second handshake with the same keys, or parked until it's taken
+ * or its TTL runs out.
+ */
+class WarmSet {
+public:
+  static std::string key_of(const key::Keypair &our_keypair, const Peer &peer);
+
+  /*
+   * Claim key for a prewarm. False if it's already being prewarmed or a
+   * connection is parked for it.
+   */
+  bool start(const std::string &key);
+  /*
+   * Park the prewarmed socket (nullptr if prewarming failed) and block until
+   * it's taken, or until ttl has passed, when it's closed.
+   */
+  void park(const std::string &key, std::shared_ptr<Socket> socket,
+            std::chrono::milliseconds ttl);
+  /*
+   * The socket parked for key, waiting for it first if key is being
+   * prewarmed. nullptr if there is none, or prewarming failed.
+   */
+  std::shared_ptr<Socket> take(const std::string &key);
+
+  // connections being prewarmed or parked
+  std::size_t size();
+
+private:
+  struct Entry {
+    bool ready = false;
+    bool taken = false;
+    std::shared_ptr<Socket> socket;
+  };
+
+  metrics::InstrumentedMutex _mutex{"prewarm::WarmSet"};
+  std::condition_variable_any _cv;
+  std::map<std::string, std::shared_ptr<Entry>> _entries;
+};
+
+// the process-wide set Connection uses
+WarmSet &warm_set();
+
+/*
+ * Run the calling thread at a lower priority (nice kPrewarmNice), so that
+ * prewarms give way to connections already needed.
+ */
+const int kPrewarmNice = 10;
+void lower_thread_priority();
+}
+}
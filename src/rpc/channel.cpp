@@ -0,0 +1,318 @@
+#include <future>
+#include <p2psc/log.h>
+#include <p2psc/rpc/channel.h>
+#include <p2psc/rpc/rpc_exception.h>
+#include <util/big_endian.h>
+#include <vector>
+
+namespace p2psc {
+namespace rpc {
+namespace {
+
+/*
+ * Every frame is a one byte kind, the call id (8 bytes, big endian), the
+ * length of the method name (2 bytes, big endian), the payload length
+ * (4 bytes, big endian), the method name and the payload. Only requests
+ * have a method name; the payload of an error is its reason.
+ */
+enum FrameKind : char {
+  kFrameRequest = 0,
+  kFrameResponse = 1,
+  kFrameError = 2
+};
+
+const std::size_t kHeaderSize = 15;
+const std::size_t kMaxMethodSize = 0xffff;
+// Smaller payloads are copied into the frame; larger ones are sent after
+// the header (with MSG_MORE) rather than copied.
+const std::size_t kCopyThreshold = 16 * 1024;
+}
+
+struct Responder::Writer {
+  Writer(std::shared_ptr<Socket> socket, std::size_t max_payload_size)
+      : socket(socket), max_payload_size(max_payload_size),
+        mutex("rpc::Channel::Writer") {}
+
+  // Throws SocketException.
+  void write(FrameKind kind, std::uint64_t id, const std::string &method,
+             const std::string &payload) {
+    std::string frame(1, kind);
+    util::write_integer(frame, id, 8);
+    util::write_integer(frame, method.size(), 2);
+    util::write_integer(frame, payload.size(), 4);
+    frame += method;
+    std::lock_guard<metrics::InstrumentedMutex> guard(mutex);
+    if (payload.size() < kCopyThreshold) {
+      socket->send(frame + payload);
+    } else {
+      socket->send_more(frame);
+      socket->send(payload);
+    }
+  }
+
+  const std::shared_ptr<Socket> socket;
+  const std::size_t max_payload_size;
+  metrics::InstrumentedMutex mutex;
+};
+
+Responder::Responder(std::weak_ptr<Writer> writer, std::uint64_t id)
+    : _writer(writer), _id(id),
+      _responded(std::make_shared<std::atomic<bool>>(false)) {}
+
+void Responder::respond(const std::string &response) {
+  const auto writer = _writer.lock();
+  if (!writer) {
+    return;
+  }
+  if (response.size() > writer->max_payload_size) {
+    fail("Response of " + std::to_string(response.size()) +
+         " bytes is too large");
+    return;
+  }
+  if (_responded->exchange(true)) {
+    return;
+  }
+  try {
+    writer->write(kFrameResponse, _id, "", response);
+  } catch (const socket::SocketException &e) {
+    LOG(level::Debug) << "Dropping RPC response: " << e.what();
+  }
+}
+
+void Responder::fail(const std::string &reason) {
+  const auto writer = _writer.lock();
+  if (!writer || _responded->exchange(true)) {
+    return;
+  }
+  try {
+    writer->write(kFrameError, _id, "",
+                  reason.substr(0, writer->max_payload_size));
+  } catch (const socket::SocketException &e) {
+    LOG(level::Debug) << "Dropping RPC response: " << e.what();
+  }
+}
+
+Channel::Channel(std::shared_ptr<Socket> socket, const Handler &handler,
+                 const ChannelOptions &options)
+    : _socket(socket), _handler(handler), _options(options),
+      _writer(std::make_shared<Responder::Writer>(socket,
+                                                  options.max_payload_size)),
+      _mutex("rpc::Channel"), _closing(false), _socket_closed(false),
+      _next_id(1),
+      _receiver(&Channel::_receive_loop, this),
+      _deadline_thread(&Channel::_deadline_loop, this) {}
+
+Channel::~Channel() { close(); }
+
+void Channel::call(const std::string &method, const std::string &request,
+                   std::chrono::milliseconds timeout,
+                   const ResponseCallback &callback) {
+  if (method.size() > kMaxMethodSize ||
+      request.size() > _options.max_payload_size) {
+    callback(Error(error::kErrorRpcCallFailed,
+                   "Method name or request is too large"),
+             Payload());
+    return;
+  }
+  std::unique_lock<metrics::InstrumentedMutex> lock(_mutex);
+  if (_failure) {
+    const auto failure = _failure;
+    lock.unlock();
+    callback(failure, Payload());
+    return;
+  }
+  const auto id = _next_id++;
+  const auto deadline = Clock::now() + timeout;
+  _calls.emplace(id, Call{callback, deadline});
+  _deadlines.emplace(deadline, id);
+  if (_deadlines.begin()->second == id) {
+    _cv.notify_all();
+  }
+  lock.unlock();
+
+  try {
+    _writer->write(kFrameRequest, id, method, request);
+  } catch (const socket::SocketException &e) {
+    _complete(id, Error(error::kErrorRpcChannelClosed, e.what()), Payload());
+  }
+}
+
+std::string Channel::call(const std::string &method,
+                          const std::string &request,
+                          std::chrono::milliseconds timeout) {
+  std::promise<std::string> response;
+  call(method, request, timeout, [&](Error error, Payload payload) {
+    if (error) {
+      response.set_exception(
+          std::make_exception_ptr(RpcException(error.reason())));
+    } else {
+      response.set_value(payload.to_string());
+    }
+  });
+  return response.get_future().get();
+}
+
+void Channel::close() {
+  {
+    std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+    if (_closing) {
+      return;
+    }
+    _closing = true;
+    _failure = Error(error::kErrorRpcChannelClosed, "Channel closed");
+  }
+  _cv.notify_all();
+  _close_socket();
+  _receiver.join();
+  _deadline_thread.join();
+}
+
+std::size_t Channel::outstanding_calls() {
+  std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+  return _calls.size();
+}
+
+void Channel::_receive_loop() {
+  std::string received;
+  std::string reason;
+  while (reason.empty()) {
+    try {
+      received += _socket->receive();
+    } catch (const socket::SocketException &e) {
+      reason = e.what();
+      break;
+    }
+    std::size_t offset = 0;
+    while (received.size() - offset >= kHeaderSize) {
+      const auto header = received.data() + offset;
+      const auto method_size = util::read_integer(header + 9, 2);
+      const auto payload_size = util::read_integer(header + 11, 4);
+      if (payload_size > _options.max_payload_size) {
+        reason = "Received an RPC frame of " + std::to_string(payload_size) +
+                 " bytes";
+        break;
+      }
+      const auto size = kHeaderSize + method_size + payload_size;
+      if (received.size() - offset < size) {
+        break;
+      }
+      _on_frame(header[0], util::read_integer(header + 1, 8),
+                Payload(header + kHeaderSize, method_size),
+                Payload(header + kHeaderSize + method_size, payload_size));
+      offset += size;
+    }
+    received.erase(0, offset);
+  }
+
+  bool closing;
+  {
+    std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+    closing = _closing;
+  }
+  if (!closing) {
+    LOG(level::Info) << "RPC channel failed: " << reason;
+    // so that the other end notices too
+    _close_socket();
+  }
+  _fail_all(Error(error::kErrorRpcChannelClosed, reason));
+}
+
+void Channel::_deadline_loop() {
+  std::unique_lock<metrics::InstrumentedMutex> lock(_mutex);
+  while (!_closing) {
+    if (_deadlines.empty()) {
+      _cv.wait(lock);
+    } else if (Clock::now() < _deadlines.begin()->first) {
+      _cv.wait_until(lock, _deadlines.begin()->first);
+    } else {
+      const auto id = _deadlines.begin()->second;
+      lock.unlock();
+      _complete(id,
+                Error(error::kErrorRpcDeadlineExceeded, "Deadline exceeded"),
+                Payload());
+      lock.lock();
+    }
+  }
+}
+
+void Channel::_on_frame(char kind, std::uint64_t id, Payload method,
+                        Payload payload) {
+  switch (kind) {
+  case kFrameRequest:
+    _on_request(id, method, payload);
+    break;
+  case kFrameResponse:
+    _complete(id, Error(), payload);
+    break;
+  case kFrameError:
+    _complete(id, Error(error::kErrorRpcCallFailed, payload.to_string()),
+              Payload());
+    break;
+  default:
+    LOG(level::Warning) << "Ignoring RPC frame of unknown kind "
+                        << static_cast<int>(kind);
+  }
+}
+
+void Channel::_on_request(std::uint64_t id, Payload method,
+                          Payload payload) {
+  Responder responder(_writer, id);
+  if (!_handler) {
+    responder.fail("No handler for RPC requests");
+    return;
+  }
+  try {
+    _handler(method.to_string(), payload, responder);
+  } catch (const std::exception &e) {
+    responder.fail(e.what());
+  }
+}
+
+void Channel::_complete(std::uint64_t id, const Error &error,
+                        Payload response) {
+  ResponseCallback callback;
+  {
+    std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+    const auto call = _calls.find(id);
+    // it timed out, or the other end answered twice
+    if (call == _calls.end()) {
+      return;
+    }
+    callback = std::move(call->second.callback);
+    _deadlines.erase(std::make_pair(call->second.deadline, id));
+    _calls.erase(call);
+  }
+  callback(error, response);
+}
+
+void Channel::_close_socket() {
+  std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+  if (_socket_closed) {
+    return;
+  }
+  _socket_closed = true;
+  try {
+    _socket->close();
+  } catch (const socket::SocketException &e) {
+    LOG(level::Debug) << "Failed to close RPC channel socket: " << e.what();
+  }
+}
+
+void Channel::_fail_all(const Error &error) {
+  std::map<std::uint64_t, Call> calls;
+  Error failure;
+  {
+    std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+    if (!_failure) {
+      _failure = error;
+    }
+    failure = _failure;
+    calls.swap(_calls);
+    _deadlines.clear();
+  }
+  for (const auto &call : calls) {
+    call.second.callback(failure, Payload());
+  }
+}
+}
+}
@@ -0,0 +1,132 @@
+#include <p2psc/socket/buffered_socket.h>
+
+namespace p2psc {
+namespace socket {
+
+BufferedSocket::BufferedSocket(std::shared_ptr<Socket> inner,
+                               const BufferedOptions &options)
+    : SocketLayer(inner), _options(options), _mutex("socket::BufferedSocket"),
+      _held_back(false), _stopping(false), _bytes_sent(0), _writes(0),
+      _flusher(&BufferedSocket::_flush_loop, this) {
+  // the deadline write mustn't wait for the ACK of an earlier one
+  _inner->set_no_delay();
+}
+
+BufferedSocket::~BufferedSocket() {
+  _stop();
+  std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+  try {
+    _write(false);
+  } catch (const SocketException &e) {
+  }
+}
+
+void BufferedSocket::send(const std::string &data) {
+  std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+  if (_stopping) {
+    throw SocketException("Socket is closed");
+  }
+  _check_error();
+  _buffer += data;
+  _bytes_sent += data.size();
+  if (!_deadline) {
+    _deadline =
+        Clock::now() + std::chrono::microseconds(_options.flush_delay_us);
+    _cv.notify_one();
+  }
+  if (_buffer.size() >= _options.max_buffered_bytes) {
+    _write(true);
+  }
+}
+
+std::string BufferedSocket::receive() {
+  // a request mustn't sit in the buffer while we wait for its response
+  flush();
+  return _inner->receive();
+}
+
+void BufferedSocket::send_file(int file_fd, off_t offset, std::size_t size) {
+  std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+  _check_error();
+  _write(false);
+  _inner->send_file(file_fd, offset, size);
+}
+
+void BufferedSocket::close() {
+  _stop();
+  {
+    std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+    try {
+      _check_error();
+      _write(false);
+    } catch (const SocketException &e) {
+      _inner->close();
+      throw;
+    }
+  }
+  _inner->close();
+}
+
+void BufferedSocket::flush() {
+  std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+  _check_error();
+  _write(false);
+}
+
+void BufferedSocket::_flush_loop() {
+  std::unique_lock<metrics::InstrumentedMutex> lock(_mutex);
+  while (!_stopping) {
+    if (!_deadline) {
+      _cv.wait(lock);
+    } else if (Clock::now() < *_deadline) {
+      _cv.wait_until(lock, *_deadline);
+    } else {
+      try {
+        _write(false);
+      } catch (const SocketException &e) {
+        _error = e.what();
+      }
+    }
+  }
+}
+
+void BufferedSocket::_check_error() {
+  if (!_error.empty()) {
+    throw SocketException(_error);
+  }
+}
+
+void BufferedSocket::_write(bool more) {
+  // the buffer is handed over before writing, so a failed write isn't
+  // retried
+  std::string data;
+  data.swap(_buffer);
+  if (more) {
+    _held_back = true;
+    _writes++;
+    _inner->send_more(data);
+    return;
+  }
+  _deadline = boost::none;
+  if (!data.empty()) {
+    _held_back = false;
+    _writes++;
+    _inner->send(data);
+  } else if (_held_back) {
+    _held_back = false;
+    _inner->push();
+  }
+}
+
+void BufferedSocket::_stop() {
+  {
+    std::lock_guard<metrics::InstrumentedMutex> guard(_mutex);
+    _stopping = true;
+  }
+  _cv.notify_all();
+  if (_flusher.joinable()) {
+    _flusher.join();
+  }
+}
+}
+}
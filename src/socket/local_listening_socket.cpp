@@ -3,6 +3,7 @@
 #include <arpa/inet.h>
 #include <p2psc/log.h>
 #include <mutex>
+#include <poll.h>
 
 namespace p2psc {
 namespace socket {
@@ -27,6 +28,7 @@ int create_socket_fd(u_int32_t port) {
   sock_addr.sin_addr.s_addr = inet_addr(local_ip.c_str());
   sock_addr.sin_port = htons(port);
   if (bind(sockfd, (struct sockaddr *)&sock_addr, sizeof(sock_addr)) < 0) {
+    ::close(sockfd);
     throw std::runtime_error("Failed to bind to port " + std::to_string(port) +
                              ". Reason: " + strerror(errno));
   }
@@ -52,25 +54,41 @@ LocalListeningSocket::LocalListeningSocket(SocketCreator socket_creator)
 
 LocalListeningSocket::LocalListeningSocket(SocketCreator socket_creator,
                                            uint16_t port)
-    : _sockfd(create_socket_fd(port)), _port(port),
+    : _sockfd(create_socket_fd(port)), _port(port_from_socket(_sockfd)),
       _socket_creator(socket_creator) {
   listen(_sockfd, 5);
   _is_open = true;
 }
 
+LocalListeningSocket::LocalListeningSocket(uint16_t port)
+    : LocalListeningSocket(nullptr, port) {}
+
 LocalListeningSocket::~LocalListeningSocket() { close(); }
 
 std::shared_ptr<Socket> LocalListeningSocket::accept() const {
-  BOOST_ASSERT(_is_open);
-  int session_fd = ::accept(_sockfd, NULL, NULL);
+  BOOST_ASSERT(_socket_creator);
+  int session_fd = _accept_fd(std::chrono::milliseconds(0));
   if (session_fd < 0) {
     return nullptr;
   }
   return _socket_creator(session_fd);
 }
 
+int LocalListeningSocket::_accept_fd(std::chrono::milliseconds timeout) const {
+  BOOST_ASSERT(_is_open);
+  if (timeout.count() > 0) {
+    struct pollfd fd = {_sockfd, POLLIN, 0};
+    if (poll(&fd, 1, timeout.count()) != 1) {
+      return -1;
+    }
+  }
+  return ::accept(_sockfd, NULL, NULL);
+}
+
 void LocalListeningSocket::close() {
   if (_is_open) {
+    // closing the fd alone does not wake up a thread blocked in accept()
+    ::shutdown(_sockfd, SHUT_RDWR);
     ::close(_sockfd);
     _is_open = false;
   }
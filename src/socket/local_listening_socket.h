@@ -1,6 +1,7 @@
 #pragma once
 
 #include <boost/optional.hpp>
+#include <chrono>
 #include <p2psc/socket/socket.h>
 #include <p2psc/socket/socket_address.h>
 #include <p2psc/socket_creator.h>
@@ -13,9 +14,25 @@ class LocalListeningSocket {
 public:
   LocalListeningSocket(SocketCreator socket_creator);
   LocalListeningSocket(SocketCreator socket_creator, uint16_t port);
+  // for use with accept(const SocketFactory &) only
+  explicit LocalListeningSocket(uint16_t port);
   ~LocalListeningSocket();
 
   std::shared_ptr<Socket> accept() const;
+  // creates the accepted socket with socket_factory (see socket_factory.h)
+  // rather than the SocketCreator. Returns nullptr if no connection arrives
+  // within timeout, unless it is 0.
+  template <class SocketFactory>
+  std::shared_ptr<typename SocketFactory::socket_type>
+  accept(const SocketFactory &socket_factory,
+         std::chrono::milliseconds timeout =
+             std::chrono::milliseconds(0)) const {
+    const int session_fd = _accept_fd(timeout);
+    if (session_fd < 0) {
+      return nullptr;
+    }
+    return socket_factory.create(session_fd);
+  }
   void close();
 
   socket::SocketAddress get_socket_address() const;
@@ -23,6 +40,8 @@ public:
 private:
   LocalListeningSocket(const LocalListeningSocket &) = delete;
 
+  int _accept_fd(std::chrono::milliseconds timeout) const;
+
   int _sockfd;
   uint16_t _port;
   bool _is_open;
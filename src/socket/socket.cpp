@@ -1,11 +1,45 @@
+#include <algorithm>
 #include <arpa/inet.h>
 #include <boost/assert.hpp>
+#include <cstddef>
+#include <linux/tcp.h>
 #include <p2psc/log.h>
+#include <p2psc/metrics/handshake_stats.h>
 #include <p2psc/socket/socket.h>
+#include <pthread.h>
+#include <signal.h>
 #include <sstream>
 #include <sys/ioctl.h>
+#include <sys/sendfile.h>
 
 namespace p2psc {
+namespace {
+
+/*
+ * Blocks SIGPIPE in this thread for its lifetime, for calls which, unlike
+ * send, can't be told not to raise it, and discards a SIGPIPE raised
+ * meanwhile.
+ */
+class SigpipeBlocker {
+public:
+  SigpipeBlocker() {
+    sigemptyset(&_sigpipe);
+    sigaddset(&_sigpipe, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &_sigpipe, &_old_mask);
+  }
+  ~SigpipeBlocker() {
+    const timespec no_wait{0, 0};
+    while (sigtimedwait(&_sigpipe, nullptr, &no_wait) == -1 &&
+           errno == EINTR) {
+    }
+    pthread_sigmask(SIG_SETMASK, &_old_mask, nullptr);
+  }
+
+private:
+  sigset_t _sigpipe;
+  sigset_t _old_mask;
+};
+}
 
 Socket::Socket(const socket::SocketAddress &socket_address) : _is_open(false) {
   memset(&_address, 0, sizeof(_address));
@@ -13,6 +47,10 @@ Socket::Socket(const socket::SocketAddress &socket_address) : _is_open(false) {
   _address.sin_port = htons(socket_address.port());
   inet_pton(AF_INET, socket_address.ip().c_str(), &(_address.sin_addr));
   _sock_fd = ::socket(PF_INET, SOCK_STREAM, 0);
+  // the Peer rebinds the local port of its Mediator connection to listen for
+  // the Client, which is only allowed if the original socket was reusable too.
+  const int enable = 1;
+  setsockopt(_sock_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
   _connect();
 }
 
@@ -21,6 +59,10 @@ Socket::Socket(int sock_fd) : _sock_fd(sock_fd), _is_open(true) {
   getpeername(_sock_fd, (struct sockaddr *)&_address, &len);
 }
 
+Socket::Socket() : _sock_fd(-1), _is_open(false) {
+  memset(&_address, 0, sizeof(_address));
+}
+
 Socket::~Socket() {
   if (_is_open) {
     ::close(_sock_fd);
@@ -28,9 +70,34 @@ Socket::~Socket() {
   }
 }
 
-void Socket::send(const std::string &message) {
+void Socket::send(const std::string &message) { _send(message, 0); }
+
+void Socket::send_more(const std::string &message) {
+  _send(message, MSG_MORE);
+}
+
+void Socket::push() {
+  _check_is_open();
+  // uncorking pushes out what MSG_MORE held back, whether or not the socket
+  // was corked; it fails harmlessly on sockets which aren't TCP
+  const int disable = 0;
+  setsockopt(_sock_fd, IPPROTO_TCP, TCP_CORK, &disable, sizeof(disable));
+}
+
+void Socket::set_no_delay() {
+  if (_is_open) {
+    // fails harmlessly on sockets which aren't TCP
+    const int enable = 1;
+    setsockopt(_sock_fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+  }
+}
+
+void Socket::_send(const std::string &message, int flags) {
   _check_is_open();
-  const auto size = ::send(_sock_fd, &message[0], message.size(), 0);
+  metrics::count_syscall(metrics::kSyscallSend);
+  // a closed connection should throw rather than raise SIGPIPE
+  const auto size =
+      ::send(_sock_fd, &message[0], message.size(), MSG_NOSIGNAL | flags);
   if (static_cast<const unsigned long>(size) != message.length()) {
     std::stringstream fmt;
     fmt << "Unexpected data send length. Expected: " << message.length()
@@ -44,6 +111,11 @@ void Socket::send(const std::string &message) {
 
 std::string Socket::receive() {
   _check_is_open();
+  if (!_put_back.empty()) {
+    std::string data;
+    data.swap(_put_back);
+    return data;
+  }
   std::string received_data;
   char receive_buffer[socket::RECV_BUF_SIZE];
   ssize_t received_bytes;
@@ -51,6 +123,7 @@ std::string Socket::receive() {
     // The first time read is called, we block. This allows us to call
     // receive() and have that block indefinitely rather than having to
     // repeatedly call receive() at the application layer.
+    metrics::count_syscall(metrics::kSyscallRead);
     received_bytes = read(_sock_fd, receive_buffer, socket::RECV_BUF_SIZE);
 
     if (received_bytes == -1) {
@@ -66,6 +139,7 @@ std::string Socket::receive() {
     // RECV_BUF_SIZE bytes in this message.
     if (received_bytes == socket::RECV_BUF_SIZE) {
       int count;
+      metrics::count_syscall(metrics::kSyscallIoctl);
       ioctl(_sock_fd, FIONREAD, &count);
       if (count == 0) {
         break;
@@ -79,14 +153,110 @@ std::string Socket::receive() {
   return received_data;
 }
 
+void Socket::send_file(int file_fd, off_t offset, std::size_t size) {
+  _check_is_open();
+  // a closed connection should throw rather than raise SIGPIPE
+  const SigpipeBlocker sigpipe_blocker;
+  while (size > 0) {
+    metrics::count_syscall(metrics::kSyscallSend);
+    const auto sent = ::sendfile(_sock_fd, file_fd, &offset, size);
+    if (sent == -1) {
+      throw socket::SocketException("sendfile failed (fd=" +
+                                    std::to_string(_sock_fd) +
+                                    "): " + std::string(strerror(errno)));
+    } else if (sent == 0) {
+      throw socket::SocketException("sendfile failed: file ended early");
+    }
+    size -= sent;
+  }
+}
+
+void Socket::receive_exactly(char *buffer, std::size_t size) {
+  _check_is_open();
+  std::size_t received = std::min(size, _put_back.size());
+  memcpy(buffer, _put_back.data(), received);
+  _put_back.erase(0, received);
+  while (received < size) {
+    metrics::count_syscall(metrics::kSyscallRead);
+    const auto received_bytes =
+        ::recv(_sock_fd, buffer + received, size - received, MSG_WAITALL);
+    if (received_bytes == -1) {
+      throw socket::SocketException(
+          "receive failed (fd=" + std::to_string(_sock_fd) +
+          "): " + std::string(strerror(errno)));
+    } else if (received_bytes == 0) {
+      throw socket::SocketException("receive failed: Peer closed connection");
+    }
+    received += received_bytes;
+  }
+}
+
+void Socket::put_back(const std::string &data) {
+  _put_back.insert(0, data);
+}
+
 socket::SocketAddress Socket::get_socket_address() {
   char ip_str[INET_ADDRSTRLEN];
   inet_ntop(AF_INET, &(_address.sin_addr), ip_str, INET_ADDRSTRLEN);
   return socket::SocketAddress(ip_str, ntohs(_address.sin_port));
 }
 
+socket::SocketAddress Socket::get_local_address() {
+  struct sockaddr_in address;
+  socklen_t len = sizeof(address);
+  memset(&address, 0, sizeof(address));
+  getsockname(_sock_fd, (struct sockaddr *)&address, &len);
+  char ip_str[INET_ADDRSTRLEN];
+  inet_ntop(AF_INET, &(address.sin_addr), ip_str, INET_ADDRSTRLEN);
+  return socket::SocketAddress(ip_str, ntohs(address.sin_port));
+}
+
+int Socket::get_incoming_cpu() const {
+  int cpu = -1;
+  socklen_t len = sizeof(cpu);
+  if (getsockopt(_sock_fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) != 0) {
+    return -1;
+  }
+  return cpu;
+}
+
+boost::optional<socket::PathQuality> Socket::get_path_quality() const {
+  struct tcp_info info;
+  memset(&info, 0, sizeof(info));
+  socklen_t len = sizeof(info);
+  if (getsockopt(_sock_fd, IPPROTO_TCP, TCP_INFO, &info, &len) != 0) {
+    return boost::none;
+  }
+  socket::PathQuality quality;
+  quality.rtt_us = info.tcpi_rtt;
+  quality.rtt_var_us = info.tcpi_rttvar;
+  quality.total_retransmits = info.tcpi_total_retrans;
+  quality.congestion_window = info.tcpi_snd_cwnd;
+  quality.mss = info.tcpi_snd_mss;
+  // older kernels fill in less of the struct
+  if (len >= offsetof(struct tcp_info, tcpi_delivery_rate) +
+                 sizeof(info.tcpi_delivery_rate)) {
+    quality.delivery_rate = info.tcpi_delivery_rate;
+  }
+  // as the kernel counts packets in flight (tcp_packets_in_flight)
+  const std::int64_t packets_in_flight =
+      static_cast<std::int64_t>(info.tcpi_unacked) - info.tcpi_sacked -
+      info.tcpi_lost + info.tcpi_retrans;
+  quality.bytes_in_flight =
+      std::max<std::int64_t>(0, packets_in_flight) * info.tcpi_snd_mss;
+  return quality;
+}
+
+void Socket::shutdown() {
+  if (_is_open) {
+    ::shutdown(_sock_fd, SHUT_RDWR);
+  }
+}
+
 void Socket::close() {
   BOOST_ASSERT(_is_open);
+  // close(2) alone doesn't wake up other threads blocked on the socket
+  ::shutdown(_sock_fd, SHUT_RDWR);
   if (::close(_sock_fd) != 0) {
     throw socket::SocketException("Failed to close socket. Reason: " +
                                   std::string(strerror(errno)));
@@ -96,13 +266,17 @@ void Socket::close() {
 
 void Socket::_connect() {
   BOOST_ASSERT(!_is_open);
+  metrics::count_syscall(metrics::kSyscallConnect);
   int status =
       ::connect(_sock_fd, (struct sockaddr *)&_address, sizeof(_address));
   if (status != 0) {
+    // we are called from the constructor, so the destructor will not run
+    const auto error = errno;
+    ::close(_sock_fd);
     throw socket::SocketException(
         "Failed to connect to " + std::string(inet_ntoa(_address.sin_addr)) +
         ":" + std::to_string(ntohs(_address.sin_port)) +
-        ". Reason: " + strerror(errno));
+        ". Reason: " + strerror(error));
   }
   _is_open = true;
 }
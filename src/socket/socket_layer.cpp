@@ -0,0 +1,38 @@
+#include <cstring>
+#include <p2psc/socket/socket_layer.h>
+#include <unistd.h>
+
+namespace p2psc {
+namespace socket {
+
+void SocketLayer::send_file(int file_fd, off_t offset, std::size_t size) {
+  std::string data(size, '\0');
+  std::size_t read_bytes = 0;
+  while (read_bytes < size) {
+    const auto result =
+        ::pread(file_fd, &data[read_bytes], size - read_bytes, offset);
+    if (result <= 0) {
+      throw SocketException("Failed to read file to send. Reason: " +
+                            std::string(result == 0 ? "file ended early"
+                                                    : strerror(errno)));
+    }
+    read_bytes += result;
+    offset += result;
+  }
+  send(data);
+}
+
+void SocketLayer::receive_exactly(char *buffer, std::size_t size) {
+  std::size_t received = 0;
+  while (received < size) {
+    if (_received.empty()) {
+      _received = receive();
+    }
+    const auto length = std::min(size - received, _received.size());
+    memcpy(buffer + received, _received.data(), length);
+    _received.erase(0, length);
+    received += length;
+  }
+}
+}
+}
@@ -0,0 +1,52 @@
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstring>
+#include <p2psc/socket/socket_exception.h>
+#include <socket/socket_util.h>
+#include <unistd.h>
+
+namespace p2psc {
+namespace socket {
+
+std::uint64_t now_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+int create_listening_socket() {
+  const auto fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd == -1) {
+    throw SocketException(
+        std::string("Failed to create listening socket. Reason: ") +
+        strerror(errno));
+  }
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(fd, (const struct sockaddr *)&address, sizeof(address)) != 0 ||
+      listen(fd, 1) != 0) {
+    const auto error = errno;
+    ::close(fd);
+    throw SocketException(
+        std::string("Failed to listen for connection. Reason: ") +
+        strerror(error));
+  }
+  return fd;
+}
+
+std::uint16_t port_of(int fd) {
+  struct sockaddr_in address;
+  socklen_t length = sizeof(address);
+  getsockname(fd, (struct sockaddr *)&address, &length);
+  return ntohs(address.sin_port);
+}
+
+std::string ip_of(const struct sockaddr_in &address) {
+  char ip[INET_ADDRSTRLEN];
+  inet_ntop(AF_INET, &address.sin_addr, ip, sizeof(ip));
+  return ip;
+}
+}
+}
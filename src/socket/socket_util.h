@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <netinet/in.h>
+#include <string>
+
+/**
+ * Helpers shared by the rendezvous mechanisms which work on raw fds (LAN
+ * discovery and the DHT) rather than through Socket.
+ */
+namespace p2psc {
+namespace socket {
+
+// wall clock time, as carried in signed announcements and records
+std::uint64_t now_ms();
+
+/*
+ * A TCP socket listening on an ephemeral port on every interface, so that it
+ * is reachable from wherever the other end saw us, not just local_ip. Throws
+ * SocketException.
+ */
+int create_listening_socket();
+
+// the local port fd is bound to
+std::uint16_t port_of(int fd);
+
+std::string ip_of(const struct sockaddr_in &address);
+}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <spotify/json.hpp>
+#include <string>
+#include <vector>
+
+namespace p2psc {
+namespace transfer {
+
+/*
+ * Sent by the sender before any chunk. Hashes are base64 encoded.
+ */
+struct Manifest {
+  std::string name;
+  std::uint64_t size;
+  std::uint64_t chunk_size;
+  std::string root;
+  std::vector<std::string> leaves;
+};
+
+/*
+ * The receiver's reply to the Manifest: the chunks it already has.
+ */
+struct Have {
+  std::vector<std::uint64_t> chunks;
+};
+}
+}
+
+namespace spotify {
+namespace json {
+template <> struct default_codec_t<p2psc::transfer::Manifest> {
+  static codec::object_t<p2psc::transfer::Manifest> codec() {
+    auto codec = codec::object<p2psc::transfer::Manifest>();
+    codec.required("name", &p2psc::transfer::Manifest::name);
+    codec.required("size", &p2psc::transfer::Manifest::size);
+    codec.required("chunk_size", &p2psc::transfer::Manifest::chunk_size);
+    codec.required("root", &p2psc::transfer::Manifest::root);
+    codec.required("leaves", &p2psc::transfer::Manifest::leaves);
+    return codec;
+  }
+};
+
+template <> struct default_codec_t<p2psc::transfer::Have> {
+  static codec::object_t<p2psc::transfer::Have> codec() {
+    auto codec = codec::object<p2psc::transfer::Have>();
+    codec.required("chunks", &p2psc::transfer::Have::chunks);
+    return codec;
+  }
+};
+}
+}
@@ -0,0 +1,90 @@
+#include <cstring>
+#include <fcntl.h>
+#include <p2psc/transfer/transfer_exception.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <transfer/mapped_file.h>
+#include <unistd.h>
+
+namespace p2psc {
+namespace transfer {
+namespace {
+
+std::string error_string() { return std::string(strerror(errno)); }
+
+std::uint64_t file_size(int fd) {
+  struct stat stats;
+  if (fstat(fd, &stats) != 0) {
+    throw TransferException("Failed to stat file. Reason: " + error_string());
+  }
+  return stats.st_size;
+}
+}
+
+std::unique_ptr<MappedFile>
+MappedFile::open_for_reading(const std::string &path) {
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw TransferException("Failed to open " + path +
+                            ". Reason: " + error_string());
+  }
+  try {
+    return std::unique_ptr<MappedFile>(
+        new MappedFile(fd, file_size(fd), false, true));
+  } catch (const TransferException &) {
+    ::close(fd);
+    throw;
+  }
+}
+
+std::unique_ptr<MappedFile>
+MappedFile::open_for_writing(const std::string &path, std::uint64_t size) {
+  const int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    throw TransferException("Failed to open " + path +
+                            ". Reason: " + error_string());
+  }
+  try {
+    const bool existed = file_size(fd) == size;
+    if (!existed && ftruncate(fd, size) != 0) {
+      throw TransferException("Failed to resize " + path +
+                              ". Reason: " + error_string());
+    }
+    return std::unique_ptr<MappedFile>(new MappedFile(fd, size, true, existed));
+  } catch (const TransferException &) {
+    ::close(fd);
+    throw;
+  }
+}
+
+MappedFile::MappedFile(int fd, std::uint64_t size, bool writable,
+                       bool existed)
+    : _fd(fd), _size(size), _existed(existed), _data(nullptr) {
+  // mmap refuses empty mappings, and there is nothing to map anyway
+  if (size == 0) {
+    return;
+  }
+  void *data = mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                    MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) {
+    throw TransferException("Failed to map file. Reason: " + error_string());
+  }
+  _data = static_cast<char *>(data);
+  // chunks are read and written front to back
+  madvise(_data, size, MADV_SEQUENTIAL);
+}
+
+MappedFile::~MappedFile() {
+  if (_data) {
+    munmap(_data, _size);
+  }
+  ::close(_fd);
+}
+
+void MappedFile::sync() {
+  if (_data && msync(_data, _size, MS_SYNC) != 0) {
+    throw TransferException("Failed to write file. Reason: " + error_string());
+  }
+}
+}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace p2psc {
+namespace transfer {
+
+/*
+ * A file mapped into memory in its entirety. Throws TransferException.
+ */
+class MappedFile {
+public:
+  static std::unique_ptr<MappedFile> open_for_reading(const std::string &path);
+  /*
+   * Creates the file if it doesn't exist, and truncates or extends it to
+   * size.
+   */
+  static std::unique_ptr<MappedFile> open_for_writing(const std::string &path,
+                                                      std::uint64_t size);
+  ~MappedFile();
+
+  int fd() const { return _fd; }
+  char *data() const { return _data; }
+  std::uint64_t size() const { return _size; }
+  // whether the file already existed with this size before it was opened
+  bool existed() const { return _existed; }
+
+  // write changes back to the file
+  void sync();
+
+private:
+  MappedFile(int fd, std::uint64_t size, bool writable, bool existed);
+  MappedFile(const MappedFile &) = delete;
+
+  const int _fd;
+  const std::uint64_t _size;
+  const bool _existed;
+  char *_data;
+};
+}
+}
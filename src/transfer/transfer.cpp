@@ -0,0 +1,371 @@
+#include <algorithm>
+#include <atomic>
+#include <base64/base64.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <p2psc/log.h>
+#include <p2psc/transfer/transfer.h>
+#include <p2psc/transfer/transfer_exception.h>
+#include <p2psc/transfer/tree_hash.h>
+#include <thread>
+#include <transfer/manifest.h>
+#include <transfer/mapped_file.h>
+#include <util/big_endian.h>
+
+namespace p2psc {
+namespace transfer {
+namespace {
+
+/*
+ * Every message of a transfer is a frame: a one byte kind, the payload length
+ * (4 bytes, big endian) and the payload. A chunk's payload is its index
+ * (8 bytes, big endian) followed by its data.
+ */
+enum FrameKind : char {
+  kFrameManifest = 0,
+  kFrameHave = 1,
+  kFrameChunk = 2,
+  // the sender has no more chunks for this connection
+  kFrameDone = 3,
+  // the receiver has verified and stored the whole file
+  kFrameComplete = 4
+};
+
+const std::size_t kHeaderSize = 5;
+const std::size_t kIndexSize = 8;
+// so that a chunk's payload length fits in its frame header
+const std::uint64_t kMaxChunkSize = UINT32_MAX - kIndexSize;
+// A manifest holds a hash (about 47 bytes of JSON) per chunk, so this allows
+// over a million chunks.
+const std::size_t kMaxManifestSize = 64 * 1024 * 1024;
+// the largest file we can resize and map
+const std::uint64_t kMaxFileSize = std::min<std::uint64_t>(
+    std::numeric_limits<off_t>::max(), std::numeric_limits<std::size_t>::max());
+
+// a Have listing every one of chunks: 20 digits and a comma per index
+std::size_t max_have_size(std::uint64_t chunks) {
+  return sizeof("{\"chunks\":[]}") - 1 + 21 * chunks;
+}
+
+std::string frame_header(FrameKind kind, std::size_t payload_size) {
+  std::string header(1, kind);
+  util::write_integer(header, payload_size, 4);
+  return header;
+}
+
+void send_frame(Socket &socket, FrameKind kind, const std::string &payload) {
+  socket.send(frame_header(kind, payload.size()) + payload);
+}
+
+struct FrameHeader {
+  FrameKind kind;
+  std::size_t size;
+};
+
+FrameHeader receive_header(Socket &socket) {
+  char header[kHeaderSize];
+  socket.receive_exactly(header, kHeaderSize);
+  const auto size = static_cast<std::size_t>(util::read_integer(header + 1, 4));
+  return FrameHeader{static_cast<FrameKind>(header[0]), size};
+}
+
+// Throws TransferException, before allocating, for a payload over max_size.
+std::string receive_frame(Socket &socket, FrameKind expected_kind,
+                          std::size_t max_size) {
+  const auto header = receive_header(socket);
+  if (header.kind != expected_kind) {
+    throw TransferException("Unexpected transfer frame kind " +
+                            std::to_string(header.kind));
+  }
+  if (header.size > max_size) {
+    throw TransferException("Transfer frame of kind " +
+                            std::to_string(header.kind) + " too large: " +
+                            std::to_string(header.size) + " bytes");
+  }
+  std::string payload(header.size, '\0');
+  socket.receive_exactly(&payload[0], payload.size());
+  return payload;
+}
+
+std::string encode_hash(const std::string &hash) {
+  return base64_encode(reinterpret_cast<const unsigned char *>(hash.data()),
+                       hash.size());
+}
+
+std::uint64_t chunk_count(std::uint64_t size, std::uint64_t chunk_size) {
+  // an empty file is a single empty chunk; rounded up without adding to
+  // size, which may come from the other end and be close to overflowing
+  return std::max<std::uint64_t>(
+      1, size / chunk_size + (size % chunk_size != 0));
+}
+
+std::size_t chunk_length(std::uint64_t index, std::uint64_t size,
+                         std::uint64_t chunk_size) {
+  return std::min(chunk_size, size - std::min(size, index * chunk_size));
+}
+
+std::string basename(const std::string &path) {
+  const auto slash = path.find_last_of('/');
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+/*
+ * Call f(i) for every i in [0, count), spread over threads threads, which
+ * each take the next i when they're done with the last. Rethrows the first
+ * exception any call threw.
+ */
+template <class F>
+void parallel_for(std::size_t threads, std::uint64_t count, F f) {
+  std::atomic<std::uint64_t> next(0);
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  std::vector<std::thread> workers;
+  for (std::size_t t = 0; t < threads; t++) {
+    workers.emplace_back([&, t]() {
+      try {
+        for (auto i = next++; i < count; i = next++) {
+          f(t, i);
+        }
+      } catch (...) {
+        std::lock_guard<std::mutex> guard(error_mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+        // stop the other threads from taking any more work
+        next = count;
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+std::vector<std::string> hash_chunks(const MappedFile &file,
+                                     std::uint64_t chunk_size) {
+  std::vector<std::string> leaves(chunk_count(file.size(), chunk_size));
+  const auto threads =
+      std::max(1u, std::min<unsigned>(std::thread::hardware_concurrency(),
+                                      leaves.size()));
+  parallel_for(threads, leaves.size(),
+               [&](std::size_t, std::uint64_t index) {
+                 leaves[index] = TreeHash::hash_chunk(
+                     file.data() + index * chunk_size,
+                     chunk_length(index, file.size(), chunk_size));
+               });
+  return leaves;
+}
+
+void check_manifest(const Manifest &manifest) {
+  const auto &name = manifest.name;
+  if (name.empty() || name == "." || name == ".." ||
+      name.find('/') != std::string::npos) {
+    throw TransferException("Invalid file name: " + name);
+  }
+  if (manifest.chunk_size == 0 || manifest.chunk_size > kMaxChunkSize ||
+      manifest.size > kMaxFileSize ||
+      manifest.leaves.size() !=
+          chunk_count(manifest.size, manifest.chunk_size)) {
+    throw TransferException("Invalid manifest for " + name);
+  }
+}
+
+/*
+ * Receive the chunk whose header has just been received, straight into file,
+ * and verify it. Returns its length.
+ */
+std::size_t receive_chunk(Socket &socket, const FrameHeader &header,
+                          const Manifest &manifest,
+                          const std::vector<std::string> &leaves,
+                          const MappedFile &file, std::vector<char> &have) {
+  if (header.kind != kFrameChunk || header.size < kIndexSize) {
+    throw TransferException("Unexpected transfer frame kind " +
+                            std::to_string(header.kind));
+  }
+  char index_bytes[kIndexSize];
+  socket.receive_exactly(index_bytes, kIndexSize);
+  const auto index = util::read_integer(index_bytes, kIndexSize);
+  const auto length = header.size - kIndexSize;
+  if (index >= leaves.size() ||
+      length != chunk_length(index, manifest.size, manifest.chunk_size)) {
+    throw TransferException("Invalid chunk " + std::to_string(index));
+  }
+  auto *chunk = file.data() + index * manifest.chunk_size;
+  socket.receive_exactly(chunk, length);
+  if (TreeHash::hash_chunk(chunk, length) != leaves[index]) {
+    throw TransferException("Chunk " + std::to_string(index) +
+                            " does not match its hash");
+  }
+  have[index] = true;
+  return length;
+}
+}
+
+TransferStats send_file(const std::string &path,
+                        const std::vector<std::shared_ptr<Socket>> &sockets,
+                        const TransferOptions &options) {
+  BOOST_ASSERT(!sockets.empty() && options.chunk_size > 0);
+  if (options.chunk_size > kMaxChunkSize) {
+    throw TransferException("Chunk size " +
+                            std::to_string(options.chunk_size) +
+                            " does not fit in a frame");
+  }
+  const auto file = MappedFile::open_for_reading(path);
+  const auto tree_hash = TreeHash(hash_chunks(*file, options.chunk_size));
+
+  Manifest manifest{basename(path), file->size(), options.chunk_size,
+                    encode_hash(tree_hash.root()), {}};
+  for (const auto &leaf : tree_hash.leaves()) {
+    manifest.leaves.push_back(encode_hash(leaf));
+  }
+  TransferStats stats;
+  stats.chunks = manifest.leaves.size();
+
+  try {
+    const auto encoded_manifest = spotify::json::encode(manifest);
+    if (encoded_manifest.size() > kMaxManifestSize) {
+      throw TransferException("Too many chunks in " + path +
+                              " for its manifest; use a larger chunk size");
+    }
+    send_frame(*sockets[0], kFrameManifest, encoded_manifest);
+    const auto have = spotify::json::decode<Have>(receive_frame(
+        *sockets[0], kFrameHave, max_have_size(stats.chunks)));
+
+    std::vector<bool> missing(stats.chunks, true);
+    for (const auto index : have.chunks) {
+      if (index < missing.size()) {
+        missing[index] = false;
+      }
+    }
+    std::vector<std::uint64_t> chunks;
+    for (std::uint64_t index = 0; index < missing.size(); index++) {
+      if (missing[index]) {
+        chunks.push_back(index);
+        stats.bytes_transferred +=
+            chunk_length(index, file->size(), options.chunk_size);
+      }
+    }
+    stats.chunks_transferred = chunks.size();
+    LOG(level::Info) << "Sending " << chunks.size() << " of " << stats.chunks
+                     << " chunks of " << path << " over " << sockets.size()
+                     << " connections";
+
+    parallel_for(sockets.size(), chunks.size(),
+                 [&](std::size_t connection, std::uint64_t i) {
+                   const auto index = chunks[i];
+                   const auto length =
+                       chunk_length(index, file->size(), options.chunk_size);
+                   auto header = frame_header(kFrameChunk, kIndexSize + length);
+                   util::write_integer(header, index, kIndexSize);
+                   sockets[connection]->send(header);
+                   sockets[connection]->send_file(
+                       file->fd(), index * options.chunk_size, length);
+                 });
+    for (const auto &socket : sockets) {
+      send_frame(*socket, kFrameDone, "");
+    }
+    receive_frame(*sockets[0], kFrameComplete, 0);
+  } catch (const socket::SocketException &e) {
+    throw TransferException("Transfer of " + path +
+                            " failed. Reason: " + e.what());
+  } catch (const spotify::json::decode_exception &e) {
+    throw TransferException("Invalid reply to manifest: " +
+                            std::string(e.what()));
+  }
+  return stats;
+}
+
+ReceivedFile receive_file(const std::string &directory,
+                          const std::vector<std::shared_ptr<Socket>> &sockets) {
+  BOOST_ASSERT(!sockets.empty());
+  try {
+    Manifest manifest;
+    try {
+      manifest = spotify::json::decode<Manifest>(
+          receive_frame(*sockets[0], kFrameManifest, kMaxManifestSize));
+    } catch (const spotify::json::decode_exception &e) {
+      throw TransferException("Invalid manifest: " + std::string(e.what()));
+    }
+    check_manifest(manifest);
+    std::vector<std::string> leaves;
+    for (const auto &leaf : manifest.leaves) {
+      leaves.push_back(base64_decode(leaf));
+    }
+    const auto tree_hash = TreeHash(leaves);
+    if (encode_hash(tree_hash.root()) != manifest.root) {
+      throw TransferException("Manifest root does not match its chunks");
+    }
+
+    ReceivedFile received{directory + "/" + manifest.name, TransferStats()};
+    const auto partial_path = received.path + ".partial";
+    auto file = MappedFile::open_for_writing(partial_path, manifest.size);
+    std::vector<char> have(leaves.size(), false);
+    Have reply;
+    if (file->existed()) {
+      for (std::uint64_t index = 0; index < leaves.size(); index++) {
+        const auto length =
+            chunk_length(index, manifest.size, manifest.chunk_size);
+        if (TreeHash::hash_chunk(file->data() + index * manifest.chunk_size,
+                                 length) == leaves[index]) {
+          have[index] = true;
+          reply.chunks.push_back(index);
+        }
+      }
+    }
+    send_frame(*sockets[0], kFrameHave, spotify::json::encode(reply));
+
+    received.stats.chunks = leaves.size();
+    std::atomic<std::uint64_t> chunks_transferred(0);
+    std::atomic<std::uint64_t> bytes_transferred(0);
+    parallel_for(sockets.size(), sockets.size(),
+                 [&](std::size_t, std::uint64_t connection) {
+                   auto &socket = *sockets[connection];
+                   try {
+                     for (auto header = receive_header(socket);
+                          header.kind != kFrameDone;
+                          header = receive_header(socket)) {
+                       bytes_transferred += receive_chunk(
+                           socket, header, manifest, leaves, *file, have);
+                       chunks_transferred++;
+                     }
+                   } catch (...) {
+                     // the sender may be blocked sending to us, so make sure
+                     // it notices that we've given up, and stop the other
+                     // connections' receives, which would otherwise wait for
+                     // chunks it will never send
+                     for (const auto &other : sockets) {
+                       if (other.get() != &socket) {
+                         other->shutdown();
+                       }
+                     }
+                     socket.close();
+                     throw;
+                   }
+                 });
+    received.stats.chunks_transferred = chunks_transferred;
+    received.stats.bytes_transferred = bytes_transferred;
+
+    if (std::find(have.begin(), have.end(), false) != have.end()) {
+      throw TransferException("Sender finished without sending every chunk");
+    }
+    file->sync();
+    file.reset();
+    if (rename(partial_path.c_str(), received.path.c_str()) != 0) {
+      throw TransferException("Failed to rename " + partial_path +
+                              ". Reason: " + strerror(errno));
+    }
+    send_frame(*sockets[0], kFrameComplete, "");
+    return received;
+  } catch (const socket::SocketException &e) {
+    throw TransferException("Transfer failed. Reason: " +
+                            std::string(e.what()));
+  }
+}
+}
+}
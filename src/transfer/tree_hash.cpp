@@ -0,0 +1,52 @@
+#include <openssl/sha.h>
+#include <p2psc/transfer/transfer_exception.h>
+#include <p2psc/transfer/tree_hash.h>
+
+namespace p2psc {
+namespace transfer {
+namespace {
+
+const unsigned char kLeafPrefix = 0x00;
+const unsigned char kNodePrefix = 0x01;
+
+std::string hash_node(const std::string &left, const std::string &right) {
+  unsigned char hash[SHA256_DIGEST_LENGTH];
+  SHA256_CTX context;
+  SHA256_Init(&context);
+  SHA256_Update(&context, &kNodePrefix, 1);
+  SHA256_Update(&context, left.data(), left.size());
+  SHA256_Update(&context, right.data(), right.size());
+  SHA256_Final(hash, &context);
+  return std::string(hash, hash + SHA256_DIGEST_LENGTH);
+}
+}
+
+TreeHash::TreeHash(const std::vector<std::string> &leaves) : _leaves(leaves) {
+  if (leaves.empty()) {
+    throw TransferException("A tree hash needs at least one leaf");
+  }
+  auto level = leaves;
+  while (level.size() > 1) {
+    std::vector<std::string> parents;
+    for (std::size_t i = 0; i + 1 < level.size(); i += 2) {
+      parents.push_back(hash_node(level[i], level[i + 1]));
+    }
+    if (level.size() % 2 == 1) {
+      parents.push_back(level.back());
+    }
+    level.swap(parents);
+  }
+  _root = level[0];
+}
+
+std::string TreeHash::hash_chunk(const char *data, std::size_t size) {
+  unsigned char hash[SHA256_DIGEST_LENGTH];
+  SHA256_CTX context;
+  SHA256_Init(&context);
+  SHA256_Update(&context, &kLeafPrefix, 1);
+  SHA256_Update(&context, data, size);
+  SHA256_Final(hash, &context);
+  return std::string(hash, hash + SHA256_DIGEST_LENGTH);
+}
+}
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace p2psc {
+namespace util {
+
+/*
+ * The integers in the frames of our binary protocols are big endian, of size
+ * bytes.
+ */
+inline void write_integer(std::string &out, std::uint64_t value,
+                          std::size_t size) {
+  for (std::size_t i = 0; i < size; i++) {
+    out += static_cast<char>(value >> (8 * (size - 1 - i)));
+  }
+}
+
+inline std::uint64_t read_integer(const char *in, std::size_t size) {
+  std::uint64_t value = 0;
+  for (std::size_t i = 0; i < size; i++) {
+    value = (value << 8) | static_cast<unsigned char>(in[i]);
+  }
+  return value;
+}
+}
+}
@@ -0,0 +1,39 @@
+#include <boost/test/unit_test.hpp>
+#include <crypto/aes_gcm.h>
+#include <p2psc/crypto/crypto_exception.h>
+
+namespace p2psc {
+namespace test {
+
+BOOST_AUTO_TEST_SUITE(aes_gcm_test)
+
+BOOST_AUTO_TEST_CASE(ShouldOpenWhatWasSealed) {
+  const auto key = crypto::generate_secret();
+  BOOST_ASSERT(key.size() == crypto::kAesGcmKeySize);
+  const auto sealed = crypto::seal(key, "bananas", "request");
+  BOOST_ASSERT(sealed.find("bananas") == std::string::npos);
+  BOOST_ASSERT(crypto::open(key, sealed, "request") == "bananas");
+  BOOST_ASSERT(crypto::open(key, crypto::seal(key, "", "reply"), "reply")
+                   .empty());
+  // a fresh nonce every time
+  BOOST_ASSERT(crypto::seal(key, "bananas", "request") != sealed);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldNotOpenTamperedOrMisdirectedData) {
+  const auto key = crypto::generate_secret();
+  const auto sealed = crypto::seal(key, "bananas", "request");
+  auto tampered = sealed;
+  tampered[tampered.size() / 2] ^= 1;
+  BOOST_CHECK_THROW(crypto::open(key, tampered, "request"),
+                    crypto::CryptoException);
+  BOOST_CHECK_THROW(crypto::open(key, sealed, "reply"),
+                    crypto::CryptoException);
+  BOOST_CHECK_THROW(crypto::open(crypto::generate_secret(), sealed, "request"),
+                    crypto::CryptoException);
+  BOOST_CHECK_THROW(crypto::open(key, "short", "request"),
+                    crypto::CryptoException);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+}
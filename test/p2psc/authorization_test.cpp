@@ -0,0 +1,97 @@
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+#include <fstream>
+#include <p2psc/policy/authorization.h>
+#include <p2psc/policy/policy_exception.h>
+#include <random>
+
+namespace p2psc {
+namespace test {
+namespace {
+
+struct FilterFile {
+  FilterFile()
+      : path((boost::filesystem::temp_directory_path() /
+              boost::filesystem::unique_path())
+                 .string()) {}
+  ~FilterFile() { std::remove(path.c_str()); }
+
+  const std::string path;
+};
+
+std::vector<std::string> random_fingerprints(std::size_t count,
+                                             unsigned seed) {
+  std::mt19937 random(seed);
+  std::vector<std::string> fingerprints;
+  for (std::size_t i = 0; i < count; i++) {
+    std::string fingerprint(64, '0');
+    for (auto &c : fingerprint) {
+      c = "0123456789abcdef"[random() % 16];
+    }
+    fingerprints.push_back(fingerprint);
+  }
+  return fingerprints;
+}
+}
+
+BOOST_AUTO_TEST_SUITE(authorization_test)
+
+BOOST_AUTO_TEST_CASE(ShouldOnlyAllowListedPairs) {
+  const FilterFile file;
+  const auto fingerprints = random_fingerprints(2000, 1);
+  std::vector<policy::FingerprintPair> pairs;
+  // each key may connect to its next ten
+  for (std::size_t i = 0; i < 1000; i++) {
+    for (std::size_t j = 1; j <= 10; j++) {
+      pairs.emplace_back(fingerprints[i], fingerprints[i + j]);
+    }
+  }
+  policy::AuthorizationFilter::build(pairs, file.path);
+  const auto filter = policy::AuthorizationFilter::open(file.path);
+  BOOST_ASSERT(filter->pairs() == pairs.size());
+
+  for (const auto &pair : pairs) {
+    BOOST_ASSERT(filter->allows(pair.first, pair.second));
+    BOOST_ASSERT(!filter->allows(pair.second, pair.first));
+  }
+  for (std::size_t i = 1000; i + 1 < fingerprints.size(); i++) {
+    BOOST_ASSERT(!filter->allows(fingerprints[i], fingerprints[i + 1]));
+  }
+  BOOST_ASSERT(!filter->allows("", fingerprints[1]));
+  BOOST_ASSERT(!filter->allows(fingerprints[0], std::string(64, 'z')));
+
+  BOOST_CHECK_THROW(
+      policy::AuthorizationFilter::build({{"not a fingerprint", ""}},
+                                         file.path),
+      policy::PolicyException);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldReloadWithoutDisturbingChecksInProgress) {
+  const FilterFile file;
+  const auto fingerprints = random_fingerprints(4, 2);
+  policy::AuthorizationFilter::build({{fingerprints[0], fingerprints[1]}},
+                                     file.path);
+  policy::Authorization authorization(file.path);
+  const auto old_filter = authorization.filter();
+  BOOST_ASSERT(authorization.allows(fingerprints[0], fingerprints[1]));
+
+  policy::AuthorizationFilter::build({{fingerprints[2], fingerprints[3]}},
+                                     file.path);
+  // not until reloaded
+  BOOST_ASSERT(!authorization.allows(fingerprints[2], fingerprints[3]));
+  authorization.reload();
+  BOOST_ASSERT(authorization.allows(fingerprints[2], fingerprints[3]));
+  BOOST_ASSERT(!authorization.allows(fingerprints[0], fingerprints[1]));
+  BOOST_ASSERT(old_filter->allows(fingerprints[0], fingerprints[1]));
+
+  // replaced the way build() does it, as the old file is still mapped
+  std::ofstream(file.path + ".tmp") << "not a filter";
+  std::rename((file.path + ".tmp").c_str(), file.path.c_str());
+  BOOST_CHECK_THROW(authorization.reload(), policy::PolicyException);
+  BOOST_ASSERT(authorization.allows(fingerprints[2], fingerprints[3]));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+}
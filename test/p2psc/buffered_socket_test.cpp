@@ -0,0 +1,101 @@
+#include <boost/test/unit_test.hpp>
+#include <future>
+#include <p2psc/socket/buffered_socket.h>
+#include <thread>
+#include <util/socket_pair.h>
+
+namespace p2psc {
+namespace test {
+namespace {
+
+std::string receive(Socket &socket, std::size_t size) {
+  std::string received;
+  while (received.size() < size) {
+    received += socket.receive();
+  }
+  return received;
+}
+
+socket::BufferedOptions options(std::size_t max_buffered_bytes,
+                                std::uint64_t flush_delay_us) {
+  socket::BufferedOptions options;
+  options.max_buffered_bytes = max_buffered_bytes;
+  options.flush_delay_us = flush_delay_us;
+  return options;
+}
+}
+
+BOOST_AUTO_TEST_SUITE(buffered_socket_test)
+
+BOOST_AUTO_TEST_CASE(ShouldCoalesceSmallSendsIntoOneWrite) {
+  const auto sockets = util::connect();
+  socket::BufferedSocket buffered(sockets.first, options(16 * 1024, 10000000));
+
+  std::string sent;
+  for (auto i = 0; i < 100; i++) {
+    const auto message = "message " + std::to_string(i) + ";";
+    buffered.send(message);
+    sent += message;
+  }
+  BOOST_ASSERT(buffered.writes() == 0);
+  buffered.flush();
+  BOOST_ASSERT(buffered.writes() == 1);
+  BOOST_ASSERT(buffered.bytes_sent() == sent.size());
+  BOOST_ASSERT(receive(*sockets.second, sent.size()) == sent);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldWriteWhenBufferIsFullOrDeadlinePasses) {
+  const auto sockets = util::connect();
+  socket::BufferedSocket buffered(sockets.first, options(1000, 1000));
+
+  // written with MSG_MORE straight away, and pushed at the deadline
+  const auto large = std::string(1500, 'x');
+  buffered.send(large);
+  BOOST_ASSERT(buffered.writes() == 1);
+  BOOST_ASSERT(receive(*sockets.second, large.size()) == large);
+
+  buffered.send("tail");
+  BOOST_ASSERT(receive(*sockets.second, 4) == "tail");
+  BOOST_ASSERT(buffered.writes() == 2);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldWriteAtDeadlineWhileDataIsInFlight) {
+  const auto sockets = util::connect();
+  socket::BufferedSocket buffered(sockets.first, options(16 * 1024, 200));
+
+  // The other end only answers once both halves have arrived, so it doesn't
+  // acknowledge the first straight away. Under Nagle's algorithm the second
+  // would wait for that acknowledgement, a delayed ACK of up to 40ms.
+  const auto start = std::chrono::steady_clock::now();
+  for (auto i = 0; i < 20; i++) {
+    buffered.send("request ");
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    buffered.send("end");
+    BOOST_ASSERT(receive(*sockets.second, 11) == "request end");
+    sockets.second->send("ok");
+    BOOST_ASSERT(receive(*sockets.first, 2) == "ok");
+  }
+  BOOST_ASSERT(std::chrono::steady_clock::now() - start <
+               std::chrono::milliseconds(200));
+}
+
+BOOST_AUTO_TEST_CASE(ShouldFlushBeforeReceiving) {
+  const auto sockets = util::connect();
+  socket::BufferedSocket buffered(sockets.first, options(16 * 1024, 10000000));
+
+  buffered.send("ping");
+  auto response =
+      std::async(std::launch::async, [&]() { return buffered.receive(); });
+  BOOST_ASSERT(receive(*sockets.second, 4) == "ping");
+  sockets.second->send("pong");
+  BOOST_ASSERT(response.get() == "pong");
+
+  buffered.send("bye");
+  buffered.close();
+  BOOST_ASSERT(receive(*sockets.second, 3) == "bye");
+  BOOST_CHECK_THROW(buffered.send("more"), socket::SocketException);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+}
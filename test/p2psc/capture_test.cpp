@@ -0,0 +1,119 @@
+#include <boost/test/unit_test.hpp>
+#include <condition_variable>
+#include <p2psc/capture/capture.h>
+#include <p2psc/capture/capture_exception.h>
+#include <p2psc/capture/recording_socket.h>
+#include <socket/local_listening_socket.h>
+#include <thread>
+
+namespace p2psc {
+namespace test {
+namespace {
+const auto filename = "/tmp/p2psc_capture_testfile";
+}
+
+BOOST_AUTO_TEST_SUITE(capture_test)
+
+BOOST_AUTO_TEST_CASE(ShouldWriteAndReadRecords) {
+  {
+    const auto writer = capture::CaptureWriter::open(filename);
+    const auto id =
+        writer->open_connection(socket::SocketAddress("127.0.0.1", 1337));
+    writer->record(id, capture::kEventSent, "bananas");
+    writer->record(id, capture::kEventReceived, std::string("\0\1\2", 3));
+    writer->record(id, capture::kEventClose, "");
+  }
+
+  const auto reader = capture::CaptureReader::open(filename);
+  const auto open = reader->next();
+  BOOST_ASSERT(open && open->event == capture::kEventOpen);
+  BOOST_ASSERT(open->data == "127.0.0.1:1337");
+  const auto sent = reader->next();
+  BOOST_ASSERT(sent && sent->event == capture::kEventSent);
+  BOOST_ASSERT(sent->connection_id == open->connection_id);
+  BOOST_ASSERT(sent->data == "bananas");
+  BOOST_ASSERT(sent->timestamp_us >= open->timestamp_us);
+  const auto received = reader->next();
+  BOOST_ASSERT(received && received->event == capture::kEventReceived);
+  BOOST_ASSERT(received->data == std::string("\0\1\2", 3));
+  const auto close = reader->next();
+  BOOST_ASSERT(close && close->event == capture::kEventClose);
+  BOOST_ASSERT(!reader->next());
+  remove(filename);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldNotReadNonCaptureFile) {
+  FILE *file = fopen(filename, "w");
+  fputs("not a capture", file);
+  fclose(file);
+  try {
+    capture::CaptureReader::open(filename);
+    remove(filename);
+    BOOST_FAIL("Should have thrown CaptureException");
+  } catch (const capture::CaptureException &e) {
+  }
+  remove(filename);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldStopCapturingWhenWritingFails) {
+  // every write to /dev/full fails with ENOSPC
+  const auto writer = capture::CaptureWriter::open("/dev/full");
+  const auto id =
+      writer->open_connection(socket::SocketAddress("127.0.0.1", 1337));
+  writer->record(id, capture::kEventSent, std::string(128 * 1024, 'x'));
+  BOOST_ASSERT(writer->failed());
+  writer->record(id, capture::kEventClose, "");
+  BOOST_CHECK_THROW(writer->flush(), capture::CaptureException);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldRecordSocketTraffic) {
+  std::mutex mutex;
+  std::condition_variable cv;
+  uint16_t port = 0;
+  const auto writer = capture::CaptureWriter::open(filename);
+  const auto socket_creator = capture::recording_socket_creator(writer);
+  std::thread thread([&]() mutable {
+    const auto listener =
+        std::make_unique<socket::LocalListeningSocket>(socket_creator);
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      port = listener->get_socket_address().port();
+    }
+    cv.notify_one();
+    const auto socket = listener->accept();
+    BOOST_ASSERT(socket->receive() == "ping");
+    socket->send("pong");
+  });
+
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&port]() { return port != 0; });
+    const auto socket =
+        socket_creator(socket::SocketAddress(socket::local_ip, port));
+    socket->send("ping");
+    BOOST_ASSERT(socket->receive() == "pong");
+    thread.join();
+  }
+  writer->flush();
+
+  // each side of the connection gets its own id: an open, one message in
+  // each direction and a close per side.
+  const auto reader = capture::CaptureReader::open(filename);
+  int records = 0, sent = 0, received = 0;
+  while (const auto record = reader->next()) {
+    records++;
+    if (record->event == capture::kEventSent) {
+      sent++;
+    } else if (record->event == capture::kEventReceived) {
+      received++;
+    }
+  }
+  BOOST_ASSERT(records == 8);
+  BOOST_ASSERT(sent == 2);
+  BOOST_ASSERT(received == 2);
+  remove(filename);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+}
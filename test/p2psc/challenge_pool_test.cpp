@@ -0,0 +1,85 @@
+#include <boost/test/unit_test.hpp>
+#include <chrono>
+#include <p2psc/crypto/crypto_exception.h>
+#include <p2psc/handshake/challenge_pool.h>
+#include <p2psc/key/keypair.h>
+#include <set>
+#include <thread>
+
+namespace p2psc {
+namespace test {
+namespace {
+
+// polls, as the refill thread is only woken by takes
+bool await_ready(handshake::ChallengePool &pool, std::size_t ready) {
+  for (auto i = 0; i < 500; i++) {
+    if (pool.stats().ready >= ready) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+}
+
+BOOST_AUTO_TEST_SUITE(challenge_pool_test)
+
+BOOST_AUTO_TEST_CASE(ShouldPrecomputeChallengesOfHotKeys) {
+  handshake::ChallengePoolOptions options;
+  options.challenges_per_key = 3;
+  options.hot_after = 2;
+  handshake::ChallengePool pool(options);
+  const auto keypair = key::Keypair::generate();
+  const auto serialised = keypair.get_serialised_public_key();
+
+  std::set<std::string> nonces;
+  const auto check = [&](const handshake::Challenge &challenge) {
+    BOOST_ASSERT(keypair.private_decrypt(challenge.encrypted_nonce) ==
+                 challenge.nonce);
+    // every challenge is handed out once
+    BOOST_ASSERT(nonces.insert(challenge.nonce).second);
+  };
+
+  // not hot yet
+  check(pool.take(serialised));
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  BOOST_ASSERT(pool.stats().ready == 0);
+
+  check(pool.take(key::PublicKey::from_string(serialised)));
+  BOOST_ASSERT(await_ready(pool, 3));
+  for (auto i = 0; i < 3; i++) {
+    check(pool.take(serialised));
+  }
+  const auto stats = pool.stats();
+  BOOST_ASSERT(stats.hits >= 3);
+  BOOST_ASSERT(stats.hits + stats.misses == 5);
+  BOOST_ASSERT(stats.keys == 1);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldDropLeastRecentlyChallengedKeys) {
+  handshake::ChallengePoolOptions options;
+  options.hot_after = 1;
+  options.max_keys = 2;
+  handshake::ChallengePool pool(options);
+  const auto first = key::Keypair::generate().get_serialised_public_key();
+  const auto second = key::Keypair::generate().get_serialised_public_key();
+  const auto third = key::Keypair::generate().get_serialised_public_key();
+
+  pool.take(first);
+  pool.take(second);
+  pool.take(first);
+  BOOST_ASSERT(await_ready(pool, 2 * options.challenges_per_key));
+  pool.take(third);
+  // second went, and its challenges with it
+  BOOST_ASSERT(pool.stats().keys == 2);
+  const auto misses = pool.stats().misses;
+  pool.take(second);
+  BOOST_ASSERT(pool.stats().misses == misses + 1);
+
+  BOOST_CHECK_THROW(pool.take(std::string("not a key")),
+                    crypto::CryptoException);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+}
@@ -0,0 +1,163 @@
+#include <boost/test/unit_test.hpp>
+#include <p2psc/compression/compressed_socket.h>
+#include <p2psc/compression/compression_exception.h>
+#include <random>
+#include <util/socket_pair.h>
+#include <zstd.h>
+
+namespace p2psc {
+namespace test {
+namespace {
+const std::size_t kMessages = 200;
+
+struct SocketPair {
+  std::shared_ptr<compression::CompressedSocket> sender;
+  std::shared_ptr<compression::CompressedSocket> receiver;
+};
+
+SocketPair connected_pair(const compression::Compression &compression) {
+  const auto sockets = util::connect();
+  return SocketPair{std::make_shared<compression::CompressedSocket>(
+                        sockets.first, compression),
+                    std::make_shared<compression::CompressedSocket>(
+                        sockets.second, compression)};
+}
+
+compression::Compression enabled() {
+  compression::Compression compression;
+  compression.enabled = true;
+  return compression;
+}
+
+std::string telemetry(std::mt19937 &random) {
+  return "{\"host\":\"sensor-" + std::to_string(random() % 16) +
+         "\",\"temperature\":" + std::to_string(random() % 40) +
+         ",\"humidity\":" + std::to_string(random() % 100) +
+         ",\"status\":\"ok\"}";
+}
+
+std::string random_bytes(std::mt19937 &random, std::size_t size) {
+  std::string bytes(size, '\0');
+  for (auto &byte : bytes) {
+    byte = static_cast<char>(random());
+  }
+  return bytes;
+}
+
+// send all messages, then check that they arrive intact
+void send_and_verify(SocketPair &pair,
+                     const std::vector<std::string> &messages) {
+  std::string sent;
+  for (const auto &message : messages) {
+    pair.sender->send(message);
+    sent += message;
+  }
+  std::string received;
+  while (received.size() < sent.size()) {
+    received += pair.receiver->receive();
+  }
+  BOOST_ASSERT(received == sent);
+}
+}
+
+BOOST_AUTO_TEST_SUITE(compression_test)
+
+BOOST_AUTO_TEST_CASE(ShouldCompressAndDecompressStream) {
+  std::mt19937 random(1);
+  std::vector<std::string> messages;
+  for (std::size_t i = 0; i < kMessages; i++) {
+    messages.push_back(telemetry(random));
+  }
+  auto pair = connected_pair(enabled());
+  send_and_verify(pair, messages);
+  BOOST_ASSERT(pair.sender->wire_bytes_sent() <
+               pair.sender->bytes_sent() / 2);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldSendIncompressibleDataRaw) {
+  std::mt19937 random(1);
+  std::vector<std::string> messages;
+  for (std::size_t i = 0; i < kMessages; i++) {
+    messages.push_back(random_bytes(random, 1000));
+  }
+  auto pair = connected_pair(enabled());
+  send_and_verify(pair, messages);
+  // frame headers, and the few messages compression is retried on
+  BOOST_ASSERT(pair.sender->wire_bytes_sent() <
+               pair.sender->bytes_sent() + 10 * kMessages);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldCompressBetterWithDictionary) {
+  std::mt19937 random(1);
+  std::vector<std::string> samples;
+  for (std::size_t i = 0; i < 2000; i++) {
+    samples.push_back(telemetry(random));
+  }
+  auto with_dictionary = enabled();
+  with_dictionary.dictionary = compression::train_dictionary(samples, 4096);
+  BOOST_ASSERT(compression::dictionary_id(with_dictionary.dictionary) != 0);
+
+  const std::vector<std::string> message = {telemetry(random)};
+  auto pair = connected_pair(enabled());
+  send_and_verify(pair, message);
+  auto dictionary_pair = connected_pair(with_dictionary);
+  send_and_verify(dictionary_pair, message);
+  BOOST_ASSERT(dictionary_pair.sender->wire_bytes_sent() <
+               pair.sender->wire_bytes_sent());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldSplitLargeSends) {
+  std::mt19937 random(1);
+  std::string message;
+  while (message.size() < 3 * 1024 * 1024) {
+    message += telemetry(random);
+  }
+  auto pair = connected_pair(enabled());
+  send_and_verify(pair, {message});
+}
+
+BOOST_AUTO_TEST_CASE(ShouldRejectOversizedFrames) {
+  // 2 MiB of zeros compresses to a few bytes
+  const std::string zeros(2 * 1024 * 1024, '\0');
+  std::string bomb(ZSTD_compressBound(zeros.size()), '\0');
+  bomb.resize(ZSTD_compress(&bomb[0], bomb.size(), zeros.data(),
+                            zeros.size(), 1));
+  const std::vector<std::string> frames = {
+      std::string(1, '\0') + std::string(4, '\xff'),
+      std::string(1, '\1') + std::string(1, '\0') +
+          static_cast<char>(bomb.size() >> 16) +
+          static_cast<char>(bomb.size() >> 8) +
+          static_cast<char>(bomb.size()) + bomb};
+  for (const auto &frame : frames) {
+    const auto sockets = util::connect();
+    compression::CompressedSocket receiver(sockets.second, enabled());
+    sockets.first->send(frame);
+    BOOST_CHECK_THROW(receiver.receive(), socket::SocketException);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ShouldNegotiateDictionaryOnlyIfShared) {
+  auto ours = enabled();
+  ours.dictionary = "not really a dictionary, but it has an id of 0";
+  BOOST_ASSERT(!compression::negotiate(compression::Compression(),
+                                       compression::kAlgorithmZstd,
+                                       boost::none));
+  BOOST_ASSERT(!compression::negotiate(ours, boost::none, boost::none));
+  BOOST_ASSERT(!compression::negotiate(ours, std::string("lz4"), 0u));
+
+  const auto negotiated =
+      compression::negotiate(ours, compression::kAlgorithmZstd, 42u);
+  BOOST_ASSERT(negotiated);
+  BOOST_ASSERT(negotiated->dictionary.empty());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldRejectUnsupportedLevel) {
+  auto compression = enabled();
+  compression.level = 1000;
+  BOOST_CHECK_THROW(compression::set_compression(compression),
+                    compression::CompressionException);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+}
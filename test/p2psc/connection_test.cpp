@@ -23,13 +23,15 @@ BOOST_AUTO_TEST_CASE(ShouldCallbackWithErrorForNonExistantMediator) {
     BOOST_ASSERT(error);
     BOOST_ASSERT(error.kind() == error::kErrorMediatorConnectFailure);
     BOOST_ASSERT(socket == nullptr);
-    has_called_callback = true;
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      has_called_callback = true;
+    }
     cv.notify_one();
   };
   p2psc::connect(keypair, peer, mediator, callback);
   std::unique_lock<std::mutex> lock(mutex);
-  cv.wait(lock);
-  BOOST_ASSERT(has_called_callback);
+  cv.wait(lock, [&has_called_callback]() { return has_called_callback; });
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,128 @@
+#include <arpa/inet.h>
+#include <boost/test/unit_test.hpp>
+#include <cstring>
+#include <p2psc/dht/node.h>
+#include <p2psc/key/public_key.h>
+#include <p2psc/message/message.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace p2psc {
+namespace test {
+namespace {
+
+const std::size_t kNodes = 20;
+
+std::string fingerprint_of(const key::Keypair &keypair) {
+  return key::PublicKey::from_string(keypair.get_serialised_public_key())
+      .fingerprint();
+}
+
+dht::NodeId id_with_first_byte(std::uint8_t first) {
+  dht::NodeId id = {};
+  id[0] = first;
+  return id;
+}
+
+std::vector<std::unique_ptr<dht::Node>> create_network(std::size_t size) {
+  std::vector<std::unique_ptr<dht::Node>> nodes;
+  nodes.push_back(std::make_unique<dht::Node>());
+  const socket::SocketAddress seed(socket::local_ip, nodes[0]->port());
+  for (std::size_t i = 1; i < size; i++) {
+    nodes.push_back(std::make_unique<dht::Node>());
+    nodes.back()->bootstrap({seed});
+  }
+  return nodes;
+}
+
+// Sends a store query for record to node from a plain UDP socket, and waits
+// for the response.
+void store(const dht::Node &node, const message::DhtRecord &record) {
+  message::DhtQuery query{kVersion,    1,           dht::to_hex({}),
+                          message::kDhtStore,       boost::none,
+                          boost::none, record};
+  const auto data = encode(Message<message::DhtQuery>(query).format());
+  const auto fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(node.port());
+  inet_pton(AF_INET, socket::local_ip.c_str(), &address.sin_addr);
+  sendto(fd, data.data(), data.size(), 0, (struct sockaddr *)&address,
+         sizeof(address));
+  struct pollfd poll_fd = {fd, POLLIN, 0};
+  BOOST_ASSERT(poll(&poll_fd, 1, 1000) == 1);
+  ::close(fd);
+}
+}
+
+BOOST_AUTO_TEST_SUITE(dht_test)
+
+BOOST_AUTO_TEST_CASE(ShouldReturnClosestContactsFirst) {
+  dht::RoutingTable table(id_with_first_byte(0), 1);
+  for (const std::uint8_t first : {0x80, 0x01, 0x40, 0x03, 0x02}) {
+    table.update(dht::Contact{id_with_first_byte(first),
+                              socket::SocketAddress(socket::local_ip, first)});
+  }
+  // 0x02 shares a bucket with 0x03, which is full
+  BOOST_ASSERT(table.size() == 4);
+  const auto closest = table.closest(id_with_first_byte(0x41), 3);
+  BOOST_ASSERT(closest.size() == 3);
+  BOOST_ASSERT(closest[0].id == id_with_first_byte(0x40));
+  BOOST_ASSERT(closest[1].id == id_with_first_byte(0x01));
+  BOOST_ASSERT(closest[2].id == id_with_first_byte(0x03));
+
+  table.remove(id_with_first_byte(0x40));
+  BOOST_ASSERT(table.closest(id_with_first_byte(0x41), 1)[0].id ==
+               id_with_first_byte(0x01));
+  BOOST_ASSERT(dht::shared_prefix_length(id_with_first_byte(0),
+                                         id_with_first_byte(0x10)) == 3);
+  BOOST_ASSERT(dht::from_hex(dht::to_hex(id_with_first_byte(0x41))) ==
+               id_with_first_byte(0x41));
+  BOOST_ASSERT(!dht::from_hex("not hex"));
+}
+
+BOOST_AUTO_TEST_CASE(ShouldFindRecordPublishedByAnotherNode) {
+  const auto nodes = create_network(kNodes);
+  for (const auto &node : nodes) {
+    BOOST_ASSERT(node->known_nodes() > 0);
+  }
+  const auto keypair = key::Keypair::generate();
+  const auto fingerprint = fingerprint_of(keypair);
+  BOOST_ASSERT(nodes[3]->publish(keypair, "their_fingerprint", 1337) > 0);
+
+  std::size_t stored = 0;
+  for (const auto &node : nodes) {
+    stored += node->stored_records();
+  }
+  BOOST_ASSERT(stored > 0 && stored <= nodes[3]->options().k);
+  const auto record = nodes[kNodes - 1]->find(fingerprint, "their_fingerprint");
+  BOOST_ASSERT(record);
+  BOOST_ASSERT(record->ip == socket::local_ip && record->port == 1337);
+  // only the peer the record is for finds it
+  BOOST_ASSERT(!nodes[kNodes - 1]->find(fingerprint, "other_fingerprint"));
+}
+
+BOOST_AUTO_TEST_CASE(ShouldOnlyStoreRecordsSignedByTheirKey) {
+  const auto nodes = create_network(3);
+  const auto keypair = key::Keypair::generate();
+  BOOST_ASSERT(nodes[1]->publish(keypair, "their_fingerprint", 1337) > 0);
+  const auto record =
+      nodes[2]->find(fingerprint_of(keypair), "their_fingerprint");
+  BOOST_ASSERT(record);
+
+  dht::Node node;
+  auto forged = *record;
+  forged.port = 1338;
+  store(node, forged);
+  forged = *record;
+  forged.public_key = key::Keypair::generate().get_serialised_public_key();
+  store(node, forged);
+  BOOST_ASSERT(node.stored_records() == 0);
+  store(node, *record);
+  BOOST_ASSERT(node.stored_records() == 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+}
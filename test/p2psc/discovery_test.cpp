@@ -0,0 +1,79 @@
+#include <boost/test/unit_test.hpp>
+#include <discovery/lan_discovery.h>
+#include <future>
+#include <p2psc/discovery/discovery_exception.h>
+#include <p2psc/socket_factory.h>
+
+namespace p2psc {
+namespace test {
+namespace {
+
+Peer peer_of(const key::Keypair &keypair) {
+  return Peer(key::PublicKey::from_string(keypair.get_serialised_public_key()));
+}
+
+discovery::Discovery options() {
+  discovery::Discovery discovery;
+  discovery.enabled = true;
+  discovery.timeout_ms = 1000;
+  return discovery;
+}
+}
+
+BOOST_AUTO_TEST_SUITE(discovery_test)
+
+BOOST_AUTO_TEST_CASE(ShouldRejectInvalidSettings) {
+  auto discovery = options();
+  discovery.group = "192.168.1.1";
+  BOOST_CHECK_THROW(discovery::set_discovery(discovery),
+                    discovery::DiscoveryException);
+  discovery = options();
+  discovery.announce_interval_ms = 0;
+  BOOST_CHECK_THROW(discovery::set_discovery(discovery),
+                    discovery::DiscoveryException);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldFindPeerAndConnectOnLan) {
+  const auto keypair = key::Keypair::generate();
+  const auto other_keypair = key::Keypair::generate();
+  discovery::LanDiscovery ours(keypair, peer_of(other_keypair), options());
+  discovery::LanDiscovery theirs(other_keypair, peer_of(keypair), options());
+  BOOST_ASSERT(ours.is_client() != theirs.is_client());
+  auto &client = ours.is_client() ? ours : theirs;
+  auto &peer = ours.is_client() ? theirs : ours;
+
+  auto peer_found = std::async(std::launch::async, [&]() {
+    return peer.find();
+  });
+  const auto address = client.find();
+  BOOST_ASSERT(address && peer_found.get());
+
+  const PlainSocketFactory socket_factory;
+  const auto client_socket = socket_factory.create(*address);
+  const auto peer_fd = peer.accept();
+  BOOST_ASSERT(peer_fd != -1);
+  const auto peer_socket = socket_factory.create(peer_fd);
+  client_socket->send("hello");
+  BOOST_ASSERT(peer_socket->receive() == "hello");
+}
+
+BOOST_AUTO_TEST_CASE(ShouldIgnoreAnnouncementsForOtherPeers) {
+  const auto keypair = key::Keypair::generate();
+  const auto other_keypair = key::Keypair::generate();
+  const auto third_keypair = key::Keypair::generate();
+  auto short_timeout = options();
+  short_timeout.timeout_ms = 200;
+  discovery::LanDiscovery ours(keypair, peer_of(other_keypair),
+                               short_timeout);
+  // looking for someone else
+  discovery::LanDiscovery theirs(other_keypair, peer_of(third_keypair),
+                                 short_timeout);
+
+  auto found = std::async(std::launch::async, [&]() { return theirs.find(); });
+  BOOST_ASSERT(!ours.find());
+  BOOST_ASSERT(!found.get());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+}
@@ -0,0 +1,98 @@
+#include <boost/test/unit_test.hpp>
+#include <condition_variable>
+#include <p2psc/key/keypair.h>
+#include <p2psc/metrics/count_allocations.h>
+#include <p2psc/metrics/handshake_stats.h>
+#include <socket/local_listening_socket.h>
+#include <thread>
+
+namespace p2psc {
+namespace test {
+namespace {
+const auto socket_creator =
+    [](const SocketAddressOrFileDescriptor &address_or_file_descriptor) {
+      if (address_or_file_descriptor.has_socket_address()) {
+        return std::make_shared<Socket>(
+            address_or_file_descriptor.socket_address());
+      } else {
+        return std::make_shared<Socket>(address_or_file_descriptor.sock_fd());
+      }
+    };
+}
+
+BOOST_AUTO_TEST_SUITE(handshake_stats_test)
+
+BOOST_AUTO_TEST_CASE(ShouldNotCountWithoutHandler) {
+  std::thread thread([]() {
+    {
+      metrics::HandshakeStatsScope scope;
+      const auto allocation = std::make_unique<std::string>(100, 'x');
+      metrics::count_crypto_operation();
+    }
+    const auto &stats = metrics::last_handshake_stats();
+    BOOST_ASSERT(stats.allocations == 0);
+    BOOST_ASSERT(stats.crypto_operations == 0);
+  });
+  thread.join();
+}
+
+BOOST_AUTO_TEST_CASE(ShouldCountSocketSyscallsAndAllocations) {
+  int handled = 0;
+  metrics::set_handshake_stats_handler(
+      [&handled](const metrics::HandshakeStats &) { handled++; });
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  uint16_t port = 0;
+  std::thread thread([&]() mutable {
+    const auto listener =
+        std::make_unique<socket::LocalListeningSocket>(socket_creator);
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      port = listener->get_socket_address().port();
+    }
+    cv.notify_one();
+    const auto socket = listener->accept();
+    socket->send(socket->receive());
+  });
+
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&port]() { return port != 0; });
+  }
+  {
+    metrics::HandshakeStatsScope scope;
+    const auto socket =
+        std::make_shared<Socket>(socket::SocketAddress(socket::local_ip, port));
+    // exactly one full buffer, so receive() has to ask whether more is coming
+    socket->send(std::string(socket::RECV_BUF_SIZE, 'x'));
+    BOOST_ASSERT(socket->receive().size() == socket::RECV_BUF_SIZE);
+  }
+  thread.join();
+  metrics::set_handshake_stats_handler(nullptr);
+
+  const auto &stats = metrics::last_handshake_stats();
+  BOOST_ASSERT(handled == 1);
+  BOOST_ASSERT(stats.connect_calls == 1);
+  BOOST_ASSERT(stats.send_calls == 1);
+  BOOST_ASSERT(stats.read_calls == 1);
+  BOOST_ASSERT(stats.ioctl_calls == 1);
+  BOOST_ASSERT(stats.crypto_operations == 0);
+  BOOST_ASSERT(stats.allocations > 0);
+  BOOST_ASSERT(stats.allocated_bytes >= socket::RECV_BUF_SIZE);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldCountCryptoOperations) {
+  metrics::set_handshake_stats_handler([](const metrics::HandshakeStats &) {});
+  const auto keypair = key::Keypair::generate();
+  {
+    metrics::HandshakeStatsScope scope;
+    keypair.private_decrypt(keypair.public_encrypt("bananas"));
+  }
+  metrics::set_handshake_stats_handler(nullptr);
+  BOOST_ASSERT(metrics::last_handshake_stats().crypto_operations == 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+}
@@ -0,0 +1,335 @@
+#include <boost/test/unit_test.hpp>
+#include <p2psc/connection_exception.h>
+#include <p2psc/handshake/handshake.h>
+#include <p2psc/message/advertise_abort.h>
+#include <p2psc/message/advertise_challenge.h>
+#include <p2psc/message/advertise_response.h>
+#include <p2psc/message/message_exception.h>
+#include <p2psc/message/peer_disconnect.h>
+#include <p2psc/message/peer_identification.h>
+#include <p2psc/socket/socket_exception.h>
+
+namespace p2psc {
+namespace test {
+namespace {
+const auto mediator = Mediator("127.0.0.1", 9999);
+const std::uint16_t peer_port = 1234;
+
+template <class T> std::string encode_message(const T &payload) {
+  return encode(Message<T>(payload).format());
+}
+
+std::vector<handshake::Action> drain(handshake::StateMachine &machine) {
+  std::vector<handshake::Action> actions;
+  while (const auto action = machine.poll_action()) {
+    actions.push_back(*action);
+  }
+  return actions;
+}
+
+/*
+ * Plays the Mediator's part up to the point where it has verified us, and
+ * leaves handshake waiting for the Mediator's decision.
+ */
+void verify_with_mediator(handshake::Handshake &handshake,
+                          const key::Keypair &keypair) {
+  handshake.start();
+  auto actions = drain(handshake);
+  BOOST_ASSERT(actions.size() == 1);
+  BOOST_ASSERT(actions[0].type == handshake::Action::kActionConnect);
+  BOOST_ASSERT(*actions[0].address == mediator.socket_address);
+
+  handshake.on_connected();
+  actions = drain(handshake);
+  BOOST_ASSERT(actions.size() == 1);
+  BOOST_ASSERT(actions[0].message_type == message::kTypeAdvertise);
+
+  handshake.on_message(encode_message(
+      message::AdvertiseChallenge{keypair.public_encrypt("mediator nonce")}));
+  actions = drain(handshake);
+  BOOST_ASSERT(actions.size() == 1);
+  BOOST_ASSERT(message::decode<message::AdvertiseResponse>(actions[0].data)
+                   .payload.nonce == "mediator nonce");
+}
+
+handshake::Handshake create_handshake(
+    const key::Keypair &our_keypair, const key::Keypair &their_keypair,
+    const handshake::Extensions &extensions = handshake::Extensions()) {
+  return handshake::Handshake(
+      our_keypair,
+      Peer(key::PublicKey::from_string(
+          their_keypair.get_serialised_public_key())),
+      mediator, []() { return "nonce"; }, extensions);
+}
+
+// Deliver every message from's pending Send actions to to.
+void deliver(handshake::Handshake &from, handshake::Handshake &to) {
+  for (const auto &action : drain(from)) {
+    BOOST_ASSERT(action.type == handshake::Action::kActionSend);
+    to.on_message(action.data);
+  }
+}
+
+// Take client and peer through the whole handshake.
+void complete(handshake::Handshake &client, const key::Keypair &client_keypair,
+              handshake::Handshake &peer, const key::Keypair &peer_keypair) {
+  verify_with_mediator(client, client_keypair);
+  client.on_message(encode_message(
+      message::PeerIdentification{kVersion, "127.0.0.1", peer_port}));
+  drain(client);
+  verify_with_mediator(peer, peer_keypair);
+  peer.on_message(encode_message(message::PeerDisconnect{peer_port}));
+  drain(peer);
+
+  peer.on_connected();
+  client.on_connected();
+  while (!client.is_done() || !peer.is_done()) {
+    deliver(client, peer);
+    deliver(peer, client);
+  }
+}
+}
+
+BOOST_AUTO_TEST_SUITE(handshake_test)
+
+BOOST_AUTO_TEST_CASE(ShouldHandshakeAsClientAndPeer) {
+  const auto client_keypair = key::Keypair::generate();
+  const auto peer_keypair = key::Keypair::generate();
+  auto client = create_handshake(client_keypair, peer_keypair);
+  auto peer = create_handshake(peer_keypair, client_keypair);
+
+  verify_with_mediator(client, client_keypair);
+  client.on_message(encode_message(
+      message::PeerIdentification{kVersion, "127.0.0.1", peer_port}));
+  auto actions = drain(client);
+  BOOST_ASSERT(client.role() == handshake::Handshake::kRoleClient);
+  BOOST_ASSERT(actions.size() == 2);
+  BOOST_ASSERT(actions[0].type ==
+               handshake::Action::kActionCloseMediatorConnection);
+  BOOST_ASSERT(actions[1].type == handshake::Action::kActionConnect);
+  BOOST_ASSERT(actions[1].address->port() == peer_port);
+
+  verify_with_mediator(peer, peer_keypair);
+  peer.on_message(encode_message(message::PeerDisconnect{peer_port}));
+  actions = drain(peer);
+  BOOST_ASSERT(peer.role() == handshake::Handshake::kRolePeer);
+  BOOST_ASSERT(actions.size() == 2);
+  BOOST_ASSERT(actions[0].type ==
+               handshake::Action::kActionCloseMediatorConnection);
+  BOOST_ASSERT(actions[1].type == handshake::Action::kActionListen);
+  BOOST_ASSERT(actions[1].port == peer_port);
+
+  peer.on_connected();
+  client.on_connected();
+  // PeerChallenge, PeerChallengeResponse, PeerResponse, PeerAcknowledgement
+  deliver(client, peer);
+  deliver(peer, client);
+  deliver(client, peer);
+  BOOST_ASSERT(peer.is_done());
+  BOOST_ASSERT(!client.is_done());
+  deliver(peer, client);
+  BOOST_ASSERT(client.is_done());
+  BOOST_ASSERT(!client.has_action() && !peer.has_action());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldHandshakeWithoutMediatorWhenAlreadyConnected) {
+  const auto client_keypair = key::Keypair::generate();
+  const auto peer_keypair = key::Keypair::generate();
+  auto client = create_handshake(client_keypair, peer_keypair);
+  auto peer = create_handshake(peer_keypair, client_keypair);
+
+  client.start_as_client(PunchedPeer(
+      Peer(key::PublicKey::from_string(
+          peer_keypair.get_serialised_public_key())),
+      socket::SocketAddress("127.0.0.1", peer_port), kVersion));
+  peer.start_as_peer();
+  BOOST_ASSERT(client.role() == handshake::Handshake::kRoleClient);
+  BOOST_ASSERT(peer.role() == handshake::Handshake::kRolePeer);
+  while (!client.is_done() || !peer.is_done()) {
+    deliver(client, peer);
+    deliver(peer, client);
+  }
+  BOOST_ASSERT(!client.has_action() && !peer.has_action());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldMeetIntroducedPeerAtRendezvous) {
+  const auto client_keypair = key::Keypair::generate();
+  const auto peer_keypair = key::Keypair::generate();
+  auto client = create_handshake(client_keypair, peer_keypair);
+  auto peer = create_handshake(peer_keypair, client_keypair);
+
+  client.start_at(handshake::Rendezvous{
+      true, socket::SocketAddress("127.0.0.1", peer_port)});
+  auto actions = drain(client);
+  BOOST_ASSERT(actions.size() == 1);
+  BOOST_ASSERT(actions[0].type == handshake::Action::kActionConnect);
+  BOOST_ASSERT(actions[0].address->port() == peer_port);
+
+  peer.start_at(handshake::Rendezvous{
+      false, socket::SocketAddress("127.0.0.1", peer_port)});
+  actions = drain(peer);
+  BOOST_ASSERT(actions.size() == 1);
+  BOOST_ASSERT(actions[0].type == handshake::Action::kActionListen);
+  BOOST_ASSERT(actions[0].port == peer_port);
+  BOOST_ASSERT(actions[0].delay ==
+               handshake::Handshake::introduced_accept_timeout);
+
+  peer.on_connected();
+  client.on_connected();
+  while (!client.is_done() || !peer.is_done()) {
+    deliver(client, peer);
+    deliver(peer, client);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ShouldNegotiateCompressionOnlyIfBothEnable) {
+  const auto client_keypair = key::Keypair::generate();
+  const auto peer_keypair = key::Keypair::generate();
+  handshake::Extensions enabled;
+  enabled.compression.enabled = true;
+  enabled.compression.level = 7;
+
+  auto client = create_handshake(client_keypair, peer_keypair, enabled);
+  auto peer = create_handshake(peer_keypair, client_keypair, enabled);
+  complete(client, client_keypair, peer, peer_keypair);
+  BOOST_ASSERT(client.negotiated_compression()->level == 7);
+  BOOST_ASSERT(peer.negotiated_compression()->level == 7);
+
+  auto other_client = create_handshake(client_keypair, peer_keypair, enabled);
+  auto other_peer = create_handshake(peer_keypair, client_keypair);
+  complete(other_client, client_keypair, other_peer, peer_keypair);
+  BOOST_ASSERT(!other_client.negotiated_compression());
+  BOOST_ASSERT(!other_peer.negotiated_compression());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldNegotiateLocalSocketOnlyOnTheSameHost) {
+  const auto client_keypair = key::Keypair::generate();
+  const auto peer_keypair = key::Keypair::generate();
+  handshake::Extensions client_extensions;
+  client_extensions.host_id = std::string("host");
+  handshake::Extensions peer_extensions = client_extensions;
+  peer_extensions.local_socket_name = "p2psc-test";
+  peer_extensions.local_socket_token = "token";
+
+  auto client = create_handshake(client_keypair, peer_keypair,
+                                 client_extensions);
+  auto peer = create_handshake(peer_keypair, client_keypair, peer_extensions);
+  complete(client, client_keypair, peer, peer_keypair);
+  BOOST_ASSERT(*client.local_socket() == "p2psc-test");
+  BOOST_ASSERT(*peer.local_socket() == "p2psc-test");
+  BOOST_ASSERT(*client.local_socket_token() == "token");
+
+  peer_extensions.host_id = std::string("other host");
+  auto other_client = create_handshake(client_keypair, peer_keypair,
+                                       client_extensions);
+  auto other_peer =
+      create_handshake(peer_keypair, client_keypair, peer_extensions);
+  complete(other_client, client_keypair, other_peer, peer_keypair);
+  BOOST_ASSERT(!other_client.local_socket());
+  BOOST_ASSERT(!other_peer.local_socket());
+  BOOST_ASSERT(!other_client.local_socket_token());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldExchangeEarlyDataOnlyIfPeerResponds) {
+  const auto client_keypair = key::Keypair::generate();
+  const auto peer_keypair = key::Keypair::generate();
+  handshake::Extensions client_extensions;
+  client_extensions.early_data.request = std::string("ping");
+  handshake::Extensions peer_extensions;
+  std::vector<std::string> requests;
+  peer_extensions.early_data.responder = [&](const std::string &request) {
+    requests.push_back(request);
+    return "pong";
+  };
+
+  auto client = create_handshake(client_keypair, peer_keypair,
+                                 client_extensions);
+  auto peer = create_handshake(peer_keypair, client_keypair, peer_extensions);
+  complete(client, client_keypair, peer, peer_keypair);
+  BOOST_ASSERT(*client.early_data_reply() == "pong");
+  BOOST_ASSERT(!peer.early_data_reply());
+  BOOST_ASSERT(requests == std::vector<std::string>{"ping"});
+
+  // the Peer doesn't accept early data
+  auto other_client = create_handshake(client_keypair, peer_keypair,
+                                       client_extensions);
+  auto other_peer = create_handshake(peer_keypair, client_keypair);
+  complete(other_client, client_keypair, other_peer, peer_keypair);
+  BOOST_ASSERT(!other_client.early_data_reply());
+
+  // too large to send early
+  client_extensions.early_data.request =
+      std::string(handshake::kMaxEarlyDataSize + 1, 'x');
+  auto large_client = create_handshake(client_keypair, peer_keypair,
+                                       client_extensions);
+  auto large_peer =
+      create_handshake(peer_keypair, client_keypair, peer_extensions);
+  complete(large_client, client_keypair, large_peer, peer_keypair);
+  BOOST_ASSERT(!large_client.early_data_reply());
+  BOOST_ASSERT(requests.size() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldRetryConnectingToPeerWithBackoff) {
+  const auto keypair = key::Keypair::generate();
+  auto client = create_handshake(keypair, key::Keypair::generate());
+  verify_with_mediator(client, keypair);
+  client.on_message(encode_message(
+      message::PeerIdentification{kVersion, "127.0.0.1", peer_port}));
+  drain(client);
+
+  auto expected_delay = std::chrono::milliseconds(10);
+  for (int attempt = 1; attempt < handshake::Handshake::max_connect_attempts;
+       attempt++) {
+    client.on_socket_error("Connection refused");
+    auto actions = drain(client);
+    BOOST_ASSERT(actions.size() == 1);
+    BOOST_ASSERT(actions[0].type == handshake::Action::kActionStartTimer);
+    BOOST_ASSERT(actions[0].delay == expected_delay);
+    expected_delay *= 2;
+
+    client.on_timer();
+    actions = drain(client);
+    BOOST_ASSERT(actions.size() == 1);
+    BOOST_ASSERT(actions[0].type == handshake::Action::kActionConnect);
+  }
+  BOOST_CHECK_THROW(client.on_socket_error("Connection refused"),
+                    socket::SocketException);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldFailWhenMediatorIsUnreachable) {
+  auto handshake =
+      create_handshake(key::Keypair::generate(), key::Keypair::generate());
+  handshake.start();
+  drain(handshake);
+  try {
+    handshake.on_socket_error("Connection refused");
+    BOOST_FAIL("Expected ConnectionException");
+  } catch (const ConnectionException &e) {
+    BOOST_ASSERT(e.error().kind() == error::kErrorMediatorConnectFailure);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ShouldFailOnAdvertiseAbort) {
+  auto handshake =
+      create_handshake(key::Keypair::generate(), key::Keypair::generate());
+  handshake.start();
+  handshake.on_connected();
+  drain(handshake);
+  BOOST_CHECK_THROW(handshake.on_message(encode_message(
+                        message::AdvertiseAbort{"not today"})),
+                    std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldRejectUndecodableMessages) {
+  auto handshake =
+      create_handshake(key::Keypair::generate(), key::Keypair::generate());
+  handshake.start();
+  handshake.on_connected();
+  drain(handshake);
+  BOOST_CHECK_THROW(handshake.on_message("bananas"),
+                    message::MessageException);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+}
@@ -0,0 +1,94 @@
+#include <boost/test/unit_test.hpp>
+#include <condition_variable>
+#include <p2psc/metrics/instrumented_mutex.h>
+#include <thread>
+
+namespace p2psc {
+namespace test {
+
+BOOST_AUTO_TEST_SUITE(instrumented_mutex_test)
+
+BOOST_AUTO_TEST_CASE(ShouldNotProfileWhenDisabled) {
+  metrics::InstrumentedMutex mutex("instrumented_mutex_test/disabled");
+  {
+    std::lock_guard<metrics::InstrumentedMutex> guard(mutex);
+  }
+  BOOST_ASSERT(mutex.try_lock());
+  mutex.unlock();
+  const auto stats = metrics::lock_stats()["instrumented_mutex_test/disabled"];
+  BOOST_ASSERT(stats.acquisitions == 0);
+  BOOST_ASSERT(stats.hold_ns == 0);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldRecordContention) {
+  const auto site = "instrumented_mutex_test/contended";
+  metrics::set_lock_profiling_enabled(true);
+  metrics::InstrumentedMutex mutex(site);
+  std::unique_lock<metrics::InstrumentedMutex> lock(mutex);
+  std::thread thread([&mutex]() {
+    std::lock_guard<metrics::InstrumentedMutex> guard(mutex);
+  });
+  // only let go once the thread is blocked on the lock, however long it
+  // takes to get there
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (metrics::lock_stats()[site].waiting == 0 &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  BOOST_ASSERT(metrics::lock_stats()[site].waiting == 1);
+  lock.unlock();
+  thread.join();
+  metrics::set_lock_profiling_enabled(false);
+
+  const auto stats = metrics::lock_stats()[site];
+  BOOST_ASSERT(stats.acquisitions == 2);
+  BOOST_ASSERT(stats.contentions == 1);
+  BOOST_ASSERT(stats.wait_ns > 0);
+  BOOST_ASSERT(stats.max_wait_ns == stats.wait_ns);
+  BOOST_ASSERT(stats.hold_ns > 0);
+  BOOST_ASSERT(stats.waiting == 0);
+
+  metrics::reset_lock_stats();
+  BOOST_ASSERT(metrics::lock_stats()[site].acquisitions == 0);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldShareStatsBetweenMutexesOfOneSite) {
+  const auto site = "instrumented_mutex_test/shared";
+  metrics::set_lock_profiling_enabled(true);
+  metrics::InstrumentedMutex mutex_1(site);
+  metrics::InstrumentedMutex mutex_2(site);
+  {
+    std::lock_guard<metrics::InstrumentedMutex> guard_1(mutex_1);
+    std::lock_guard<metrics::InstrumentedMutex> guard_2(mutex_2);
+  }
+  metrics::set_lock_profiling_enabled(false);
+  BOOST_ASSERT(metrics::lock_stats()[site].acquisitions == 2);
+  BOOST_ASSERT(metrics::lock_stats()[site].contentions == 0);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldWorkWithConditionVariable) {
+  metrics::set_lock_profiling_enabled(true);
+  metrics::InstrumentedMutex mutex("instrumented_mutex_test/cv");
+  std::condition_variable_any cv;
+  bool ready = false;
+  std::thread thread([&]() {
+    {
+      std::lock_guard<metrics::InstrumentedMutex> guard(mutex);
+      ready = true;
+    }
+    cv.notify_one();
+  });
+  {
+    std::unique_lock<metrics::InstrumentedMutex> lock(mutex);
+    cv.wait(lock, [&ready]() { return ready; });
+  }
+  thread.join();
+  metrics::set_lock_profiling_enabled(false);
+  BOOST_ASSERT(metrics::lock_stats()["instrumented_mutex_test/cv"]
+                   .acquisitions >= 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+}
@@ -1,5 +1,6 @@
 #include <boost/test/unit_test.hpp>
 #include <p2psc/log.h>
+#include <p2psc/socket_factory.h>
 #include <socket/local_listening_socket.h>
 #include <condition_variable>
 
@@ -44,12 +45,15 @@ BOOST_AUTO_TEST_CASE(ShouldBindToSpecifiedPort) {
 BOOST_AUTO_TEST_CASE(ShouldAcceptAndCreateSocket) {
   std::mutex mutex;
   std::condition_variable cv;
-  uint16_t port;
+  uint16_t port = 0;
   bool has_received_message = false;
   std::thread thread([&]() mutable {
     const auto listener =
         std::make_unique<socket::LocalListeningSocket>(socket_creator);
-    port = listener->get_socket_address().port();
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      port = listener->get_socket_address().port();
+    }
     cv.notify_one();
     const auto socket = listener->accept();
     BOOST_ASSERT(socket != nullptr);
@@ -59,7 +63,7 @@ BOOST_AUTO_TEST_CASE(ShouldAcceptAndCreateSocket) {
   });
 
   std::unique_lock<std::mutex> lock(mutex);
-  cv.wait(lock);
+  cv.wait(lock, [&port]() { return port != 0; });
   const auto address = socket::SocketAddress("127.0.0.1", port);
   try {
     const auto socket = std::make_shared<Socket>(address);
@@ -71,6 +75,17 @@ BOOST_AUTO_TEST_CASE(ShouldAcceptAndCreateSocket) {
   BOOST_ASSERT(has_received_message);
 }
 
+BOOST_AUTO_TEST_CASE(ShouldAcceptWithSocketFactory) {
+  const PlainSocketFactory socket_factory;
+  const auto listener = std::make_unique<socket::LocalListeningSocket>(0);
+  // the connection is queued until accept() is called
+  const auto client = socket_factory.create(listener->get_socket_address());
+  const std::shared_ptr<PlainSocket> socket = listener->accept(socket_factory);
+  BOOST_ASSERT(socket != nullptr);
+  client->send("bananas");
+  BOOST_ASSERT(socket->receive() == "bananas");
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 }
 }
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include <boost/test/unit_test.hpp>
+#include <future>
+#include <local/local_listener.h>
+#include <p2psc/local/local_transport.h>
+#include <util/socket_pair.h>
+
+namespace p2psc {
+namespace test {
+namespace {
+const auto kAcceptTimeout = std::chrono::milliseconds(1000);
+
+struct TcpPair {
+  std::shared_ptr<Socket> client;
+  std::shared_ptr<Socket> peer;
+};
+
+TcpPair tcp_pair() {
+  const auto sockets = util::connect();
+  return TcpPair{sockets.first, sockets.second};
+}
+}
+
+BOOST_AUTO_TEST_SUITE(local_transport_test)
+
+BOOST_AUTO_TEST_CASE(ShouldHaveStableHostId) {
+  BOOST_ASSERT(local::host_id().size() == 64);
+  BOOST_ASSERT(local::host_id() == local::host_id());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldReplaceTcpConnectionWithUnixDomainSocket) {
+  const auto tcp = tcp_pair();
+  const auto peer_address = tcp.client->get_socket_address();
+  local::LocalListener listener;
+
+  auto accepted = std::async(std::launch::async, [&]() {
+    return listener.accept(*tcp.peer, kAcceptTimeout);
+  });
+  const auto client = local::connect(listener.name(), listener.token(),
+                                     *tcp.client, kAcceptTimeout);
+  const auto peer = accepted.get();
+  BOOST_ASSERT(client && peer);
+  BOOST_ASSERT(client->get_socket_address() == peer_address);
+
+  client->send("hello");
+  BOOST_ASSERT(peer->receive() == "hello");
+  peer->send("world");
+  BOOST_ASSERT(client->receive() == "world");
+  BOOST_CHECK_THROW(tcp.client->send("closed"), socket::SocketException);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldStayOnTcpIfUnixDomainSocketIsUnavailable) {
+  const auto tcp = tcp_pair();
+  local::LocalListener listener;
+
+  BOOST_ASSERT(!local::connect("p2psc-missing", listener.token(),
+                               *tcp.client, kAcceptTimeout));
+  BOOST_ASSERT(!listener.accept(*tcp.peer, std::chrono::milliseconds(10)));
+  tcp.client->send("hello");
+  BOOST_ASSERT(tcp.peer->receive() == "hello");
+}
+
+BOOST_AUTO_TEST_CASE(ShouldRejectConnectionWithoutToken) {
+  const auto tcp = tcp_pair();
+  const auto intruder_tcp = tcp_pair();
+  local::LocalListener listener;
+  auto accepted = std::async(std::launch::async, [&]() {
+    return listener.accept(*tcp.peer, kAcceptTimeout);
+  });
+
+  // connecting first doesn't get it the Client's connection
+  const std::string wrong_token(listener.token().size(), '0');
+  BOOST_ASSERT(!local::connect(listener.name(), wrong_token,
+                               *intruder_tcp.client, kAcceptTimeout));
+  intruder_tcp.client->send("hello");
+  BOOST_ASSERT(intruder_tcp.peer->receive() == "hello");
+
+  const auto client = local::connect(listener.name(), listener.token(),
+                                     *tcp.client, kAcceptTimeout);
+  const auto peer = accepted.get();
+  BOOST_ASSERT(client && peer);
+  client->send("hello");
+  BOOST_ASSERT(peer->receive() == "hello");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+}
@@ -0,0 +1,56 @@
+#include <boost/test/unit_test.hpp>
+#include <future>
+#include <p2psc/message/message_exception.h>
+#include <p2psc/message/message_reader.h>
+#include <thread>
+#include <util/socket_pair.h>
+
+namespace p2psc {
+namespace test {
+
+BOOST_AUTO_TEST_SUITE(message_reader_test)
+
+BOOST_AUTO_TEST_CASE(ShouldReassembleMessagesReceivedInPieces) {
+  message::MessageReader reader;
+  reader.append("{\"type\":3,\"payload\":{\"key\":\"}{\\\"");
+  BOOST_ASSERT(!reader.next());
+  reader.append("\"}}{\"type\":4");
+  BOOST_ASSERT(*reader.next() ==
+               "{\"type\":3,\"payload\":{\"key\":\"}{\\\"\"}}");
+  BOOST_ASSERT(!reader.next());
+  reader.append(",\"payload\":{}}");
+  BOOST_ASSERT(*reader.next() == "{\"type\":4,\"payload\":{}}");
+  BOOST_ASSERT(reader.take_rest().empty());
+
+  reader.append("not json");
+  BOOST_ASSERT(*reader.next() == "not json");
+}
+
+BOOST_AUTO_TEST_CASE(ShouldRejectOversizedMessage) {
+  message::MessageReader reader;
+  reader.append("{\"key\":\"" + std::string(message::kMaxMessageSize, 'a'));
+  BOOST_CHECK_THROW(reader.next(), message::MessageException);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldPutBackWhatFollowsMessage) {
+  const auto sockets = util::connect();
+  const auto &client = sockets.first;
+  const auto &server = sockets.second;
+
+  // arriving in two pieces, as a message larger than a segment may
+  const auto message = "{\"key\":\"" + std::string(5000, 'a') + "\"}";
+  client->send(message.substr(0, 3000));
+  auto sending = std::async(std::launch::async, [&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    client->send(message.substr(3000) + "data");
+  });
+  BOOST_ASSERT(message::receive_message(*server) == message);
+  sending.get();
+  char data[4];
+  server->receive_exactly(data, sizeof(data));
+  BOOST_ASSERT(std::string(data, sizeof(data)) == "data");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+}
@@ -6,6 +6,10 @@
 #include <p2psc/message/advertise_response.h>
 #include <p2psc/message/advertise_retry.h>
 #include <p2psc/message/message.h>
+#include <p2psc/message/dht_query.h>
+#include <p2psc/message/dht_response.h>
+#include <p2psc/message/introduction.h>
+#include <p2psc/message/lan_announcement.h>
 #include <p2psc/message/message_decoder.h>
 #include <p2psc/message/peer_acknowledgement.h>
 #include <p2psc/message/peer_challenge.h>
@@ -63,10 +67,47 @@ BOOST_AUTO_TEST_CASE(ShouldSerialiseAndDeserialiseAllMessageTypes) {
   verifySerialisation(message::PeerDisconnect{1});
   verifySerialisation(message::PeerIdentification{1, "127.0.0.1", 1337});
   verifySerialisation(message::PeerChallenge{"test_encrypted_nonce"});
+  verifySerialisation(
+      message::PeerChallenge{"test_encrypted_nonce", std::string("zstd"), 7});
   verifySerialisation(message::PeerChallengeResponse{"test_encrypted_nonce",
                                                      "test_decrypted_nonce"});
+  verifySerialisation(message::PeerChallengeResponse{
+      "test_encrypted_nonce", "test_decrypted_nonce", std::string("zstd"), 0});
+  verifySerialisation(message::PeerChallenge{
+      "test_encrypted_nonce", boost::none, boost::none, std::string("host")});
+  verifySerialisation(message::PeerChallengeResponse{
+      "test_encrypted_nonce", "test_decrypted_nonce", boost::none, boost::none,
+      std::string("p2psc-test")});
   verifySerialisation(message::PeerResponse{"test_decrypted_nonce"});
+  verifySerialisation(message::PeerChallenge{
+      "test_encrypted_nonce", boost::none, boost::none, boost::none,
+      std::string("test_secret")});
+  verifySerialisation(message::PeerChallengeResponse{
+      "test_encrypted_nonce", "test_decrypted_nonce", boost::none, boost::none,
+      boost::none, std::string("test_secret")});
+  verifySerialisation(message::PeerResponse{"test_decrypted_nonce",
+                                            std::string("test_early_data")});
+  verifySerialisation(message::LanAnnouncement{
+      kVersion, "test_from", "test_to", 1337, 1234567890123, "test_sig"});
+  verifySerialisation(
+      message::Introduction{kVersion, "test_key", true, "127.0.0.1", 1337});
+  const message::DhtRecord record{"test_key", "test_to",     "127.0.0.1",
+                                  1337,       1234567890123, "test_sig"};
+  verifySerialisation(message::DhtQuery{kVersion, 42, "test_id",
+                                        message::kDhtStore, boost::none,
+                                        boost::none, record});
+  verifySerialisation(message::DhtQuery{kVersion, 42, "test_id",
+                                        message::kDhtFindValue,
+                                        std::string("test_target"),
+                                        std::string("test_to"), boost::none});
+  verifySerialisation(message::DhtResponse{
+      42, "test_id", "127.0.0.1", {{"test_id", "127.0.0.1", 1337}},
+      {record}});
   verifySerialisationWithoutPayload(message::PeerAcknowledgement{});
+  verifySerialisation(
+      message::PeerAcknowledgement{std::string("test_early_data")});
+  verifySerialisation(message::PeerAcknowledgement{
+      boost::none, std::string("test_local_socket_token")});
 }
 
 BOOST_AUTO_TEST_SUITE_END()
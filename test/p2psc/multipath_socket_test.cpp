@@ -0,0 +1,179 @@
+#include <boost/test/unit_test.hpp>
+#include <future>
+#include <p2psc/multipath/multipath_socket.h>
+#include <random>
+#include <util/socket_pair.h>
+
+namespace p2psc {
+namespace test {
+namespace {
+struct Paths {
+  std::vector<std::shared_ptr<Socket>> ours;
+  std::vector<std::shared_ptr<Socket>> theirs;
+};
+
+Paths connect(std::size_t count) {
+  Paths paths;
+  for (std::size_t i = 0; i < count; i++) {
+    const auto sockets = util::connect();
+    paths.ours.push_back(sockets.first);
+    paths.theirs.push_back(sockets.second);
+  }
+  return paths;
+}
+
+std::string random_data(std::size_t size) {
+  std::mt19937 random(1);
+  std::string data(size, '\0');
+  for (auto &byte : data) {
+    byte = static_cast<char>(random());
+  }
+  return data;
+}
+
+std::string receive(Socket &socket, std::size_t size) {
+  std::string received;
+  while (received.size() < size) {
+    received += socket.receive();
+  }
+  return received;
+}
+
+multipath::MultipathOptions small_segments() {
+  multipath::MultipathOptions options;
+  options.segment_size = 1000;
+  options.max_pending_bytes = 20000;
+  return options;
+}
+}
+
+BOOST_AUTO_TEST_SUITE(multipath_socket_test)
+
+BOOST_AUTO_TEST_CASE(ShouldReassembleDataSpreadOverPaths) {
+  const auto paths = connect(3);
+  multipath::MultipathSocket ours(paths.ours, small_segments());
+  multipath::MultipathSocket theirs(paths.theirs, small_segments());
+
+  const auto data = random_data(1000000);
+  auto sending = std::async(std::launch::async, [&]() {
+    for (std::size_t offset = 0; offset < data.size(); offset += 12345) {
+      ours.send(data.substr(offset, 12345));
+    }
+  });
+  BOOST_ASSERT(receive(theirs, data.size()) == data);
+  sending.get();
+
+  // and back
+  theirs.send("bananas");
+  BOOST_ASSERT(receive(ours, 7) == "bananas");
+
+  std::size_t paths_used = 0;
+  for (const auto &stats : ours.path_stats()) {
+    BOOST_ASSERT(!stats.failed && stats.quality);
+    paths_used += stats.bytes_sent > 0;
+  }
+  BOOST_ASSERT(paths_used > 1);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldMeasureRoundTripTimes) {
+  const auto paths = connect(2);
+  multipath::MultipathSocket ours(paths.ours);
+  multipath::MultipathSocket theirs(paths.theirs);
+
+  ours.send(random_data(1000));
+  receive(theirs, 1000);
+  // close() waits for the acknowledgement
+  ours.close();
+  const auto stats = ours.path_stats();
+  BOOST_ASSERT(stats[0].rtt_us > 0 || stats[1].rtt_us > 0);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldSurviveFailedPath) {
+  const auto paths = connect(2);
+  multipath::MultipathSocket ours(paths.ours, small_segments());
+  // their end of the second path is gone
+  paths.theirs[1]->close();
+  multipath::MultipathSocket theirs({paths.theirs[0]}, small_segments());
+
+  const auto data = random_data(100000);
+  ours.send(data);
+  BOOST_ASSERT(receive(theirs, data.size()) == data);
+  ours.close();
+  BOOST_ASSERT(ours.path_stats()[1].failed);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldThrowOnceOtherEndCloses) {
+  const auto paths = connect(2);
+  multipath::MultipathSocket ours(paths.ours);
+  auto theirs =
+      std::make_unique<multipath::MultipathSocket>(paths.theirs);
+
+  theirs->send("bananas");
+  theirs.reset();
+  BOOST_ASSERT(receive(ours, 7) == "bananas");
+  BOOST_CHECK_THROW(ours.receive(), socket::SocketException);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldMoveToAddedPath) {
+  const auto paths = connect(2);
+  auto options = small_segments();
+  options.wait_for_paths = true;
+  multipath::MultipathSocket ours({paths.ours[0]}, options);
+  multipath::MultipathSocket theirs({paths.theirs[0]}, options);
+  bool disconnected = false;
+  ours.set_disconnect_handler([&disconnected]() { disconnected = true; });
+
+  ours.send("bananas");
+  BOOST_ASSERT(receive(theirs, 7) == "bananas");
+  ours.drop_paths_from("127.0.0.1", "Gone");
+  BOOST_ASSERT(disconnected);
+  // blocks until there is a path again
+  const auto data = random_data(50000);
+  auto sending = std::async(std::launch::async, [&]() { ours.send(data); });
+  ours.add_path(paths.ours[1]);
+  theirs.add_path(paths.theirs[1]);
+  BOOST_ASSERT(receive(theirs, data.size()) == data);
+  sending.get();
+  BOOST_ASSERT(ours.path_stats().size() == 2);
+  BOOST_ASSERT(ours.path_stats()[0].failed);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldFailSilentPath) {
+  const auto paths = connect(1);
+  multipath::MultipathOptions options;
+  options.heartbeat_interval_ms = 10;
+  options.path_timeout_ms = 100;
+  multipath::MultipathSocket ours(paths.ours, options);
+  // the other end is a plain socket, which sends no heartbeats
+  BOOST_CHECK_THROW(ours.receive(), socket::SocketException);
+  BOOST_ASSERT(ours.path_stats()[0].failed);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldFailPathOnMalformedFrame) {
+  // a segment claiming 4 GiB, and a heartbeat with a payload
+  const std::vector<std::string> frames = {
+      std::string(9, '\0') + std::string(4, '\xff'),
+      std::string(1, '\2') + std::string(11, '\0') + std::string(1, '\1')};
+  for (const auto &frame : frames) {
+    const auto paths = connect(1);
+    multipath::MultipathSocket ours(paths.ours, small_segments());
+    paths.theirs[0]->send(frame);
+    BOOST_CHECK_THROW(ours.receive(), socket::SocketException);
+    BOOST_ASSERT(ours.path_stats()[0].failed);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ShouldThrowWhenAbandoned) {
+  const auto paths = connect(1);
+  multipath::MultipathOptions options;
+  options.wait_for_paths = true;
+  multipath::MultipathSocket ours(paths.ours, options);
+  paths.theirs[0]->close();
+  auto receiving = std::async(std::launch::async, [&]() { ours.receive(); });
+  ours.abandon("Gave up");
+  BOOST_CHECK_THROW(receiving.get(), socket::SocketException);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+}
@@ -0,0 +1,83 @@
+#include <atomic>
+#include <boost/test/unit_test.hpp>
+#include <future>
+#include <p2psc/local/local_socket.h>
+#include <p2psc/metrics/path_quality_sampler.h>
+#include <sys/socket.h>
+#include <thread>
+#include <util/socket_pair.h>
+
+namespace p2psc {
+namespace test {
+namespace {
+
+void wait_until(std::function<bool()> condition) {
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (!condition() && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  BOOST_ASSERT(condition());
+}
+}
+
+BOOST_AUTO_TEST_SUITE(path_quality_test)
+
+BOOST_AUTO_TEST_CASE(ShouldReportPathQualityOfTcpConnections) {
+  const auto sockets = util::connect();
+  for (auto i = 0; i < 10; i++) {
+    sockets.first->send(std::string(1000, 'x'));
+    sockets.second->receive();
+    sockets.second->send("ack");
+    sockets.first->receive();
+  }
+  const auto quality = sockets.first->get_path_quality();
+  BOOST_ASSERT(quality);
+  BOOST_ASSERT(quality->rtt_us > 0);
+  BOOST_ASSERT(quality->congestion_window > 0 && quality->mss > 0);
+  BOOST_ASSERT(quality->bytes_in_flight == 0);
+
+  int fds[2];
+  BOOST_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  const socket::SocketAddress address(socket::local_ip, 1);
+  local::LocalSocket local_socket(fds[0], address, address);
+  BOOST_ASSERT(!local_socket.get_path_quality());
+  close(fds[1]);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldSampleSocketsUntilTheyAreDestroyed) {
+  auto sockets = util::connect();
+  std::atomic<int> samples(0);
+  metrics::PathQualitySampler sampler(
+      std::chrono::milliseconds(5),
+      [&](const std::string &name, const socket::PathQuality &) {
+        BOOST_ASSERT(name == "client");
+        samples++;
+      });
+  sampler.add("client", sockets.first);
+  wait_until([&]() { return samples >= 3; });
+
+  sockets.first = nullptr;
+  wait_until([&]() { return sampler.latest().empty(); });
+}
+
+BOOST_AUTO_TEST_CASE(ShouldSampleAddedSocketsStraightAwayOnItsThread) {
+  const auto sockets = util::connect();
+  std::atomic<int> samples(0);
+  std::thread::id handler_thread;
+  metrics::PathQualitySampler sampler(
+      std::chrono::hours(1),
+      [&](const std::string &, const socket::PathQuality &) {
+        handler_thread = std::this_thread::get_id();
+        samples++;
+      });
+  sampler.add("client", sockets.first);
+  sampler.add("server", sockets.second);
+  // long before the first round is due
+  wait_until([&]() { return sampler.latest().size() == 2 && samples == 2; });
+  BOOST_ASSERT(handler_thread != std::this_thread::get_id());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+}
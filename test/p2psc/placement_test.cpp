@@ -0,0 +1,63 @@
+#include <boost/test/unit_test.hpp>
+#include <p2psc/placement/placement.h>
+#include <p2psc/placement/placement_exception.h>
+#include <thread>
+#include <util/socket_pair.h>
+
+namespace p2psc {
+namespace test {
+
+BOOST_AUTO_TEST_SUITE(placement_test)
+
+BOOST_AUTO_TEST_CASE(ShouldParseCpuList) {
+  const auto cpus = placement::CpuSet::parse("0-3, 8,10-11,2");
+  BOOST_ASSERT((cpus.cpus() == std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+  BOOST_ASSERT(cpus.contains(8));
+  BOOST_ASSERT(!cpus.contains(9));
+  BOOST_ASSERT(cpus.to_string() == "0-3,8,10-11");
+  BOOST_ASSERT(placement::CpuSet::parse("").empty());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldNotParseInvalidCpuList) {
+  for (const auto cpu_list : {"a", "3-1", "-1", "1-"}) {
+    try {
+      placement::CpuSet::parse(cpu_list);
+      BOOST_FAIL("Should have thrown PlacementException");
+    } catch (const placement::PlacementException &e) {
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ShouldPinThreadToCpu) {
+  std::thread thread([]() {
+    const auto cpu = placement::current_cpu();
+    placement::CpuSet cpus;
+    cpus.add(cpu);
+    placement::pin_current_thread(cpus);
+    BOOST_ASSERT(placement::current_cpu() == cpu);
+    // the CPU we run on always belongs to some NUMA node, and that node
+    // contains it.
+    const auto node = placement::numa_node_of_cpu(cpu);
+    BOOST_ASSERT(placement::CpuSet::of_numa_node(node).contains(cpu));
+  });
+  thread.join();
+}
+
+BOOST_AUTO_TEST_CASE(ShouldReportIncomingCpuOfAcceptedSocket) {
+  const auto sockets = util::connect();
+  sockets.first->send("bananas");
+  sockets.second->receive();
+  const auto incoming_cpu = sockets.second->get_incoming_cpu();
+  if (incoming_cpu == -1) {
+    BOOST_TEST_MESSAGE("SO_INCOMING_CPU is unsupported, skipping");
+    return;
+  }
+  // over loopback, the packets were received by one of our own CPUs
+  BOOST_ASSERT(incoming_cpu >= 0 &&
+               static_cast<unsigned>(incoming_cpu) <
+                   std::thread::hardware_concurrency());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+}
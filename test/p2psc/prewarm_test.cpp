@@ -0,0 +1,51 @@
+#include <boost/test/unit_test.hpp>
+#include <future>
+#include <p2psc/socket/socket_exception.h>
+#include <prewarm/warm_set.h>
+#include <util/socket_pair.h>
+
+namespace p2psc {
+namespace test {
+
+BOOST_AUTO_TEST_SUITE(prewarm_test)
+
+BOOST_AUTO_TEST_CASE(ShouldWaitForConnectionBeingPrewarmed) {
+  prewarm::WarmSet warm_set;
+  const auto sockets = util::connect();
+  BOOST_ASSERT(warm_set.start("key"));
+  BOOST_ASSERT(!warm_set.start("key"));
+
+  auto taken = std::async(std::launch::async,
+                          [&]() { return warm_set.take("key"); });
+  BOOST_ASSERT(taken.wait_for(std::chrono::milliseconds(50)) ==
+               std::future_status::timeout);
+  auto parked = std::async(std::launch::async, [&]() {
+    warm_set.park("key", sockets.first, std::chrono::milliseconds(10000));
+  });
+  BOOST_ASSERT(taken.get() == sockets.first);
+  // handing the socket over ends the park
+  parked.get();
+  BOOST_ASSERT(warm_set.size() == 0);
+  BOOST_ASSERT(warm_set.take("key") == nullptr);
+
+  // a failed prewarm leaves connect() to connect itself
+  BOOST_ASSERT(warm_set.start("key"));
+  warm_set.park("key", nullptr, std::chrono::milliseconds(10000));
+  BOOST_ASSERT(warm_set.take("key") == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldCloseParkedConnectionAfterTtl) {
+  prewarm::WarmSet warm_set;
+  const auto sockets = util::connect();
+  BOOST_ASSERT(warm_set.start("key"));
+  warm_set.park("key", sockets.first, std::chrono::milliseconds(20));
+
+  BOOST_ASSERT(warm_set.size() == 0);
+  BOOST_ASSERT(warm_set.take("key") == nullptr);
+  // the other end sees it closed
+  BOOST_CHECK_THROW(sockets.second->receive(), socket::SocketException);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+}
@@ -0,0 +1,113 @@
+#include <boost/test/unit_test.hpp>
+#include <future>
+#include <p2psc/rpc/channel.h>
+#include <p2psc/rpc/rpc_exception.h>
+#include <util/socket_pair.h>
+
+namespace p2psc {
+namespace test {
+namespace {
+
+const auto kTimeout = std::chrono::milliseconds(5000);
+}
+
+BOOST_AUTO_TEST_SUITE(rpc_test)
+
+BOOST_AUTO_TEST_CASE(ShouldMatchOutOfOrderResponsesToCalls) {
+  const auto sockets = util::connect();
+  std::mutex mutex;
+  std::vector<std::pair<std::string, rpc::Responder>> requests;
+  std::promise<void> all_received;
+  rpc::Channel server(sockets.second, [&](const std::string &method,
+                                          rpc::Payload request,
+                                          rpc::Responder responder) {
+    std::lock_guard<std::mutex> guard(mutex);
+    requests.emplace_back(method + ":" + request.to_string(), responder);
+    if (requests.size() == 10) {
+      all_received.set_value();
+    }
+  });
+  rpc::Channel client(sockets.first,
+                      [](const std::string &, rpc::Payload request,
+                         rpc::Responder responder) {
+                        responder.respond(request.to_string());
+                      });
+
+  std::vector<std::promise<std::string>> responses(10);
+  for (auto i = 0; i < 10; i++) {
+    client.call("echo", std::to_string(i), kTimeout,
+                [&responses, i](Error error, rpc::Payload response) {
+                  BOOST_ASSERT(!error);
+                  responses[i].set_value(response.to_string());
+                });
+  }
+  all_received.get_future().get();
+  BOOST_ASSERT(client.outstanding_calls() == 10);
+
+  // answered last to first
+  for (auto it = requests.rbegin(); it != requests.rend(); ++it) {
+    it->second.respond(it->first);
+  }
+  for (auto i = 0; i < 10; i++) {
+    BOOST_ASSERT(responses[i].get_future().get() ==
+                 "echo:" + std::to_string(i));
+  }
+  BOOST_ASSERT(client.outstanding_calls() == 0);
+
+  // and in the other direction, with a large payload
+  const auto large = std::string(1 << 20, 'x');
+  BOOST_ASSERT(server.call("echo", large, kTimeout) == large);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldFailCallsPastDeadlineOrWhenChannelCloses) {
+  const auto sockets = util::connect();
+  rpc::Channel server(sockets.second, [](const std::string &method,
+                                         rpc::Payload request,
+                                         rpc::Responder responder) {
+    if (method == "fail") {
+      responder.fail("no " + request.to_string());
+    } else if (method == "throw") {
+      throw std::runtime_error("thrown");
+    }
+    // anything else is never answered
+  });
+  auto client = std::make_unique<rpc::Channel>(sockets.first);
+
+  std::promise<Error> late;
+  client->call("slow", "", std::chrono::milliseconds(50),
+               [&](Error error, rpc::Payload) { late.set_value(error); });
+  BOOST_ASSERT(late.get_future().get().kind() ==
+               error::kErrorRpcDeadlineExceeded);
+
+  try {
+    client->call("fail", "bananas", kTimeout);
+    BOOST_FAIL("Should have thrown RpcException");
+  } catch (const rpc::RpcException &e) {
+    BOOST_ASSERT(std::string(e.what()) == "no bananas");
+  }
+  BOOST_CHECK_THROW(client->call("throw", "", kTimeout), rpc::RpcException);
+
+  std::promise<Error> outstanding;
+  client->call("slow", "", kTimeout, [&](Error error, rpc::Payload) {
+    outstanding.set_value(error);
+  });
+  client.reset();
+  BOOST_ASSERT(outstanding.get_future().get().kind() ==
+               error::kErrorRpcChannelClosed);
+
+  // the server notices the connection went away
+  for (auto i = 0; i < 100; i++) {
+    std::promise<Error> result;
+    server.call("slow", "", std::chrono::milliseconds(10),
+                [&](Error error, rpc::Payload) { result.set_value(error); });
+    const auto error = result.get_future().get();
+    if (error.kind() == error::kErrorRpcChannelClosed) {
+      return;
+    }
+  }
+  BOOST_FAIL("Server channel should have closed");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+}
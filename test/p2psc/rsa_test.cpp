@@ -2,6 +2,8 @@
 #include <crypto/rsa.h>
 #include <iostream>
 #include <p2psc/crypto/crypto_exception.h>
+#include <p2psc/key/keypair.h>
+#include <p2psc/key/public_key.h>
 
 namespace p2psc {
 namespace test {
@@ -112,6 +114,24 @@ BOOST_AUTO_TEST_CASE(ShouldRestoreKeyFromFile) {
   remove(filename);
 }
 
+BOOST_AUTO_TEST_CASE(ShouldRestoreKeyFromDerFile) {
+  const auto generated_key = crypto::RSA::generate();
+  const auto filename = "/tmp/p2psc_testfile.der";
+  generated_key->write_der_to_file(filename);
+  const auto key = crypto::RSA::from_der(filename);
+  BOOST_ASSERT(key->get_public_key_string() ==
+               generated_key->get_public_key_string());
+  const auto encrypted = generated_key->public_encrypt(message);
+  BOOST_ASSERT(key->private_decrypt(encrypted) == message);
+  remove(filename);
+
+  // PEM isn't DER
+  generated_key->write_to_file(filename);
+  BOOST_CHECK_THROW(crypto::RSA::from_der(filename), crypto::CryptoException);
+  remove(filename);
+  BOOST_CHECK_THROW(crypto::RSA::from_der(filename), crypto::CryptoException);
+}
+
 BOOST_AUTO_TEST_CASE(ShouldNotRestoreKeyFromNonExistantFile) {
   try {
     crypto::RSA::from_pem("file_does_not_exist.pem");
@@ -180,6 +200,57 @@ BOOST_AUTO_TEST_CASE(ShouldNotDecryptWithoutPassword) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(ShouldVerifySignatureOnlyWithSignersKey) {
+  const auto keypair = key::Keypair::generate();
+  const auto public_key =
+      key::PublicKey::from_string(keypair.get_serialised_public_key());
+  const auto other_key =
+      key::PublicKey::from_string(key::Keypair::generate()
+                                      .get_serialised_public_key());
+  const auto signature = keypair.sign(message);
+  BOOST_ASSERT(public_key.verify(message, signature));
+  BOOST_ASSERT(!public_key.verify("apples", signature));
+  BOOST_ASSERT(!other_key.verify(message, signature));
+  BOOST_ASSERT(!public_key.verify(message, "not a signature"));
+}
+
+BOOST_AUTO_TEST_CASE(ShouldUseMultiPrimeKeysLikeTwoPrimeKeys) {
+  const auto key = crypto::RSA::generate(kDefaultKeySize, 3);
+  BOOST_ASSERT(key->primes() == 3 && key->key_size() == kDefaultKeySize);
+  // other peers only see an ordinary public key
+  const auto public_key =
+      crypto::RSA::from_public_key(key->get_public_key_string());
+  BOOST_ASSERT(public_key->primes() == 0);
+  BOOST_ASSERT(key->private_decrypt(public_key->public_encrypt(message)) ==
+               message);
+  BOOST_ASSERT(public_key->public_decrypt(key->private_encrypt(message)) ==
+               message);
+
+  const auto filename = "/tmp/p2psc_testfile";
+  key->write_to_file(filename, "password", "aes-256-cbc");
+  const auto restored_key = crypto::RSA::from_pem(filename, "password");
+  BOOST_ASSERT(restored_key->primes() == 3);
+  BOOST_ASSERT(restored_key->private_decrypt(key->public_encrypt(message)) ==
+               message);
+  remove(filename);
+
+  key::KeyOptions options;
+  options.size = 3072;
+  options.primes = 3;
+  const auto keypair = key::Keypair::generate(options);
+  const auto verifier =
+      key::PublicKey::from_string(keypair.get_serialised_public_key());
+  BOOST_ASSERT(verifier.verify(message, keypair.sign(message)));
+}
+
+BOOST_AUTO_TEST_CASE(ShouldNotGenerateKeysWithTooManyPrimes) {
+  BOOST_CHECK_THROW(crypto::RSA::generate(kDefaultKeySize, 4),
+                    crypto::CryptoException);
+  BOOST_CHECK_THROW(crypto::RSA::generate(512, 3), crypto::CryptoException);
+  BOOST_CHECK_THROW(crypto::RSA::generate(kDefaultKeySize, 1),
+                    crypto::CryptoException);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 }
\ No newline at end of file
@@ -0,0 +1,245 @@
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+#include <fstream>
+#include <future>
+#include <p2psc/socket/socket_layer.h>
+#include <p2psc/transfer/transfer.h>
+#include <p2psc/transfer/transfer_exception.h>
+#include <p2psc/transfer/tree_hash.h>
+#include <random>
+#include <transfer/manifest.h>
+#include <util/socket_pair.h>
+
+namespace p2psc {
+namespace test {
+namespace {
+const std::size_t kChunkSize = 4096;
+
+struct Connections {
+  std::vector<std::shared_ptr<Socket>> senders;
+  std::vector<std::shared_ptr<Socket>> receivers;
+};
+
+Connections connect(std::size_t count) {
+  Connections connections;
+  for (std::size_t i = 0; i < count; i++) {
+    const auto sockets = util::connect();
+    connections.senders.push_back(sockets.first);
+    connections.receivers.push_back(sockets.second);
+  }
+  return connections;
+}
+
+struct Directories {
+  Directories()
+      : source(boost::filesystem::temp_directory_path() /
+               boost::filesystem::unique_path()),
+        destination(boost::filesystem::temp_directory_path() /
+                    boost::filesystem::unique_path()) {
+    boost::filesystem::create_directory(source);
+    boost::filesystem::create_directory(destination);
+  }
+  ~Directories() {
+    boost::filesystem::remove_all(source);
+    boost::filesystem::remove_all(destination);
+  }
+
+  const boost::filesystem::path source;
+  const boost::filesystem::path destination;
+};
+
+// sends garbage in place of file data
+class CorruptingSocket : public socket::SocketLayer {
+public:
+  using SocketLayer::SocketLayer;
+
+  void send_file(int, off_t, std::size_t size) override {
+    send(std::string(size, 'x'));
+  }
+};
+
+std::string random_data(std::size_t size) {
+  std::mt19937 random(1);
+  std::string data(size, '\0');
+  for (auto &byte : data) {
+    byte = static_cast<char>(random());
+  }
+  return data;
+}
+
+void write_file(const boost::filesystem::path &path, const std::string &data) {
+  std::ofstream file(path.string(), std::ios::binary);
+  file << data;
+}
+
+// sends payload as a manifest frame, as a sender would
+void send_manifest(Socket &socket, const std::string &payload,
+                   std::uint32_t size) {
+  std::string frame(1, 0);
+  for (auto shift : {24, 16, 8, 0}) {
+    frame += static_cast<char>(size >> shift);
+  }
+  socket.send(frame + payload);
+}
+
+void send_manifest(Socket &socket, const std::string &payload) {
+  send_manifest(socket, payload, payload.size());
+}
+
+std::string read_file(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+}
+
+transfer::ReceivedFile transfer_file(const Directories &directories,
+                                     const std::string &name,
+                                     std::size_t connection_count,
+                                     transfer::TransferStats &sent) {
+  const auto connections = connect(connection_count);
+  transfer::TransferOptions options;
+  options.chunk_size = kChunkSize;
+  auto sending = std::async(std::launch::async, [&]() {
+    return transfer::send_file((directories.source / name).string(),
+                               connections.senders, options);
+  });
+  const auto received = transfer::receive_file(
+      directories.destination.string(), connections.receivers);
+  sent = sending.get();
+  return received;
+}
+}
+
+BOOST_AUTO_TEST_SUITE(transfer_test)
+
+BOOST_AUTO_TEST_CASE(ShouldHashTree) {
+  const auto a = transfer::TreeHash::hash_chunk("a", 1);
+  const auto b = transfer::TreeHash::hash_chunk("b", 1);
+  const auto c = transfer::TreeHash::hash_chunk("c", 1);
+  BOOST_ASSERT(a.size() == 32);
+  BOOST_ASSERT(transfer::TreeHash({a}).root() == a);
+  // the unpaired leaf is carried up a level
+  const auto ab = transfer::TreeHash({a, b}).root();
+  BOOST_ASSERT(transfer::TreeHash({a, b, c}).root() ==
+               transfer::TreeHash({ab, c}).root());
+  BOOST_ASSERT(transfer::TreeHash({a, b, c}).root() !=
+               transfer::TreeHash({a, c, b}).root());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldTransferFileOverSeveralConnections) {
+  const Directories directories;
+  // not a multiple of the chunk size
+  const auto data = random_data(100 * kChunkSize + 123);
+  write_file(directories.source / "artifact", data);
+
+  transfer::TransferStats sent;
+  const auto received = transfer_file(directories, "artifact", 4, sent);
+  BOOST_ASSERT(received.path ==
+               (directories.destination / "artifact").string());
+  BOOST_ASSERT(read_file(received.path) == data);
+  BOOST_ASSERT(sent.chunks == 101);
+  BOOST_ASSERT(sent.chunks_transferred == 101);
+  BOOST_ASSERT(received.stats.bytes_transferred == data.size());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldTransferEmptyFile) {
+  const Directories directories;
+  write_file(directories.source / "empty", "");
+
+  transfer::TransferStats sent;
+  const auto received = transfer_file(directories, "empty", 1, sent);
+  BOOST_ASSERT(read_file(received.path).empty());
+  BOOST_ASSERT(sent.chunks == 1);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldResumePartialTransfer) {
+  const Directories directories;
+  const auto data = random_data(10 * kChunkSize);
+  write_file(directories.source / "artifact", data);
+  // the first 6 chunks arrived before the transfer was interrupted, the
+  // 7th only partly
+  auto partial = data.substr(0, 6 * kChunkSize + 10);
+  partial.resize(data.size(), '\0');
+  write_file(directories.destination / "artifact.partial", partial);
+
+  transfer::TransferStats sent;
+  const auto received = transfer_file(directories, "artifact", 2, sent);
+  BOOST_ASSERT(read_file(received.path) == data);
+  BOOST_ASSERT(sent.chunks_transferred == 4);
+  BOOST_ASSERT(received.stats.chunks_transferred == 4);
+  BOOST_ASSERT(!boost::filesystem::exists(directories.destination /
+                                          "artifact.partial"));
+}
+
+BOOST_AUTO_TEST_CASE(ShouldFailForMissingFile) {
+  const Directories directories;
+  BOOST_CHECK_THROW(
+      transfer::send_file((directories.source / "missing").string(),
+                          connect(1).senders),
+      transfer::TransferException);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldStopEveryConnectionWhenOneFails) {
+  const Directories directories;
+  // large enough that the sender is still sending when the receiver fails
+  write_file(directories.source / "artifact", random_data(16 << 20));
+  auto connections = connect(2);
+  connections.senders[0] =
+      std::make_shared<CorruptingSocket>(connections.senders[0]);
+  transfer::TransferOptions options;
+  options.chunk_size = kChunkSize;
+  auto sending = std::async(std::launch::async, [&]() {
+    transfer::send_file((directories.source / "artifact").string(),
+                        connections.senders, options);
+  });
+  BOOST_CHECK_THROW(transfer::receive_file(directories.destination.string(),
+                                           connections.receivers),
+                    transfer::TransferException);
+  BOOST_CHECK_THROW(sending.get(), transfer::TransferException);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldRejectChunksTooLargeForFrame) {
+  const Directories directories;
+  write_file(directories.source / "artifact", "data");
+  transfer::TransferOptions options;
+  options.chunk_size = std::size_t(1) << 32;
+  BOOST_CHECK_THROW(
+      transfer::send_file((directories.source / "artifact").string(),
+                          connect(1).senders, options),
+      transfer::TransferException);
+
+  const auto connections = connect(1);
+  const transfer::Manifest manifest{"artifact", 4, options.chunk_size,
+                                    "", {""}};
+  send_manifest(*connections.senders[0], spotify::json::encode(manifest));
+  BOOST_CHECK_THROW(transfer::receive_file(directories.destination.string(),
+                                           connections.receivers),
+                    transfer::TransferException);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldRejectManifestsBeforeAllocating) {
+  const Directories directories;
+  {
+    // if this were allocated, receive_file would wait for 4 GiB to arrive
+    const auto connections = connect(1);
+    send_manifest(*connections.senders[0], "{", UINT32_MAX);
+    BOOST_CHECK_THROW(transfer::receive_file(directories.destination.string(),
+                                             connections.receivers),
+                      transfer::TransferException);
+  }
+  {
+    // one chunk, if the chunk count overflowed
+    const auto connections = connect(1);
+    const transfer::Manifest manifest{"artifact", UINT64_MAX, kChunkSize, "",
+                                      {""}};
+    send_manifest(*connections.senders[0], spotify::json::encode(manifest));
+    BOOST_CHECK_THROW(transfer::receive_file(directories.destination.string(),
+                                             connections.receivers),
+                      transfer::TransferException);
+  }
+  BOOST_ASSERT(boost::filesystem::is_empty(directories.destination));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <future>
+#include <memory>
+#include <p2psc/socket/socket.h>
+#include <p2psc/socket_factory.h>
+#include <socket/local_listening_socket.h>
+#include <utility>
+
+namespace p2psc {
+namespace test {
+namespace util {
+
+// both ends of a TCP connection over loopback
+inline std::pair<std::shared_ptr<Socket>, std::shared_ptr<Socket>> connect() {
+  socket::LocalListeningSocket listener(0);
+  const PlainSocketFactory socket_factory;
+  auto accepted = std::async(std::launch::async, [&]() {
+    return listener.accept(socket_factory);
+  });
+  const auto client = socket_factory.create(listener.get_socket_address());
+  return std::make_pair(client, accepted.get());
+}
+}
+}
+}